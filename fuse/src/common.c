@@ -70,6 +70,10 @@ OF SUCH DAMAGE.
 */
 
 #include "common.h"
+#include "crc32c.h"
+#include "dedup.h"
+#include "pi_cache.h"
+#include "shard.h"
 
 #include <sys/types.h>          /* uid_t */
 #include <unistd.h>
@@ -81,6 +85,7 @@ OF SUCH DAMAGE.
 #include <stdarg.h>
 #include <regex.h>              // canonicalize()
 #include <assert.h>
+#include <limits.h>             /* XATTR_SIZE_MAX */
 
 // ---------------------------------------------------------------------------
 // COMMON
@@ -188,6 +193,10 @@ int expand_path_info(PathInfo*   info, /* side-effect */
    LOG(LOG_INFO, "sub-path    %s\n", sub_path);
    LOG(LOG_INFO, "md-path     %s\n", info->post.md_path);
 
+   // files in a sharded namespace may be in another MDFS
+   if (shard_resolve(info, sub_path))
+      return -1;
+
 
 #if 0
    // Should be impossible, as long as the trash-dir is not below the mdfs-dir
@@ -340,13 +349,26 @@ int expand_trash_info(PathInfo*    info,
 
 
 int stat_regular(PathInfo* info) {
-   TRY_DECLS();
 
    if (info->flags & PI_STAT_QUERY)
       return 0;                 /* already called stat_regular() */
 
    memset(&(info->st), 0, sizeof(struct stat));
-   __TRY0( MD_PATH_OP(lstat, info->ns, info->post.md_path, &info->st) );
+
+   // fuse may have a recent result (or a recent ENOENT)
+   int hit = pi_cache_stat(info);
+   if (hit < 0)
+      return -1;
+   else if (! hit) {
+      uint64_t gen = pi_cache_gen(info->post.md_path);
+      if (MD_PATH_OP(lstat, info->ns, info->post.md_path, &info->st)) {
+         LOG(LOG_INFO, "lstat(%s) failed (%d) %s\n",
+             info->post.md_path, errno, strerror(errno));
+         pi_cache_put(info, errno, gen);
+         return -1;
+      }
+      pi_cache_put(info, 0, gen);
+   }
 
    info->flags |= PI_STAT_QUERY;
    return 0;
@@ -406,9 +428,10 @@ int init_xattr_specs() {
 
 
 
-// Attempt to read all MarFS system-xattrs from the file.  All values are
-// assumed to be ascii text.  Parse these values to populate fields in the
-// corresponding structs, in PathInfo.
+// Attempt to read all MarFS system-xattrs from the file.  These are either
+// the packed MARFS_MD_XATTR, or (for files that haven't been converted)
+// the older ascii text values.  Parse these values to populate fields in
+// the corresponding structs, in PathInfo.
 //
 // For each found xattr, we set the corresponding flag (XattrValueType) in
 // PathInfo.xattrs.  Then, you can use has_any_xattrs() to test wheter
@@ -444,6 +467,43 @@ int init_xattr_specs() {
 //       overwritten by the (quite possibly incorrect) md_path that is
 //       stored in the xattr.  Do we ever actually want that?
 
+// lgetxattr(), unless the PathInfo cache knows the MD file doesn't have it
+static
+ssize_t read_xattr(PathInfo* info, const XattrSpec* spec,
+                   char* value, XattrMaskType missing) {
+   if (missing & spec->value_type) {
+      errno = ENOATTR;
+      return -1;
+   }
+   return MD_PATH_OP(lgetxattr, info->ns, info->post.md_path,
+                     spec->key_name, value, MARFS_MAX_XATTR_SIZE);
+}
+
+// For MD files without the packed xattr, one llistxattr() tells us which
+// of the text xattrs aren't there, so we don't have to ask for them.  (Most
+// files without MARFS_MD_XATTR are directories or DIRECT files, which
+// have none of them.)  If the list can't be read, we claim nothing is
+// absent, and the xattrs are each asked for, as before.
+static
+XattrMaskType v1_absent(PathInfo* info) {
+   char    names[MARFS_MAX_XATTR_SIZE];
+   ssize_t size = MD_PATH_OP(llistxattr, info->ns, info->post.md_path,
+                             names, MARFS_MAX_XATTR_SIZE);
+   if (size < 0)
+      return 0;
+
+   XattrMaskType present = 0;
+   const char*   name;
+   for (name=names; name < names + size; name += strlen(name) +1) {
+      XattrSpec* spec;
+      for (spec=MarFS_xattr_specs; spec->value_type!=XVT_NONE; ++spec) {
+         if (! strcmp(name, spec->key_name))
+            present |= spec->value_type;
+      }
+   }
+   return (MARFS_PACKED_XATTRS & ~present);
+}
+
 int stat_xattrs(PathInfo* info, int load_md_path) {
    TRY_DECLS();
    ssize_t str_size;
@@ -451,15 +511,56 @@ int stat_xattrs(PathInfo* info, int load_md_path) {
    if (info->flags & PI_XATTR_QUERY)
       return 0;                 // already did this
 
+   // taken before looking at the MDFS.  (See pi_cache.h)
+   uint64_t gen = pi_cache_gen(info->post.md_path);
+
    // call stat_regular().
    __TRY0( stat_regular(info) );
 
+   // Fuse may have parsed these recently.  Values that the MD file doesn't
+   // have are still initialized below.  (Callers asking for the md_path in
+   // POST always go to the MDFS.)
+   XattrMaskType missing = 0;
+   XattrMaskType cached  = (load_md_path ? 0 : pi_cache_xattrs(info, &missing));
+   XattrMaskType prior   = info->xattrs;
+
+   // Files written with xattr_version 2 have Pre, Post and Restart all in
+   // MARFS_MD_XATTR.  Sections it doesn't have are treated like missing
+   // xattrs, below.  Otherwise, we read the text xattrs.
+   char          xattr_value_str[MARFS_MAX_XATTR_SIZE];
+   XattrMaskType packed = 0;    // found in MARFS_MD_XATTR
+   XattrMaskType absent = 0;    // known not to be on the MD file
+
+   if (MARFS_PACKED_XATTRS & ~(cached | missing)) {
+      str_size = MD_PATH_OP(lgetxattr, info->ns, info->post.md_path,
+                            MARFS_MD_XATTR, xattr_value_str, MARFS_MAX_XATTR_SIZE);
+      if (str_size != -1) {
+         uint8_t sections;
+         __TRY0( bin_2_md(&info->pre, &info->post, &info->restart, &sections,
+                          xattr_value_str, str_size, 0, load_md_path) );
+         LOG(LOG_INFO, "packed MD, sections 0x%02x\n", sections);
+         packed        = (sections & MARFS_PACKED_XATTRS);
+         absent        = (MARFS_PACKED_XATTRS & ~packed);
+         info->xattrs |= packed;
+      }
+      else if (errno == ENOATTR)
+         absent = v1_absent(info);
+      else if ((errno == EPERM) && S_ISLNK(info->st.st_mode))
+         absent = MARFS_PACKED_XATTRS; // GPFS: no xattrs on symlinks
+      else {
+         LOG(LOG_INFO, "lgetxattr -> err (%d) %s\n", errno, strerror(errno));
+         return -1;
+      }
+   }
+
    // go through the list of reserved Xattrs, and install string values into
    // fields of the corresponding structs, in PathInfo.
-   char       xattr_value_str[MARFS_MAX_XATTR_SIZE];
    XattrSpec* spec;
    for (spec=MarFS_xattr_specs; spec->value_type!=XVT_NONE; ++spec) {
 
+      if ((cached | packed) & spec->value_type)
+         continue;
+
       switch (spec->value_type) {
 
       case XVT_PRE: {
@@ -467,9 +568,7 @@ int stat_xattrs(PathInfo* info, int load_md_path) {
          // NOTE: If obj doesn't exist, its md_ctime will match the
          //       ctime currently found in info->st, as a result of
          //       the call to stat_regular(), above.
-         str_size = MD_PATH_OP(lgetxattr, info->ns, info->post.md_path,
-                               spec->key_name, xattr_value_str,
-                               MARFS_MAX_XATTR_SIZE);
+         str_size = read_xattr(info, spec, xattr_value_str, (missing | absent));
 
          if (str_size != -1) {
             // got the xattr-value.  Parse it into info->pre
@@ -496,9 +595,7 @@ int stat_xattrs(PathInfo* info, int load_md_path) {
       }
 
       case XVT_POST: {
-         str_size = MD_PATH_OP(lgetxattr, info->ns, info->post.md_path,
-                               spec->key_name, xattr_value_str,
-                               MARFS_MAX_XATTR_SIZE);
+         str_size = read_xattr(info, spec, xattr_value_str, (missing | absent));
 
          if (str_size != -1) {
             // got the xattr-value.  Parse it into info->post
@@ -522,9 +619,7 @@ int stat_xattrs(PathInfo* info, int load_md_path) {
       }
 
       case XVT_RESTART: {
-         str_size = MD_PATH_OP(lgetxattr, info->ns, info->post.md_path,
-                               spec->key_name, xattr_value_str,
-                               MARFS_MAX_XATTR_SIZE);
+         str_size = read_xattr(info, spec, xattr_value_str, (missing | absent));
 
          if (str_size != -1) {
             // got the xattr-value.  Parse it into info->pre
@@ -565,10 +660,17 @@ int stat_xattrs(PathInfo* info, int load_md_path) {
    // subsequent calls can skip processing
    info->flags |= PI_XATTR_QUERY;
 
+   // found text xattrs?  save_xattrs() will convert them.
+   if ((info->xattrs & ~prior) & ~(cached | packed) & MARFS_PACKED_XATTRS)
+      info->flags |= PI_XATTRS_V1;
+
 
    // initialize the object-ID fields
    __TRY0( update_pre(&info->pre) );
 
+   if (! load_md_path && ! (cached | missing))
+      pi_cache_put(info, 0, gen);
+
    return 0;                    /* "success" */
 }
 
@@ -1060,14 +1162,143 @@ int has_any_xattrs(PathInfo* info, XattrMaskType mask) {
 
 
 
-// For all the attributes in <mask>, convert info xattrs to stringified values, and save
-// on info->post.md_path.
-int save_xattrs(PathInfo* info, XattrMaskType mask) {
+// Read back the Pre/Post/Restart that the MD file has now, in either
+// format.  Returns the XattrValueTypes found, or -1.
+static
+int load_md_xattrs(PathInfo*           info,
+                   MarFS_XattrPre*     pre,
+                   MarFS_XattrPost*    post,
+                   MarFS_XattrRestart* restart) {
+   char    value[MARFS_MAX_XATTR_SIZE];
+   ssize_t size;
+
+   memset(pre,  0, sizeof(MarFS_XattrPre));
+   memset(post, 0, sizeof(MarFS_XattrPost));
+   init_restart(restart);
+
+   size = MD_PATH_OP(lgetxattr, info->ns, info->post.md_path,
+                     MARFS_MD_XATTR, value, MARFS_MAX_XATTR_SIZE);
+   if (size >= 0) {
+      uint8_t sections;
+      if (bin_2_md(pre, post, restart, &sections, value, size, 1, 1))
+         return -1;
+      return (sections & MARFS_PACKED_XATTRS);
+   }
+   else if (errno != ENOATTR)
+      return -1;
+
+   // not converted yet
+   int        found = 0;
+   XattrSpec* spec;
+   for (spec=MarFS_xattr_specs; spec->value_type!=XVT_NONE; ++spec) {
+      if (! (spec->value_type & MARFS_PACKED_XATTRS))
+         continue;
+
+      size = MD_PATH_OP(lgetxattr, info->ns, info->post.md_path,
+                        spec->key_name, value, MARFS_MAX_XATTR_SIZE -1);
+      if (size < 0) {
+         if (errno == ENOATTR)
+            continue;
+         return -1;
+      }
+      value[size] = 0;
+
+      int rc = 0;
+      switch (spec->value_type) {
+      case XVT_PRE:      rc = str_2_pre(pre, value, NULL);      break;
+      case XVT_POST:     rc = str_2_post(post, value, 1, 1);    break;
+      case XVT_RESTART:  rc = str_2_restart(restart, value);    break;
+      default:                                                  break;
+      }
+      if (rc) {
+         LOG(LOG_ERR, "couldn't parse %s '%s'\n", spec->key_name, value);
+         return -1;
+      }
+      found |= spec->value_type;
+   }
+
+   if (found)
+      info->flags |= PI_XATTRS_V1;
+   return found;
+}
+
+
+// Save the structs selected by <mask> into MARFS_MD_XATTR.  The others
+// keep whatever the MD file already has, which we have to read back,
+// because they share the one value.  Text xattrs left from before the
+// file was converted are removed afterwards.  A reader that sees both
+// formats believes the packed one.
+static
+int save_md_xattr(PathInfo* info, XattrMaskType mask) {
    TRY_DECLS();
 
-   // call stat_regular().
-   __TRY0( stat_regular(info) );
+   MarFS_XattrPre      pre;
+   MarFS_XattrPost     post;
+   MarFS_XattrRestart  restart;
+   int                 keep = 0;
+
+   if (MARFS_PACKED_XATTRS & ~mask) {
+      __TRY_GE0( keep = load_md_xattrs(info, &pre, &post, &restart) );
+      keep &= ~mask;
+   }
 
+   // pre_2_str() always did this for us
+   if (mask & XVT_PRE)
+      __TRY0( update_pre(&info->pre) );
+
+   // as with the text xattrs, clearing XVT_RESTART in info->xattrs, and
+   // saving it, removes it.
+   const MarFS_XattrPre*     save_pre
+      = ((mask & XVT_PRE)  ? &info->pre  : ((keep & XVT_PRE)  ? &pre  : NULL));
+   const MarFS_XattrPost*    save_post
+      = ((mask & XVT_POST) ? &info->post : ((keep & XVT_POST) ? &post : NULL));
+   const MarFS_XattrRestart* save_restart
+      = ((mask & XVT_RESTART)
+         ? ((info->xattrs & XVT_RESTART) ? &info->restart : NULL)
+         : ((keep & XVT_RESTART) ? &restart : NULL));
+
+   if (save_pre || save_post || save_restart) {
+      char    value[MARFS_MAX_XATTR_SIZE];
+      ssize_t size;
+
+      __TRY_GE0( size = md_2_bin(value, MARFS_MAX_XATTR_SIZE,
+                                 save_pre, save_post, save_restart,
+                                 info->ns->iwrite_repo,
+                                 (info->post.flags & POST_TRASH)) );
+      LOG(LOG_INFO, "%s: %ld bytes\n", MARFS_MD_XATTR, size);
+      __TRY0( MD_PATH_OP(lsetxattr, info->ns, info->post.md_path,
+                         MARFS_MD_XATTR, value, size, 0) );
+   }
+   else if (MD_PATH_OP(lremovexattr, info->ns, info->post.md_path, MARFS_MD_XATTR)
+            && (errno != ENOATTR)) {
+      LOG(LOG_INFO, "ERR removexattr(%s, %s) (%d) %s\n",
+          info->post.md_path, MARFS_MD_XATTR, errno, strerror(errno));
+      return -1;
+   }
+
+   if (info->flags & PI_XATTRS_V1) {
+      XattrSpec* spec;
+      for (spec=MarFS_xattr_specs; spec->value_type!=XVT_NONE; ++spec) {
+         if ((spec->value_type & MARFS_PACKED_XATTRS)
+             && MD_PATH_OP(lremovexattr, info->ns, info->post.md_path, spec->key_name)
+             && (errno != ENOATTR)) {
+            LOG(LOG_INFO, "ERR removexattr(%s, %s) (%d) %s\n",
+                info->post.md_path, spec->key_name, errno, strerror(errno));
+            return -1;
+         }
+      }
+      info->flags &= ~PI_XATTRS_V1;
+   }
+
+   return 0;
+}
+
+
+// For all the attributes in <mask>, convert info xattrs to stringified values, and save
+// on info->post.md_path.
+static
+int save_text_xattrs(PathInfo* info, XattrMaskType mask) {
+   TRY_DECLS();
 
    // go through the list of reserved Xattrs, and install string values into
    // fields of the corresponding structs, in PathInfo.
@@ -1162,6 +1393,70 @@ int save_xattrs(PathInfo* info, XattrMaskType mask) {
    return 0;                    /* "success" */
 }
 
+
+// The file may have been written with xattr_version 2.  Readers believe
+// MARFS_MD_XATTR over the text xattrs we just saved, so it has to go.
+// First, move the sections we didn't save into text xattrs, too.  This is
+// the reverse of the conversion in save_md_xattr().
+static
+int unpack_md_xattr(PathInfo* info, XattrMaskType mask) {
+   TRY_DECLS();
+
+   char    value[MARFS_MAX_XATTR_SIZE];
+   ssize_t size = MD_PATH_OP(lgetxattr, info->ns, info->post.md_path,
+                             MARFS_MD_XATTR, value, MARFS_MAX_XATTR_SIZE);
+   if (size < 0)
+      return ((errno == ENOATTR) ? 0 : -1);
+
+   PathInfo old = *info;
+   uint8_t  sections;
+   memset(&old.pre,  0, sizeof(MarFS_XattrPre));
+   memset(&old.post, 0, sizeof(MarFS_XattrPost));
+   init_restart(&old.restart);
+   __TRY0( bin_2_md(&old.pre, &old.post, &old.restart, &sections,
+                    value, size, 1, 1) );
+
+   XattrMaskType unpack = (sections & MARFS_PACKED_XATTRS & ~mask);
+   if (unpack) {
+      old.xattrs |= unpack;
+      __TRY0( save_text_xattrs(&old, unpack) );
+   }
+
+   if (MD_PATH_OP(lremovexattr, info->ns, info->post.md_path, MARFS_MD_XATTR)
+       && (errno != ENOATTR)) {
+      LOG(LOG_INFO, "ERR removexattr(%s, %s) (%d) %s\n",
+          info->post.md_path, MARFS_MD_XATTR, errno, strerror(errno));
+      return -1;
+   }
+   return 0;
+}
+
+
+// With xattr_version 2 (the default), Pre/Post/Restart go into the packed
+// MARFS_MD_XATTR.  (See save_md_xattr())  Otherwise, they are text
+// xattrs, and any MARFS_MD_XATTR is unpacked and removed.
+static
+int save_xattrs_internal(PathInfo* info, XattrMaskType mask) {
+   TRY_DECLS();
+
+   // call stat_regular().
+   __TRY0( stat_regular(info) );
+
+   if (marfs_config->xattr_version >= MARFS_MD_XATTR_VERS)
+      return save_md_xattr(info, mask);
+
+   __TRY0( save_text_xattrs(info, mask) );
+   return unpack_md_xattr(info, mask);
+}
+
+int save_xattrs(PathInfo* info, XattrMaskType mask) {
+   int rc = save_xattrs_internal(info, mask);
+
+   // even a partial failure may have changed some of them
+   pi_cache_invalidate(info->post.md_path);
+   return rc;
+}
+
 static
 void init_filehandle(MarFS_FileHandle* fh, PathInfo* info) {
    memset((char*)fh, 0, sizeof(MarFS_FileHandle));
@@ -1378,6 +1673,7 @@ int  trash_unlink(PathInfo*   info,
    if (! has_all_xattrs(info, XVT_PRE)) {
       LOG(LOG_INFO, "incomplete xattrs\n"); // not enough to reclaim objs
       __TRY0( MD_PATH_OP(unlink, info->ns, info->post.md_path) );
+      pi_cache_invalidate(info->post.md_path);
       return 0;
    }
 
@@ -1387,7 +1683,223 @@ int  trash_unlink(PathInfo*   info,
    // first.  Instead, we'll copy to the trash, then unlink the original.
    __TRY0( trash_truncate(info, path) );
    __TRY0( MD_PATH_OP(unlink, info->ns, info->post.md_path) );
+   pi_cache_invalidate(info->post.md_path);
+
+   return 0;
+}
+
+
+// Copy the contents of the MD file <info> to <dest_path>: the physical
+// data, which may include chunk-info beyond the logical size, then trunc
+// to the logical size.  Caller has done stat_xattrs() and stat_regular().
+// Xattrs are not copied.
+static
+int copy_md_data(PathInfo*   info,
+                 const char* dest_path,
+                 int         open_flags,
+                 mode_t      new_mode) {
+   TRY_DECLS();
+
+   // read from md_file
+   // file handle for the metadata file
+   MarFS_FileHandle md_fh;
+   init_filehandle(&md_fh, info);
+   // open_md will initialize the file handle for us.
+   open_md(&md_fh, 0 /* open for reading */);
+   if(! is_open_md(&md_fh)) {
+      LOG(LOG_ERR, "open(%s, O_RDONLY) [oct]%o failed\n",
+          info->post.md_path, new_mode);
+      return -1;
+   }
+   // write to dest file
+   MarFS_FileHandle dest_fh;
+   init_filehandle(&dest_fh, info);
+   open_md_path(&dest_fh, dest_path, open_flags, new_mode);
+   if(! is_open_md(&dest_fh)) {
+      LOG(LOG_ERR, "open(%s, [oct]%o, [oct]%o) failed\n",
+          dest_path, open_flags, new_mode);
+      __TRY0( close_md(&md_fh) );
+      return -1;
+   }
+
+   // MD files are trunc'ed to their "logical" size (the size of the data
+   // they represent).  They may also contain some "system" data (blobs we
+   // have tucked inside, to track object-storage.  Move the physical data,
+   // then trunc to logical size.
+   off_t log_size = info->st.st_size;
+   off_t phy_size = (has_all_xattrs(info, XVT_POST)
+                     ? info->post.chunk_info_bytes
+                     : info->st.st_size); // fuse crashed?  Can still GC.
+
+   if (phy_size) {
+
+      // buf used for data-transfer
+      const size_t BUF_SIZE = 32 * 1024 * 1024; /* 32 MB */
+      char* buf = malloc(BUF_SIZE);
+      if (!buf) {
+         LOG(LOG_ERR, "malloc %ld bytes failed\n", BUF_SIZE);
+
+         // clean-up
+         __TRY0( close_md(&md_fh) );
+         __TRY0( close_md(&dest_fh) );
+         return -1;
+      }
+
+      size_t read_size = ((phy_size < BUF_SIZE) ? phy_size : BUF_SIZE);
+      size_t wr_total = 0;
+
+      // copy phy-data from md_file to dest_file, one buf at a time
+      ssize_t rd_count;
+      for (rd_count = MD_FILE_OP(read, &md_fh, (void*)buf, read_size);
+           (read_size && (rd_count > 0));
+           rd_count = MD_FILE_OP(read, &md_fh, (void*)buf, read_size)) {
+         char*  buf_ptr = buf;
+         size_t remain  = rd_count;
+         while (remain) {
+            size_t wr_count = MD_FILE_OP(write, &dest_fh, buf_ptr, remain);
+            if (wr_count < 0) {
+               LOG(LOG_ERR, "err writing %s (byte %ld)\n",
+                   dest_path, wr_total);
+
+               // clean-up
+               __TRY0( close_md(&md_fh) );
+               __TRY0( close_md(&dest_fh) );
+               free(buf);
+               return -1;
+            }
+            remain   -= wr_count;
+            wr_total += wr_count;
+            buf_ptr  += wr_count;
+         }
+
+         size_t phy_remain = phy_size - wr_total;
+         read_size = ((phy_remain < BUF_SIZE) ? phy_remain : BUF_SIZE);
+      }
+      free(buf);
+      if (rd_count < 0) {
+         LOG(LOG_ERR, "err reading %s (byte %ld)\n",
+             dest_path, wr_total);
+
+         // clean-up
+         __TRY0( close_md(&md_fh) );
+         __TRY0( close_md(&dest_fh) );
+         return -1;
+      }
+   }
+
+   // clean-up
+   __TRY0( close_md(&md_fh) );
+   __TRY0( close_md(&dest_fh) );
+
+   // trunc dest-file to size
+   __TRY0( MD_PATH_OP(truncate, info->ns, dest_path, log_size) );
+
+   return 0;
+}
+
+
+// copy all xattrs of <src_path> (ours and the user's) to <dest_path>
+static
+int copy_md_xattrs(PathInfo* info, const char* src_path, const char* dest_path) {
+   TRY_DECLS();
+
+   ssize_t list_len = MD_PATH_OP(llistxattr, info->ns, src_path, NULL, 0);
+   if (list_len <= 0)
+      return (int)list_len;
+
+   char* list = (char*)malloc(list_len);
+   char* val  = (char*)malloc(XATTR_SIZE_MAX);
+   if (! list || ! val) {
+      free(list);
+      free(val);
+      errno = ENOMEM;
+      return -1;
+   }
+
+   list_len = MD_PATH_OP(llistxattr, info->ns, src_path, list, list_len);
+   rc = ((list_len < 0) ? -1 : 0);
+
+   const char* name;
+   for (name=list; !rc && (name < list + list_len); name += strlen(name) +1) {
+      ssize_t len = MD_PATH_OP(lgetxattr, info->ns, src_path, name, val, XATTR_SIZE_MAX);
+      if ((len < 0)
+          || MD_PATH_OP(lsetxattr, info->ns, dest_path, name, val, len, 0)) {
+         LOG(LOG_ERR, "couldn't copy xattr %s to %s: %s\n",
+             name, dest_path, strerror(errno));
+         rc = -1;
+      }
+   }
+
+   free(val);
+   free(list);
+   return rc;
+}
 
+
+// Move an MD file to <dest_path>, which is on some other MDFS in the same
+// namespace (e.g. a rename between MD shards, where rename() gives EXDEV).
+// Like the trash, we copy the data (with the chunk-info) and the xattrs,
+// but into a temporary name beside <dest_path>, which is then renamed into
+// place, replacing any existing file there, as rename() would.  Then the
+// original is unlinked.  The objects are untouched, so PRE and POST still
+// describe them.
+int move_md_file(PathInfo* info, const char* dest_path) {
+   TRY_DECLS();
+   char tmp_path[MARFS_MAX_MD_PATH];
+
+   __TRY0( stat_xattrs(info, 0) );
+   __TRY0( stat_regular(info) );
+
+   int prt_count = snprintf(tmp_path, MARFS_MAX_MD_PATH, "%s.mv_%d_%lx",
+                            dest_path, (int)getpid(), (unsigned long)pthread_self());
+   if ((prt_count < 0) || (prt_count >= MARFS_MAX_MD_PATH)) {
+      LOG(LOG_ERR, "no room for temporary name beside %s\n", dest_path);
+      errno = ENAMETOOLONG;
+      return -1;
+   }
+
+   if (S_ISLNK(info->st.st_mode)) {
+      char target[MARFS_MAX_MD_PATH];
+      ssize_t len = MD_PATH_OP(readlink, info->ns, info->post.md_path,
+                               target, MARFS_MAX_MD_PATH -1);
+      if (len < 0)
+         return -1;
+      target[len] = 0;
+      __TRY0( MD_PATH_OP(symlink, info->ns, target, tmp_path) );
+   }
+   else if (! S_ISREG(info->st.st_mode)) {
+      errno = EXDEV;            // directories stay in the primary tree
+      return -1;
+   }
+   else {
+      mode_t new_mode = info->st.st_mode & (S_IRWXU|S_IRWXG|S_IRWXO);
+      rc = copy_md_data(info, tmp_path, (O_CREAT|O_EXCL|O_WRONLY), new_mode);
+
+      struct utimbuf times = { .actime  = info->st.st_atime,
+                               .modtime = info->st.st_mtime };
+      if (! rc)
+         rc = copy_md_xattrs(info, info->post.md_path, tmp_path);
+      if (! rc)
+         rc = MD_PATH_OP(utime, info->ns, tmp_path, &times);
+   }
+
+   if (! rc
+       && ((info->st.st_uid != geteuid()) || (info->st.st_gid != getegid())))
+      rc = MD_PATH_OP(lchown, info->ns, tmp_path, info->st.st_uid, info->st.st_gid);
+   if (! rc)
+      rc = MD_PATH_OP(rename, info->ns, tmp_path, dest_path);
+   if (rc) {
+      int err = errno;
+      LOG(LOG_ERR, "couldn't move %s to %s: %s\n",
+          info->post.md_path, dest_path, strerror(err));
+      MD_PATH_OP(unlink, info->ns, tmp_path);
+      errno = err;
+      return -1;
+   }
+
+   __TRY0( MD_PATH_OP(unlink, info->ns, info->post.md_path) );
+   pi_cache_invalidate(info->post.md_path);
+   pi_cache_invalidate(dest_path);
    return 0;
 }
 
@@ -1481,102 +1993,9 @@ int  trash_truncate(PathInfo*   info,
       __TRY0( MD_PATH_OP(chmod, info->ns, info->trash_md_path, new_mode) );
    }
 
-   else {
-      // read from md_file
-      // file handle for the metadata file
-      MarFS_FileHandle md_fh;
-      init_filehandle(&md_fh, info);
-      // open_md will initialize the file handle for us.
-      open_md(&md_fh, 0 /* open for reading */);
-      if(! is_open_md(&md_fh)) {
-         LOG(LOG_ERR, "open(%s, O_RDONLY) [oct]%o failed\n",
-             info->post.md_path, new_mode);
-         return -1;
-      }
-      // write to trash file
-      MarFS_FileHandle trash_fh;
-      init_filehandle(&trash_fh, info);
-      open_md_path(&trash_fh, info->trash_md_path,
-                   (O_CREAT|O_WRONLY), new_mode);
-      if(! is_open_md(&trash_fh)) {
-         LOG(LOG_ERR, "open(%s, (O_CREAT|O_WRONLY), [oct]%o) failed\n",
-             info->trash_md_path, new_mode);
-         __TRY0( close_md(&md_fh) );
-         return -1;
-      }
-
-      // MD files are trunc'ed to their "logical" size (the size of the data
-      // they represent).  They may also contain some "system" data (blobs we
-      // have tucked inside, to track object-storage.  Move the physical data,
-      // then trunc to logical size.
-      off_t log_size = info->st.st_size;
-      off_t phy_size = (has_all_xattrs(info, XVT_POST)
-                        ? info->post.chunk_info_bytes
-                        : info->st.st_size); // fuse crashed?  Can still GC.
-
-      if (phy_size) {
-
-         // buf used for data-transfer
-         const size_t BUF_SIZE = 32 * 1024 * 1024; /* 32 MB */
-         char* buf = malloc(BUF_SIZE);
-         if (!buf) {
-            LOG(LOG_ERR, "malloc %ld bytes failed\n", BUF_SIZE);
-
-            // clean-up
-            __TRY0( close_md(&md_fh) );
-            __TRY0( close_md(&trash_fh) );
-            return -1;
-         }
-
-         size_t read_size = ((phy_size < BUF_SIZE) ? phy_size : BUF_SIZE);
-         size_t wr_total = 0;
-
-         // copy phy-data from md_file to trash_file, one buf at a time
-         ssize_t rd_count;
-         for (rd_count = MD_FILE_OP(read, &md_fh, (void*)buf, read_size);
-              (read_size && (rd_count > 0));
-              rd_count = MD_FILE_OP(read, &md_fh, (void*)buf, read_size)) {
-            char*  buf_ptr = buf;
-            size_t remain  = rd_count;
-            while (remain) {
-               size_t wr_count = MD_FILE_OP(write, &trash_fh, buf_ptr, remain);
-               if (wr_count < 0) {
-                  LOG(LOG_ERR, "err writing %s (byte %ld)\n",
-                      info->trash_md_path, wr_total);
-
-                  // clean-up
-                  __TRY0( close_md(&md_fh) );
-                  __TRY0( close_md(&trash_fh) );
-                  free(buf);
-                  return -1;
-               }
-               remain   -= wr_count;
-               wr_total += wr_count;
-               buf_ptr  += wr_count;
-            }
-
-            size_t phy_remain = phy_size - wr_total;
-            read_size = ((phy_remain < BUF_SIZE) ? phy_remain : BUF_SIZE);
-         }
-         free(buf);
-         if (rd_count < 0) {
-            LOG(LOG_ERR, "err reading %s (byte %ld)\n",
-                info->trash_md_path, wr_total);
-
-            // clean-up
-            __TRY0( close_md(&md_fh) );
-            __TRY0( close_md(&trash_fh) );
-            return -1;
-         }
-      }
-
-      // clean-up
-      __TRY0( close_md(&md_fh) );
-      __TRY0( close_md(&trash_fh) );
-
-      // trunc trash-file to size
-      __TRY0( MD_PATH_OP(truncate, info->ns, info->trash_md_path, log_size) );
-   }
+   else
+      __TRY0( copy_md_data(info, info->trash_md_path,
+                           (O_CREAT|O_WRONLY), new_mode) );
 
    // copy any xattrs to the trash-file.
    //
@@ -1599,6 +2018,14 @@ int  trash_truncate(PathInfo*   info,
       trash_info.post.chunks           = info->st.st_size / sizeof(MultiChunkInfo);
       trash_info.post.chunk_info_bytes = trash_info.post.chunks * sizeof(MultiChunkInfo);
    }
+   // GC needs the chunk-references, too
+   int has_dedup = dedup_copy_xattr(info, info->trash_md_path);
+   if (has_dedup < 0) {
+      LOG(LOG_ERR, "couldn't copy %s to trash: %s\n", DEDUP_XATTR, strerror(errno));
+      return -1;
+   }
+   else if (has_dedup)
+      trash_info.post.flags |= POST_DEDUP;
    __TRY0( save_xattrs(&trash_info, (info->xattrs | XVT_POST)) ); // GC needs POST
 
    // update trash-file atime/mtime to support "undelete"
@@ -1618,6 +2045,7 @@ int  trash_truncate(PathInfo*   info,
    __TRY0( trunc_xattrs(info) );
 
    // old stat-info and xattr-info is obsolete.  Generate new obj-ID, etc.
+   pi_cache_invalidate(info->post.md_path);
    info->flags &= ~(PI_STAT_QUERY | PI_XATTR_QUERY);
    info->xattr_inits = 0;
    __TRY0( stat_xattrs(info, 0) );   // has none, so initialize from scratch
@@ -1647,6 +2075,10 @@ int trunc_xattrs(PathInfo* info) {
       MD_PATH_OP(lremovexattr, info->ns, info->post.md_path, spec->key_name);
       info->xattrs &= ~(spec->value_type);
    }
+   MD_PATH_OP(lremovexattr, info->ns, info->post.md_path, MARFS_MD_XATTR);
+   MD_PATH_OP(lremovexattr, info->ns, info->post.md_path, DEDUP_XATTR);
+   info->flags &= ~PI_XATTRS_V1;
+   pi_cache_invalidate(info->post.md_path);
    return 0;
 }
 
@@ -1811,10 +2243,16 @@ int destroy_data(MarFS_FileHandle* fh) {
    int rc = 0;
 
 #if USE_DAL
+   // any async ops still outstanding must finish, before the DAL state
+   // they refer to goes away.
+   dal_async_free(&FH_DAL_CTX(fh));
+
    // clean-up DAL state
    rc = DAL_OP(destroy, fh, FH_DAL(fh));
    FH_DAL(fh) = NULL; // need to make sure that if we call open_data
                       // again, it will actually reinitialize the dal
+#else
+   rc = stream_release(&fh->os);
 #endif
 
    return rc;
@@ -1843,23 +2281,31 @@ int open_data(MarFS_FileHandle* fh,
    // if we haven't already initialized the FileHandle DAL, do it now.
    init_data(fh);
 
+   // A deduplicated chunk is read from the object that holds its data.
+   // Nothing must be put back, afterwards.  The bucket and objid are
+   // rebuilt by the next update_pre(), and some DALs (e.g. the
+   // chunk-cache) don't use them until the first get_data().
+   if (! writing_p && fh->info.dedup)
+      TRY0( dedup_redirect(&fh->info) );
+
 #if USE_DAL
-   TRY0( DAL_OP(update_object_location, fh) );
+   rc = DAL_OP(update_object_location, fh);
 #else
-   TRY0( update_url(&fh->os, &fh->info) );
+   rc = update_url(&fh->os, &fh->info);
 #endif
    // if we haven't already opened the data-stream, do it now.
    //
    // TBD: is_open().  Should assimilate FH->os_init, which should become a flag
    //
    // if (! DAL_OP(is_open, fh))
-   {
-      if (DAL_OP(open, fh, writing_p,
-                 chunk_offset, content_length, preserve_wr_count, timeout) ) {
+   if (! rc) {
+      rc = DAL_OP(open, fh, writing_p,
+                  chunk_offset, content_length, preserve_wr_count, timeout);
+      if (rc)
          LOG(LOG_ERR, "open_data() failed: %s\n", strerror(errno));
-         return -1;
-      }
    }
+   if (rc)
+      return -1;
 
    LOG(LOG_INFO, "open_data() ok\n");
    EXIT();
@@ -2013,6 +2459,49 @@ int delete_data(MarFS_FileHandle* fh) {
    return 0;
 }
 
+// Like delete_data(), for a batch of objects that differ from <fh> only in
+// info.pre.objid (e.g. the chunks of a Multi file).  status[i] gets 0 or
+// the errno for objids[i].  See DAL.del_many.
+int delete_data_many(MarFS_FileHandle*  fh,
+                     const char**       objids,
+                     size_t             count,
+                     int*               status) {
+   TRY_DECLS();
+   int err = 0;
+
+   if (! count)
+      return 0;
+
+#if USE_DAL
+   TRY0( init_data(fh) );
+   if (DAL_OP(del_many, fh, FH_DAL(fh), fh, objids, count, status))
+      err = errno;
+   TRY0( destroy_data(fh) );
+
+#else
+   char   objid[MARFS_MAX_OBJID_SIZE];
+   size_t i;
+
+   strcpy(objid, fh->info.pre.objid);
+   for (i=0; i<count; ++i) {
+      strncpy(fh->info.pre.objid, objids[i], MARFS_MAX_OBJID_SIZE);
+      fh->info.pre.objid[MARFS_MAX_OBJID_SIZE -1] = 0;
+      status[i] = (delete_data(fh) ? (errno ? errno : EIO) : 0);
+      if (status[i] && ! err)
+         err = status[i];
+   }
+   strcpy(fh->info.pre.objid, objid);
+#endif
+
+   if (err) {
+      LOG(LOG_INFO, "FAIL: %s (%ld objects), errno=%d '%s'\n\n",
+          "delete_data_many", count, err, strerror(err));
+      errno = err;
+      return -1;
+   }
+   return 0;
+}
+
 
 // Assure MD is open.
 //
@@ -2198,12 +2687,11 @@ int seek_chunkinfo(MarFS_FileHandle* fh, size_t chunk_no) {
 //    //    then we can fill out the chunk-info.  And, in both cases,
 //    //    OS.written should be preserved.
 //
-int write_chunkinfo(MarFS_FileHandle*     fh,
-                    // size_t                open_offset,
+static
+void fill_chunkinfo(MarFS_FileHandle*     fh,
                     size_t                user_data_written,
-                    int                   size_is_per_chunk) {
-   TRY_DECLS();
-
+                    int                   size_is_per_chunk,
+                    MultiChunkInfo*       chunk_info) {
    PathInfo* info = &fh->info;
 
    const size_t recovery             = MARFS_REC_UNI_SIZE;
@@ -2213,28 +2701,93 @@ int write_chunkinfo(MarFS_FileHandle*     fh,
                                         ? user_data_written
                                         : (user_data_written - log_offset));
 
-   const size_t chunk_info_len    = sizeof(MultiChunkInfo);
-   char         str[chunk_info_len];
-
-   MultiChunkInfo chunk_info = (MultiChunkInfo) {
+   *chunk_info = (MultiChunkInfo) {
       .config_vers_maj  = MARFS_CONFIG_MAJOR, // marfs_config->version_major,
       .config_vers_min  = MARFS_CONFIG_MINOR, // marfs_config->version_minor,
       .chunk_no         = info->pre.chunk_no,
       .logical_offset   = log_offset,
       .chunk_data_bytes = user_data_this_chunk,
-      .correct_info     = info->post.correct_info,
+      .correct_info     = chunk_correctinfo(fh),
       .encrypt_info     = info->post.encrypt_info,
    };
 
-   // convert struct to portable binary
-   ssize_t str_count = chunkinfo_2_str(str, chunk_info_len, &chunk_info);
-   if (str_count < 0) {
-      LOG(LOG_ERR, "error preparing chunk-info (%ld < 0)\n",
-          str_count);
-      errno = EIO;
-      return -1;
-   }
-   if (str_count < chunk_info_len) {
+   LOG(LOG_INFO, "chunk=%ld, open_offset=%ld, data_length=%ld\n",
+       info->pre.chunk_no, fh->open_offset, user_data_this_chunk);
+}
+
+int write_chunkinfo(MarFS_FileHandle*     fh,
+                    // size_t                open_offset,
+                    size_t                user_data_written,
+                    int                   size_is_per_chunk) {
+   MultiChunkInfo chunk_info;
+   fill_chunkinfo(fh, user_data_written, size_is_per_chunk, &chunk_info);
+   return put_chunkinfo(fh, &chunk_info);
+}
+
+
+// A retired PUT may still fail after marfs_write() has moved on to the
+// next chunk.  Chunk-info in the MD file says the chunk is there, so we
+// hold it in the file-handle until stream_retired() says the PUT is done.
+// At most OS_MAX_PIPE PUTs are in flight.
+int queue_chunkinfo(MarFS_FileHandle*     fh,
+                    size_t                user_data_written,
+                    int                   size_is_per_chunk) {
+
+   if (fh->ci_pending_count >= OS_MAX_PIPE) {
+      LOG(LOG_ERR, "too many chunk-infos pending (%d)\n", fh->ci_pending_count);
+      errno = EIO;
+      return -1;
+   }
+   fill_chunkinfo(fh, user_data_written, size_is_per_chunk,
+                  &fh->ci_pending[fh->ci_pending_count]);
+   fh->ci_pending_count += 1;
+
+   return flush_chunkinfo(fh);
+}
+
+// Write pending chunk-info for the PUTs that have finished.  If any
+// retired PUT failed, the pending chunk-info is dropped.
+int flush_chunkinfo(MarFS_FileHandle* fh) {
+   TRY_DECLS();
+
+   if (! fh->ci_pending_count)
+      return 0;
+
+   int in_flight = stream_retired(&fh->os);
+   if (in_flight < 0) {
+      LOG(LOG_ERR, "dropping %d pending chunk-infos\n", fh->ci_pending_count);
+      fh->ci_pending_count = 0;
+      return -1;
+   }
+
+   int done = fh->ci_pending_count - in_flight;
+   int i;
+   for (i=0; i<done; ++i)
+      TRY0( put_chunkinfo(fh, &fh->ci_pending[i]) );
+
+   if (done > 0) {
+      memmove(fh->ci_pending, fh->ci_pending + done,
+              in_flight * sizeof(MultiChunkInfo));
+      fh->ci_pending_count = in_flight;
+   }
+   return 0;
+}
+
+int put_chunkinfo(MarFS_FileHandle* fh, const MultiChunkInfo* chunk_info) {
+   TRY_DECLS();
+
+   const size_t chunk_info_len    = sizeof(MultiChunkInfo);
+   char         str[chunk_info_len];
+
+   // convert struct to portable binary
+   ssize_t str_count = chunkinfo_2_str(str, chunk_info_len, chunk_info);
+   if (str_count < 0) {
+      LOG(LOG_ERR, "error preparing chunk-info (%ld < 0)\n",
+          str_count);
+      errno = EIO;
+      return -1;
+   }
+   if (str_count < chunk_info_len) {
       // pad with zeros, if nec
       memset(str + str_count, 0, (chunk_info_len - str_count));
    }
@@ -2248,12 +2801,9 @@ int write_chunkinfo(MarFS_FileHandle*     fh,
    TRY0( open_md(fh, 1) );
 
    // seek to offset for this chunk, in MD file
-   TRY0(seek_chunkinfo(fh, info->pre.chunk_no));
+   TRY0(seek_chunkinfo(fh, chunk_info->chunk_no));
 
    // write portable binary to MD file
-   LOG(LOG_INFO, "chunk=%ld, open_offset=%ld, data_length=%ld\n",
-       info->pre.chunk_no, fh->open_offset, user_data_this_chunk);
-
    ssize_t wr_count = MD_FILE_OP(write, fh, str, chunk_info_len);
 
    if (wr_count < 0) {
@@ -2268,7 +2818,9 @@ int write_chunkinfo(MarFS_FileHandle*     fh,
       return -1;
    }
 
-
+   // MD file size changed, and any chunk-index is stale
+   pi_cache_invalidate(fh->info.post.md_path);
+   free_chunk_index(fh);
    return 0;
 }
 
@@ -2315,6 +2867,110 @@ int read_chunkinfo(MarFS_FileHandle* fh, MultiChunkInfo* chnk) {
 }
 
 
+// Readers that jump around in a Multi file need the MultiChunkInfo for
+// arbitrary chunks.  (Today, that's only check_correctinfo(), with
+// verify_reads.  Plain reads compute object-IDs from the chunk_no, and
+// GC reads the chunk-info sequentially.)  Doing seek_chunkinfo() +
+// read_chunkinfo() for each one costs two MD syscalls per lookup, so
+// instead, the first lookup on a file-handle pulls the whole chunk-info
+// region into memory, and later lookups just decode record N from there.
+//
+// We don't mmap() the MD file for this.  MDALs don't expose an fd, and
+// another client truncating the MD file (e.g. trash_truncate()) would
+// SIGBUS the daemon.  The region is small anyway (one record per chunk),
+// but we won't load more than CHUNK_INDEX_MAX; bigger (or incomplete)
+// files, and chunks past the end of the index, fall back to
+// seek_chunkinfo() + read_chunkinfo().
+
+#define CHUNK_INDEX_MAX   (64 * 1024 * 1024) /* bytes of chunk-info */
+
+typedef struct ChunkIndex {
+   char*    buf;              // raw chunk-info, as stored in the MD file
+   size_t   count;            // records in <buf>.  0 means not indexed
+} ChunkIndex;
+
+static
+int load_chunk_index(MarFS_FileHandle* fh) {
+   TRY_DECLS();
+   const size_t chunk_info_len = sizeof(MultiChunkInfo);
+   const size_t size           = fh->info.post.chunk_info_bytes;
+
+   ChunkIndex*  idx = (ChunkIndex*)calloc(1, sizeof(ChunkIndex));
+   if (! idx) {
+      LOG(LOG_ERR, "couldn't allocate chunk-index\n");
+      errno = ENOMEM;
+      return -1;
+   }
+   fh->chunk_index = idx;
+
+   // e.g. N:1 files still being written by pftool have no chunk_info_bytes
+   if (! size || (size % chunk_info_len) || (size > CHUNK_INDEX_MAX)) {
+      LOG(LOG_INFO, "not indexing %lu bytes of chunk-info\n", size);
+      return 0;
+   }
+   idx->buf = (char*)malloc(size);
+   if (! idx->buf) {
+      LOG(LOG_INFO, "no memory to index %lu bytes of chunk-info\n", size);
+      return 0;
+   }
+
+   TRY0( open_md(fh, 0) );
+   TRY0( seek_chunkinfo(fh, 0) );
+
+   size_t done = 0;
+   while (done < size) {
+      ssize_t rd_count = MD_FILE_OP(read, fh, idx->buf + done, size - done);
+      if (rd_count < 0) {
+         LOG(LOG_ERR, "error reading chunk-info (%s)\n", strerror(errno));
+         return -1;
+      }
+      else if (rd_count == 0)
+         break;                 // MD file is shorter than its chunk-info
+      done += rd_count;
+   }
+
+   idx->count = done / chunk_info_len;
+   LOG(LOG_INFO, "indexed %lu chunks of %s\n", idx->count, fh->info.post.md_path);
+   return 0;
+}
+
+int get_chunkinfo(MarFS_FileHandle* fh, size_t chunk_no, MultiChunkInfo* chnk) {
+   TRY_DECLS();
+   const size_t chunk_info_len = sizeof(MultiChunkInfo);
+
+   if (! fh->chunk_index)
+      TRY0( load_chunk_index(fh) );
+
+   // not indexed, or the MD file has grown since we loaded the index
+   ChunkIndex* idx = fh->chunk_index;
+   if (chunk_no >= idx->count) {
+      TRY0( open_md(fh, 0) );
+      TRY0( seek_chunkinfo(fh, chunk_no) );
+      return read_chunkinfo(fh, chnk);
+   }
+
+   ssize_t str_count = str_2_chunkinfo(chnk, idx->buf + (chunk_no * chunk_info_len),
+                                       chunk_info_len);
+   if (str_count < 0) {
+      LOG(LOG_ERR, "error preparing chunk-info (%ld < 0)\n",
+          str_count);
+      errno = EIO;
+      return -1;
+   }
+   return 0;
+}
+
+void free_chunk_index(MarFS_FileHandle* fh) {
+   ChunkIndex* idx = fh->chunk_index;
+   if (! idx)
+      return;
+
+   free(idx->buf);
+   free(idx);
+   fh->chunk_index = NULL;
+}
+
+
 
 
 // This is intended to count the number of valid MultiChunkInfo records in
@@ -2433,6 +3089,119 @@ ssize_t count_chunkinfo(MarFS_FileHandle* fh) {
 
 
 
+// ---------------------------------------------------------------------------
+// CORRECT-INFO
+//
+// With CORRECTTYPE_CRC32C, marfs_write() computes a CRC32C of the
+// user-data in each chunk (not counting recovery-info).  That goes into
+// the chunk's MultiChunkInfo, and the CRC of the whole file goes into
+// Post.correct_info.  For a Uni or Packed file, those are the same thing.
+//
+// On read, with Repo.verify_reads, a chunk (or a whole Uni/Packed file)
+// that is read from its start to its end, in order, is checked against
+// the recorded value.  Reads that skip around just aren't checked.
+// ---------------------------------------------------------------------------
+
+void update_correctinfo(MarFS_FileHandle* fh, const char* buf, size_t size) {
+   if (fh->info.pre.correction != CORRECTTYPE_CRC32C)
+      return;
+
+   fh->write_status.chunk_crc      = crc32c(fh->write_status.chunk_crc, buf, size);
+   fh->write_status.chunk_crc_len += size;
+}
+
+CorrectInfo chunk_correctinfo(MarFS_FileHandle* fh) {
+   if (fh->info.pre.correction != CORRECTTYPE_CRC32C)
+      return 0;
+   return (CORRECT_INFO_VALID | fh->write_status.chunk_crc);
+}
+
+void fold_correctinfo(MarFS_FileHandle* fh) {
+   WriteStatus* ws = &fh->write_status;
+   if (fh->info.pre.correction != CORRECTTYPE_CRC32C)
+      return;
+
+   ws->file_crc      = crc32c_combine(ws->file_crc, ws->chunk_crc, ws->chunk_crc_len);
+   ws->chunk_crc     = 0;
+   ws->chunk_crc_len = 0;
+   fh->info.post.correct_info = (CORRECT_INFO_VALID | ws->file_crc);
+}
+
+// check the CRC of <chunk_no> (or of the whole file, if it isn't Multi)
+static
+int check_correctinfo(MarFS_FileHandle* fh, size_t chunk_no, uint32_t crc) {
+   TRY_DECLS();
+   PathInfo*   info   = &fh->info;
+   CorrectInfo expect = info->post.correct_info;
+
+   if (info->post.obj_type == OBJ_MULTI) {
+      MultiChunkInfo chnk;
+      TRY0( get_chunkinfo(fh, chunk_no, &chnk) );
+      expect = chnk.correct_info;
+   }
+
+   // e.g. written before CRCs, or by pftool N:1, which installs its own
+   // chunk-info
+   if (! (expect & CORRECT_INFO_VALID))
+      return 0;
+
+   if ((uint32_t)expect != crc) {
+      LOG(LOG_ERR, "CRC mismatch in %s, chunk %lu: 0x%08x, expected 0x%08x\n",
+          info->post.md_path, chunk_no, crc, (uint32_t)expect);
+      errno = EIO;
+      return -1;
+   }
+   LOG(LOG_INFO, "CRC ok for %s, chunk %lu\n", info->post.md_path, chunk_no);
+   return 0;
+}
+
+// <offset> is the logical offset of <buf>.  Caller has already STAT'ed.
+int verify_correctinfo(MarFS_FileHandle* fh, size_t offset,
+                       const char* buf, size_t size) {
+   TRY_DECLS();
+   PathInfo*    info = &fh->info;
+   ReadStatus*  rs   = &fh->read_status;
+
+   if (! info->pre.repo->verify_reads
+       || (info->pre.correction != CORRECTTYPE_CRC32C))
+      return 0;
+
+   const size_t data1  = (info->pre.chunk_size - MARFS_REC_UNI_SIZE);
+   const size_t extent = info->st.st_size;
+   const int    multi  = (info->post.obj_type == OBJ_MULTI);
+
+   while (size && (offset < extent)) {
+      size_t chunk_no = (multi ? (offset / data1) : 0);
+      size_t start    = chunk_no * data1;
+      size_t end      = ((multi && (start + data1 < extent)) ? start + data1 : extent);
+      size_t n        = ((size < end - offset) ? size : end - offset);
+
+      int    in_order = 1;
+
+      if ((rs->crc_start == start) && (rs->crc_next == offset))
+         rs->crc = crc32c(rs->crc, buf, n);
+      else if (offset == start) {
+         rs->crc_start = start;
+         rs->crc       = crc32c(0, buf, n);
+      }
+      else
+         in_order = 0;          // can't check this one
+
+      rs->crc_next = (in_order ? offset + n : (size_t)-1);
+      if (in_order && (rs->crc_next == end)) {
+         rs->crc_next = (size_t)-1;
+         TRY0( check_correctinfo(fh, chunk_no, rs->crc) );
+      }
+
+      offset += n;
+      buf    += n;
+      size   -= n;
+   }
+   return 0;
+}
+
+
+
 // write appropriate recovery-info into an object.  Moved this here so it
 // could be shared by marfs_write() and marfs_release()
 //
@@ -3369,6 +4138,784 @@ void terminate_all_readers(MarFS_FileHandle* fh) {
 }
 
 
+// ---------------------------------------------------------------------------
+// READ-AHEAD
+//
+// see the comments above struct ReadAhead, in common.h.  marfs_read()
+// calls read_ahead_start() on a sequential read, if the repo has
+// read_buffers > 1.  From then on, read_ahead_thread() walks through the
+// file in RA_BUF_SIZE pieces, opening/closing streams with the same
+// chunk/byte-range logic as marfs_read_internal(), and read_ahead_get()
+// consumes the filled slots.  Caller is holding FH.OS.read_lock, so
+// there's only ever one consumer.
+// ---------------------------------------------------------------------------
+
+static
+void* read_ahead_thread(void* arg) {
+   MarFS_FileHandle* fh   = (MarFS_FileHandle*)arg;
+   PathInfo*         info = &fh->info;  /* shorthand */
+   ObjectStream*     os   = &fh->os;
+   ReadAhead*        ra   = fh->read_status.read_ahead;
+
+   const size_t   recovery   = MARFS_REC_UNI_SIZE; // sys bytes, per chunk
+   const size_t   data1      = (info->pre.chunk_size - recovery); // log bytes, per chunk
+   const size_t   max_get    = info->pre.repo->max_get_size;
+   const uint16_t rd_timeout = info->pre.repo->read_timeout;
+
+   size_t open_remain = 0;      // unfetched part of the current byte-range
+
+   while (ra->log_offset < ra->log_end) {
+
+      // wait for a free slot (or for read_ahead_stop())
+      WAIT(&ra->empty);
+      if (ra->flags & RA_STOP)
+         break;
+
+      if (! (os->flags & OSF_OPEN)) {
+
+         // same computations as marfs_read_internal()
+         size_t phy_offset   = info->post.obj_offset + ra->log_offset;
+         size_t chunk_no     = phy_offset / data1;
+         size_t chunk_offset = phy_offset - (chunk_no * data1);
+         size_t chunk_remain = data1 - chunk_offset;
+         size_t log_remain   = ra->log_end - ra->log_offset;
+
+         open_remain = ((log_remain < chunk_remain) ? log_remain : chunk_remain);
+         if (max_get && (open_remain > max_get))
+            open_remain = max_get;
+
+         info->pre.chunk_no = chunk_no;
+         update_pre(&info->pre);
+
+         LOG(LOG_INFO, "read-ahead opening chunk %lu, byte_range: %lu, %lu\n",
+             chunk_no, chunk_offset, chunk_offset + open_remain -1);
+         if (open_data(fh, OS_GET, chunk_offset, open_remain, 0, rd_timeout)) {
+            ra->err    = errno;
+            ra->flags |= RA_ERR;
+            break;
+         }
+      }
+
+      RABuf* rb   = &ra->ring[ra->head];
+      size_t want = ((open_remain < RA_BUF_SIZE) ? open_remain : RA_BUF_SIZE);
+      size_t got  = 0;
+      while (got < want) {
+         ssize_t rc_ssize = DAL_OP(get, fh, rb->buf + got, want - got);
+         if (rc_ssize <= 0) {
+            LOG(LOG_ERR, "read-ahead get returned %ld at %lu (%d '%s')\n",
+                rc_ssize, ra->log_offset + got, os->iob.code, os->iob.result);
+            break;
+         }
+         got += rc_ssize;
+      }
+      if (got < want) {
+         ra->err    = EIO;
+         ra->flags |= RA_ERR;
+         break;
+      }
+
+      // hand the slot to read_ahead_get()
+      rb->pos          = 0;
+      rb->len          = want;
+      ra->log_offset  += want;
+      open_remain     -= want;
+      ra->head         = (ra->head +1) % ra->bufs;
+      POST(&ra->full);
+
+      // End of this byte-range.  Closing now means the next iteration
+      // opens the following range (e.g. the next chunk of a Multi) while
+      // the caller is still consuming what we've already fetched.
+      if (! open_remain) {
+         if (close_data(fh, 0, 0)) {
+            ra->err    = errno;
+            ra->flags |= RA_ERR;
+            break;
+         }
+      }
+   }
+
+   LOG(LOG_INFO, "read-ahead done at %lu (flags=0x%02x)\n", ra->log_offset, ra->flags);
+   ra->flags |= RA_DONE;
+   POST(&ra->full);             // in case read_ahead_get() is waiting
+   return NULL;
+}
+
+
+// Begin read-ahead at logical <offset>, stopping at <log_end>.  Caller
+// must not have the stream open.
+int read_ahead_start(MarFS_FileHandle* fh, size_t offset, size_t log_end) {
+   const MarFS_Repo* repo = fh->info.pre.repo;
+
+   ReadAhead* ra = (ReadAhead*)calloc(1, sizeof(ReadAhead));
+   if (! ra) {
+      LOG(LOG_ERR, "couldn't allocate ReadAhead\n");
+      errno = ENOMEM;
+      return -1;
+   }
+   ra->bufs       = ((repo->read_buffers > RA_MAX_BUFS) ? RA_MAX_BUFS : repo->read_buffers);
+   ra->log_offset = offset;
+   ra->log_end    = log_end;
+
+   int i;
+   for (i=0; i<ra->bufs; ++i) {
+      ra->ring[i].buf = (char*)malloc(RA_BUF_SIZE);
+      if (! ra->ring[i].buf) {
+         LOG(LOG_ERR, "couldn't allocate read-ahead buffer %d\n", i);
+         while (i--)
+            free(ra->ring[i].buf);
+         free(ra);
+         errno = ENOMEM;
+         return -1;
+      }
+   }
+   SEM_INIT(&ra->empty, 0, ra->bufs);
+   SEM_INIT(&ra->full,  0, 0);
+
+   fh->read_status.read_ahead = ra;
+
+   LOG(LOG_INFO, "starting read-ahead (%d x %d) at %lu\n", ra->bufs, RA_BUF_SIZE, offset);
+   if (pthread_create(&ra->thr, NULL, &read_ahead_thread, fh)) {
+      LOG(LOG_ERR, "pthread_create failed: '%s'\n", strerror(errno));
+      fh->read_status.read_ahead = NULL;
+      for (i=0; i<ra->bufs; ++i)
+         free(ra->ring[i].buf);
+      SEM_DESTROY(&ra->empty);
+      SEM_DESTROY(&ra->full);
+      free(ra);
+      errno = EIO;
+      return -1;
+   }
+
+   return 0;
+}
+
+
+// Copy up to <size> bytes of read-ahead into <buf>.  Returns the amount
+// copied, which is only less than <size> at EOF, or if the read-ahead
+// thread failed after fetching some data.  (In the latter case, the next
+// call returns -1 with the thread's errno.)
+ssize_t read_ahead_get(MarFS_FileHandle* fh, char* buf, size_t size) {
+   ReadAhead* ra = fh->read_status.read_ahead;
+
+   static const uint16_t default_timeout = 20; /* totally made up out of thin air */
+   uint16_t timeout_sec = (fh->info.pre.repo->read_timeout
+                           ? fh->info.pre.repo->read_timeout
+                           : default_timeout);
+
+   size_t read_count = 0;
+   while (read_count < size) {
+
+      // wait for the thread to fill a slot
+      if (TIMED_WAIT(&ra->full, timeout_sec)) {
+         LOG(LOG_ERR, "timed-out waiting %ds for read-ahead at %lu\n",
+             timeout_sec, fh->read_status.log_offset + read_count);
+         errno = EIO;
+         return -1;
+      }
+
+      RABuf* rb = &ra->ring[ra->tail];
+      if (! rb->len) {
+         // no more data is coming.  Leave the post, for later callers.
+         POST(&ra->full);
+         if (read_count)
+            break;
+         if (ra->flags & RA_ERR) {
+            LOG(LOG_ERR, "read-ahead failed: '%s'\n", strerror(ra->err));
+            errno = ra->err;
+            return -1;
+         }
+         LOG(LOG_INFO, "read-ahead at EOF\n");
+         break;
+      }
+
+      size_t move = rb->len - rb->pos;
+      if (move > (size - read_count))
+         move = (size - read_count);
+      memcpy(buf + read_count, rb->buf + rb->pos, move);
+      rb->pos    += move;
+      read_count += move;
+
+      if (rb->pos < rb->len)
+         POST(&ra->full);       // still more in this slot
+      else {
+         rb->len  = 0;
+         ra->tail = (ra->tail +1) % ra->bufs;
+         POST(&ra->empty);      // thread can refill it
+      }
+   }
+
+   return read_count;
+}
+
+
+// Stop the read-ahead thread, and free its resources.  This doesn't close
+// the stream, which the thread may have left open at some position that
+// doesn't match FH.read_status.log_offset.  Caller should treat the
+// stream as though it was left open by a discontiguous read.
+int read_ahead_stop(MarFS_FileHandle* fh) {
+   ReadAhead* ra = fh->read_status.read_ahead;
+   if (! ra)
+      return 0;
+
+   LOG(LOG_INFO, "stopping read-ahead at %lu\n", ra->log_offset);
+   ra->flags |= RA_STOP;
+   POST(&ra->empty);            // in case thread is waiting for a slot
+
+   // If the thread is inside a get, this could take as long as the
+   // read-timeout.
+   int rc = pthread_join(ra->thr, NULL);
+   if (rc)
+      LOG(LOG_ERR, "failed to join read-ahead thread: '%s'\n", strerror(rc));
+
+   int i;
+   for (i=0; i<ra->bufs; ++i)
+      free(ra->ring[i].buf);
+   SEM_DESTROY(&ra->empty);
+   SEM_DESTROY(&ra->full);
+   free(ra);
+
+   fh->read_status.read_ahead = NULL;
+   if (rc) {
+      errno = rc;
+      return -1;
+   }
+   return 0;
+}
+
+
+
+// ---------------------------------------------------------------------------
+// HEDGED GET
+//
+// see the comments above HEDGE_PROBE_SIZE, in common.h.  fetch_range()
+// runs one or more "attempts" at a byte-range GET.  Each attempt has a
+// private copy of the caller's PathInfo (with its own ObjectStream), and
+// first reads HEDGE_PROBE_SIZE bytes into a private buffer.  The first
+// attempt to get that far is the winner, and is the only one that ever
+// writes into the caller's buffer.  The winner interrupts the attempts
+// that are still waiting for their first bytes (see DAL.interrupt), and
+// each loser then cancels its own GET.
+//
+// A loser may still be cleaning up when fetch_range() returns, so
+// attempts run detached, and the shared HedgedGet is freed by whoever
+// drops the last reference to it.
+// ---------------------------------------------------------------------------
+
+typedef struct {
+   const MarFS_Repo*  repo;
+   uint32_t           ms[HEDGE_SAMPLES]; // ring of first-byte latencies
+   size_t             count;             // total samples recorded
+} HedgeStats;
+
+static HedgeStats      hedge_stats[HEDGE_MAX_REPOS];
+static pthread_mutex_t hedge_stats_lock = PTHREAD_MUTEX_INITIALIZER;
+
+typedef enum {
+   HG_RUNNING = 0,
+   HG_OK,
+   HG_FAILED,
+} HedgeState;
+
+struct HedgeAttempt;
+
+typedef struct {
+   pthread_mutex_t      lock;
+   pthread_cond_t       cond;         // signalled when any attempt resolves
+   char*                buf;          // caller's buffer (winner only)
+   struct HedgeAttempt* winner;
+   struct HedgeAttempt* probing;      // attempts waiting for first bytes
+   HedgeState           state;        // of the winner
+   int                  err;          // errno, if the winner failed
+   int                  active;       // attempts not yet resolved
+   int                  refs;         // caller + attempts still running
+   char                 host[MARFS_MAX_HOST_SIZE]; // of the latest attempt
+} HedgedGet;
+
+typedef struct HedgeAttempt {
+   pthread_t          thr;
+   MarFS_FileHandle   fh;             // private copy of caller's PathInfo
+   HedgedGet*         hg;
+   size_t             offset;         // within the chunk
+   size_t             len;
+   uint16_t           timeout;
+   struct HedgeAttempt* next;         // in HedgedGet.probing
+   char               probe[HEDGE_PROBE_SIZE];
+} HedgeAttempt;
+
+
+static
+uint32_t elapsed_ms(const struct timespec* t0) {
+   struct timespec t1;
+   clock_gettime(CLOCK_MONOTONIC, &t1);
+   return (((t1.tv_sec - t0->tv_sec) * 1000)
+           + ((t1.tv_nsec - t0->tv_nsec) / 1000000));
+}
+
+static
+void hedge_record(const MarFS_Repo* repo, uint32_t ms) {
+   pthread_mutex_lock(&hedge_stats_lock);
+   int i;
+   for (i=0; i<HEDGE_MAX_REPOS; ++i) {
+      if (! hedge_stats[i].repo)
+         hedge_stats[i].repo = repo;
+      if (hedge_stats[i].repo == repo) {
+         HedgeStats* hs = &hedge_stats[i];
+         hs->ms[hs->count % HEDGE_SAMPLES] = ms;
+         hs->count += 1;
+         break;
+      }
+   }
+   pthread_mutex_unlock(&hedge_stats_lock);
+}
+
+static
+int cmp_u32(const void* a, const void* b) {
+   uint32_t x = *(const uint32_t*)a;
+   uint32_t y = *(const uint32_t*)b;
+   return ((x > y) - (x < y));
+}
+
+// milliseconds to wait for first bytes, before hedging a GET to <repo>
+static
+uint32_t hedge_delay(const MarFS_Repo* repo) {
+   uint32_t ms[HEDGE_SAMPLES];
+   size_t   n = 0;
+
+   pthread_mutex_lock(&hedge_stats_lock);
+   int i;
+   for (i=0; i<HEDGE_MAX_REPOS; ++i) {
+      if (hedge_stats[i].repo == repo) {
+         n = hedge_stats[i].count;
+         if (n > HEDGE_SAMPLES)
+            n = HEDGE_SAMPLES;
+         memcpy(ms, hedge_stats[i].ms, n * sizeof(uint32_t));
+         break;
+      }
+   }
+   pthread_mutex_unlock(&hedge_stats_lock);
+
+   if (n < HEDGE_MIN_SAMPLES)
+      return HEDGE_DEFAULT_MS;
+
+   qsort(ms, n, sizeof(uint32_t), cmp_u32);
+   uint32_t delay = ms[(n * repo->hedge_percentile) / 100];
+   return ((delay < HEDGE_MIN_MS) ? HEDGE_MIN_MS : delay);
+}
+
+
+// drop a reference to <hg>, and wake the caller.  Frees <hg> if this was
+// the last reference.  Caller holds hg->lock.
+static
+void hedge_unref(HedgedGet* hg) {
+   int last = (--hg->refs == 0);
+   pthread_cond_signal(&hg->cond);
+   pthread_mutex_unlock(&hg->lock);
+   if (last) {
+      pthread_cond_destroy(&hg->cond);
+      pthread_mutex_destroy(&hg->lock);
+      free(hg);
+   }
+}
+
+// Caller holds hg->lock
+static
+void hedge_unlist(HedgedGet* hg, HedgeAttempt* ha) {
+   HedgeAttempt** pp;
+   for (pp = &hg->probing; *pp; pp = &(*pp)->next) {
+      if (*pp == ha) {
+         *pp = ha->next;
+         break;
+      }
+   }
+}
+
+// Stop an attempt's GET before it is complete.  Reads can't be aborted,
+// but a sync after interrupt() cancels the op-thread, as it would after a
+// time-out.
+static
+void hedge_cancel(MarFS_FileHandle* fh) {
+   DAL_OP(interrupt, fh);
+   close_data(fh, 0, 1);
+}
+
+static
+void* hedge_attempt(void* arg) {
+   HedgeAttempt*     ha   = (HedgeAttempt*)arg;
+   HedgedGet*        hg   = ha->hg;
+   MarFS_FileHandle* fh   = &ha->fh;
+   int               won  = 0;
+   int               err  = 0;
+   ssize_t           rc_ssize;
+
+   struct timespec t0;
+   clock_gettime(CLOCK_MONOTONIC, &t0);
+
+   if (open_data(fh, OS_GET, ha->offset, ha->len, 0, ha->timeout)) {
+      err = errno;
+      destroy_data(fh);         // open_data() always does init_data()
+      goto done;
+   }
+
+   // let a winner interrupt us, while we wait for the first bytes
+   pthread_mutex_lock(&hg->lock);
+   int lost = (hg->winner != NULL);
+   if (! lost) {
+      ha->next    = hg->probing;
+      hg->probing = ha;
+   }
+   pthread_mutex_unlock(&hg->lock);
+
+   if (lost) {
+      LOG(LOG_INFO, "GET %s lost the race\n", fh->info.pre.host);
+      hedge_cancel(fh);
+      goto done;
+   }
+
+   size_t probe_size = ((ha->len < HEDGE_PROBE_SIZE) ? ha->len : HEDGE_PROBE_SIZE);
+   rc_ssize = DAL_OP(get, fh, ha->probe, probe_size);
+
+   pthread_mutex_lock(&hg->lock);
+   hedge_unlist(hg, ha);
+   lost = (hg->winner != NULL);
+   if ((rc_ssize > 0) && ! lost) {
+      hg->winner = ha;
+      won = 1;
+
+      // the others can stop waiting
+      HedgeAttempt* other;
+      for (other = hg->probing; other; other = other->next)
+         DAL_OP(interrupt, &other->fh);
+   }
+   pthread_mutex_unlock(&hg->lock);
+
+   if (lost) {
+      LOG(LOG_INFO, "GET %s lost the race\n", fh->info.pre.host);
+      hedge_cancel(fh);
+      goto done;
+   }
+   if (rc_ssize <= 0) {
+      LOG(LOG_ERR, "GET %s returned %ld (%d '%s')\n",
+          fh->info.pre.host, rc_ssize, fh->os.iob.code, fh->os.iob.result);
+      hedge_cancel(fh);
+      err = EIO;
+      goto done;
+   }
+   hedge_record(fh->info.pre.repo, elapsed_ms(&t0));
+
+   // we won.  Only this attempt writes into the caller's buffer.
+   memcpy(hg->buf, ha->probe, rc_ssize);
+   size_t got = rc_ssize;
+   while (got < ha->len) {
+      rc_ssize = DAL_OP(get, fh, hg->buf + got, ha->len - got);
+      if (rc_ssize <= 0) {
+         LOG(LOG_ERR, "GET %s returned %ld at %lu (%d '%s')\n",
+             fh->info.pre.host, rc_ssize, ha->offset + got,
+             fh->os.iob.code, fh->os.iob.result);
+         break;
+      }
+      got += rc_ssize;
+   }
+   if (got < ha->len) {
+      hedge_cancel(fh);
+      err = EIO;
+   }
+   else if (close_data(fh, 0, 1))
+      err = errno;
+
+ done:
+   pthread_mutex_lock(&hg->lock);
+   hg->active -= 1;
+   if (won) {
+      hg->state = (err ? HG_FAILED : HG_OK);
+      hg->err   = err;
+   }
+   else if (err && ! hg->err)
+      hg->err = err;
+   free(ha);
+   hedge_unref(hg);             // unlocks
+   return NULL;
+}
+
+// Start a new attempt, on a copy of <fh>.  If <avoid> is non-NULL, try to
+// pick some other host.  If <detach> is zero, the attempt runs in this
+// thread.  Caller holds hg->lock.
+static
+int hedge_start(HedgedGet* hg, MarFS_FileHandle* fh,
+                size_t offset, size_t len, uint16_t timeout,
+                const char* avoid, int detach) {
+
+   HedgeAttempt* ha = (HedgeAttempt*)calloc(1, sizeof(HedgeAttempt));
+   if (! ha) {
+      LOG(LOG_ERR, "couldn't allocate a HedgeAttempt\n");
+      errno = ENOMEM;
+      return -1;
+   }
+   ha->fh.info = fh->info;
+   ha->hg      = hg;
+   ha->offset  = offset;
+   ha->len     = len;
+   ha->timeout = timeout;
+
+   // each attempt advances the caller's seed, so retries don't all pick
+   // the same host.
+   int tries = 0;
+   do {
+      ha->fh.info.pre.seed = rand_r(&fh->info.pre.seed);
+      update_pre(&ha->fh.info.pre);
+   } while (avoid
+            && (fh->info.pre.repo->host_count > 1)
+            && ! strcmp(ha->fh.info.pre.host, avoid)
+            && (++tries < 8));
+   strncpy(hg->host, ha->fh.info.pre.host, MARFS_MAX_HOST_SIZE);
+
+   hg->active += 1;
+   hg->refs   += 1;
+
+   if (! detach) {
+      pthread_mutex_unlock(&hg->lock);
+      hedge_attempt(ha);
+      pthread_mutex_lock(&hg->lock);
+      return 0;
+   }
+
+   pthread_attr_t attr;
+   pthread_attr_init(&attr);
+   pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+   int rc = pthread_create(&ha->thr, &attr, &hedge_attempt, ha);
+   pthread_attr_destroy(&attr);
+   if (rc) {
+      LOG(LOG_ERR, "pthread_create failed: '%s'\n", strerror(rc));
+      hg->active -= 1;
+      hg->refs   -= 1;
+      free(ha);
+      errno = rc;
+      return -1;
+   }
+   return 0;
+}
+
+
+// Fill <buf> with <len> bytes from <offset> in chunk fh->info.pre.chunk_no.
+// The caller's stream is not used.  fh->info.pre.seed is advanced, for
+// every GET we issue.  Returns 0 if all the data was read, otherwise -1.
+int fetch_range(MarFS_FileHandle* fh, char* buf,
+                size_t offset, size_t len, uint16_t timeout) {
+
+   const MarFS_Repo* repo    = fh->info.pre.repo;
+   const int         hedging = (repo->hedge_percentile != 0);
+   int               retries = repo->read_retries;
+   int               hedged  = 0;
+   char              host[MARFS_MAX_HOST_SIZE];
+
+   HedgedGet* hg = (HedgedGet*)calloc(1, sizeof(HedgedGet));
+   if (! hg) {
+      LOG(LOG_ERR, "couldn't allocate a HedgedGet\n");
+      errno = ENOMEM;
+      return -1;
+   }
+   pthread_mutex_init(&hg->lock, NULL);
+   pthread_cond_init(&hg->cond, NULL);
+   hg->buf  = buf;
+   hg->refs = 1;                // us
+
+   pthread_mutex_lock(&hg->lock);
+
+   // without hedging, there's no reason to run the attempt in a thread
+   if (hedge_start(hg, fh, offset, len, timeout, NULL, hedging)) {
+      hg->state = HG_FAILED;
+      hg->err   = errno;
+   }
+
+   while (hg->state != HG_OK) {
+
+      if ((hg->state == HG_FAILED)
+          || (! hg->winner && ! hg->active)) {
+
+         // the winner failed part-way, or every attempt failed before
+         // producing any data.  No other attempt can touch <buf> now.
+         if (! retries) {
+            if (! hg->err)
+               hg->err = EIO;
+            break;
+         }
+         --retries;
+         LOG(LOG_INFO, "retrying GET %lu-%lu (%d retries left)\n",
+             offset, offset + len -1, retries);
+         hg->winner = NULL;
+         hg->state  = HG_RUNNING;
+         hg->err    = 0;
+         hedged     = 0;
+         if (hedge_start(hg, fh, offset, len, timeout, NULL, hedging)) {
+            hg->state = HG_FAILED;
+            hg->err   = errno;
+         }
+         continue;
+      }
+
+      if (hedging && ! hedged && ! hg->winner) {
+
+         uint32_t        ms = hedge_delay(repo);
+         struct timespec deadline;
+         clock_gettime(CLOCK_REALTIME, &deadline);
+         deadline.tv_sec  += ms / 1000;
+         deadline.tv_nsec += (ms % 1000) * 1000000;
+         if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec  += 1;
+            deadline.tv_nsec -= 1000000000;
+         }
+
+         if ((pthread_cond_timedwait(&hg->cond, &hg->lock, &deadline) == ETIMEDOUT)
+             && ! hg->winner
+             && hg->active) {
+
+            LOG(LOG_INFO, "no data after %u ms, hedging GET %lu-%lu\n",
+                ms, offset, offset + len -1);
+            hedged = 1;
+            strncpy(host, hg->host, MARFS_MAX_HOST_SIZE);
+            hedge_start(hg, fh, offset, len, timeout, host, 1);
+         }
+      }
+      else
+         pthread_cond_wait(&hg->cond, &hg->lock);
+   }
+
+   int err = ((hg->state == HG_OK) ? 0 : hg->err);
+   hedge_unref(hg);             // unlocks
+
+   if (err) {
+      LOG(LOG_ERR, "GET %lu-%lu failed: '%s'\n",
+          offset, offset + len -1, strerror(err));
+      errno = err;
+      return -1;
+   }
+   return 0;
+}
+
+
+
+
+// ---------------------------------------------------------------------------
+// PARALLEL GET
+//
+// see the comments above PG_MAX_PARTS, in common.h.  marfs_read_internal()
+// calls parallel_get() instead of opening the file-handle's own stream,
+// when the repo has parallel_gets > 1, and the caller wants enough data
+// from the current chunk to be worth splitting.  (Also when the repo has
+// hedge_percentile > 0, and the read is at least HEDGE_MIN_SIZE, in which
+// case there may be only one part.)  Each
+// part gets a private copy of the file-handle (i.e. PathInfo, with its own ObjectStream and
+// DAL state), so the parts don't interfere with each other, or with the
+// caller's stream, which is left closed.
+// ---------------------------------------------------------------------------
+
+typedef struct {
+   pthread_t          thr;
+   MarFS_FileHandle   fh;          // private copy of caller's PathInfo
+   char*              buf;         // where this part goes in caller's buf
+   size_t             offset;      // offset of this part, within the chunk
+   size_t             len;
+   uint16_t           timeout;
+   int                err;         // errno, if the part failed
+} ParGet;
+
+static
+void* parallel_get_thread(void* arg) {
+   ParGet*           pg      = (ParGet*)arg;
+   MarFS_FileHandle* fh      = &pg->fh;
+   const size_t      max_get = fh->info.pre.repo->max_get_size;
+
+   // each request still respects max_get_size
+   size_t done = 0;
+   while (done < pg->len) {
+      size_t open_size = pg->len - done;
+      if (max_get && (open_size > max_get))
+         open_size = max_get;
+
+      // maybe a different host, for each request
+      if (fetch_range(fh, pg->buf + done, pg->offset + done, open_size, pg->timeout)) {
+         pg->err = errno;
+         break;
+      }
+      done += open_size;
+   }
+
+   return NULL;
+}
+
+
+// Fill <buf> with <size> bytes from <chunk_offset> in chunk <chunk_no>,
+// using up to repo.parallel_gets concurrent GETs.  Caller's stream must
+// not be open.  Returns 0 if all the data was read, otherwise -1.
+int parallel_get(MarFS_FileHandle* fh, char* buf,
+                 size_t chunk_no, size_t chunk_offset,
+                 size_t size, uint16_t timeout) {
+
+   size_t parts = fh->info.pre.repo->parallel_gets;
+   if (parts > PG_MAX_PARTS)
+      parts = PG_MAX_PARTS;
+   if (parts > (size / PG_MIN_PART))
+      parts = (size / PG_MIN_PART);
+   if (! parts)
+      parts = 1;
+
+   ParGet* pg = (ParGet*)calloc(parts, sizeof(ParGet));
+   if (! pg) {
+      LOG(LOG_ERR, "couldn't allocate %lu ParGets\n", parts);
+      errno = ENOMEM;
+      return -1;
+   }
+
+   LOG(LOG_INFO, "parallel get: chunk %lu, %lu-%lu in %lu parts\n",
+       chunk_no, chunk_offset, chunk_offset + size -1, parts);
+
+   size_t part_size = size / parts;
+   size_t offset    = 0;
+   size_t i;
+   for (i=0; i<parts; ++i) {
+      pg[i].fh.info      = fh->info;
+      pg[i].fh.info.pre.chunk_no = chunk_no;
+      pg[i].fh.info.pre.seed    += i; // don't all pick the same host
+      pg[i].buf          = buf + offset;
+      pg[i].offset       = chunk_offset + offset;
+      pg[i].len          = ((i == parts -1) ? (size - offset) : part_size);
+      pg[i].timeout      = timeout;
+      offset            += pg[i].len;
+   }
+
+   // part 0 runs in this thread.  If we can't start a thread for some
+   // other part, we run that one here, too.
+   size_t started = 0;
+   for (i=1; i<parts; ++i) {
+      if (pthread_create(&pg[i].thr, NULL, &parallel_get_thread, &pg[i])) {
+         LOG(LOG_ERR, "pthread_create failed for part %lu: '%s'\n",
+             i, strerror(errno));
+         break;
+      }
+      ++ started;
+   }
+   parallel_get_thread(&pg[0]);
+   for (i=started+1; i<parts; ++i)
+      parallel_get_thread(&pg[i]);
+
+   int err = pg[0].err;
+   for (i=1; i<parts; ++i) {
+      if (i <= started)
+         pthread_join(pg[i].thr, NULL);
+      if (pg[i].err && ! err)
+         err = pg[i].err;
+   }
+   free(pg);
+
+   if (err) {
+      LOG(LOG_ERR, "parallel get failed: '%s'\n", strerror(err));
+      errno = err;
+      return -1;
+   }
+   return 0;
+}
+
+
+
 // Computes a good, uniform, hash of the string.
 //
 // Treats each character in the length n string as a coefficient of a
@@ -362,6 +362,7 @@ typedef enum {
 // shorthand for useful XattrValueType combinations
 #define MARFS_MD_XATTRS   (XVT_PRE | XVT_POST)     /* MD-related XattrValueTypes */
 #define MARFS_ALL_XATTRS  (XVT_PRE | XVT_POST | XVT_RESTART | XVT_SHARD)  /* all XattrValueTypes */
+#define MARFS_PACKED_XATTRS (XVT_PRE | XVT_POST | XVT_RESTART)   /* kept in MARFS_MD_XATTR */
 
 
 
@@ -417,10 +418,14 @@ typedef enum {
    PI_STAT_QUERY   = 0x02,      // i.e. maybe PathInfo.st empty for a reason
    PI_XATTR_QUERY  = 0x04,      // i.e. maybe PathInfo.xattr empty for a reason
    PI_TRASH_PATH   = 0x08,      // expand_trash_info() was called?
+   PI_XATTRS_V1    = 0x10,      // MD file has the text xattrs (see MARFS_MD_XATTR)
+   PI_MD_SHARD     = 0x20,      // post.md_path is in one of Namespace.md_shards (see shard.h)
    //   PI_STATVFS      = 0x80,      // stvfs has been initialized from Namespace.fsinfo?
 } PathInfoFlagValue;
 
 
+struct DedupTable;
+
 typedef struct PathInfo {
    MarFS_Namespace*     ns;
    struct stat          st;
@@ -436,6 +441,7 @@ typedef struct PathInfo {
 
    PathInfoFlagType     flags;
    char                 trash_md_path[MARFS_MAX_MD_PATH];
+   struct DedupTable*   dedup;       // chunk references (see dedup.h)
 } PathInfo;
 
 
@@ -539,10 +545,93 @@ typedef struct ReadQueueElt {
 } ReadQueueElt;
 
 
+
+// READ-AHEAD
+//
+// If the repo has read_buffers > 1, sequential reads are served from a
+// ring of buffers that is filled by a background thread, running ahead of
+// ReadStatus.log_offset.  This keeps the GET moving between calls to
+// marfs_read().  The thread does its own close/open at the end of each
+// byte-range, so the GET for the next chunk of a Multi is issued while the
+// caller is still consuming the tail of the previous chunk.
+//
+// While read-ahead is running, it owns the ObjectStream, and info.pre.  A
+// discontiguous read (or close) must call read_ahead_stop(), which joins
+// the thread.  The stream may be left open.  See read_ahead_*() in
+// common.c.
+
+#define RA_MAX_BUFS   16
+#define RA_BUF_SIZE   (1024 * 1024) /* per slot */
+
+typedef enum {
+   RA_STOP  = 0x01,             // read_ahead_stop() wants thread to quit
+   RA_DONE  = 0x02,             // thread reached log_end (or quit)
+   RA_ERR   = 0x04,             // thread failed.  See ReadAhead.err
+} RAFlags;
+
+typedef struct {
+   char*                buf;
+   size_t               len;       // valid data in <buf>.  0 means empty
+   size_t               pos;       // amount already given to marfs_read()
+} RABuf;
+
+typedef struct ReadAhead {
+   pthread_t            thr;
+   SEM_T                empty;     // counts free slots
+   SEM_T                full;      // counts filled slots
+   RABuf                ring[RA_MAX_BUFS];
+   uint8_t              bufs;      // number of slots in use
+   uint8_t              head;      // next slot for thread to fill
+   uint8_t              tail;      // next slot for marfs_read() to drain
+   size_t               log_offset; // logical offset of next byte to fetch
+   size_t               log_end;   // logical EOF
+   volatile uint8_t     flags;     // RAFlags
+   int                  err;       // errno, if RA_ERR
+} ReadAhead;
+
+
+// PARALLEL GET
+//
+// If the repo has parallel_gets > 1, a large span that marfs_read() wants
+// from a single chunk is split into that many sub-ranges, each of which is
+// fetched by its own thread, with its own stream, directly into the
+// caller's buffer.  Each sub-range calls update_pre(), so the requests are
+// spread across the host-range.  See parallel_get() in common.c.
+
+#define PG_MAX_PARTS      32
+#define PG_MIN_PART       (1024 * 1024) /* don't split below this */
+
+
+// HEDGED GET
+//
+// Each of the GETs issued by parallel_get() goes through fetch_range().
+// If the repo has hedge_percentile > 0, and the first bytes of a GET
+// haven't arrived after that percentile of the recent first-byte
+// latencies for the repo, a duplicate GET is sent to another host in the
+// host-range.  The first one to produce data gets to fill the caller's
+// buffer; the other is interrupted, and cleans up after itself.  Reads
+// smaller than HEDGE_MIN_SIZE are not hedged; they aren't worth the
+// private stream that each attempt needs.  If the repo has read_retries >
+// 0, a GET that fails is re-issued (up to that many times), possibly to a
+// different host.  Only parallel or hedged GETs are retried.
+
+#define HEDGE_MIN_SIZE    (1024 * 1024) /* smaller reads use the fh's own stream */
+#define HEDGE_PROBE_SIZE  (64 * 1024) /* "first bytes" of a response */
+#define HEDGE_SAMPLES     64          /* first-byte latencies kept per repo */
+#define HEDGE_MIN_SAMPLES 8           /* below this, use HEDGE_DEFAULT_MS */
+#define HEDGE_DEFAULT_MS  1000
+#define HEDGE_MIN_MS      20
+#define HEDGE_MAX_REPOS   32
+
+
 typedef struct {
    volatile size_t        log_offset;    // effective offset (shows contiguous reads)
    volatile size_t        data_remain;   // the unread part of marfs_open_at_offset()
    volatile ReadQueueElt* read_queue;    // out-of-order reads from NFS threads
+   ReadAhead*             read_ahead;    // non-NULL while read-ahead is running
+   size_t                 crc_start;     // logical start of chunk being verified
+   size_t                 crc_next;      // next logical offset it expects
+   uint32_t               crc;           // CRC32C of [crc_start, crc_next)
 } ReadStatus;
 
 
@@ -621,6 +710,9 @@ typedef struct {
    size_t        user_req;      // part of current request for user-data
    size_t        sys_req;       // part of current request for sys-data (recovery-info)
    size_t        rec_info_mark; // total user-data written as of last rec-info mark
+   uint32_t      chunk_crc;     // CRC32C of user-data in this chunk, so far
+   size_t        chunk_crc_len; // bytes covered by chunk_crc
+   uint32_t      file_crc;      // CRC32C of user-data in previous chunks
 } WriteStatus;
 
 
@@ -638,6 +730,9 @@ typedef struct {
 
 
 
+struct Stripe;
+struct ChunkIndex;
+
 typedef struct {
    PathInfo        info;         // includes xattrs, MDFS path, etc
    char            ns_path[MARFS_MAX_NS_PATH];  // path in NS, not in MDFS
@@ -674,6 +769,10 @@ typedef struct {
    int             data_ready;
    TimingData      timing_data;  // supersedes the TimingData in ne_handle
    char            repo_name[MARFS_MAX_REPO_NAME];    // repo where stats were gathered
+   struct Stripe*  stripe;       // per-object streams of a striped file (see stripe.h)
+   struct ChunkIndex* chunk_index; // in-memory MD chunk-info (see get_chunkinfo())
+   MultiChunkInfo  ci_pending[OS_MAX_PIPE]; // chunk-info for PUTs in flight (see queue_chunkinfo())
+   uint8_t         ci_pending_count;
 } MarFS_FileHandle;
 
 
@@ -900,6 +999,9 @@ extern int  trunc_xattrs  (PathInfo* info);
 extern int  trash_unlink  (PathInfo* info, const char* path);
 extern int  trash_truncate(PathInfo* info, const char* path);
 
+// rename() across MDFS roots of one namespace (e.g. MD shards)
+extern int  move_md_file  (PathInfo* info, const char* dest_path);
+
 extern int  check_quotas  (PathInfo* info);
 
 extern int  update_url     (ObjectStream* os, PathInfo* info);
@@ -926,6 +1028,8 @@ extern int  close_data(MarFS_FileHandle* fh,
                        int               abort_p,
                        int               force_p);
 extern int  delete_data(MarFS_FileHandle* fh);
+extern int  delete_data_many(MarFS_FileHandle* fh, const char** objids,
+                             size_t count, int* status);
 // extern int  init_data(MarFS_FileHandle* fh);
 
 extern int  fake_filehandle_for_delete(MarFS_FileHandle* fh,
@@ -942,12 +1046,40 @@ extern int     write_chunkinfo(MarFS_FileHandle*     fh,
                                size_t                user_data_written,
                                int                   size_is_per_chunk);
 
+// write a caller-built MultiChunkInfo into the slot for chnk->chunk_no
+extern int     put_chunkinfo  (MarFS_FileHandle* fh, const MultiChunkInfo* chnk);
+
+// Like write_chunkinfo(), for a chunk whose PUT was retired to a
+// write-pipeline.  The chunk-info is only written once the PUT has
+// finished.  flush_chunkinfo() writes whatever has finished so far.
+extern int     queue_chunkinfo(MarFS_FileHandle*     fh,
+                               size_t                user_data_written,
+                               int                   size_is_per_chunk);
+extern int     flush_chunkinfo(MarFS_FileHandle* fh);
+
 extern int     read_chunkinfo (MarFS_FileHandle* fh, MultiChunkInfo* chnk);
 
 extern int     seek_chunkinfo (MarFS_FileHandle* fh, size_t chunk_no);
 
 extern ssize_t count_chunkinfo(MarFS_FileHandle* fh);
 
+// random-access to the MultiChunkInfo for <chunk_no>.  The first call
+// loads all the chunk-info into <fh>, later calls just index into it.
+extern int     get_chunkinfo  (MarFS_FileHandle* fh, size_t chunk_no, MultiChunkInfo* chnk);
+extern void    free_chunk_index(MarFS_FileHandle* fh);
+
+
+// CORRECTTYPE_CRC32C.  Writers add user-data with update_correctinfo(),
+// get the value for this chunk's MultiChunkInfo with chunk_correctinfo(),
+// and call fold_correctinfo() when the chunk is done (also at close), to
+// update Post.correct_info.  Readers pass what they read to
+// verify_correctinfo(), which checks chunks that were read in order.
+extern void        update_correctinfo(MarFS_FileHandle* fh, const char* buf, size_t size);
+extern CorrectInfo chunk_correctinfo (MarFS_FileHandle* fh);
+extern void        fold_correctinfo  (MarFS_FileHandle* fh);
+extern int         verify_correctinfo(MarFS_FileHandle* fh, size_t offset,
+                                      const char* buf, size_t size);
+
 
 extern ssize_t write_recoveryinfo(ObjectStream* os, PathInfo* info, MarFS_FileHandle* fh);
 
@@ -975,6 +1107,20 @@ extern void          dequeue_reader(off_t offset, MarFS_FileHandle* fh);
 extern void          check_read_queue     (MarFS_FileHandle* fh);
 extern void          terminate_all_readers(MarFS_FileHandle* fh);
 
+// background read-ahead for sequential marfs_read()
+extern int           read_ahead_start(MarFS_FileHandle* fh, size_t offset, size_t log_end);
+extern ssize_t       read_ahead_get  (MarFS_FileHandle* fh, char* buf, size_t size);
+extern int           read_ahead_stop (MarFS_FileHandle* fh);
+
+// concurrent byte-range GETs within one chunk, for large reads
+extern int           parallel_get(MarFS_FileHandle* fh, char* buf,
+                                  size_t chunk_no, size_t chunk_offset,
+                                  size_t size, uint16_t timeout);
+
+// one byte-range GET, with hedging and retries per repo config
+extern int           fetch_range(MarFS_FileHandle* fh, char* buf,
+                                 size_t offset, size_t len, uint16_t timeout);
+
 //support for path conversion tool
 //extern void get_path_template(char* path_template, MarFS_FileHandle* fh);
 
@@ -0,0 +1,343 @@
+/*
+This file is part of MarFS, which is released under the BSD license.
+
+
+Copyright (c) 2015, Los Alamos National Security (LANS), LLC
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation and/or
+other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors
+may be used to endorse or promote products derived from this software without
+specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+-----
+NOTE:
+-----
+MarFS uses libaws4c for Amazon S3 object communication. The original version
+is at https://aws.amazon.com/code/Amazon-S3/2601 and under the LGPL license.
+LANS, LLC added functionality to the original work. The original work plus
+LANS, LLC contributions is found at https://github.com/jti-lanl/aws4c.
+
+GNU licenses can be found at <http://www.gnu.org/licenses/>.
+
+
+From Los Alamos National Security, LLC:
+LA-CC-15-039
+
+Copyright (c) 2015, Los Alamos National Security, LLC All rights reserved.
+Copyright 2015. Los Alamos National Security, LLC. This software was produced
+under U.S. Government contract DE-AC52-06NA25396 for Los Alamos National
+Laboratory (LANL), which is operated by Los Alamos National Security, LLC for
+the U.S. Department of Energy. The U.S. Government has rights to use,
+reproduce, and distribute this software.  NEITHER THE GOVERNMENT NOR LOS
+ALAMOS NATIONAL SECURITY, LLC MAKES ANY WARRANTY, EXPRESS OR IMPLIED, OR
+ASSUMES ANY LIABILITY FOR THE USE OF THIS SOFTWARE.  If software is
+modified to produce derivative works, such modified software should be
+clearly marked, so as not to confuse it with the version available from
+LANL.
+
+THIS SOFTWARE IS PROVIDED BY LOS ALAMOS NATIONAL SECURITY, LLC AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL LOS ALAMOS NATIONAL SECURITY, LLC OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+
+
+#include "crc32c.h"
+
+#include <string.h>
+#include <pthread.h>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#  define CRC32C_X86   1
+#  include <nmmintrin.h>
+#elif defined(__aarch64__) && defined(__GNUC__) && (__GNUC__ >= 6)
+#  define CRC32C_ARM   1
+#  include <arm_acle.h>
+#  include <sys/auxv.h>
+#  include <asm/hwcap.h>
+#endif
+
+
+#define CRC32C_POLY  0x82f63b78   // reflected
+
+
+static uint32_t        crc32c_table[8][256];
+static uint32_t        crc32c_x2n[32];     // x^(2^n) mod P
+static pthread_once_t  crc32c_once = PTHREAD_ONCE_INIT;
+
+typedef uint32_t (*crc32c_fn)(uint32_t crc, const void* buf, size_t len);
+static crc32c_fn       crc32c_best = NULL;
+static const char*     crc32c_best_name = "table";
+
+static void            crc32c_init(void);
+
+// The crc32 instructions have a latency of several cycles, but can start
+// one per cycle, so the hardware versions run three independent CRCs over
+// adjacent lanes, and then combine them.
+#define CRC32C_LANE    8192
+static uint32_t        crc32c_lane_shift;  // x^(8*CRC32C_LANE) mod P
+static uint32_t        crc32c_multmodp(uint32_t a, uint32_t b);
+
+
+
+// ---------------------------------------------------------------------------
+// table-driven
+// ---------------------------------------------------------------------------
+
+static uint32_t crc32c_tbl(uint32_t crc, const void* buf, size_t len) {
+   const uint8_t* p = (const uint8_t*)buf;
+
+   crc = ~crc;
+   while (len && ((uintptr_t)p & 7)) {
+      crc = crc32c_table[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+      --len;
+   }
+   while (len >= 8) {
+      uint64_t word;
+      memcpy(&word, p, 8);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+      word = __builtin_bswap64(word);
+#endif
+      word ^= crc;
+      crc = (crc32c_table[7][ word        & 0xff] ^
+             crc32c_table[6][(word >>  8) & 0xff] ^
+             crc32c_table[5][(word >> 16) & 0xff] ^
+             crc32c_table[4][(word >> 24) & 0xff] ^
+             crc32c_table[3][(word >> 32) & 0xff] ^
+             crc32c_table[2][(word >> 40) & 0xff] ^
+             crc32c_table[1][(word >> 48) & 0xff] ^
+             crc32c_table[0][ word >> 56        ]);
+      p   += 8;
+      len -= 8;
+   }
+   while (len--)
+      crc = crc32c_table[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+
+   return ~crc;
+}
+
+uint32_t crc32c_sw(uint32_t crc, const void* buf, size_t len) {
+   pthread_once(&crc32c_once, &crc32c_init);
+   return crc32c_tbl(crc, buf, len);
+}
+
+
+
+// ---------------------------------------------------------------------------
+// hardware
+// ---------------------------------------------------------------------------
+
+#if CRC32C_X86
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_hw(uint32_t crc, const void* buf, size_t len) {
+   const uint8_t* p = (const uint8_t*)buf;
+   uint64_t       c = ~crc;
+
+   while (len && ((uintptr_t)p & 7)) {
+      c = _mm_crc32_u8((uint32_t)c, *p++);
+      --len;
+   }
+   while (len >= 3 * CRC32C_LANE) {
+      const uint8_t* p1 = p  + CRC32C_LANE;
+      const uint8_t* p2 = p1 + CRC32C_LANE;
+      uint64_t       c1 = 0xffffffff;
+      uint64_t       c2 = 0xffffffff;
+      size_t         i;
+      for (i=0; i<CRC32C_LANE; i+=8) {
+         uint64_t w0, w1, w2;
+         memcpy(&w0, p  + i, 8);
+         memcpy(&w1, p1 + i, 8);
+         memcpy(&w2, p2 + i, 8);
+         c  = _mm_crc32_u64(c,  w0);
+         c1 = _mm_crc32_u64(c1, w1);
+         c2 = _mm_crc32_u64(c2, w2);
+      }
+      uint32_t f = ~(uint32_t)c;
+      f = crc32c_multmodp(crc32c_lane_shift, f) ^ ~(uint32_t)c1;
+      f = crc32c_multmodp(crc32c_lane_shift, f) ^ ~(uint32_t)c2;
+      c = ~f;
+      p   += 3 * CRC32C_LANE;
+      len -= 3 * CRC32C_LANE;
+   }
+   while (len >= 8) {
+      uint64_t word;
+      memcpy(&word, p, 8);
+      c    = _mm_crc32_u64(c, word);
+      p   += 8;
+      len -= 8;
+   }
+   while (len--)
+      c = _mm_crc32_u8((uint32_t)c, *p++);
+
+   return ~(uint32_t)c;
+}
+
+#elif CRC32C_ARM
+__attribute__((target("+crc")))
+static uint32_t crc32c_hw(uint32_t crc, const void* buf, size_t len) {
+   const uint8_t* p = (const uint8_t*)buf;
+
+   crc = ~crc;
+   while (len && ((uintptr_t)p & 7)) {
+      crc = __crc32cb(crc, *p++);
+      --len;
+   }
+   while (len >= 3 * CRC32C_LANE) {
+      const uint8_t* p1 = p  + CRC32C_LANE;
+      const uint8_t* p2 = p1 + CRC32C_LANE;
+      uint32_t       c1 = 0xffffffff;
+      uint32_t       c2 = 0xffffffff;
+      size_t         i;
+      for (i=0; i<CRC32C_LANE; i+=8) {
+         uint64_t w0, w1, w2;
+         memcpy(&w0, p  + i, 8);
+         memcpy(&w1, p1 + i, 8);
+         memcpy(&w2, p2 + i, 8);
+         crc = __crc32cd(crc, w0);
+         c1  = __crc32cd(c1,  w1);
+         c2  = __crc32cd(c2,  w2);
+      }
+      uint32_t f = ~crc;
+      f   = crc32c_multmodp(crc32c_lane_shift, f) ^ ~c1;
+      f   = crc32c_multmodp(crc32c_lane_shift, f) ^ ~c2;
+      crc = ~f;
+      p   += 3 * CRC32C_LANE;
+      len -= 3 * CRC32C_LANE;
+   }
+   while (len >= 8) {
+      uint64_t word;
+      memcpy(&word, p, 8);
+      crc  = __crc32cd(crc, word);
+      p   += 8;
+      len -= 8;
+   }
+   while (len--)
+      crc = __crc32cb(crc, *p++);
+
+   return ~crc;
+}
+#endif
+
+
+
+// ---------------------------------------------------------------------------
+// combine
+//
+// Appending len2 zero-bytes to A multiplies crc(A) by x^(8*len2), mod P.
+// We keep x^(2^n) for each n, so that takes one multiply per bit of len2.
+// ---------------------------------------------------------------------------
+
+static uint32_t crc32c_multmodp(uint32_t a, uint32_t b) {
+   uint32_t m = (uint32_t)1 << 31;
+   uint32_t p = 0;
+   for (;;) {
+      if (a & m) {
+         p ^= b;
+         if (! (a & (m - 1)))
+            break;
+      }
+      m >>= 1;
+      b = ((b & 1) ? ((b >> 1) ^ CRC32C_POLY) : (b >> 1));
+   }
+   return p;
+}
+
+// x^(8*len) mod P
+static uint32_t crc32c_shift(size_t len) {
+   uint32_t p = (uint32_t)1 << 31;      // x^0
+   int      k = 3;                      // len is bytes, we want bits
+   for (; len; len >>= 1, ++k) {
+      if (len & 1)
+         p = crc32c_multmodp(crc32c_x2n[k & 31], p);
+   }
+   return p;
+}
+
+static void crc32c_init(void) {
+   uint32_t n;
+   int      k;
+
+   for (n=0; n<256; ++n) {
+      uint32_t crc = n;
+      for (k=0; k<8; ++k)
+         crc = ((crc & 1) ? ((crc >> 1) ^ CRC32C_POLY) : (crc >> 1));
+      crc32c_table[0][n] = crc;
+   }
+   for (n=0; n<256; ++n) {
+      uint32_t crc = crc32c_table[0][n];
+      for (k=1; k<8; ++k) {
+         crc = crc32c_table[0][crc & 0xff] ^ (crc >> 8);
+         crc32c_table[k][n] = crc;
+      }
+   }
+
+   uint32_t p = (uint32_t)1 << 30;      // x^1
+   crc32c_x2n[0] = p;
+   for (k=1; k<32; ++k)
+      crc32c_x2n[k] = p = crc32c_multmodp(p, p);
+   crc32c_lane_shift = crc32c_shift(CRC32C_LANE);
+
+   crc32c_best = &crc32c_tbl;
+#if CRC32C_X86
+   __builtin_cpu_init();
+   if (__builtin_cpu_supports("sse4.2")) {
+      crc32c_best      = &crc32c_hw;
+      crc32c_best_name = "sse4.2";
+   }
+#elif CRC32C_ARM
+   if (getauxval(AT_HWCAP) & HWCAP_CRC32) {
+      crc32c_best      = &crc32c_hw;
+      crc32c_best_name = "armv8";
+   }
+#endif
+}
+
+uint32_t crc32c_combine(uint32_t crc1, uint32_t crc2, size_t len2) {
+   pthread_once(&crc32c_once, &crc32c_init);
+   return crc32c_multmodp(crc32c_shift(len2), crc1) ^ crc2;
+}
+
+
+
+// ---------------------------------------------------------------------------
+// dispatch
+// ---------------------------------------------------------------------------
+
+uint32_t crc32c(uint32_t crc, const void* buf, size_t len) {
+   pthread_once(&crc32c_once, &crc32c_init);
+   return (*crc32c_best)(crc, buf, len);
+}
+
+const char* crc32c_impl(void) {
+   pthread_once(&crc32c_once, &crc32c_init);
+   return crc32c_best_name;
+}
@@ -75,6 +75,8 @@ OF SUCH DAMAGE.
 #include "logging.h"
 #include "dal.h"
 #include "common.h"
+#include "crc32c.h"
+#include "rs_codec.h"
 
 #include <stdlib.h>             // malloc()
 #include <errno.h>
@@ -87,6 +89,11 @@ OF SUCH DAMAGE.
 #include <dlfcn.h>
 #include <assert.h>
 #include <limits.h>             // INT_MAX
+#include <pthread.h>            // async worker-pool
+#include <aio.h>                // posix_dal_put_async(), etc
+#include <math.h>               // fault_latency()
+#include <sys/uio.h>            // preadv(), pwritev()
+#include <time.h>
 
 
 // ===========================================================================
@@ -126,6 +133,492 @@ int     default_dal_ctx_destroy(DAL_Context* ctx, DAL* dal) {
 }
 
 
+// Config for DALs that wrap some other DAL (the "backend").  Their <opts>
+// include "backend", naming the DAL to wrap, and "backend.xxx" options,
+// which are given to the backend's config() as "xxx".  We configure a
+// private copy of the backend, and return it in <backend>.  The
+// remaining options are moved to the front of <opts>, and their number
+// returned in <my_count>, for the wrapper to parse.  The wrapper still
+// owns <opts>, and frees them when it's done.
+int   wrapper_dal_config(struct DAL*     dal,
+                         xDALConfigOpt** opts,
+                         size_t          opt_count,
+                         struct DAL**    backend,
+                         size_t*         my_count) {
+
+   xDALConfigOpt** backend_opts = (xDALConfigOpt**)calloc(opt_count +1, sizeof(xDALConfigOpt*));
+   const char*     backend_name = NULL;
+   size_t          backend_count = 0;
+   size_t          count = 0;
+   if (! backend_opts) {
+      LOG(LOG_ERR, "%s: couldn't allocate backend options\n", dal->name);
+      return -1;
+   }
+
+   int i;
+   for (i=0; i<opt_count; ++i) {
+      const char* key = opts[i]->key;
+
+      if (! strncmp(key, "backend.", 8)) {
+         opts[i]->key = key + 8;
+         backend_opts[backend_count++] = opts[i];
+      }
+      else if (! strcmp(key, "backend")) {
+         backend_name = opts[i]->val.value.str;
+         free(opts[i]);
+      }
+      else
+         opts[count++] = opts[i];
+   }
+   for (i=count; i<opt_count; ++i)
+      opts[i] = NULL;
+
+   if (! backend_name) {
+      LOG(LOG_ERR, "%s DAL needs a 'backend' option\n", dal->name);
+      return -1;
+   }
+
+   DAL* b = get_DAL(backend_name);
+   if (! b || (b->config == dal->config)) {
+      LOG(LOG_ERR, "%s DAL can't use backend '%s'\n", dal->name, backend_name);
+      return -1;
+   }
+   *backend = (DAL*)malloc(sizeof(DAL));
+   if (! *backend)
+      return -1;
+   **backend = *b;
+
+   // the backend is responsible for <backend_opts> from now on
+   if ((*(*backend)->config)(*backend, backend_opts, backend_count)) {
+      LOG(LOG_ERR, "%s: config failed for backend '%s'\n", dal->name, backend_name);
+      return -1;
+   }
+
+   *my_count = count;
+   return 0;
+}
+
+
+
+// ===========================================================================
+// ASYNC
+// ===========================================================================
+//
+// Default implementations of the async DAL ops.  Each DAL_Context that has
+// issued an async op gets a DAL_Async, holding a FIFO of requests.  A
+// shared pool of worker-threads runs the blocking DAL op for each request.
+// A given context is only ever being served by one worker at a time, so
+// its requests complete in the order they were issued, while requests for
+// different contexts proceed concurrently.  Workers are started as
+// needed, up to DAL_ASYNC_WORKERS, and never exit.
+//
+// DALs with a native async implementation (see posix_dal_put_async())
+// account for their ops with dal_async_begin()/dal_async_end(), so the
+// same wait() works for everyone.
+
+#define DAL_ASYNC_WORKERS  16
+
+typedef enum {
+   DA_PUT,
+   DA_GET,
+   DA_SYNC,
+} DAL_AsyncOp;
+
+typedef struct DAL_AsyncReq {
+   DAL_AsyncOp           op;
+   DAL*                  dal;
+   char*                 buf;
+   size_t                size;
+   dal_callback          cb;
+   void*                 arg;
+   struct DAL_AsyncReq*  next;
+} DAL_AsyncReq;
+
+typedef struct DAL_Async {
+   pthread_mutex_t       lock;
+   pthread_cond_t        idle;       // signalled when pending goes to 0
+   DAL_Context*          ctx;
+   DAL_AsyncReq*         head;       // not yet started
+   DAL_AsyncReq*         tail;
+   int                   pending;    // issued, but callback not yet run
+   int                   queued;     // on the ready-list, or being served
+   int                   err;        // errno from first failed op
+   struct DAL_Async*     next_ready;
+} DAL_Async;
+
+
+// contexts with requests, waiting for a worker
+static pthread_mutex_t   async_pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t    async_pool_cond = PTHREAD_COND_INITIALIZER;
+static DAL_Async*        async_ready_head = NULL;
+static DAL_Async*        async_ready_tail = NULL;
+static int               async_workers    = 0;
+static int               async_idle       = 0;
+
+
+static
+DAL_Async* dal_async_state(DAL_Context* ctx) {
+   if (! ctx->async) {
+      DAL_Async* as = (DAL_Async*)calloc(1, sizeof(DAL_Async));
+      if (! as) {
+         LOG(LOG_ERR, "couldn't allocate DAL_Async\n");
+         errno = ENOMEM;
+         return NULL;
+      }
+      pthread_mutex_init(&as->lock, NULL);
+      pthread_cond_init(&as->idle, NULL);
+      as->ctx    = ctx;
+      ctx->async = as;
+   }
+   return ctx->async;
+}
+
+
+// number of async ops outstanding on <ctx>
+int dal_async_pending(DAL_Context* ctx) {
+   DAL_Async* as = ctx->async;
+   if (! as)
+      return 0;
+
+   pthread_mutex_lock(&as->lock);
+   int pending = as->pending;
+   pthread_mutex_unlock(&as->lock);
+   return pending;
+}
+
+int dal_async_begin(DAL_Context* ctx) {
+   DAL_Async* as = dal_async_state(ctx);
+   if (! as)
+      return -1;
+
+   pthread_mutex_lock(&as->lock);
+   as->pending += 1;
+   pthread_mutex_unlock(&as->lock);
+   return 0;
+}
+
+void dal_async_end(DAL_Context* ctx, ssize_t rc, int err,
+                   dal_callback cb, void* arg) {
+   DAL_Async* as = ctx->async;
+
+   // run the callback first, so that anyone in wait() sees its effects
+   if (cb)
+      cb(ctx, rc, err, arg);
+
+   pthread_mutex_lock(&as->lock);
+   if ((rc < 0) && ! as->err)
+      as->err = (err ? err : EIO);
+   if (--as->pending == 0)
+      pthread_cond_broadcast(&as->idle);
+   pthread_mutex_unlock(&as->lock);
+}
+
+
+// put <as> at the back of the ready-list.  Caller holds async_pool_lock.
+static
+void dal_async_ready(DAL_Async* as) {
+   as->next_ready = NULL;
+   if (async_ready_tail)
+      async_ready_tail->next_ready = as;
+   else
+      async_ready_head = as;
+   async_ready_tail = as;
+}
+
+
+static
+void* dal_async_worker(void* arg) {
+
+   pthread_mutex_lock(&async_pool_lock);
+   while (1) {
+      while (! async_ready_head) {
+         async_idle += 1;
+         pthread_cond_wait(&async_pool_cond, &async_pool_lock);
+         async_idle -= 1;
+      }
+      DAL_Async* as = async_ready_head;
+      async_ready_head = as->next_ready;
+      if (! async_ready_head)
+         async_ready_tail = NULL;
+      pthread_mutex_unlock(&async_pool_lock);
+
+      // run one request for this context
+      pthread_mutex_lock(&as->lock);
+      DAL_AsyncReq* req = as->head;
+      as->head = req->next;
+      if (! as->head)
+         as->tail = NULL;
+      pthread_mutex_unlock(&as->lock);
+
+      DAL_Context* ctx = as->ctx;
+      ssize_t      rc;
+      errno = 0;
+      switch (req->op) {
+      case DA_PUT:   rc = (*req->dal->put) (ctx, req->buf, req->size);  break;
+      case DA_GET:   rc = (*req->dal->get) (ctx, req->buf, req->size);  break;
+      case DA_SYNC:  rc = (*req->dal->sync)(ctx);                       break;
+      default:       rc = -1;  errno = EINVAL;
+      }
+      int err = ((rc < 0) ? errno : 0);
+
+      // If there are more requests for this context, they hold their own
+      // pending counts, so <as> can't be freed by a wait() that wakes up
+      // after this callback.  Then this context goes to the back of the
+      // line.
+      pthread_mutex_lock(&as->lock);
+      int more = (as->head != NULL);
+      if (! more)
+         as->queued = 0;
+      pthread_mutex_unlock(&as->lock);
+
+      dal_async_end(ctx, rc, err, req->cb, req->arg);
+      free(req);
+
+      if (more) {
+         pthread_mutex_lock(&async_pool_lock);
+         dal_async_ready(as);
+         pthread_mutex_unlock(&async_pool_lock);
+      }
+
+      pthread_mutex_lock(&async_pool_lock);
+   }
+   return NULL;
+}
+
+
+static
+int dal_async_submit(DAL_Context* ctx, DAL* dal, DAL_AsyncOp op,
+                     char* buf, size_t size, dal_callback cb, void* arg) {
+
+   DAL_Async* as = dal_async_state(ctx);
+   if (! as)
+      return -1;
+
+   DAL_AsyncReq* req = (DAL_AsyncReq*)calloc(1, sizeof(DAL_AsyncReq));
+   if (! req) {
+      LOG(LOG_ERR, "couldn't allocate DAL_AsyncReq\n");
+      errno = ENOMEM;
+      return -1;
+   }
+   req->op   = op;
+   req->dal  = dal;
+   req->buf  = buf;
+   req->size = size;
+   req->cb   = cb;
+   req->arg  = arg;
+
+   pthread_mutex_lock(&async_pool_lock);
+
+   // start another worker, if nobody is idle
+   if (! async_idle && (async_workers < DAL_ASYNC_WORKERS)) {
+      pthread_t      thr;
+      pthread_attr_t attr;
+      pthread_attr_init(&attr);
+      pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+      if (pthread_create(&thr, &attr, &dal_async_worker, NULL))
+         LOG(LOG_ERR, "couldn't start async worker (%d running)\n", async_workers);
+      else
+         async_workers += 1;
+      pthread_attr_destroy(&attr);
+   }
+   if (! async_workers) {
+      pthread_mutex_unlock(&async_pool_lock);
+      free(req);
+      errno = EAGAIN;
+      return -1;
+   }
+
+   pthread_mutex_lock(&as->lock);
+   if (as->tail)
+      as->tail->next = req;
+   else
+      as->head = req;
+   as->tail     = req;
+   as->pending += 1;
+   int ready    = ! as->queued;
+   as->queued   = 1;
+   pthread_mutex_unlock(&as->lock);
+
+   if (ready) {
+      dal_async_ready(as);
+      pthread_cond_signal(&async_pool_cond);
+   }
+   pthread_mutex_unlock(&async_pool_lock);
+
+   return 0;
+}
+
+
+int     default_dal_put_async(DAL_Context* ctx, DAL* dal,
+                              const char* buf, size_t size,
+                              dal_callback cb, void* arg) {
+   return dal_async_submit(ctx, dal, DA_PUT, (char*)buf, size, cb, arg);
+}
+
+int     default_dal_get_async(DAL_Context* ctx, DAL* dal,
+                              char* buf, size_t size,
+                              dal_callback cb, void* arg) {
+   return dal_async_submit(ctx, dal, DA_GET, buf, size, cb, arg);
+}
+
+int     default_dal_sync_async(DAL_Context* ctx, DAL* dal,
+                               dal_callback cb, void* arg) {
+   return dal_async_submit(ctx, dal, DA_SYNC, NULL, 0, cb, arg);
+}
+
+int     default_dal_wait(DAL_Context* ctx, DAL* dal, int block) {
+   DAL_Async* as = ctx->async;
+   if (! as)
+      return 0;
+
+   pthread_mutex_lock(&as->lock);
+   if (! block && as->pending) {
+      int pending = as->pending;
+      pthread_mutex_unlock(&as->lock);
+      return pending;
+   }
+   while (as->pending)
+      pthread_cond_wait(&as->idle, &as->lock);
+   int err = as->err;
+   as->err = 0;
+   pthread_mutex_unlock(&as->lock);
+
+   if (err) {
+      errno = err;
+      return -1;
+   }
+   return 0;
+}
+
+int     default_dal_interrupt(DAL_Context* ctx) {
+   errno = ENOSYS;
+   return -1;
+}
+
+int     dal_async_free(DAL_Context* ctx) {
+   DAL_Async* as = ctx->async;
+   if (! as)
+      return 0;
+
+   int rc = default_dal_wait(ctx, NULL, 1);
+
+   // a worker may still be unlocking, after the last dal_async_end()
+   pthread_mutex_lock(&as->lock);
+   pthread_mutex_unlock(&as->lock);
+
+   pthread_cond_destroy(&as->idle);
+   pthread_mutex_destroy(&as->lock);
+   free(as);
+   ctx->async = NULL;
+   return rc;
+}
+
+
+
+
+// ===========================================================================
+// DELETE-MANY
+// ===========================================================================
+//
+// Default del_many().  A few threads each take the next objid from the
+// list, and delete it with the ordinary DAL ops, on a private copy of the
+// template file-handle.  For OBJECT, the S3 contexts come back out of the
+// connection-pool, so each thread mostly reuses one connection.
+
+#define DAL_DEL_MANY_THREADS  16
+#define DAL_DEL_MANY_PER_THR  8    // don't start threads for less than this
+
+typedef struct {
+   DAL*               dal;
+   MarFS_FileHandle*  fh;
+   const char**       objids;
+   size_t             count;
+   int*               status;
+   volatile size_t    next;
+} DAL_DelMany;
+
+
+static
+void* dal_del_many_worker(void* arg) {
+   DAL_DelMany* dm  = (DAL_DelMany*)arg;
+   DAL*         dal = dm->dal;
+   DAL_Context  ictx;
+   size_t       i;
+
+   MarFS_FileHandle* ifh = (MarFS_FileHandle*)calloc(1, sizeof(MarFS_FileHandle));
+   if (! ifh) {
+      while ((i = __sync_fetch_and_add(&dm->next, 1)) < dm->count)
+         dm->status[i] = ENOMEM;
+      return NULL;
+   }
+   ifh->info = dm->fh->info;
+
+   while ((i = __sync_fetch_and_add(&dm->next, 1)) < dm->count) {
+      strncpy(ifh->info.pre.objid, dm->objids[i], MARFS_MAX_OBJID_SIZE);
+      ifh->info.pre.objid[MARFS_MAX_OBJID_SIZE -1] = 0;
+
+      int err = 0;
+      memset(&ictx, 0, sizeof(DAL_Context));
+      if ((*dal->init)(&ictx, dal, ifh))
+         err = (errno ? errno : EIO);
+      else {
+         if ((*dal->update_object_location)(&ictx)
+             || (*dal->del)(&ictx))
+            err = (errno ? errno : EIO);
+         (*dal->destroy)(&ictx, dal);
+      }
+      if (err)
+         LOG(LOG_ERR, "delete failed for %s: %s\n", dm->objids[i], strerror(err));
+      dm->status[i] = err;
+   }
+
+   stream_release(&ifh->os);
+   free(ifh);
+   return NULL;
+}
+
+
+int     default_dal_del_many(DAL_Context* ctx, DAL* dal, void* fh,
+                             const char** objids, size_t count, int* status) {
+   DAL_DelMany dm = {
+      .dal    = dal,
+      .fh     = (MarFS_FileHandle*)fh,
+      .objids = objids,
+      .count  = count,
+      .status = status,
+      .next   = 0,
+   };
+
+   size_t want = count / DAL_DEL_MANY_PER_THR;
+   if (want > DAL_DEL_MANY_THREADS)
+      want = DAL_DEL_MANY_THREADS;
+
+   pthread_t thr[DAL_DEL_MANY_THREADS];
+   size_t    started = 0;
+   while (started < want) {
+      if (pthread_create(&thr[started], NULL, &dal_del_many_worker, &dm)) {
+         LOG(LOG_ERR, "couldn't start delete thread (%ld running)\n", started);
+         break;
+      }
+      ++ started;
+   }
+
+   // we help, or do it all, if there were no threads
+   dal_del_many_worker(&dm);
+   while (started)
+      pthread_join(thr[--started], NULL);
+
+   size_t i;
+   for (i=0; i<count; ++i) {
+      if (status[i]) {
+         errno = status[i];
+         return -1;
+      }
+   }
+   return 0;
+}
+
+
 
 
 // ================================================================
@@ -196,6 +689,15 @@ int     obj_init(DAL_Context* ctx, DAL* dal, void* fh) {
    return stream_init(OS(ctx), NULL, FH(ctx));
 }
 
+// hand the stream's AWSContext back to the connection-pool (or free it)
+int     obj_destroy(DAL_Context* ctx, DAL* dal) {
+   return stream_release(OS(ctx));
+}
+
+int     obj_interrupt(DAL_Context* ctx) {
+   return stream_interrupt(OS(ctx));
+}
+
 
 
 int     obj_open(DAL_Context* ctx,
@@ -217,6 +719,29 @@ int     obj_put(DAL_Context*  ctx,
    return stream_put(OS(ctx), buf, size);
 }
 
+// If the stream has a write-ring (Repo.write_buffers > 1), stream_put()
+// already returns as soon as <buf> has been copied into a slot, so there's
+// no need to hand it to a worker.  We still go through the worker-pool if
+// it has anything queued for us, to preserve ordering.
+int     obj_put_async(DAL_Context*  ctx,
+                      DAL*          dal,
+                      const char*   buf,
+                      size_t        size,
+                      dal_callback  cb,
+                      void*         arg) {
+
+   if ((OS(ctx)->wr_bufs > 1)
+       && ! dal_async_pending(ctx)) {
+
+      if (dal_async_begin(ctx))
+         return -1;
+      int rc = stream_put(OS(ctx), buf, size);
+      dal_async_end(ctx, rc, ((rc < 0) ? errno : 0), cb, arg);
+      return 0;
+   }
+   return default_dal_put_async(ctx, dal, buf, size, cb, arg);
+}
+
 ssize_t obj_get(DAL_Context*  ctx,
                 char*         buf,
                 size_t        size) {
@@ -269,7 +794,7 @@ static DAL obj_dal = {
    .destroy                = &default_dal_ctx_destroy,
 #else
    .init                   = &obj_init,
-   .destroy                = &default_dal_ctx_destroy,
+   .destroy                = &obj_destroy,
 #endif
 
    .open                   = &obj_open,
@@ -279,7 +804,10 @@ static DAL obj_dal = {
    .abort                  = &obj_abort,
    .close                  = &obj_close,
    .del                    = &obj_delete,
-   .update_object_location = &obj_update_object_location
+   .update_object_location = &obj_update_object_location,
+
+   .put_async              = &obj_put_async,
+   .interrupt              = &obj_interrupt,
 };
 
 
@@ -361,15 +889,44 @@ DAL nop_dal = {
 
 #define MAX_POSIX_PREFIX_LEN MARFS_MAX_REPO_NAME
 
+// Objects can be spread across <fanout_levels> of subdirectories under
+// the namespace directory, each level having up to <fanout_width>
+// subdirectories (named in hex), chosen by hashing the objid.  The default
+// (0 levels) puts every object directly in the namespace directory.
+//
+// Fan-out can be turned on for a repo that already has objects.  Objects
+// are only ever created in the fan-out layout, but a get or delete that
+// doesn't find the object there tries the flat path, too.  (See
+// posix_flat_path().)  Changing fanout_levels or fanout_width on a repo
+// that already uses fan-out would strand its objects.  Don't do that.
+//
+//   <opt> <key_val> fanout_levels : N </key_val> </opt>   max 4
+//   <opt> <key_val> fanout_width  : N </key_val> </opt>   max 4096
+//
+#define POSIX_MAX_FANOUT_LEVELS  4
+#define POSIX_MAX_FANOUT_WIDTH   4096
+
 #define MAX_OBJECT_PATH_LEN (MAX_POSIX_PREFIX_LEN               \
                              + MARFS_MAX_REPO_NAME + 1          \
                              + MARFS_MAX_NAMESPACE_NAME + 1     \
+                             + (POSIX_MAX_FANOUT_LEVELS * 4)    \
                              + MARFS_MAX_OBJID_SIZE + 1)
 
+// POSIX DAL.global_state.  POSIX_DIRECT extends this.
+typedef struct {
+   int      fanout_levels;
+   int      fanout_width;
+} PosixConfig;
+
+struct posix_direct;
+
 typedef struct posix_dal_ctx {
    MarFS_FileHandle* fh;
+   const PosixConfig* config;
    int fd;
    char file_path[MAX_OBJECT_PATH_LEN];
+   size_t dir_len;              // file_path[0..dir_len) is the parent dir
+   struct posix_direct* direct; // only for POSIX_DIRECT
 } PosixDal_Context;
 
 enum posix_dal_flags {
@@ -383,31 +940,155 @@ enum posix_dal_flags {
 #define POSIX_DAL_PATH(CTX)    POSIX_DAL_CONTEXT(CTX)->file_path
 
 
+// parse one of the options in the comment above POSIX_MAX_FANOUT_LEVELS.
+// Returns 1 if <key> was one of ours, otherwise 0.
+static
+int posix_config_opt(PosixConfig* cfg, const char* key, const char* val) {
+   if (! strcmp(key, "fanout_levels"))
+      cfg->fanout_levels = strtol(val, NULL, 10);
+   else if (! strcmp(key, "fanout_width"))
+      cfg->fanout_width = strtol(val, NULL, 10);
+   else
+      return 0;
+
+   LOG(LOG_INFO, "parsing posix option \"%s\" = %s\n", key, val);
+   return 1;
+}
+
+static
+void posix_config_check(PosixConfig* cfg) {
+   if (cfg->fanout_levels < 0)
+      cfg->fanout_levels = 0;
+   if (cfg->fanout_levels > POSIX_MAX_FANOUT_LEVELS)
+      cfg->fanout_levels = POSIX_MAX_FANOUT_LEVELS;
+   if (cfg->fanout_width < 1)
+      cfg->fanout_width = 256;
+   if (cfg->fanout_width > POSIX_MAX_FANOUT_WIDTH)
+      cfg->fanout_width = POSIX_MAX_FANOUT_WIDTH;
+}
+
+int posix_dal_config(struct DAL*     dal,
+                     xDALConfigOpt** opts,
+                     size_t          opt_count) {
+
+   PosixConfig* cfg = (PosixConfig*)calloc(1, sizeof(PosixConfig));
+   if (! cfg) {
+      LOG(LOG_ERR, "couldn't allocate PosixConfig\n");
+      return -1;
+   }
+
+   int i;
+   for (i=0; i<opt_count; ++i) {
+      if (! posix_config_opt(cfg, opts[i]->key, opts[i]->val.value.str)) {
+         LOG(LOG_ERR, "Unrecognized POSIX DAL config option: %s\n",
+             opts[i]->key);
+         free(cfg);
+         return -1;
+      }
+   }
+   free_xdal_config_options(opts);
+   posix_config_check(cfg);
+
+   dal->global_state = cfg;
+   return 0;
+}
+
+
+
+// Process-wide cache of directories we know exist, so that opening an
+// object doesn't have to stat() (or mkdir()) its parents every time.  We
+// only remember paths, hashed into a fixed-size table.  If the table
+// fills, we just keep calling mkdir().  A directory that is removed behind
+// our back will cause the open to fail, which is what would have happened
+// anyhow, without the cache.
+
+#define POSIX_DIR_CACHE_SIZE  (64 * 1024)
+
+static char*           posix_dir_cache[POSIX_DIR_CACHE_SIZE];
+static pthread_mutex_t posix_dir_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static
+int posix_dir_cached(const char* path, int insert) {
+   size_t h     = polyhash(path) % POSIX_DIR_CACHE_SIZE;
+   int    found = 0;
+   int    i;
+
+   pthread_mutex_lock(&posix_dir_cache_lock);
+   for (i=0; i<16; ++i) {
+      char** slot = &posix_dir_cache[(h + i) % POSIX_DIR_CACHE_SIZE];
+      if (! *slot) {
+         if (insert)
+            *slot = strdup(path);
+         break;
+      }
+      if (! strcmp(*slot, path)) {
+         found = 1;
+         break;
+      }
+   }
+   pthread_mutex_unlock(&posix_dir_cache_lock);
+   return found;
+}
+
+// mkdir <path>, and any missing parents below <top_len>, unless the
+// cache says it already exists.  <path> is modified temporarily.
+static
+int posix_mkdirs(char* path, size_t top_len) {
+   if (posix_dir_cached(path, 0))
+      return 0;
+
+   char* p = path + top_len;
+   while (1) {
+      char* slash = strchr(p, '/');
+      if (slash)
+         *slash = 0;
+      if (*path
+          && mkdir(path, 0755) // XXX: an arbitrary mode.
+          && (errno != EEXIST)) {
+         LOG(LOG_ERR, "POSIX_DAL: mkdir(%s) failed: %s\n", path, strerror(errno));
+         if (slash)
+            *slash = '/';
+         return -1;
+      }
+      if (! slash)
+         break;
+      *slash = '/';
+      p = slash +1;
+      if (! *p)
+         break;
+   }
+
+   posix_dir_cached(path, 1);
+   return 0;
+}
+
+
 int posix_dal_ctx_init(DAL_Context* ctx, struct DAL* dal, void* fh /* ? */) {
    ENTRY();
    ctx->data.ptr = malloc(sizeof(PosixDal_Context));
+   if (! ctx->data.ptr) {
+      LOG(LOG_ERR, "couldn't allocate PosixDal_Context\n");
+      errno = ENOMEM;
+      return -1;
+   }
    POSIX_DAL_CONTEXT(ctx)->fd = -1;
    POSIX_DAL_CONTEXT(ctx)->fh = (MarFS_FileHandle*)fh;
+   POSIX_DAL_CONTEXT(ctx)->config = (const PosixConfig*)dal->global_state;
+   POSIX_DAL_CONTEXT(ctx)->dir_len = 0;
+   POSIX_DAL_CONTEXT(ctx)->direct = NULL;
    ctx->flags = 0;
 
    // create repo/namespace directory under the posix-repo from config.
    const MarFS_Repo *repo = POSIX_DAL_FH(ctx)->info.pre.repo;
    const MarFS_Namespace *ns = POSIX_DAL_FH(ctx)->info.pre.ns;
-   struct stat st;
 
    char repo_path[MARFS_MAX_REPO_NAME + MARFS_MAX_HOST_SIZE
                   + MARFS_MAX_NAMESPACE_NAME];
-   sprintf(repo_path, "%s/%s", repo->host, repo->name);
 
    // Check that the directory
    // <repo-host>/<repo-name>/<namespace-name> exists
-   if(stat(repo_path, &st) == -1) {
-      TRY0( mkdir(repo_path, 0755) ); // XXX: an arbitrary mode.
-   }
    sprintf(repo_path, "%s/%s/%s", repo->host, repo->name, ns->name);
-   if(stat(repo_path, &st) == -1) {
-      TRY0( mkdir(repo_path, 0755) );
-   }
+   TRY0( posix_mkdirs(repo_path, strlen(repo->host) +1) );
 
    memset(POSIX_DAL_PATH(ctx), '\0', MAX_OBJECT_PATH_LEN);
    
@@ -422,31 +1103,96 @@ int posix_dal_ctx_destroy(DAL_Context* ctx, struct DAL* dal) {
 }
 
 
-// Generate the full path the the object in the POSIX repository.
-// This will be used as the ->update_object_location interface
-// function.
-int generate_path(DAL_Context* ctx) {
-   ENTRY();
-   const MarFS_Repo*      repo        = POSIX_DAL_FH(ctx)->info.pre.repo;
-   const MarFS_Namespace* ns          = POSIX_DAL_FH(ctx)->info.pre.ns;
-   char*                  object_path = POSIX_DAL_PATH(ctx);
+// Write the path for <objid> into <object_path>, and return the length of
+// its parent-directory part (including the trailing slash).
+static
+size_t posix_object_path(char*                  object_path,
+                         const PosixConfig*     config,
+                         const MarFS_Repo*      repo,
+                         const MarFS_Namespace* ns,
+                         const char*            objid) {
 
    sprintf(object_path, "%s/%s/%s/", repo->host, repo->name, ns->name);
    LOG(LOG_INFO, "POSIX_DAL Repo top level dir: %s\n", object_path);
 
-   char* object_id_start = object_path + strlen(object_path);
-   strncat(object_path, POSIX_DAL_FH(ctx)->info.pre.objid,
-           MARFS_MAX_OBJID_SIZE);
+   // fan-out subdirs.  polyhash() is weak in the low bits, for objids
+   // that differ only near the end, so scramble it first.
+   if (config && config->fanout_levels) {
+      uint64_t h = polyhash(objid);
+      h ^= h >> 33;
+      h *= 0xff51afd7ed558ccdULL;
+      h ^= h >> 33;
+
+      int i;
+      for (i=0; i<config->fanout_levels; ++i) {
+         char* end = object_path + strlen(object_path);
+         sprintf(end, "%x/", (unsigned)(h % config->fanout_width));
+         h /= config->fanout_width;
+      }
+   }
+   size_t dir_len = strlen(object_path);
+
+   char* object_id_start = object_path + dir_len;
+   strncat(object_path, objid, MARFS_MAX_OBJID_SIZE);
 
    flatten_objid(object_id_start);
 
    LOG(LOG_INFO, "generated path: %s\n", object_path);
+   return dir_len;
+}
+
+// Generate the full path the the object in the POSIX repository.
+// This will be used as the ->update_object_location interface
+// function.
+int generate_path(DAL_Context* ctx) {
+   ENTRY();
+
+   POSIX_DAL_CONTEXT(ctx)->dir_len
+      = posix_object_path(POSIX_DAL_PATH(ctx),
+                          POSIX_DAL_CONTEXT(ctx)->config,
+                          POSIX_DAL_FH(ctx)->info.pre.repo,
+                          POSIX_DAL_FH(ctx)->info.pre.ns,
+                          POSIX_DAL_FH(ctx)->info.pre.objid);
    ctx->flags |= POSIX_DAL_PATH_GENERATED;
 
    EXIT();
    return 0;
 }
 
+// Point <ctx> at the flat (no fan-out) path for its objid, where objects
+// written before fan-out was configured will be.  Returns 0 if there is no
+// fan-out, so there's nowhere else to look.
+static
+int posix_flat_path(DAL_Context* ctx) {
+   const PosixConfig* config = POSIX_DAL_CONTEXT(ctx)->config;
+   if (! config || ! config->fanout_levels)
+      return 0;
+
+   POSIX_DAL_CONTEXT(ctx)->dir_len
+      = posix_object_path(POSIX_DAL_PATH(ctx), NULL,
+                          POSIX_DAL_FH(ctx)->info.pre.repo,
+                          POSIX_DAL_FH(ctx)->info.pre.ns,
+                          POSIX_DAL_FH(ctx)->info.pre.objid);
+   return 1;
+}
+
+// make sure the fan-out subdirs for the object exist, before creating it
+static
+int posix_object_dirs(DAL_Context* ctx) {
+   const PosixConfig* config = POSIX_DAL_CONTEXT(ctx)->config;
+   if (! config || ! config->fanout_levels)
+      return 0;
+
+   char*  path    = POSIX_DAL_PATH(ctx);
+   size_t dir_len = POSIX_DAL_CONTEXT(ctx)->dir_len;
+   char   save    = path[dir_len];
+
+   path[dir_len] = 0;
+   int rc = posix_mkdirs(path, strlen(POSIX_DAL_FH(ctx)->info.pre.repo->host) +1);
+   path[dir_len] = save;
+   return rc;
+}
+
 int posix_dal_open(DAL_Context* ctx,
                    int          is_put,
                    size_t       chunk_offset,
@@ -455,170 +1201,3920 @@ int posix_dal_open(DAL_Context* ctx,
                    uint16_t     timeout) {
    ENTRY();
 
-   // fail if the path has not been generated. This should never
-   // happen and would be a logical error.
-   if(! (ctx->flags & POSIX_DAL_PATH_GENERATED)) {
-      LOG(LOG_ERR, "POSIX_DAL: no previous call to "
-          "DAL->update_object_location");
+   // fail if the path has not been generated. This should never
+   // happen and would be a logical error.
+   if(! (ctx->flags & POSIX_DAL_PATH_GENERATED)) {
+      LOG(LOG_ERR, "POSIX_DAL: no previous call to "
+          "DAL->update_object_location");
+      return -1;
+   }
+
+   TRY0( stream_cleanup_for_reopen(POSIX_DAL_OS(ctx), preserve_write_count) );
+
+   char*        object_path = POSIX_DAL_PATH(ctx);
+   int          object_flags;
+   const mode_t mode        = S_IRUSR|S_IWUSR;
+
+   if(is_put) {
+      TRY0( posix_object_dirs(ctx) );
+      POSIX_DAL_OS(ctx)->flags |= OSF_WRITING;
+      object_flags = O_WRONLY|O_CREAT;
+   }
+   else {
+      POSIX_DAL_OS(ctx)->flags |= OSF_READING;
+      object_flags = O_RDONLY;
+   }
+
+   int fd = open(object_path, object_flags, mode);
+   if ((fd < 0) && (errno == ENOENT) && ! is_put && posix_flat_path(ctx)) {
+      LOG(LOG_INFO, "POSIX_DAL: trying flat path %s\n", object_path);
+      fd = open(object_path, object_flags, mode);
+   }
+   if(fd < 0) {
+      LOG(LOG_ERR, "Failed to open file with posix_dal: %s\n", object_path);
+      return -1;
+   }
+
+   if (chunk_offset) {
+      off_t rc = lseek(fd, chunk_offset, SEEK_SET);
+      if (rc == (off_t)-1) {
+         LOG(LOG_ERR, "lseek(%ld) faild for posix_dal: %s\n",
+             chunk_offset, object_path);
+         return -1;
+      }
+   }
+
+   POSIX_DAL_FD(ctx) = fd;
+   POSIX_DAL_OS(ctx)->flags |= OSF_OPEN;
+
+   EXIT();
+   return 0;
+}
+
+int posix_dal_put(DAL_Context* ctx, const char* buf, size_t size) {
+   int written = write(POSIX_DAL_FD(ctx), buf, size);
+
+   if(written >= 0)
+      POSIX_DAL_OS(ctx)->written += written;
+
+   return written;
+}
+
+ssize_t posix_dal_get(DAL_Context* ctx, char* buf, size_t size) {
+   ssize_t size_read = 0;
+
+   size_read = read(POSIX_DAL_FD(ctx), buf, size);
+   if(size_read == 0) {
+      POSIX_DAL_OS(ctx)->flags |= OSF_EOF;
+   }
+   else if(size_read < 0) {
+      return size_read; // relying on errno set by read
+   }
+
+   POSIX_DAL_OS(ctx)->written += size_read;
+
+   return size_read;
+}
+
+static int close_posix_object(DAL_Context* ctx) {
+   TRY_DECLS();
+
+   TRY0( close(POSIX_DAL_FD(ctx)) );
+   POSIX_DAL_OS(ctx)->flags &= ~OSF_OPEN;
+   POSIX_DAL_OS(ctx)->flags |= OSF_CLOSED;
+   // prevent future mistakes by clearing out the file descriptor.
+   POSIX_DAL_FD(ctx) = -1;
+
+   return 0;
+}
+
+// See comments on stream_sync. When this returns, all I/O (ever) is
+// completed. No more I/O errors are possible. There should be no more
+// operations done on the stream at this point.
+int posix_dal_sync(DAL_Context* ctx) {
+   TRY_DECLS();
+
+   // fsync will set errno = EBADF if the fd is not open. In order to
+   // be consistent with stream_sync, we detect that case and fail
+   // with EINVAL instead.
+   if(! (POSIX_DAL_OS(ctx)->flags & OSF_OPEN)) {
+      LOG(LOG_ERR, "%s isn't open\n", POSIX_DAL_OS(ctx)->url);
+      errno = EINVAL;
+      return -1;
+   }
+
+   TRY0( fsync(POSIX_DAL_FD(ctx)) );
+
+   // Since close might cause an error we do it here.
+   TRY0( close_posix_object(ctx) );
+
+   return 0;
+}
+
+// Undo any writes that have been made since the "object" was opened.
+//
+// NOTE: Based on the use of this function, we are assuming that no
+//       data has been written to the object when this is called.
+//       In this case, this boils down to a no-op.
+int posix_dal_abort(DAL_Context* ctx) {
+   if(! (POSIX_DAL_OS(ctx)->flags & OSF_OPEN)) {
+      LOG(LOG_ERR, "POSIX_DAL: abort: %s isn't open", POSIX_DAL_OS(ctx)->url);
+      errno = EINVAL;
+      return -1;
+   }
+
+   POSIX_DAL_OS(ctx)->flags |= OSF_ABORT;
+
+   // other than setting flags, this is a no-op.
+
+   return 0;
+}
+
+int posix_dal_close(DAL_Context* ctx) {
+   TRY_DECLS();
+
+   // the file may have already been closed by _sync
+   if(! (POSIX_DAL_OS(ctx)->flags & OSF_OPEN)) {
+      return 0;
+   }
+
+   TRY0( close_posix_object(ctx) );
+
+   return 0;
+}
+
+int posix_dal_delete(DAL_Context* ctx) {
+   int rc = unlink(POSIX_DAL_PATH(ctx));
+   if (rc && (errno == ENOENT) && posix_flat_path(ctx))
+      rc = unlink(POSIX_DAL_PATH(ctx));
+   return rc;
+}
+
+// Batch delete.  With fan-out, a batch is spread over many directories,
+// so we keep a small table of open dirfds, and unlinkat() each object
+// relative to its parent.  That saves the kernel walking the whole path
+// again for every object.  POSIX_DIRECT has the same layout, and uses
+// this too.
+
+#define POSIX_DEL_DIRFDS  64
+
+typedef struct {
+   int    fd;
+   char   dir[MAX_OBJECT_PATH_LEN];
+} PosixDirFd;
+
+int posix_dal_del_many(DAL_Context* ctx, DAL* dal, void* fh_void,
+                       const char** objids, size_t count, int* status) {
+
+   MarFS_FileHandle*  fh     = (MarFS_FileHandle*)fh_void;
+   const PosixConfig* config = POSIX_DAL_CONTEXT(ctx)->config;
+   char*              path   = POSIX_DAL_PATH(ctx);
+   int                first  = 0;
+   size_t             i;
+
+   PosixDirFd* dirs = (PosixDirFd*)malloc(POSIX_DEL_DIRFDS * sizeof(PosixDirFd));
+   if (! dirs)
+      return default_dal_del_many(ctx, dal, fh, objids, count, status);
+   for (i=0; i<POSIX_DEL_DIRFDS; ++i)
+      dirs[i].fd = -1;
+
+   for (i=0; i<count; ++i) {
+      size_t dir_len = posix_object_path(path, config,
+                                         fh->info.pre.repo, fh->info.pre.ns,
+                                         objids[i]);
+      char   save    = path[dir_len];
+      path[dir_len] = 0;
+
+      PosixDirFd* d = &dirs[polyhash(path) % POSIX_DEL_DIRFDS];
+      if ((d->fd < 0) || strcmp(d->dir, path)) {
+         if (d->fd >= 0)
+            close(d->fd);
+         d->fd = open(path, O_RDONLY | O_DIRECTORY);
+         strcpy(d->dir, path);
+      }
+      path[dir_len] = save;
+
+      status[i] = 0;
+      if (d->fd < 0)
+         status[i] = errno;
+      else if (unlinkat(d->fd, path + dir_len, 0))
+         status[i] = errno;
+
+      // maybe written before fan-out was configured
+      if ((status[i] == ENOENT) && config && config->fanout_levels) {
+         posix_object_path(path, NULL, fh->info.pre.repo, fh->info.pre.ns,
+                           objids[i]);
+         status[i] = (unlink(path) ? errno : 0);
+      }
+
+      if (status[i]) {
+         LOG(LOG_ERR, "POSIX_DAL: unlink(%s) failed: %s\n",
+             path, strerror(status[i]));
+         if (! first)
+            first = status[i];
+      }
+   }
+
+   for (i=0; i<POSIX_DEL_DIRFDS; ++i) {
+      if (dirs[i].fd >= 0)
+         close(dirs[i].fd);
+   }
+   free(dirs);
+
+   // the path in <ctx> no longer matches <fh>
+   ctx->flags &= ~POSIX_DAL_PATH_GENERATED;
+
+   if (first) {
+      errno = first;
+      return -1;
+   }
+   return 0;
+}
+
+
+// Native async ops, using POSIX AIO.  Each op gets the current file
+// offset, and advances the fd's offset past it, so async ops can be
+// mixed with the blocking ones, as long as caller waits for them before
+// sync/close.  Completions run in threads started by the AIO library.
+// posix_dal_sync_async() uses aio_fsync(), which covers all the ops
+// already queued on the fd, and closes the file when it completes.
+
+typedef struct {
+   struct aiocb   cb;
+   DAL_Context*   ctx;
+   int            is_get;
+   int            is_sync;
+   dal_callback   fn;
+   void*          arg;
+} PosixAIO;
+
+static
+void posix_aio_done(union sigval sv) {
+   PosixAIO*    pa  = (PosixAIO*)sv.sival_ptr;
+   DAL_Context* ctx = pa->ctx;
+
+   int     err = aio_error(&pa->cb);
+   ssize_t rc  = aio_return(&pa->cb);
+   if (err) {
+      LOG(LOG_ERR, "POSIX_DAL: async op on %s failed: %s\n",
+          POSIX_DAL_PATH(ctx), strerror(err));
+      rc = -1;
+   }
+   else if (pa->is_sync) {
+      rc = close_posix_object(ctx);
+      err = ((rc < 0) ? errno : 0);
+   }
+   else {
+      __sync_fetch_and_add(&POSIX_DAL_OS(ctx)->written, rc);
+      if (pa->is_get && (rc == 0))
+         POSIX_DAL_OS(ctx)->flags |= OSF_EOF;
+   }
+
+   dal_async_end(ctx, rc, err, pa->fn, pa->arg);
+   free(pa);
+}
+
+static
+int posix_aio_start(DAL_Context* ctx, int is_get, int is_sync,
+                    char* buf, size_t size, dal_callback fn, void* arg) {
+
+   if (POSIX_DAL_FD(ctx) < 0) {
+      LOG(LOG_ERR, "POSIX_DAL: %s isn't open\n", POSIX_DAL_PATH(ctx));
+      errno = EBADF;
+      return -1;
+   }
+
+   PosixAIO* pa = (PosixAIO*)calloc(1, sizeof(PosixAIO));
+   if (! pa) {
+      LOG(LOG_ERR, "POSIX_DAL: couldn't allocate PosixAIO\n");
+      errno = ENOMEM;
+      return -1;
+   }
+   pa->ctx     = ctx;
+   pa->is_get  = is_get;
+   pa->is_sync = is_sync;
+   pa->fn      = fn;
+   pa->arg     = arg;
+
+   pa->cb.aio_fildes = POSIX_DAL_FD(ctx);
+   pa->cb.aio_buf    = buf;
+   pa->cb.aio_nbytes = size;
+   pa->cb.aio_sigevent.sigev_notify          = SIGEV_THREAD;
+   pa->cb.aio_sigevent.sigev_notify_function = &posix_aio_done;
+   pa->cb.aio_sigevent.sigev_value.sival_ptr = pa;
+
+   if (! is_sync) {
+      // claim [offset, offset+size) of the file for this op
+      off_t end = lseek(POSIX_DAL_FD(ctx), size, SEEK_CUR);
+      if (end == (off_t)-1) {
+         LOG(LOG_ERR, "POSIX_DAL: lseek failed for %s\n", POSIX_DAL_PATH(ctx));
+         free(pa);
+         return -1;
+      }
+      pa->cb.aio_offset = end - size;
+   }
+
+   if (dal_async_begin(ctx)) {
+      free(pa);
+      return -1;
+   }
+
+   int rc = (is_sync
+             ? aio_fsync(O_SYNC, &pa->cb)
+             : is_get
+             ? aio_read(&pa->cb)
+             : aio_write(&pa->cb));
+   if (rc) {
+      int err = errno;
+      LOG(LOG_ERR, "POSIX_DAL: couldn't start async op on %s: %s\n",
+          POSIX_DAL_PATH(ctx), strerror(err));
+      if (! is_sync)
+         lseek(POSIX_DAL_FD(ctx), -(off_t)size, SEEK_CUR);
+      dal_async_end(ctx, 0, 0, NULL, NULL);
+      free(pa);
+      errno = err;
+      return -1;
+   }
+   return 0;
+}
+
+int posix_dal_put_async(DAL_Context* ctx, DAL* dal,
+                        const char* buf, size_t size,
+                        dal_callback cb, void* arg) {
+   return posix_aio_start(ctx, 0, 0, (char*)buf, size, cb, arg);
+}
+
+int posix_dal_get_async(DAL_Context* ctx, DAL* dal,
+                        char* buf, size_t size,
+                        dal_callback cb, void* arg) {
+   return posix_aio_start(ctx, 1, 0, buf, size, cb, arg);
+}
+
+int posix_dal_sync_async(DAL_Context* ctx, DAL* dal,
+                         dal_callback cb, void* arg) {
+   if(! (POSIX_DAL_OS(ctx)->flags & OSF_OPEN)) {
+      LOG(LOG_ERR, "%s isn't open\n", POSIX_DAL_OS(ctx)->url);
+      errno = EINVAL;
+      return -1;
+   }
+   return posix_aio_start(ctx, 0, 1, NULL, 0, cb, arg);
+}
+
+
+
+DAL posix_dal = {
+   .name         = "POSIX",
+   .name_len     = 5,
+
+   .global_state = NULL,
+
+   .config       = &posix_dal_config,
+   .init         = &posix_dal_ctx_init,
+   .destroy      = &posix_dal_ctx_destroy,
+
+   .open         = &posix_dal_open,
+   .put          = &posix_dal_put,
+   .get          = &posix_dal_get,
+   .sync         = &posix_dal_sync,
+   .abort        = &posix_dal_abort,
+   .close        = &posix_dal_close,
+   .del          = &posix_dal_delete,
+
+   .update_object_location = &generate_path,
+
+   .put_async    = &posix_dal_put_async,
+   .get_async    = &posix_dal_get_async,
+   .sync_async   = &posix_dal_sync_async,
+   .del_many     = &posix_dal_del_many,
+};
+
+
+
+
+
+// ===========================================================================
+// POSIX_DIRECT
+// ===========================================================================
+//
+// An alternate engine for POSIX repos, for writing large objects to
+// parallel filesystems.  The namespace/path layout is the same as the POSIX
+// DAL, and reads are the same (apart from a sequential-access hint).
+// Writes differ:
+//
+//   -- the file may be opened with O_DIRECT, so data doesn't go through
+//      the page-cache.  (If the filesystem refuses, we fall back to
+//      buffered I/O.)
+//
+//   -- the file is fallocate()d to the chunk-size, at open, and truncated
+//      to the amount actually written, at sync.
+//
+//   -- put() copies into a set of aligned buffers, allocated once per
+//      stream.  Each full buffer is written with aio_write(), so up to
+//      <queue_depth> writes may be in flight, while the caller fills the
+//      next buffer.
+//
+// Options (all optional), in addition to the POSIX fan-out options:
+//
+//   <opt> <key_val> direct      : yes|no </key_val> </opt>  default: yes
+//   <opt> <key_val> prealloc    : yes|no </key_val> </opt>  default: yes
+//   <opt> <key_val> queue_depth : N      </key_val> </opt>  default: 4
+//   <opt> <key_val> buf_size    : bytes  </key_val> </opt>  default: 1MB
+//
+// ===========================================================================
+
+#define PD_ALIGN           4096
+#define PD_MAX_DEPTH       16
+
+typedef struct {
+   PosixConfig  posix;          // must be first.  (See PosixDal_Context.config)
+   int          direct;
+   int          prealloc;
+   int          depth;
+   size_t       buf_size;       // multiple of PD_ALIGN
+} PosixDirectConfig;
+
+typedef struct {
+   struct aiocb  cb;
+   char*         buf;
+   int           busy;          // aio_write() in flight
+} PDBuf;
+
+typedef struct posix_direct {
+   const PosixDirectConfig* cfg;
+   PDBuf                    bufs[PD_MAX_DEPTH];
+   int                      cur;     // buffer being filled
+   size_t                   fill;    // bytes in bufs[cur]
+   off_t                    offset;  // file-offset of bufs[cur]
+   int                      direct;  // fd really has O_DIRECT
+   int                      err;     // errno from a failed write
+} PosixDirect;
+
+#define POSIX_DIRECT(CTX)   POSIX_DAL_CONTEXT(CTX)->direct
+
+
+static
+int pd_yes(const char* str) {
+   return (! strcasecmp(str, "yes") || ! strcmp(str, "1"));
+}
+
+int posix_direct_config(struct DAL*     dal,
+                        xDALConfigOpt** opts,
+                        size_t          opt_count) {
+
+   PosixDirectConfig* cfg = (PosixDirectConfig*)calloc(1, sizeof(PosixDirectConfig));
+   if (! cfg) {
+      LOG(LOG_ERR, "couldn't allocate PosixDirectConfig\n");
+      return -1;
+   }
+   cfg->direct   = 1;
+   cfg->prealloc = 1;
+   cfg->depth    = 4;
+   cfg->buf_size = (1024 * 1024);
+
+   int i;
+   for (i=0; i<opt_count; ++i) {
+      const char* val = opts[i]->val.value.str;
+      if (! strcmp(opts[i]->key, "direct"))
+         cfg->direct = pd_yes(val);
+      else if (! strcmp(opts[i]->key, "prealloc"))
+         cfg->prealloc = pd_yes(val);
+      else if (! strcmp(opts[i]->key, "queue_depth"))
+         cfg->depth = strtol(val, NULL, 10);
+      else if (! strcmp(opts[i]->key, "buf_size"))
+         cfg->buf_size = strtoul(val, NULL, 10);
+      else if (posix_config_opt(&cfg->posix, opts[i]->key, val))
+         continue;
+      else {
+         LOG(LOG_ERR, "Unrecognized POSIX_DIRECT DAL config option: %s\n",
+             opts[i]->key);
+         free(cfg);
+         return -1;
+      }
+      LOG(LOG_INFO, "parsing posix_direct option \"%s\" = %s\n",
+          opts[i]->key, val);
+   }
+   free_xdal_config_options(opts);
+   posix_config_check(&cfg->posix);
+
+   if (cfg->depth < 1)
+      cfg->depth = 1;
+   if (cfg->depth > PD_MAX_DEPTH)
+      cfg->depth = PD_MAX_DEPTH;
+   if (cfg->buf_size < PD_ALIGN)
+      cfg->buf_size = PD_ALIGN;
+   cfg->buf_size = (cfg->buf_size + PD_ALIGN -1) & ~((size_t)PD_ALIGN -1);
+
+   dal->global_state = cfg;
+   return 0;
+}
+
+
+int posix_direct_ctx_init(DAL_Context* ctx, struct DAL* dal, void* fh) {
+   TRY_DECLS();
+
+   TRY0( posix_dal_ctx_init(ctx, dal, fh) );
+
+   PosixDirect* pd = (PosixDirect*)calloc(1, sizeof(PosixDirect));
+   if (! pd) {
+      LOG(LOG_ERR, "couldn't allocate PosixDirect\n");
+      errno = ENOMEM;
+      return -1;
+   }
+   pd->cfg = (const PosixDirectConfig*)dal->global_state;
+   POSIX_DIRECT(ctx) = pd;
+   return 0;
+}
+
+int posix_direct_ctx_destroy(DAL_Context* ctx, struct DAL* dal) {
+   PosixDirect* pd = POSIX_DIRECT(ctx);
+   if (pd) {
+      int i;
+      for (i=0; i<PD_MAX_DEPTH; ++i)
+         free(pd->bufs[i].buf);
+      free(pd);
+   }
+   return posix_dal_ctx_destroy(ctx, dal);
+}
+
+
+// wait for the write (if any) in bufs[i] to finish
+static
+void pd_wait(PosixDirect* pd, int i) {
+   PDBuf* b = &pd->bufs[i];
+   if (! b->busy)
+      return;
+
+   const struct aiocb* list[1] = { &b->cb };
+   while (aio_error(&b->cb) == EINPROGRESS)
+      aio_suspend(list, 1, NULL);
+
+   int     err = aio_error(&b->cb);
+   ssize_t rc  = aio_return(&b->cb);
+   if (err || (rc != b->cb.aio_nbytes)) {
+      LOG(LOG_ERR, "POSIX_DIRECT: write of %ld at %ld returned %ld (%s)\n",
+          b->cb.aio_nbytes, b->cb.aio_offset, rc, strerror(err ? err : EIO));
+      if (! pd->err)
+         pd->err = (err ? err : EIO);
+   }
+   b->busy = 0;
+}
+
+static
+void pd_wait_all(PosixDirect* pd) {
+   int i;
+   for (i=0; i<pd->cfg->depth; ++i)
+      pd_wait(pd, i);
+}
+
+// start writing <len> bytes from bufs[cur], and make the next buffer
+// ready to fill.
+static
+int pd_submit(DAL_Context* ctx, size_t len) {
+   PosixDirect* pd = POSIX_DIRECT(ctx);
+   PDBuf*       b  = &pd->bufs[pd->cur];
+
+   memset(&b->cb, 0, sizeof(b->cb));
+   b->cb.aio_fildes = POSIX_DAL_FD(ctx);
+   b->cb.aio_buf    = b->buf;
+   b->cb.aio_nbytes = len;
+   b->cb.aio_offset = pd->offset;
+   b->cb.aio_sigevent.sigev_notify = SIGEV_NONE;
+
+   if (aio_write(&b->cb)) {
+      LOG(LOG_ERR, "POSIX_DIRECT: aio_write failed: %s\n", strerror(errno));
+      pd->err = errno;
+      return -1;
+   }
+   b->busy     = 1;
+   pd->offset += len;
+   pd->fill    = 0;
+   pd->cur     = (pd->cur +1) % pd->cfg->depth;
+
+   pd_wait(pd, pd->cur);
+   return (pd->err ? -1 : 0);
+}
+
+
+int posix_direct_open(DAL_Context* ctx,
+                      int          is_put,
+                      size_t       chunk_offset,
+                      size_t       content_length,
+                      uint8_t      preserve_write_count,
+                      uint16_t     timeout) {
+   ENTRY();
+   PosixDirect*             pd  = POSIX_DIRECT(ctx);
+   const PosixDirectConfig* cfg = pd->cfg;
+
+   if (! is_put) {
+      TRY0( posix_dal_open(ctx, is_put, chunk_offset, content_length,
+                           preserve_write_count, timeout) );
+      posix_fadvise(POSIX_DAL_FD(ctx), chunk_offset, content_length,
+                    POSIX_FADV_SEQUENTIAL);
+      EXIT();
+      return 0;
+   }
+
+   if(! (ctx->flags & POSIX_DAL_PATH_GENERATED)) {
+      LOG(LOG_ERR, "POSIX_DIRECT: no previous call to "
+          "DAL->update_object_location");
+      return -1;
+   }
+   if (chunk_offset) {
+      LOG(LOG_ERR, "POSIX_DIRECT: can't write at offset %ld\n", chunk_offset);
+      errno = EINVAL;
+      return -1;
+   }
+
+   TRY0( stream_cleanup_for_reopen(POSIX_DAL_OS(ctx), preserve_write_count) );
+   TRY0( posix_object_dirs(ctx) );
+
+   // buffers are allocated once per stream
+   int i;
+   for (i=0; i<cfg->depth; ++i) {
+      if (! pd->bufs[i].buf
+          && posix_memalign((void**)&pd->bufs[i].buf, PD_ALIGN, cfg->buf_size)) {
+         LOG(LOG_ERR, "POSIX_DIRECT: couldn't allocate %ld-byte buffer\n",
+             cfg->buf_size);
+         errno = ENOMEM;
+         return -1;
+      }
+      pd->bufs[i].busy = 0;
+   }
+   pd->cur    = 0;
+   pd->fill   = 0;
+   pd->offset = 0;
+   pd->err    = 0;
+
+   char*        object_path = POSIX_DAL_PATH(ctx);
+   const mode_t mode        = S_IRUSR|S_IWUSR;
+   int          fd          = -1;
+
+   pd->direct = cfg->direct;
+   if (pd->direct) {
+      fd = open(object_path, O_WRONLY|O_CREAT|O_DIRECT, mode);
+      if ((fd < 0) && (errno == EINVAL)) {
+         LOG(LOG_INFO, "POSIX_DIRECT: no O_DIRECT for %s\n", object_path);
+         pd->direct = 0;
+      }
+   }
+   if (! pd->direct)
+      fd = open(object_path, O_WRONLY|O_CREAT, mode);
+   if (fd < 0) {
+      LOG(LOG_ERR, "Failed to open file with posix_direct: %s\n", object_path);
+      return -1;
+   }
+
+   // reserve space for the whole chunk, if we know how big it could be
+   size_t prealloc = (content_length
+                      ? content_length
+                      : POSIX_DAL_FH(ctx)->info.pre.repo->chunk_size);
+   if (cfg->prealloc && prealloc
+       && fallocate(fd, 0, 0, prealloc)) {
+      LOG(LOG_INFO, "POSIX_DIRECT: fallocate(%ld) failed for %s: %s\n",
+          prealloc, object_path, strerror(errno));
+   }
+
+   POSIX_DAL_FD(ctx) = fd;
+   POSIX_DAL_OS(ctx)->flags |= (OSF_WRITING | OSF_OPEN);
+
+   EXIT();
+   return 0;
+}
+
+int posix_direct_put(DAL_Context* ctx, const char* buf, size_t size) {
+   PosixDirect* pd   = POSIX_DIRECT(ctx);
+   size_t       left = size;
+
+   if (pd->err) {
+      errno = pd->err;
+      return -1;
+   }
+   while (left) {
+      size_t room = pd->cfg->buf_size - pd->fill;
+      size_t move = ((left < room) ? left : room);
+      memcpy(pd->bufs[pd->cur].buf + pd->fill, buf, move);
+      pd->fill += move;
+      buf      += move;
+      left     -= move;
+
+      if ((pd->fill == pd->cfg->buf_size)
+          && pd_submit(ctx, pd->fill)) {
+         errno = pd->err;
+         return -1;
+      }
+   }
+
+   POSIX_DAL_OS(ctx)->written += size;
+   return size;
+}
+
+// Write any partial buffer, wait for everything, and trim the file back
+// to what was actually written.  With O_DIRECT, the last write is padded
+// out to PD_ALIGN.
+int posix_direct_sync(DAL_Context* ctx) {
+   TRY_DECLS();
+   PosixDirect* pd = POSIX_DIRECT(ctx);
+
+   if (! (POSIX_DAL_OS(ctx)->flags & OSF_WRITING))
+      return posix_dal_sync(ctx);
+
+   if(! (POSIX_DAL_OS(ctx)->flags & OSF_OPEN)) {
+      LOG(LOG_ERR, "%s isn't open\n", POSIX_DAL_OS(ctx)->url);
+      errno = EINVAL;
+      return -1;
+   }
+
+   off_t total = pd->offset + pd->fill;
+   if (pd->fill && ! pd->err) {
+      size_t len = pd->fill;
+      if (pd->direct) {
+         len = (len + PD_ALIGN -1) & ~((size_t)PD_ALIGN -1);
+         memset(pd->bufs[pd->cur].buf + pd->fill, 0, len - pd->fill);
+      }
+      pd_submit(ctx, len);
+   }
+   pd_wait_all(pd);
+   if (pd->err) {
+      close_posix_object(ctx);
+      errno = pd->err;
+      return -1;
+   }
+
+   TRY0( ftruncate(POSIX_DAL_FD(ctx), total) );
+   TRY0( fdatasync(POSIX_DAL_FD(ctx)) );
+   TRY0( close_posix_object(ctx) );
+
+   return 0;
+}
+
+int posix_direct_abort(DAL_Context* ctx) {
+   PosixDirect* pd = POSIX_DIRECT(ctx);
+
+   if (POSIX_DAL_FD(ctx) >= 0) {
+      aio_cancel(POSIX_DAL_FD(ctx), NULL);
+      pd_wait_all(pd);
+   }
+   return posix_dal_abort(ctx);
+}
+
+int posix_direct_close(DAL_Context* ctx) {
+   PosixDirect* pd = POSIX_DIRECT(ctx);
+
+   if (POSIX_DAL_OS(ctx)->flags & OSF_OPEN)
+      pd_wait_all(pd);
+   return posix_dal_close(ctx);
+}
+
+
+
+DAL posix_direct_dal = {
+   .name         = "POSIX_DIRECT",
+   .name_len     = 12,
+
+   .global_state = NULL,
+
+   .config       = &posix_direct_config,
+   .init         = &posix_direct_ctx_init,
+   .destroy      = &posix_direct_ctx_destroy,
+
+   .open         = &posix_direct_open,
+   .put          = &posix_direct_put,
+   .get          = &posix_dal_get,
+   .sync         = &posix_direct_sync,
+   .abort        = &posix_direct_abort,
+   .close        = &posix_direct_close,
+   .del          = &posix_dal_delete,
+
+   .update_object_location = &generate_path,
+
+   .del_many     = &posix_dal_del_many,
+};
+
+
+
+
+
+// ===========================================================================
+// MEM
+// ===========================================================================
+//
+// Objects live in process memory, in a hash-map sharded by key, with one
+// lock per shard.  Writes and reads round-trip, so this is useful for
+// measuring the overhead of MarFS itself (FUSE, MDAL, xattrs), without
+// storage latency.  Nothing survives the process.
+//
+// An object being written is private to its stream, until sync() installs
+// it in the map (replacing any older version).  Readers hold a reference,
+// so a concurrent replace or delete doesn't pull the data out from under
+// them.
+//
+// Options (all optional):
+//
+//   <opt> <key_val> max_bytes  : N </key_val> </opt>  total data. 0 = no limit
+//   <opt> <key_val> max_object : N </key_val> </opt>  per object. 0 = no limit
+//
+// Writes that would exceed a limit fail with ENOSPC.
+// ===========================================================================
+
+#define MEM_SHARDS         64
+#define MEM_BUCKETS        1024     /* per shard */
+#define MEM_MAX_KEY        (MARFS_MAX_REPO_NAME + MARFS_MAX_OBJID_SIZE + 2)
+
+typedef struct {
+   size_t   max_bytes;
+   size_t   max_object;
+} MemConfig;
+
+typedef struct MemObj {
+   char             key[MEM_MAX_KEY];
+   uint64_t         hash;
+   char*            data;
+   size_t           size;
+   size_t           alloc;
+   int              refs;          // map + readers.  (under shard lock)
+   struct MemObj*   next;          // in bucket
+} MemObj;
+
+typedef struct {
+   pthread_mutex_t  lock;
+   MemObj*          bucket[MEM_BUCKETS];
+} MemShard;
+
+static MemShard         mem_shard[MEM_SHARDS];
+static pthread_once_t   mem_once = PTHREAD_ONCE_INIT;
+static volatile size_t  mem_bytes = 0;     // allocated, in all objects
+
+typedef struct {
+   MarFS_FileHandle*  fh;
+   const MemConfig*   config;
+   char               key[MEM_MAX_KEY];
+   uint64_t           hash;
+   MemObj*            obj;          // being written, or read
+   size_t             pos;          // read position
+   size_t             end;          // end of requested read range
+} MemDal_Context;
+
+#define MEM_CONTEXT(CTX)  ((MemDal_Context*)((CTX)->data.ptr))
+#define MEM_OS(CTX)       (&MEM_CONTEXT(CTX)->fh->os)
+
+
+static
+void mem_init_shards(void) {
+   int i;
+   for (i=0; i<MEM_SHARDS; ++i)
+      pthread_mutex_init(&mem_shard[i].lock, NULL);
+}
+
+static
+MemShard* mem_shard_for(uint64_t hash) {
+   return &mem_shard[hash % MEM_SHARDS];
+}
+
+static
+void mem_free_obj(MemObj* obj) {
+   __sync_fetch_and_sub(&mem_bytes, obj->alloc);
+   free(obj->data);
+   free(obj);
+}
+
+// drop a reference.  Caller must not hold the shard lock.
+static
+void mem_unref(MemObj* obj) {
+   MemShard* shard = mem_shard_for(obj->hash);
+   pthread_mutex_lock(&shard->lock);
+   int last = (--obj->refs == 0);
+   pthread_mutex_unlock(&shard->lock);
+   if (last)
+      mem_free_obj(obj);
+}
+
+// remove <key> from the map.  Returns the object, which still holds the
+// map's reference, or NULL.  Caller holds the shard lock.
+static
+MemObj* mem_unlink(MemShard* shard, const char* key, uint64_t hash) {
+   MemObj** prev = &shard->bucket[(hash / MEM_SHARDS) % MEM_BUCKETS];
+   for ( ; *prev; prev = &(*prev)->next) {
+      MemObj* obj = *prev;
+      if ((obj->hash == hash) && ! strcmp(obj->key, key)) {
+         *prev = obj->next;
+         obj->next = NULL;
+         return obj;
+      }
+   }
+   return NULL;
+}
+
+
+int mem_dal_config(struct DAL*     dal,
+                   xDALConfigOpt** opts,
+                   size_t          opt_count) {
+
+   MemConfig* cfg = (MemConfig*)calloc(1, sizeof(MemConfig));
+   if (! cfg) {
+      LOG(LOG_ERR, "couldn't allocate MemConfig\n");
+      return -1;
+   }
+
+   int i;
+   for (i=0; i<opt_count; ++i) {
+      const char* val = opts[i]->val.value.str;
+      if (! strcmp(opts[i]->key, "max_bytes"))
+         cfg->max_bytes = strtoull(val, NULL, 10);
+      else if (! strcmp(opts[i]->key, "max_object"))
+         cfg->max_object = strtoull(val, NULL, 10);
+      else {
+         LOG(LOG_ERR, "Unrecognized MEM DAL config option: %s\n",
+             opts[i]->key);
+         free(cfg);
+         return -1;
+      }
+      LOG(LOG_INFO, "parsing mem option \"%s\" = %s\n", opts[i]->key, val);
+   }
+   free_xdal_config_options(opts);
+
+   pthread_once(&mem_once, &mem_init_shards);
+   dal->global_state = cfg;
+   return 0;
+}
+
+int mem_dal_ctx_init(DAL_Context* ctx, struct DAL* dal, void* fh) {
+   ctx->flags    = 0;
+   ctx->data.ptr = calloc(1, sizeof(MemDal_Context));
+   if (! ctx->data.ptr) {
+      LOG(LOG_ERR, "couldn't allocate MemDal_Context\n");
+      errno = ENOMEM;
+      return -1;
+   }
+   MEM_CONTEXT(ctx)->fh     = (MarFS_FileHandle*)fh;
+   MEM_CONTEXT(ctx)->config = (const MemConfig*)dal->global_state;
+   return 0;
+}
+
+// drop whatever object the stream is holding.  An uncommitted write just
+// goes away.
+static
+void mem_release(DAL_Context* ctx) {
+   MemDal_Context* mc = MEM_CONTEXT(ctx);
+   if (! mc->obj)
+      return;
+
+   if (MEM_OS(ctx)->flags & OSF_WRITING)
+      mem_free_obj(mc->obj);
+   else
+      mem_unref(mc->obj);
+   mc->obj = NULL;
+}
+
+int mem_dal_ctx_destroy(DAL_Context* ctx, struct DAL* dal) {
+   if (MEM_CONTEXT(ctx)) {
+      mem_release(ctx);
+      free(MEM_CONTEXT(ctx));
+      ctx->data.ptr = NULL;
+   }
+   return 0;
+}
+
+int mem_dal_update_object_location(DAL_Context* ctx) {
+   MemDal_Context* mc   = MEM_CONTEXT(ctx);
+   PathInfo*       info = &mc->fh->info;
+
+   snprintf(mc->key, MEM_MAX_KEY, "%s/%s", info->pre.repo->name, info->pre.objid);
+   mc->hash = polyhash(mc->key);
+   return 0;
+}
+
+int mem_dal_open(DAL_Context* ctx,
+                 int          is_put,
+                 size_t       chunk_offset,
+                 size_t       content_length,
+                 uint8_t      preserve_write_count,
+                 uint16_t     timeout) {
+   TRY_DECLS();
+   MemDal_Context* mc = MEM_CONTEXT(ctx);
+   ObjectStream*   os = MEM_OS(ctx);
+
+   if (! mc->key[0]) {
+      LOG(LOG_ERR, "MEM_DAL: no previous call to "
+          "DAL->update_object_location\n");
+      errno = EINVAL;
+      return -1;
+   }
+
+   mem_release(ctx);            // (checks OSF_WRITING)
+   TRY0( stream_cleanup_for_reopen(os, preserve_write_count) );
+
+   if (is_put) {
+      if (chunk_offset) {
+         LOG(LOG_ERR, "MEM_DAL: can't write at offset %ld\n", chunk_offset);
+         errno = EINVAL;
+         return -1;
+      }
+      MemObj* obj = (MemObj*)calloc(1, sizeof(MemObj));
+      if (! obj) {
+         errno = ENOMEM;
+         return -1;
+      }
+      strncpy(obj->key, mc->key, MEM_MAX_KEY);
+      obj->hash = mc->hash;
+      obj->refs = 1;            // the map's, once installed
+      mc->obj   = obj;
+      os->flags |= OSF_WRITING;
+   }
+   else {
+      MemShard* shard = mem_shard_for(mc->hash);
+      pthread_mutex_lock(&shard->lock);
+      MemObj* obj = shard->bucket[(mc->hash / MEM_SHARDS) % MEM_BUCKETS];
+      for ( ; obj; obj = obj->next) {
+         if ((obj->hash == mc->hash) && ! strcmp(obj->key, mc->key))
+            break;
+      }
+      if (obj)
+         obj->refs += 1;
+      pthread_mutex_unlock(&shard->lock);
+
+      if (! obj) {
+         LOG(LOG_ERR, "MEM_DAL: no object %s\n", mc->key);
+         errno = ENOENT;
+         return -1;
+      }
+      mc->obj = obj;
+      mc->pos = chunk_offset;
+      mc->end = (content_length ? chunk_offset + content_length : obj->size);
+      if (mc->end > obj->size)
+         mc->end = obj->size;
+      os->flags |= OSF_READING;
+   }
+
+   os->flags |= OSF_OPEN;
+   return 0;
+}
+
+int mem_dal_put(DAL_Context* ctx, const char* buf, size_t size) {
+   MemDal_Context*  mc  = MEM_CONTEXT(ctx);
+   const MemConfig* cfg = mc->config;
+   MemObj*          obj = mc->obj;
+
+   if (! obj || ! (MEM_OS(ctx)->flags & OSF_WRITING)) {
+      errno = EBADF;
+      return -1;
+   }
+   if (cfg->max_object && (obj->size + size > cfg->max_object)) {
+      LOG(LOG_ERR, "MEM_DAL: %s would exceed max_object\n", obj->key);
+      errno = ENOSPC;
+      return -1;
+   }
+
+   if (obj->size + size > obj->alloc) {
+      size_t new_alloc = (obj->alloc ? obj->alloc : 64 * 1024);
+      while (new_alloc < obj->size + size)
+         new_alloc *= 2;
+      if (cfg->max_object && (new_alloc > cfg->max_object))
+         new_alloc = cfg->max_object;
+
+      size_t grow  = new_alloc - obj->alloc;
+      size_t total = __sync_add_and_fetch(&mem_bytes, grow);
+      if (cfg->max_bytes && (total > cfg->max_bytes)) {
+         __sync_fetch_and_sub(&mem_bytes, grow);
+         LOG(LOG_ERR, "MEM_DAL: max_bytes exceeded, writing %s\n", obj->key);
+         errno = ENOSPC;
+         return -1;
+      }
+      char* new_data = (char*)realloc(obj->data, new_alloc);
+      if (! new_data) {
+         __sync_fetch_and_sub(&mem_bytes, grow);
+         errno = ENOMEM;
+         return -1;
+      }
+      obj->data  = new_data;
+      obj->alloc = new_alloc;
+   }
+
+   memcpy(obj->data + obj->size, buf, size);
+   obj->size              += size;
+   MEM_OS(ctx)->written   += size;
+   return size;
+}
+
+ssize_t mem_dal_get(DAL_Context* ctx, char* buf, size_t size) {
+   MemDal_Context* mc = MEM_CONTEXT(ctx);
+
+   if (! mc->obj || ! (MEM_OS(ctx)->flags & OSF_READING)) {
+      errno = EBADF;
+      return -1;
+   }
+
+   size_t avail = ((mc->pos < mc->end) ? mc->end - mc->pos : 0);
+   if (size > avail)
+      size = avail;
+   if (! size) {
+      MEM_OS(ctx)->flags |= OSF_EOF;
+      return 0;
+   }
+
+   memcpy(buf, mc->obj->data + mc->pos, size);
+   mc->pos              += size;
+   MEM_OS(ctx)->written += size;
+   return size;
+}
+
+static
+void mem_close_stream(DAL_Context* ctx) {
+   mem_release(ctx);
+   MEM_OS(ctx)->flags &= ~OSF_OPEN;
+   MEM_OS(ctx)->flags |= OSF_CLOSED;
+}
+
+// For a write, install the new object in the map, replacing (and
+// dropping the map's reference to) any older version.
+int mem_dal_sync(DAL_Context* ctx) {
+   MemDal_Context* mc = MEM_CONTEXT(ctx);
+   ObjectStream*   os = MEM_OS(ctx);
+
+   if (! (os->flags & OSF_OPEN)) {
+      LOG(LOG_ERR, "%s isn't open\n", os->url);
+      errno = EINVAL;
+      return -1;
+   }
+
+   if ((os->flags & OSF_WRITING) && mc->obj) {
+      MemObj*   obj   = mc->obj;
+      MemShard* shard = mem_shard_for(obj->hash);
+
+      pthread_mutex_lock(&shard->lock);
+      MemObj* old = mem_unlink(shard, obj->key, obj->hash);
+      MemObj** bucket = &shard->bucket[(obj->hash / MEM_SHARDS) % MEM_BUCKETS];
+      obj->next = *bucket;
+      *bucket   = obj;
+      pthread_mutex_unlock(&shard->lock);
+
+      mc->obj = NULL;
+      if (old)
+         mem_unref(old);
+   }
+
+   mem_close_stream(ctx);
+   return 0;
+}
+
+int mem_dal_abort(DAL_Context* ctx) {
+   if (! (MEM_OS(ctx)->flags & OSF_OPEN)) {
+      LOG(LOG_ERR, "MEM_DAL: abort: %s isn't open\n", MEM_OS(ctx)->url);
+      errno = EINVAL;
+      return -1;
+   }
+   MEM_OS(ctx)->flags |= OSF_ABORT;
+   mem_release(ctx);
+   return 0;
+}
+
+int mem_dal_close(DAL_Context* ctx) {
+   if (MEM_OS(ctx)->flags & OSF_OPEN)
+      mem_close_stream(ctx);
+   return 0;
+}
+
+int mem_dal_delete(DAL_Context* ctx) {
+   MemDal_Context* mc    = MEM_CONTEXT(ctx);
+   MemShard*       shard = mem_shard_for(mc->hash);
+
+   pthread_mutex_lock(&shard->lock);
+   MemObj* obj = mem_unlink(shard, mc->key, mc->hash);
+   pthread_mutex_unlock(&shard->lock);
+
+   if (! obj) {
+      errno = ENOENT;
+      return -1;
+   }
+   mem_unref(obj);
+   return 0;
+}
+
+
+
+DAL mem_dal = {
+   .name         = "MEM",
+   .name_len     = 3,
+
+   .global_state = NULL,
+
+   .config       = &mem_dal_config,
+   .init         = &mem_dal_ctx_init,
+   .destroy      = &mem_dal_ctx_destroy,
+
+   .open         = &mem_dal_open,
+   .put          = &mem_dal_put,
+   .get          = &mem_dal_get,
+   .sync         = &mem_dal_sync,
+   .abort        = &mem_dal_abort,
+   .close        = &mem_dal_close,
+   .del          = &mem_dal_delete,
+
+   .update_object_location = &mem_dal_update_object_location
+};
+
+
+
+
+
+// ===========================================================================
+// CACHE
+// ===========================================================================
+//
+// A read-cache that wraps some other DAL (the "backend").  Reads are
+// served from fixed-size blocks of the object, kept as files in a local
+// scratch directory.  A missing block is fetched from the backend (as a
+// block-sized range), written to the cache, then served from there.
+// Writes, deletes, etc, pass straight through.
+//
+// Objids are never re-used for different data (see update_pre()), so a
+// cached block never goes stale.  Blocks are found by name, so they are
+// shared by all processes using the same directory, e.g. successive steps
+// of a job on the same node.  The name of a block only makes sense for one
+// block_size, so blocks live under "<dir>/bs-<block_size>/".  Each hit
+// touches the block file, and when our accounting says that directory
+// exceeds its budget, we scan it and remove the least-recently-used
+// blocks, down to 90% of the budget.  (Blocks left under some other
+// block_size are not counted, and must be cleaned up by hand.)
+//
+//   <dal>
+//     <type>CACHE</type>
+//     <opt> <key_val> backend     : OBJECT          </key_val> </opt>
+//     <opt> <key_val> dir         : /scratch/mcache </key_val> </opt>
+//     <opt> <key_val> budget      : bytes           </key_val> </opt>
+//     <opt> <key_val> block_size  : bytes           </key_val> </opt>  default 4MB
+//     <opt> <key_val> backend.xxx : value           </key_val> </opt>
+//   </dal>
+//
+// Options named "backend.xxx" are given to the backend's config(), as
+// "xxx".
+// ===========================================================================
+
+#define CACHE_DEFAULT_BLOCK  (4 * 1024 * 1024)
+#define CACHE_SUBDIRS        256
+
+typedef struct {
+   DAL*              backend;       // private copy, configured
+   char*             dir;           // "<dir>/bs-<block_size>"
+   size_t            budget;
+   size_t            block_size;
+   volatile size_t   bytes;         // bytes we believe are in <dir>
+   pthread_mutex_t   evict_lock;
+} CacheConfig;
+
+typedef struct {
+   DAL_Context       inner;         // backend's context
+   CacheConfig*      config;
+   MarFS_FileHandle* fh;
+   int               bypass;        // this stream doesn't use the cache
+   char              path[PATH_MAX]; // "<dir>/<xx>/<objid>." (+ block number)
+   size_t            path_len;
+   size_t            pos;           // read position
+   size_t            end;           // end of requested range (0 = none)
+   uint16_t          timeout;
+   char*             block_buf;
+} CacheDal_Context;
+
+// DAL_Context.flags
+enum cache_dal_flags {
+   CACHE_DAL_READING = (1 << 0)  // cache (not backend) owns the open read
+};
+
+#define CACHE_CONTEXT(CTX)  ((CacheDal_Context*)((CTX)->data.ptr))
+#define CACHE_INNER(CTX)    (&CACHE_CONTEXT(CTX)->inner)
+#define CACHE_DAL(CTX)      (CACHE_CONTEXT(CTX)->config->backend)
+#define CACHE_OS(CTX)       (&CACHE_CONTEXT(CTX)->fh->os)
+
+#define BACKEND_OP(OP, CTX, ...)                                        \
+   (*CACHE_DAL(CTX)->OP)(CACHE_INNER(CTX), ##__VA_ARGS__)
+
+
+typedef struct {
+   time_t   atime;
+   size_t   size;
+   char     name[NAME_MAX +1];
+   uint16_t subdir;
+} CacheEntry;
+
+static
+int cache_entry_cmp(const void* a, const void* b) {
+   time_t x = ((const CacheEntry*)a)->atime;
+   time_t y = ((const CacheEntry*)b)->atime;
+   return ((x > y) - (x < y));
+}
+
+// Scan the cache directory.  If <evict>, remove the oldest blocks until
+// the total is within 90% of the budget.  Updates cfg->bytes.
+static
+void cache_scan(CacheConfig* cfg, int evict) {
+   pthread_mutex_lock(&cfg->evict_lock);
+
+   size_t      count = 0;
+   size_t      alloc = 0;
+   size_t      total = 0;
+   CacheEntry* list  = NULL;
+   char        path[PATH_MAX];
+   int         i;
+
+   for (i=0; i<CACHE_SUBDIRS; ++i) {
+      snprintf(path, PATH_MAX, "%s/%02x", cfg->dir, i);
+      DIR* dirp = opendir(path);
+      if (! dirp)
+         continue;
+
+      struct dirent* d;
+      while ((d = readdir(dirp))) {
+         struct stat st;
+         if (d->d_name[0] == '.')
+            continue;
+         if (fstatat(dirfd(dirp), d->d_name, &st, 0) || ! S_ISREG(st.st_mode))
+            continue;
+         total += st.st_size;
+         if (! evict)
+            continue;
+
+         if (count == alloc) {
+            alloc = (alloc ? alloc * 2 : 1024);
+            CacheEntry* new_list = (CacheEntry*)realloc(list, alloc * sizeof(CacheEntry));
+            if (! new_list)
+               break;
+            list = new_list;
+         }
+         list[count].atime  = st.st_mtime;
+         list[count].size   = st.st_size;
+         list[count].subdir = i;
+         strncpy(list[count].name, d->d_name, NAME_MAX +1);
+         ++count;
+      }
+      closedir(dirp);
+   }
+
+   if (evict && (total > cfg->budget)) {
+      size_t goal = (cfg->budget / 10) * 9;
+      qsort(list, count, sizeof(CacheEntry), cache_entry_cmp);
+
+      size_t n;
+      for (n=0; (n<count) && (total > goal); ++n) {
+         snprintf(path, PATH_MAX, "%s/%02x/%s", cfg->dir, list[n].subdir, list[n].name);
+         if (! unlink(path))
+            total -= list[n].size;
+      }
+      LOG(LOG_INFO, "CACHE: evicted %ld blocks from %s, %ld bytes remain\n",
+          n, cfg->dir, total);
+   }
+   free(list);
+
+   cfg->bytes = total;
+   pthread_mutex_unlock(&cfg->evict_lock);
+}
+
+
+int cache_dal_config(struct DAL*     dal,
+                     xDALConfigOpt** opts,
+                     size_t          opt_count) {
+
+   CacheConfig* cfg = (CacheConfig*)calloc(1, sizeof(CacheConfig));
+   size_t       my_count;
+   if (! cfg) {
+      LOG(LOG_ERR, "couldn't allocate CacheConfig\n");
+      return -1;
+   }
+   cfg->block_size = CACHE_DEFAULT_BLOCK;
+   pthread_mutex_init(&cfg->evict_lock, NULL);
+
+   if (wrapper_dal_config(dal, opts, opt_count, &cfg->backend, &my_count))
+      return -1;
+
+   int i;
+   for (i=0; i<my_count; ++i) {
+      const char* key = opts[i]->key;
+      const char* val = opts[i]->val.value.str;
+
+      if (! strcmp(key, "dir"))
+         cfg->dir = strdup(val);
+      else if (! strcmp(key, "budget"))
+         cfg->budget = strtoull(val, NULL, 10);
+      else if (! strcmp(key, "block_size"))
+         cfg->block_size = strtoull(val, NULL, 10);
+      else {
+         LOG(LOG_ERR, "Unrecognized CACHE DAL config option: %s\n", key);
+         return -1;
+      }
+      LOG(LOG_INFO, "parsing cache option \"%s\" = %s\n", key, val);
+   }
+   for (i=0; i<my_count; ++i)
+      free(opts[i]);
+   free(opts);
+
+   if (! cfg->dir || ! cfg->budget || ! cfg->block_size) {
+      LOG(LOG_ERR, "CACHE DAL needs 'backend', 'dir', and 'budget' options\n");
+      return -1;
+   }
+
+   // create the subdirs, and see how much is already there
+   char path[PATH_MAX];
+   mkdir(cfg->dir, 0700);
+   snprintf(path, PATH_MAX, "%s/bs-%ld", cfg->dir, cfg->block_size);
+   free(cfg->dir);
+   cfg->dir = strdup(path);
+   if (! cfg->dir)
+      return -1;
+   mkdir(cfg->dir, 0700);
+   for (i=0; i<CACHE_SUBDIRS; ++i) {
+      snprintf(path, PATH_MAX, "%s/%02x", cfg->dir, i);
+      if (mkdir(path, 0700) && (errno != EEXIST)) {
+         LOG(LOG_ERR, "CACHE: couldn't create %s: %s\n", path, strerror(errno));
+         return -1;
+      }
+   }
+   cache_scan(cfg, 1);
+
+   dal->global_state = cfg;
+   return 0;
+}
+
+
+int cache_dal_ctx_init(DAL_Context* ctx, struct DAL* dal, void* fh) {
+   TRY_DECLS();
+
+   ctx->flags    = 0;
+   ctx->data.ptr = calloc(1, sizeof(CacheDal_Context));
+   if (! ctx->data.ptr) {
+      LOG(LOG_ERR, "couldn't allocate CacheDal_Context\n");
+      errno = ENOMEM;
+      return -1;
+   }
+   CACHE_CONTEXT(ctx)->config = (CacheConfig*)dal->global_state;
+   CACHE_CONTEXT(ctx)->fh     = (MarFS_FileHandle*)fh;
+
+   TRY0( (*CACHE_DAL(ctx)->init)(CACHE_INNER(ctx), CACHE_DAL(ctx), fh) );
+   return 0;
+}
+
+int cache_dal_ctx_destroy(DAL_Context* ctx, struct DAL* dal) {
+   int rc = 0;
+   if (CACHE_CONTEXT(ctx)) {
+      dal_async_free(CACHE_INNER(ctx));
+      rc = (*CACHE_DAL(ctx)->destroy)(CACHE_INNER(ctx), CACHE_DAL(ctx));
+      free(CACHE_CONTEXT(ctx)->block_buf);
+      free(CACHE_CONTEXT(ctx));
+      ctx->data.ptr = NULL;
+   }
+   return rc;
+}
+
+int cache_dal_update_object_location(DAL_Context* ctx) {
+   CacheDal_Context* cc    = CACHE_CONTEXT(ctx);
+   const char*       objid = cc->fh->info.pre.objid;
+
+   char flat[MARFS_MAX_OBJID_SIZE];
+   strncpy(flat, objid, MARFS_MAX_OBJID_SIZE);
+   flat[MARFS_MAX_OBJID_SIZE -1] = 0;
+   flatten_objid(flat);
+
+   // leave room for ".<block>" in a file-name
+   cc->bypass = (strlen(flat) + 18 > NAME_MAX);
+   if (! cc->bypass) {
+      int len = snprintf(cc->path, PATH_MAX, "%s/%02x/%s.",
+                         cc->config->dir,
+                         (unsigned)(polyhash(objid) % CACHE_SUBDIRS), flat);
+      cc->bypass   = (len + 18 >= PATH_MAX);
+      cc->path_len = len;
+   }
+
+   return BACKEND_OP(update_object_location, ctx);
+}
+
+
+int cache_dal_open(DAL_Context* ctx,
+                   int          is_put,
+                   size_t       chunk_offset,
+                   size_t       content_length,
+                   uint8_t      preserve_write_count,
+                   uint16_t     timeout) {
+   TRY_DECLS();
+   CacheDal_Context* cc = CACHE_CONTEXT(ctx);
+
+   if (is_put || cc->bypass)
+      return BACKEND_OP(open, ctx, is_put, chunk_offset, content_length,
+                        preserve_write_count, timeout);
+
+   // reading through the cache.  The backend isn't opened until we need
+   // to fill a block.
+   TRY0( stream_cleanup_for_reopen(CACHE_OS(ctx), preserve_write_count) );
+   cc->pos     = chunk_offset;
+   cc->end     = (content_length ? chunk_offset + content_length : 0);
+   cc->timeout = timeout;
+   CACHE_OS(ctx)->flags |= (OSF_READING | OSF_OPEN);
+   ctx->flags  |= CACHE_DAL_READING;
+   return 0;
+}
+
+
+// fetch block <block> from the backend, and install it in the cache, at
+// <path>.  The backend's stream ops have side-effects on the ObjectStream
+// that we don't want our caller to see, so we save and restore it.
+static
+int cache_fill(DAL_Context* ctx, size_t block, const char* path) {
+   CacheDal_Context* cc   = CACHE_CONTEXT(ctx);
+   ObjectStream*     os   = CACHE_OS(ctx);
+   size_t            bs   = cc->config->block_size;
+   OSFlags_t         save_flags   = os->flags;
+   size_t            save_written = os->written;
+   size_t            got  = 0;
+   int               err  = 0;
+
+   if (! cc->block_buf) {
+      cc->block_buf = (char*)malloc(bs);
+      if (! cc->block_buf) {
+         errno = ENOMEM;
+         return -1;
+      }
+   }
+
+   os->flags = OSF_CLOSED;
+   if (BACKEND_OP(open, ctx, 0, block * bs, bs, 0, cc->timeout))
+      err = errno;
+   else {
+      while (got < bs) {
+         ssize_t rc = BACKEND_OP(get, ctx, cc->block_buf + got, bs - got);
+         if (rc < 0) {
+            err = (errno ? errno : EIO);
+            break;
+         }
+         if (rc == 0)
+            break;
+         got += rc;
+      }
+      if (err)
+         BACKEND_OP(abort, ctx);
+      else if (BACKEND_OP(sync, ctx))
+         err = errno;
+      BACKEND_OP(close, ctx);
+   }
+   os->flags   = save_flags;
+   os->written = save_written;
+   if (err) {
+      LOG(LOG_ERR, "CACHE: couldn't fetch block %ld of %s: %s\n",
+          block, os->url, strerror(err));
+      errno = err;
+      return -1;
+   }
+
+   // write it under a temporary name, so other readers never see part
+   char tmp[PATH_MAX];
+   snprintf(tmp, PATH_MAX, "%s.%d.%lx", path, getpid(), (unsigned long)pthread_self());
+   int fd = open(tmp, O_WRONLY|O_CREAT|O_EXCL, S_IRUSR|S_IWUSR);
+   if (fd < 0) {
+      LOG(LOG_ERR, "CACHE: couldn't create %s: %s\n", tmp, strerror(errno));
+      return -1;
+   }
+   if ((write(fd, cc->block_buf, got) != got)
+       || close(fd)
+       || rename(tmp, path)) {
+      LOG(LOG_ERR, "CACHE: couldn't install %s: %s\n", path, strerror(errno));
+      unlink(tmp);
+      return -1;
+   }
+
+   size_t total = __sync_add_and_fetch(&cc->config->bytes, got);
+   if (total > cc->config->budget)
+      cache_scan(cc->config, 1);
+   return 0;
+}
+
+ssize_t cache_dal_get(DAL_Context* ctx, char* buf, size_t size) {
+   CacheDal_Context* cc = CACHE_CONTEXT(ctx);
+
+   if (! (ctx->flags & CACHE_DAL_READING))
+      return BACKEND_OP(get, ctx, buf, size);
+
+   if (cc->end && (cc->pos + size > cc->end))
+      size = ((cc->pos < cc->end) ? cc->end - cc->pos : 0);
+   if (! size) {
+      CACHE_OS(ctx)->flags |= OSF_EOF;
+      return 0;
+   }
+
+   size_t bs     = cc->config->block_size;
+   size_t block  = cc->pos / bs;
+   size_t offset = cc->pos % bs;
+   if (size > bs - offset)
+      size = bs - offset;       // caller will come back for the rest
+
+   sprintf(cc->path + cc->path_len, "%lx", block);
+   int fd = open(cc->path, O_RDONLY);
+   if (fd < 0) {
+      if (cache_fill(ctx, block, cc->path))
+         return -1;
+      fd = open(cc->path, O_RDONLY);
+      if (fd < 0) {
+         LOG(LOG_ERR, "CACHE: %s vanished after fill\n", cc->path);
+         return -1;
+      }
+   }
+   else
+      futimens(fd, NULL);       // LRU
+
+   ssize_t rc = pread(fd, buf, size, offset);
+   close(fd);
+   cc->path[cc->path_len] = 0;
+   if (rc < 0)
+      return -1;
+
+   // a short block is the end of the object
+   if (rc == 0)
+      CACHE_OS(ctx)->flags |= OSF_EOF;
+   cc->pos                += rc;
+   CACHE_OS(ctx)->written += rc;
+   return rc;
+}
+
+int cache_dal_put(DAL_Context* ctx, const char* buf, size_t size) {
+   return BACKEND_OP(put, ctx, buf, size);
+}
+
+static
+void cache_close_read(DAL_Context* ctx) {
+   ctx->flags &= ~CACHE_DAL_READING;
+   CACHE_OS(ctx)->flags &= ~OSF_OPEN;
+   CACHE_OS(ctx)->flags |= OSF_CLOSED;
+}
+
+int cache_dal_sync(DAL_Context* ctx) {
+   if (! (ctx->flags & CACHE_DAL_READING))
+      return BACKEND_OP(sync, ctx);
+
+   cache_close_read(ctx);
+   return 0;
+}
+
+int cache_dal_abort(DAL_Context* ctx) {
+   if (! (ctx->flags & CACHE_DAL_READING))
+      return BACKEND_OP(abort, ctx);
+
+   CACHE_OS(ctx)->flags |= OSF_ABORT;
+   return 0;
+}
+
+int cache_dal_close(DAL_Context* ctx) {
+   if (! (ctx->flags & CACHE_DAL_READING))
+      return BACKEND_OP(close, ctx);
+
+   if (CACHE_OS(ctx)->flags & OSF_OPEN)
+      cache_close_read(ctx);
+   return 0;
+}
+
+int cache_dal_delete(DAL_Context* ctx) {
+   return BACKEND_OP(del, ctx);
+}
+
+int cache_dal_del_many(DAL_Context* ctx, DAL* dal, void* fh,
+                       const char** objids, size_t count, int* status) {
+   return BACKEND_OP(del_many, ctx, CACHE_DAL(ctx), fh, objids, count, status);
+}
+
+
+
+DAL cache_dal = {
+   .name         = "CACHE",
+   .name_len     = 5,
+
+   .global_state = NULL,
+
+   .config       = &cache_dal_config,
+   .init         = &cache_dal_ctx_init,
+   .destroy      = &cache_dal_ctx_destroy,
+
+   .open         = &cache_dal_open,
+   .put          = &cache_dal_put,
+   .get          = &cache_dal_get,
+   .sync         = &cache_dal_sync,
+   .abort        = &cache_dal_abort,
+   .close        = &cache_dal_close,
+   .del          = &cache_dal_delete,
+
+   .update_object_location = &cache_dal_update_object_location,
+
+   .del_many     = &cache_dal_del_many,
+};
+
+
+
+
+// ===========================================================================
+// COMPRESS
+// ===========================================================================
+//
+// A filter that wraps some other DAL (the "backend"), compressing object
+// data before it is handed to the backend's put(), and decompressing it
+// after get().  This is what gives meaning to Repo.comp_type: init_pre()
+// records the repo's comp_type in the Pre xattr of each new object, and
+// that value (not the current config) decides how an object is read back.
+// Objects with comp_type NONE pass straight through, so a repo can be
+// switched to compression without rewriting existing data.
+//
+// Data is cut into frames of <frame_size> uncompressed bytes (the last
+// one may be short).  Each frame is compressed independently, with a
+// small header, so it can be decoded on its own.  A frame that doesn't
+// shrink is stored raw.  All of MarFS's offset math (chunk sizes, packed
+// obj_offsets, recovery-info) stays in uncompressed bytes; os->written
+// also counts uncompressed bytes.
+//
+// To support ranged reads, sync() writes a small index object alongside
+// the data, named "<objid>.zidx", holding the physical end of each frame.
+// A read of [offset, offset+len) loads the index, and GETs only the
+// frames covering that range.  The index is only written once the data
+// PUT has completed, so the chunks of a compressed Multi are not
+// overlapped by the repo's write_pipeline.
+//
+//   <dal>
+//     <type>COMPRESS</type>
+//     <opt> <key_val> backend     : OBJECT </key_val> </opt>
+//     <opt> <key_val> frame_size  : bytes  </key_val> </opt>  default 256KB
+//     <opt> <key_val> backend.xxx : value  </key_val> </opt>
+//   </dal>
+//
+// Options named "backend.xxx" are given to the backend's config(), as
+// "xxx".
+// ===========================================================================
+
+#define COMPRESS_DEFAULT_FRAME   (256 * 1024)
+#define COMPRESS_MIN_FRAME       (4 * 1024)
+#define COMPRESS_MAX_FRAME       (64 * 1024 * 1024)
+
+// frame header:  magic[2], codec[1], pad[1], ulen[4], clen[4]
+#define COMPRESS_FRAME_MAGIC     0x5a4d          // "MZ"
+#define COMPRESS_HDR_SIZE        12
+
+// index header:  magic[4], frame_size[4], total[8], count[8], then
+// <count> physical frame-ends, [8] each.  All little-endian.
+#define COMPRESS_INDEX_MAGIC     0x58495a4d      // "MZIX"
+#define COMPRESS_INDEX_HDR       24
+#define COMPRESS_INDEX_PROBE     (64 * 1024)
+#define COMPRESS_INDEX_SUFFIX    ".zidx"
+
+
+// ...........................................................................
+// LZ codec
+//
+// A byte-oriented LZ77, in the style of LZ4 blocks.  Each sequence is a
+// token (literal-count in the high nibble, match-length minus 4 in the
+// low nibble, either one extended with 255-runs when it's 15), the
+// literals, then a 2-byte match offset.  The final sequence has literals
+// only.  Fast, and no dictionary or state crosses a frame boundary.
+// ...........................................................................
+
+#define LZ_HASH_BITS   12
+#define LZ_MIN_MATCH   4
+#define LZ_MAX_OFFSET  65535
+#define LZ_LAST_LITS   5       // the final bytes are always literals
+#define LZ_MATCH_LIMIT 12      // no match starts this close to the end
+
+static inline
+uint32_t lz_read32(const uint8_t* p) {
+   uint32_t v;
+   memcpy(&v, p, 4);
+   return v;
+}
+
+static inline
+uint32_t lz_hash(uint32_t v) {
+   return (v * 2654435761U) >> (32 - LZ_HASH_BITS);
+}
+
+// bytes needed to extend a length of <len>, past its 4-bit nibble
+static inline
+size_t lz_len_bytes(size_t len) {
+   return ((len < 15) ? 0 : ((len - 15) / 255) + 1);
+}
+
+static
+uint8_t* lz_put_len(uint8_t* op, size_t len) {
+   len -= 15;
+   while (len >= 255) {
+      *op++ = 255;
+      len  -= 255;
+   }
+   *op++ = (uint8_t)len;
+   return op;
+}
+
+// Returns compressed size, or 0 if the result wouldn't fit in <cap>.
+static
+size_t lz_compress(const char* src, size_t len, char* dst, size_t cap) {
+   const uint8_t* base   = (const uint8_t*)src;
+   const uint8_t* ip     = base;
+   const uint8_t* iend   = base + len;
+   const uint8_t* mlimit = ((len > LZ_MATCH_LIMIT) ? iend - LZ_MATCH_LIMIT : base);
+   const uint8_t* anchor = base;
+   uint8_t*       op     = (uint8_t*)dst;
+   uint8_t*       oend   = op + cap;
+   uint32_t       table[1 << LZ_HASH_BITS];
+
+   memset(table, 0, sizeof(table));
+
+   while (ip < mlimit) {
+      uint32_t       seq = lz_read32(ip);
+      uint32_t       h   = lz_hash(seq);
+      const uint8_t* ref = base + table[h];
+      table[h] = ip - base;
+
+      if ((ref >= ip)
+          || ((ip - ref) > LZ_MAX_OFFSET)
+          || (lz_read32(ref) != seq)) {
+         ++ip;
+         continue;
+      }
+
+      const uint8_t* p = ip  + LZ_MIN_MATCH;
+      const uint8_t* q = ref + LZ_MIN_MATCH;
+      while ((p < iend - LZ_LAST_LITS) && (*p == *q)) {
+         ++p;
+         ++q;
+      }
+
+      size_t lit = ip - anchor;
+      size_t ml  = (p - ip) - LZ_MIN_MATCH;
+      if ((size_t)(oend - op) < 1 + lz_len_bytes(lit) + lit + 2 + lz_len_bytes(ml))
+         return 0;
+
+      uint8_t* token = op++;
+      *token = (uint8_t)((((lit < 15) ? lit : 15) << 4) | ((ml < 15) ? ml : 15));
+      if (lit >= 15)
+         op = lz_put_len(op, lit);
+      memcpy(op, anchor, lit);
+      op += lit;
+
+      size_t offset = ip - ref;
+      *op++ = (uint8_t)(offset & 0xff);
+      *op++ = (uint8_t)(offset >> 8);
+      if (ml >= 15)
+         op = lz_put_len(op, ml);
+
+      ip     = p;
+      anchor = p;
+   }
+
+   // trailing literals
+   size_t lit = iend - anchor;
+   if ((size_t)(oend - op) < 1 + lz_len_bytes(lit) + lit)
+      return 0;
+   *op++ = (uint8_t)(((lit < 15) ? lit : 15) << 4);
+   if (lit >= 15)
+      op = lz_put_len(op, lit);
+   memcpy(op, anchor, lit);
+   op += lit;
+
+   return op - (uint8_t*)dst;
+}
+
+// Returns decompressed size, or -1 if <src> is malformed, or would
+// overflow <cap>.
+static
+ssize_t lz_decompress(const char* src, size_t len, char* dst, size_t cap) {
+   const uint8_t* ip   = (const uint8_t*)src;
+   const uint8_t* iend = ip + len;
+   uint8_t*       op   = (uint8_t*)dst;
+   uint8_t*       oend = op + cap;
+
+   while (ip < iend) {
+      unsigned token = *ip++;
+      size_t   lit   = token >> 4;
+      unsigned b;
+
+      if (lit == 15) {
+         do {
+            if (ip >= iend)
+               return -1;
+            b    = *ip++;
+            lit += b;
+         } while (b == 255);
+      }
+      if ((lit > (size_t)(iend - ip)) || (lit > (size_t)(oend - op)))
+         return -1;
+      memcpy(op, ip, lit);
+      op += lit;
+      ip += lit;
+
+      if (ip == iend)
+         break;                 // final sequence has no match
+
+      if ((iend - ip) < 2)
+         return -1;
+      size_t offset = ip[0] | (ip[1] << 8);
+      ip += 2;
+      if (! offset || (offset > (size_t)(op - (uint8_t*)dst)))
+         return -1;
+
+      size_t ml = token & 15;
+      if (ml == 15) {
+         do {
+            if (ip >= iend)
+               return -1;
+            b   = *ip++;
+            ml += b;
+         } while (b == 255);
+      }
+      ml += LZ_MIN_MATCH;
+      if (ml > (size_t)(oend - op))
+         return -1;
+
+      const uint8_t* ref = op - offset;
+      if (offset >= ml) {
+         memcpy(op, ref, ml);
+         op += ml;
+      }
+      else {
+         while (ml--)           // overlapping copy, e.g. runs
+            *op++ = *ref++;
+      }
+   }
+
+   return op - (uint8_t*)dst;
+}
+
+
+// ...........................................................................
+// codecs, indexed by MarFS_CompType.  The type is what goes in the Pre
+// xattr, and in each frame header, so a given value must always mean the
+// same codec.
+// ...........................................................................
+
+typedef struct {
+   const char* name;
+   size_t    (*compress)  (const char* src, size_t len, char* dst, size_t cap);
+   ssize_t   (*decompress)(const char* src, size_t len, char* dst, size_t cap);
+} CompressCodec;
+
+static const CompressCodec compress_codecs[] = {
+   [COMPTYPE_LZ] = { "LZ", &lz_compress, &lz_decompress },
+};
+
+#define COMPRESS_CODEC_COUNT  (sizeof(compress_codecs) / sizeof(CompressCodec))
+
+// NULL for COMPTYPE_NONE, or anything we don't know
+static
+const CompressCodec* compress_codec(unsigned type) {
+   if ((type == COMPTYPE_NONE)
+       || (type >= COMPRESS_CODEC_COUNT)
+       || ! compress_codecs[type].compress)
+      return NULL;
+   return &compress_codecs[type];
+}
+
+
+// ...........................................................................
+// the DAL
+// ...........................................................................
+
+typedef struct {
+   DAL*              backend;       // private copy, configured
+   size_t            frame_size;
+} CompressConfig;
+
+typedef struct {
+   DAL_Context       inner;         // backend's context
+   const CompressConfig* config;
+   MarFS_FileHandle* fh;
+   const CompressCodec* codec;      // for PUT
+   uint16_t          timeout;
+
+   size_t            frame_size;    // from config (PUT) or index (GET)
+   size_t            buf_size;
+   char*             ubuf;          // uncompressed frame
+   char*             cbuf;          // header + compressed frame
+   size_t            ufill;         // bytes in ubuf
+   size_t            upos;          // GET: bytes of ubuf already returned
+   size_t            skip;          // GET: bytes to drop from next frame
+   size_t            remain;        // GET: bytes left in requested range
+
+   uint64_t*         index;         // physical end of each frame
+   size_t            index_count;
+   size_t            index_alloc;
+   size_t            total;         // uncompressed bytes in the object
+   char              index_objid[MARFS_MAX_OBJID_SIZE]; // whose index we hold
+} CompressDal_Context;
+
+// DAL_Context.flags
+enum compress_dal_flags {
+   COMPRESS_DAL_FRAMED = (1 << 0),  // open stream is compressed
+   COMPRESS_DAL_EMPTY  = (1 << 1)   // read is past the end, backend not opened
+};
+
+#define COMPRESS_CONTEXT(CTX)  ((CompressDal_Context*)((CTX)->data.ptr))
+#define COMPRESS_INNER(CTX)    (&COMPRESS_CONTEXT(CTX)->inner)
+#define COMPRESS_DAL(CTX)      (COMPRESS_CONTEXT(CTX)->config->backend)
+#define COMPRESS_OS(CTX)       (&COMPRESS_CONTEXT(CTX)->fh->os)
+
+#define COMPRESS_OP(OP, CTX, ...)                                       \
+   (*COMPRESS_DAL(CTX)->OP)(COMPRESS_INNER(CTX), ##__VA_ARGS__)
+
+
+static inline
+void compress_put32(char* p, uint32_t v) {
+   int i;
+   for (i=0; i<4; ++i)
+      p[i] = (char)(v >> (8 * i));
+}
+static inline
+void compress_put64(char* p, uint64_t v) {
+   compress_put32(p,     (uint32_t)v);
+   compress_put32(p + 4, (uint32_t)(v >> 32));
+}
+static inline
+uint32_t compress_get32(const char* p) {
+   const uint8_t* u = (const uint8_t*)p;
+   return (u[0] | (u[1] << 8) | (u[2] << 16) | ((uint32_t)u[3] << 24));
+}
+static inline
+uint64_t compress_get64(const char* p) {
+   return (compress_get32(p) | ((uint64_t)compress_get32(p + 4) << 32));
+}
+
+
+int compress_dal_config(struct DAL*     dal,
+                        xDALConfigOpt** opts,
+                        size_t          opt_count) {
+
+   CompressConfig* cfg = (CompressConfig*)calloc(1, sizeof(CompressConfig));
+   size_t          my_count;
+   if (! cfg) {
+      LOG(LOG_ERR, "couldn't allocate CompressConfig\n");
+      return -1;
+   }
+   cfg->frame_size = COMPRESS_DEFAULT_FRAME;
+
+   if (wrapper_dal_config(dal, opts, opt_count, &cfg->backend, &my_count))
+      return -1;
+
+   int i;
+   for (i=0; i<my_count; ++i) {
+      const char* key = opts[i]->key;
+      const char* val = opts[i]->val.value.str;
+
+      if (! strcmp(key, "frame_size"))
+         cfg->frame_size = strtoull(val, NULL, 10);
+      else {
+         LOG(LOG_ERR, "Unrecognized COMPRESS DAL config option: %s\n", key);
+         return -1;
+      }
+      LOG(LOG_INFO, "parsing compress option \"%s\" = %s\n", key, val);
+   }
+   for (i=0; i<my_count; ++i)
+      free(opts[i]);
+   free(opts);
+
+   if ((cfg->frame_size < COMPRESS_MIN_FRAME)
+       || (cfg->frame_size > COMPRESS_MAX_FRAME)) {
+      LOG(LOG_ERR, "COMPRESS frame_size %lu is not in [%u, %u]\n",
+          cfg->frame_size, COMPRESS_MIN_FRAME, COMPRESS_MAX_FRAME);
+      return -1;
+   }
+
+   dal->global_state = cfg;
+   return 0;
+}
+
+
+int compress_dal_ctx_init(DAL_Context* ctx, struct DAL* dal, void* fh) {
+   TRY_DECLS();
+
+   ctx->flags    = 0;
+   ctx->data.ptr = calloc(1, sizeof(CompressDal_Context));
+   if (! ctx->data.ptr) {
+      LOG(LOG_ERR, "couldn't allocate CompressDal_Context\n");
+      errno = ENOMEM;
+      return -1;
+   }
+   COMPRESS_CONTEXT(ctx)->config = (const CompressConfig*)dal->global_state;
+   COMPRESS_CONTEXT(ctx)->fh     = (MarFS_FileHandle*)fh;
+
+   TRY0( (*COMPRESS_DAL(ctx)->init)(COMPRESS_INNER(ctx), COMPRESS_DAL(ctx), fh) );
+   return 0;
+}
+
+int compress_dal_ctx_destroy(DAL_Context* ctx, struct DAL* dal) {
+   int rc = 0;
+   CompressDal_Context* cc = COMPRESS_CONTEXT(ctx);
+   if (cc) {
+      dal_async_free(COMPRESS_INNER(ctx));
+      rc = (*COMPRESS_DAL(ctx)->destroy)(COMPRESS_INNER(ctx), COMPRESS_DAL(ctx));
+      free(cc->ubuf);
+      free(cc->cbuf);
+      free(cc->index);
+      free(cc);
+      ctx->data.ptr = NULL;
+   }
+   return rc;
+}
+
+int compress_dal_update_object_location(DAL_Context* ctx) {
+   return COMPRESS_OP(update_object_location, ctx);
+}
+
+
+// make sure the frame buffers can hold frames of <frame_size>
+static
+int compress_buffers(CompressDal_Context* cc, size_t frame_size) {
+   cc->frame_size = frame_size;
+   if (cc->buf_size >= frame_size)
+      return 0;
+
+   free(cc->ubuf);
+   free(cc->cbuf);
+   cc->ubuf     = (char*)malloc(frame_size);
+   cc->cbuf     = (char*)malloc(COMPRESS_HDR_SIZE + frame_size);
+   cc->buf_size = frame_size;
+   if (! cc->ubuf || ! cc->cbuf) {
+      LOG(LOG_ERR, "couldn't allocate %lu-byte frame buffers\n", frame_size);
+      free(cc->ubuf);
+      free(cc->cbuf);
+      cc->ubuf     = NULL;
+      cc->cbuf     = NULL;
+      cc->buf_size = 0;
+      errno = ENOMEM;
+      return -1;
+   }
+   return 0;
+}
+
+static
+int compress_index_add(CompressDal_Context* cc, uint64_t end) {
+   if (cc->index_count == cc->index_alloc) {
+      size_t    alloc = (cc->index_alloc ? cc->index_alloc * 2 : 1024);
+      uint64_t* index = (uint64_t*)realloc(cc->index, alloc * sizeof(uint64_t));
+      if (! index) {
+         errno = ENOMEM;
+         return -1;
+      }
+      cc->index       = index;
+      cc->index_alloc = alloc;
+   }
+   cc->index[cc->index_count++] = end;
+   return 0;
+}
+
+// read up to <len> bytes from an open backend stream.  Returns the count,
+// which is short only at the end of the stream, or -1.
+static
+ssize_t compress_read_full(DAL* dal, DAL_Context* ctx, char* buf, size_t len) {
+   size_t got = 0;
+   while (got < len) {
+      ssize_t rc = (*dal->get)(ctx, buf + got, len - got);
+      if (rc < 0)
+         return -1;
+      if (rc == 0)
+         break;
+      got += rc;
+   }
+   return got;
+}
+
+
+typedef enum {
+   ZIDX_PUT,
+   ZIDX_GET,
+   ZIDX_DEL
+} ZIdxOp;
+
+// Write, read, or delete the index for the current object.  The index is
+// a separate object, so it gets its own backend context, on a private
+// copy of the file-handle, naming "<objid>.zidx".
+static
+int compress_index_io(DAL_Context* ctx, ZIdxOp op) {
+   CompressDal_Context* cc  = COMPRESS_CONTEXT(ctx);
+   DAL*                 dal = COMPRESS_DAL(ctx);
+   DAL_Context          ictx;
+   char*                buf = NULL;
+   size_t               len = 0;
+   int                  err = 0;
+
+   MarFS_FileHandle* ifh = (MarFS_FileHandle*)calloc(1, sizeof(MarFS_FileHandle));
+   if (! ifh) {
+      errno = ENOMEM;
+      return -1;
+   }
+   ifh->info = cc->fh->info;
+
+   char*  objid     = ifh->info.pre.objid;
+   size_t objid_len = strlen(objid);
+   if (objid_len + sizeof(COMPRESS_INDEX_SUFFIX) > MARFS_MAX_OBJID_SIZE) {
+      LOG(LOG_ERR, "no room for index suffix on objid %s\n", objid);
+      free(ifh);
+      errno = ENAMETOOLONG;
+      return -1;
+   }
+   strcpy(objid + objid_len, COMPRESS_INDEX_SUFFIX);
+
+   memset(&ictx, 0, sizeof(DAL_Context));
+   if ((*dal->init)(&ictx, dal, ifh)) {
+      err = errno;
+      goto free_fh;
+   }
+   if ((*dal->update_object_location)(&ictx)) {
+      err = errno;
+      goto destroy;
+   }
+
+   switch (op) {
+   case ZIDX_DEL:
+      if ((*dal->del)(&ictx))
+         err = errno;
+      break;
+
+   case ZIDX_PUT:
+      len = COMPRESS_INDEX_HDR + (cc->index_count * 8);
+      buf = (char*)malloc(len);
+      if (! buf) {
+         err = ENOMEM;
+         break;
+      }
+      compress_put32(buf,      COMPRESS_INDEX_MAGIC);
+      compress_put32(buf + 4,  (uint32_t)cc->frame_size);
+      compress_put64(buf + 8,  cc->total);
+      compress_put64(buf + 16, cc->index_count);
+      size_t i;
+      for (i=0; i<cc->index_count; ++i)
+         compress_put64(buf + COMPRESS_INDEX_HDR + (i * 8), cc->index[i]);
+
+      if ((*dal->open)(&ictx, 1, 0, len, 0, cc->timeout)) {
+         err = errno;
+         break;
+      }
+      if ((*dal->put)(&ictx, buf, len) != len) {
+         err = (errno ? errno : EIO);
+         (*dal->abort)(&ictx);
+      }
+      else if ((*dal->sync)(&ictx))
+         err = errno;
+      (*dal->close)(&ictx);
+      break;
+
+   case ZIDX_GET:
+      // Most indexes fit in one probe.  If not, the header says how much
+      // more to fetch.
+      len = COMPRESS_INDEX_PROBE;
+      buf = (char*)malloc(len);
+      if (! buf) {
+         err = ENOMEM;
+         break;
+      }
+      size_t  need = len;
+      size_t  got  = 0;
+      while (! err && (got < need)) {
+         if ((*dal->open)(&ictx, 0, got, need - got, 0, cc->timeout)) {
+            err = errno;
+            break;
+         }
+         ssize_t rc = compress_read_full(dal, &ictx, buf + got, need - got);
+         if (rc < 0) {
+            err = (errno ? errno : EIO);
+            (*dal->abort)(&ictx);
+         }
+         else if ((*dal->sync)(&ictx))
+            err = errno;
+         (*dal->close)(&ictx);
+         if (err)
+            break;
+         got += rc;
+
+         if ((got < COMPRESS_INDEX_HDR)
+             || (compress_get32(buf) != COMPRESS_INDEX_MAGIC)) {
+            err = EIO;
+            break;
+         }
+         need = COMPRESS_INDEX_HDR + (compress_get64(buf + 16) * 8);
+         if (need > len) {
+            char* new_buf = (char*)realloc(buf, need);
+            if (! new_buf) {
+               err = ENOMEM;
+               break;
+            }
+            buf = new_buf;
+            len = need;
+         }
+         else if (got < need) {
+            err = EIO;          // index is truncated
+            break;
+         }
+      }
+      if (err)
+         break;
+
+      size_t count      = compress_get64(buf + 16);
+      size_t frame_size = compress_get32(buf + 4);
+      if ((frame_size < COMPRESS_MIN_FRAME)
+          || (frame_size > COMPRESS_MAX_FRAME)) {
+         err = EIO;
+         break;
+      }
+      cc->index_count = 0;
+      for (i=0; i<count; ++i) {
+         if (compress_index_add(cc, compress_get64(buf + COMPRESS_INDEX_HDR + (i * 8)))) {
+            err = errno;
+            break;
+         }
+      }
+      if (err)
+         break;
+      if (compress_buffers(cc, frame_size)) {
+         err = errno;
+         break;
+      }
+      cc->total = compress_get64(buf + 8);
+      strncpy(cc->index_objid, cc->fh->info.pre.objid, MARFS_MAX_OBJID_SIZE);
+      cc->index_objid[MARFS_MAX_OBJID_SIZE -1] = 0;
+      break;
+   }
+
+ destroy:
+   dal_async_free(&ictx);
+   (*dal->destroy)(&ictx, dal);
+   stream_release(&ifh->os);
+ free_fh:
+   free(ifh);
+   free(buf);
+
+   if (err) {
+      LOG(LOG_ERR, "COMPRESS: index %s failed for %s: %s\n",
+          ((op == ZIDX_PUT) ? "PUT" : (op == ZIDX_GET) ? "GET" : "DEL"),
+          cc->fh->info.pre.objid, strerror(err));
+      if (op == ZIDX_GET)
+         cc->index_objid[0] = 0;
+      errno = err;
+      return -1;
+   }
+   return 0;
+}
+
+
+int compress_dal_open(DAL_Context* ctx,
+                      int          is_put,
+                      size_t       chunk_offset,
+                      size_t       content_length,
+                      uint8_t      preserve_write_count,
+                      uint16_t     timeout) {
+   TRY_DECLS();
+   CompressDal_Context* cc = COMPRESS_CONTEXT(ctx);
+   ObjectStream*        os = COMPRESS_OS(ctx);
+
+   ctx->flags &= ~(COMPRESS_DAL_FRAMED | COMPRESS_DAL_EMPTY);
+   if (! compress_codec(cc->fh->info.pre.compression))
+      return COMPRESS_OP(open, ctx, is_put, chunk_offset, content_length,
+                         preserve_write_count, timeout);
+
+   cc->timeout = timeout;
+   cc->ufill   = 0;
+   cc->upos    = 0;
+   cc->skip    = 0;
+
+   if (is_put) {
+      TRY0( compress_buffers(cc, cc->config->frame_size) );
+      cc->codec          = compress_codec(cc->fh->info.pre.compression);
+      cc->index_count    = 0;
+      cc->total          = 0;
+      cc->index_objid[0] = 0;
+
+      // compressed size isn't known, so don't give a content-length
+      TRY0( COMPRESS_OP(open, ctx, is_put, chunk_offset, 0,
+                        preserve_write_count, timeout) );
+      ctx->flags |= COMPRESS_DAL_FRAMED;
+      return 0;
+   }
+
+   // reading.  The index gives the physical range holding the frames that
+   // cover the logical range.  It's kept across opens of the same object.
+   if (strcmp(cc->index_objid, cc->fh->info.pre.objid))
+      TRY0( compress_index_io(ctx, ZIDX_GET) );
+
+   if (chunk_offset >= cc->total) {
+      TRY0( stream_cleanup_for_reopen(os, preserve_write_count) );
+      os->flags  |= (OSF_READING | OSF_OPEN);
+      cc->remain  = 0;
+      ctx->flags |= (COMPRESS_DAL_FRAMED | COMPRESS_DAL_EMPTY);
+      return 0;
+   }
+
+   size_t end = cc->total;
+   if (content_length && (chunk_offset + content_length < end))
+      end = chunk_offset + content_length;
+
+   size_t first = chunk_offset / cc->frame_size;
+   size_t last  = (end -1) / cc->frame_size;
+   if (last >= cc->index_count) {
+      LOG(LOG_ERR, "COMPRESS: index for %s is short (%lu < %lu frames)\n",
+          cc->fh->info.pre.objid, cc->index_count, last +1);
+      errno = EIO;
+      return -1;
+   }
+   size_t pstart = (first ? cc->index[first -1] : 0);
+   size_t pend   = cc->index[last];
+
+   TRY0( COMPRESS_OP(open, ctx, is_put, pstart, pend - pstart,
+                     preserve_write_count, timeout) );
+   cc->skip    = chunk_offset - (first * cc->frame_size);
+   cc->remain  = end - chunk_offset;
+   ctx->flags |= COMPRESS_DAL_FRAMED;
+   return 0;
+}
+
+
+// compress the frame in ubuf, and PUT it.  The backend counts physical
+// bytes in os->written, but our callers want logical ones.
+static
+int compress_emit(DAL_Context* ctx) {
+   CompressDal_Context* cc      = COMPRESS_CONTEXT(ctx);
+   ObjectStream*        os      = COMPRESS_OS(ctx);
+   char*                payload = cc->cbuf + COMPRESS_HDR_SIZE;
+   uint8_t              codec   = cc->fh->info.pre.compression;
+
+   size_t clen = (*cc->codec->compress)(cc->ubuf, cc->ufill, payload, cc->ufill);
+   if (! clen) {
+      memcpy(payload, cc->ubuf, cc->ufill);
+      clen  = cc->ufill;
+      codec = COMPTYPE_NONE;    // didn't shrink, stored raw
+   }
+
+   cc->cbuf[0] = (char)(COMPRESS_FRAME_MAGIC & 0xff);
+   cc->cbuf[1] = (char)(COMPRESS_FRAME_MAGIC >> 8);
+   cc->cbuf[2] = (char)codec;
+   cc->cbuf[3] = 0;
+   compress_put32(cc->cbuf + 4, (uint32_t)cc->ufill);
+   compress_put32(cc->cbuf + 8, (uint32_t)clen);
+
+   size_t size         = COMPRESS_HDR_SIZE + clen;
+   size_t save_written = os->written;
+   int    rc           = COMPRESS_OP(put, ctx, cc->cbuf, size);
+   os->written = save_written;
+   if (rc != size) {
+      LOG(LOG_ERR, "COMPRESS: backend put returned %d, for %lu\n", rc, size);
+      if (! errno)
+         errno = EIO;
+      return -1;
+   }
+
+   uint64_t prev = (cc->index_count ? cc->index[cc->index_count -1] : 0);
+   if (compress_index_add(cc, prev + size))
+      return -1;
+   cc->total += cc->ufill;
+   cc->ufill  = 0;
+   return 0;
+}
+
+int compress_dal_put(DAL_Context* ctx, const char* buf, size_t size) {
+   CompressDal_Context* cc = COMPRESS_CONTEXT(ctx);
+
+   if (! (ctx->flags & COMPRESS_DAL_FRAMED))
+      return COMPRESS_OP(put, ctx, buf, size);
+
+   size_t done = 0;
+   while (done < size) {
+      size_t n = cc->frame_size - cc->ufill;
+      if (n > size - done)
+         n = size - done;
+      memcpy(cc->ubuf + cc->ufill, buf + done, n);
+      cc->ufill += n;
+      done      += n;
+      if ((cc->ufill == cc->frame_size) && compress_emit(ctx))
+         return -1;
+   }
+
+   COMPRESS_OS(ctx)->written += size;
+   return size;
+}
+
+
+// read and decode the next frame into ubuf.  Like compress_emit(), this
+// hides the backend's side-effects on the ObjectStream.
+static
+int compress_next_frame(DAL_Context* ctx) {
+   CompressDal_Context* cc  = COMPRESS_CONTEXT(ctx);
+   ObjectStream*        os  = COMPRESS_OS(ctx);
+   DAL*                 dal = COMPRESS_DAL(ctx);
+   size_t               save_written = os->written;
+   OSFlags_t            save_eof     = (os->flags & OSF_EOF);
+   int                  err = 0;
+
+   ssize_t rc = compress_read_full(dal, COMPRESS_INNER(ctx), cc->cbuf, COMPRESS_HDR_SIZE);
+   if (rc != COMPRESS_HDR_SIZE)
+      err = ((rc < 0) && errno) ? errno : EIO;
+   else {
+      uint8_t  codec = (uint8_t)cc->cbuf[2];
+      uint32_t ulen  = compress_get32(cc->cbuf + 4);
+      uint32_t clen  = compress_get32(cc->cbuf + 8);
+      const CompressCodec* c = compress_codec(codec);
+
+      if ((compress_get32(cc->cbuf) & 0xffff) != COMPRESS_FRAME_MAGIC
+          || (ulen > cc->frame_size)
+          || (clen > cc->frame_size)
+          || (cc->skip > ulen)
+          || ((codec != COMPTYPE_NONE) && ! c)
+          || ((codec == COMPTYPE_NONE) && (clen != ulen)))
+         err = EIO;
+
+      // raw frames are read straight into ubuf
+      else if (codec == COMPTYPE_NONE) {
+         rc = compress_read_full(dal, COMPRESS_INNER(ctx), cc->ubuf, clen);
+         if (rc != clen)
+            err = ((rc < 0) && errno) ? errno : EIO;
+      }
+      else {
+         char* payload = cc->cbuf + COMPRESS_HDR_SIZE;
+         rc = compress_read_full(dal, COMPRESS_INNER(ctx), payload, clen);
+         if (rc != clen)
+            err = ((rc < 0) && errno) ? errno : EIO;
+         else if ((*c->decompress)(payload, clen, cc->ubuf, cc->frame_size) != ulen)
+            err = EIO;
+      }
+
+      cc->ufill = ulen;
+      cc->upos  = cc->skip;
+      cc->skip  = 0;
+   }
+
+   os->written = save_written;
+   os->flags   = (os->flags & ~OSF_EOF) | save_eof;
+   if (err) {
+      LOG(LOG_ERR, "COMPRESS: bad frame in %s: %s\n",
+          cc->fh->info.pre.objid, strerror(err));
+      cc->ufill = 0;
+      cc->upos  = 0;
+      errno = err;
+      return -1;
+   }
+   return 0;
+}
+
+ssize_t compress_dal_get(DAL_Context* ctx, char* buf, size_t size) {
+   CompressDal_Context* cc = COMPRESS_CONTEXT(ctx);
+   ObjectStream*        os = COMPRESS_OS(ctx);
+
+   if (! (ctx->flags & COMPRESS_DAL_FRAMED))
+      return COMPRESS_OP(get, ctx, buf, size);
+
+   if (size > cc->remain)
+      size = cc->remain;
+
+   size_t done = 0;
+   while (done < size) {
+      if ((cc->upos == cc->ufill) && compress_next_frame(ctx))
+         return -1;
+
+      size_t n = cc->ufill - cc->upos;
+      if (n > size - done)
+         n = size - done;
+      memcpy(buf + done, cc->ubuf + cc->upos, n);
+      cc->upos += n;
+      done     += n;
+   }
+
+   cc->remain  -= done;
+   os->written += done;
+   if (! cc->remain)
+      os->flags |= OSF_EOF;
+   return done;
+}
+
+static
+void compress_close_empty(DAL_Context* ctx) {
+   ctx->flags &= ~(COMPRESS_DAL_FRAMED | COMPRESS_DAL_EMPTY);
+   COMPRESS_OS(ctx)->flags &= ~OSF_OPEN;
+   COMPRESS_OS(ctx)->flags |= OSF_CLOSED;
+}
+
+int compress_dal_sync(DAL_Context* ctx) {
+   CompressDal_Context* cc = COMPRESS_CONTEXT(ctx);
+   ObjectStream*        os = COMPRESS_OS(ctx);
+
+   if (ctx->flags & COMPRESS_DAL_EMPTY) {
+      compress_close_empty(ctx);
+      return 0;
+   }
+   if (! (ctx->flags & COMPRESS_DAL_FRAMED)
+       || ! (os->flags & OSF_WRITING))
+      return COMPRESS_OP(sync, ctx);
+
+   // Flush the partial frame, then write the index, once the data is
+   // safe.  With a write-pipeline, a retired PUT would still be running
+   // when the backend's sync() returns, and if it then failed, we'd leave
+   // an index with no data.  So framed streams are never retired: the
+   // sync waits for this PUT (and any retired before it) to complete.
+   // (See stream_sync_piped().)
+   if (cc->ufill && compress_emit(ctx))
+      return -1;
+   os->flags &= ~OSF_RETIRE;
+
+   size_t save_written = os->written;
+   int    rc           = COMPRESS_OP(sync, ctx);
+   os->written = save_written;
+   if (rc)
+      return -1;
+
+   if (compress_index_io(ctx, ZIDX_PUT))
+      return -1;
+   strncpy(cc->index_objid, cc->fh->info.pre.objid, MARFS_MAX_OBJID_SIZE);
+   cc->index_objid[MARFS_MAX_OBJID_SIZE -1] = 0;
+   return 0;
+}
+
+int compress_dal_abort(DAL_Context* ctx) {
+   if (ctx->flags & COMPRESS_DAL_EMPTY) {
+      COMPRESS_OS(ctx)->flags |= OSF_ABORT;
+      return 0;
+   }
+   COMPRESS_CONTEXT(ctx)->index_objid[0] = 0;
+   return COMPRESS_OP(abort, ctx);
+}
+
+int compress_dal_close(DAL_Context* ctx) {
+   if (ctx->flags & COMPRESS_DAL_EMPTY) {
+      if (COMPRESS_OS(ctx)->flags & OSF_OPEN)
+         compress_close_empty(ctx);
+      return 0;
+   }
+   ctx->flags &= ~COMPRESS_DAL_FRAMED;
+   return COMPRESS_OP(close, ctx);
+}
+
+// The data is what matters.  A leftover index is only wasted space, so
+// failing to delete it is logged, but not returned.
+int compress_dal_delete(DAL_Context* ctx) {
+   CompressDal_Context* cc = COMPRESS_CONTEXT(ctx);
+
+   if (COMPRESS_OP(del, ctx))
+      return -1;
+   if (compress_codec(cc->fh->info.pre.compression))
+      compress_index_io(ctx, ZIDX_DEL);
+   cc->index_objid[0] = 0;
+   return 0;
+}
+
+// Same, for a batch.  The index objects for the ones that were deleted go
+// in a second batch, whose status is only logged.
+int compress_dal_del_many(DAL_Context* ctx, DAL* dal, void* fh_void,
+                          const char** objids, size_t count, int* status) {
+   CompressDal_Context* cc      = COMPRESS_CONTEXT(ctx);
+   MarFS_FileHandle*    fh      = (MarFS_FileHandle*)fh_void;
+   DAL*                 backend = COMPRESS_DAL(ctx);
+
+   int rc  = COMPRESS_OP(del_many, ctx, backend, fh, objids, count, status);
+   int err = errno;
+   cc->index_objid[0] = 0;
+   if (! compress_codec(fh->info.pre.compression))
+      return rc;
+
+   char*        names  = (char*)malloc(count * MARFS_MAX_OBJID_SIZE);
+   const char** idx    = (const char**)malloc(count * sizeof(char*));
+   int*         istat  = (int*)malloc(count * sizeof(int));
+   size_t       icount = 0;
+   size_t       i;
+
+   if (names && idx && istat) {
+      for (i=0; i<count; ++i) {
+         if (status[i])
+            continue;
+         char* name = names + (icount * MARFS_MAX_OBJID_SIZE);
+         if (snprintf(name, MARFS_MAX_OBJID_SIZE, "%s%s",
+                      objids[i], COMPRESS_INDEX_SUFFIX) >= MARFS_MAX_OBJID_SIZE)
+            continue;
+         idx[icount++] = name;
+      }
+      if (icount
+          && COMPRESS_OP(del_many, ctx, backend, fh, idx, icount, istat))
+         LOG(LOG_ERR, "failed to delete some of %ld indexes\n", icount);
+   }
+   else
+      LOG(LOG_ERR, "no memory to delete %ld indexes\n", count);
+
+   free(istat);
+   free(idx);
+   free(names);
+
+   errno = err;
+   return rc;
+}
+
+
+
+DAL compress_dal = {
+   .name         = "COMPRESS",
+   .name_len     = 8,
+
+   .global_state = NULL,
+
+   .config       = &compress_dal_config,
+   .init         = &compress_dal_ctx_init,
+   .destroy      = &compress_dal_ctx_destroy,
+
+   .open         = &compress_dal_open,
+   .put          = &compress_dal_put,
+   .get          = &compress_dal_get,
+   .sync         = &compress_dal_sync,
+   .abort        = &compress_dal_abort,
+   .close        = &compress_dal_close,
+   .del          = &compress_dal_delete,
+
+   .update_object_location = &compress_dal_update_object_location,
+
+   .del_many     = &compress_dal_del_many,
+};
+
+
+
+
+// ===========================================================================
+// FAULT
+// ===========================================================================
+//
+// A wrapper around some other DAL (the "backend"), that makes it behave
+// more like a busy production store.  Each call can be delayed by a
+// latency drawn from a distribution, streams can be held to a bandwidth
+// cap, and calls can fail, or hang and then time out, at configured rates.
+// With NO_OP or POSIX as the backend, this lets us exercise read-ahead,
+// async writes, and timeout handling on a single machine.
+//
+//   <dal>
+//     <type>FAULT</type>
+//     <opt> <key_val> backend      : POSIX      </key_val> </opt>
+//     <opt> <key_val> seed         : N          </key_val> </opt>  default from the clock
+//     <opt> <key_val> bandwidth    : bytes/sec  </key_val> </opt>  per stream, default none
+//     <opt> <key_val> timeout_ms   : msec       </key_val> </opt>  default from open(), or 20s
+//     <opt> <key_val> <op>.latency : <dist>     </key_val> </opt>
+//     <opt> <key_val> <op>.error   : fraction   </key_val> </opt>  e.g. 0.001
+//     <opt> <key_val> <op>.errno   : EIO        </key_val> </opt>  name or number
+//     <opt> <key_val> <op>.timeout : fraction   </key_val> </opt>
+//     <opt> <key_val> backend.xxx  : value      </key_val> </opt>
+//   </dal>
+//
+// <op> is open, put, get, sync, del, or "all".  Options are applied in
+// order, so "all.xxx" can be followed by overrides for specific ops.
+// <dist> is in milliseconds, and is one of:
+//
+//   fixed:T                 always T
+//   uniform:LO:HI           uniform in [LO, HI)
+//   exp:MEAN                exponential
+//   lognormal:MEDIAN:SIGMA  SIGMA is for the underlying normal
+//   pareto:MIN:ALPHA        heavy-tailed.  ALPHA <= 2 has infinite variance
+//
+// The latency comes first.  Then an injected timeout sleeps for timeout_ms
+// and fails with ETIMEDOUT, and an injected error fails at once.  Either
+// way, the backend is not called.  Given a seed, each process sees the
+// same sequence of faults, for the same sequence of contexts.
+// ===========================================================================
+
+#define FAULT_DEFAULT_TIMEOUT_MS  20000
+
+typedef enum {
+   FOP_OPEN = 0,
+   FOP_PUT,
+   FOP_GET,
+   FOP_SYNC,
+   FOP_DEL,
+   FOP_COUNT
+} FaultOpType;
+
+static const char* fault_op_name[FOP_COUNT] = {
+   "open", "put", "get", "sync", "del"
+};
+
+typedef enum {
+   FD_NONE = 0,
+   FD_FIXED,
+   FD_UNIFORM,
+   FD_EXP,
+   FD_LOGNORMAL,
+   FD_PARETO,
+} FaultDist;
+
+typedef struct {
+   FaultDist         dist;
+   double            a;             // distribution parameters (see above)
+   double            b;
+   double            error;         // fraction of calls that fail
+   int               err;           // ... with this errno
+   double            timeout;       // fraction of calls that time out
+} FaultOp;
+
+typedef struct {
+   DAL*              backend;       // private copy, configured
+   uint64_t          seed;
+   size_t            bandwidth;     // bytes/sec, per stream
+   uint32_t          timeout_ms;
+   FaultOp           op[FOP_COUNT];
+} FaultConfig;
+
+typedef struct {
+   DAL_Context       inner;         // backend's context
+   const FaultConfig* config;
+   MarFS_FileHandle* fh;
+   unsigned short    rand[3];       // erand48() state
+   uint16_t          timeout;       // from open(), seconds
+   struct timespec   start;         // open() time, for the bandwidth cap
+   size_t            moved;         // bytes put/gotten since then
+} FaultDal_Context;
+
+#define FAULT_CONTEXT(CTX)  ((FaultDal_Context*)((CTX)->data.ptr))
+#define FAULT_INNER(CTX)    (&FAULT_CONTEXT(CTX)->inner)
+#define FAULT_DAL(CTX)      (FAULT_CONTEXT(CTX)->config->backend)
+
+#define FAULT_OP(OP, CTX, ...)                                          \
+   (*FAULT_DAL(CTX)->OP)(FAULT_INNER(CTX), ##__VA_ARGS__)
+
+
+// contexts get successive seeds
+static volatile uint64_t fault_ctx_count = 0;
+
+
+static
+int fault_errno(const char* val) {
+   static const struct { const char* name; int err; } names[] = {
+      { "EIO",        EIO        },
+      { "ENOENT",     ENOENT     },
+      { "EACCES",     EACCES     },
+      { "EAGAIN",     EAGAIN     },
+      { "ENOSPC",     ENOSPC     },
+      { "ETIMEDOUT",  ETIMEDOUT  },
+      { "ECONNRESET", ECONNRESET },
+   };
+   int i;
+   for (i=0; i<sizeof(names)/sizeof(names[0]); ++i) {
+      if (! strcmp(val, names[i].name))
+         return names[i].err;
+   }
+   return strtol(val, NULL, 10);
+}
+
+// parse "<name>:<a>[:<b>]".  Returns 0, or -1 if <val> is no good.
+static
+int fault_dist(FaultOp* fo, const char* val) {
+   static const struct { const char* name; FaultDist dist; int params; } dists[] = {
+      { "fixed",     FD_FIXED,     1 },
+      { "uniform",   FD_UNIFORM,   2 },
+      { "exp",       FD_EXP,       1 },
+      { "lognormal", FD_LOGNORMAL, 2 },
+      { "pareto",    FD_PARETO,    2 },
+   };
+   const char* colon = strchr(val, ':');
+   if (! colon)
+      return -1;
+
+   int i;
+   for (i=0; i<sizeof(dists)/sizeof(dists[0]); ++i) {
+      if ((strlen(dists[i].name) != (colon - val))
+          || strncmp(val, dists[i].name, colon - val))
+         continue;
+
+      double a = 0;
+      double b = 0;
+      int    n = sscanf(colon +1, "%lf:%lf", &a, &b);
+      if ((n != dists[i].params) || (a < 0) || (b < 0))
+         return -1;
+      if ((dists[i].dist == FD_UNIFORM) && (b < a))
+         return -1;
+      if ((dists[i].dist == FD_PARETO) && (b == 0))
+         return -1;
+
+      fo->dist = dists[i].dist;
+      fo->a    = a;
+      fo->b    = b;
+      return 0;
+   }
+   return -1;
+}
+
+// "<op>.<param>" options.  Returns 1 if <key> was one of ours, 0 if not,
+// -1 if the value is bad.
+static
+int fault_op_opt(FaultConfig* cfg, const char* key, const char* val) {
+   const char* dot = strchr(key, '.');
+   if (! dot)
+      return 0;
+
+   int first;
+   int last;
+   if (((dot - key) == 3) && ! strncmp(key, "all", 3)) {
+      first = 0;
+      last  = FOP_COUNT -1;
+   }
+   else {
+      for (first=0; first<FOP_COUNT; ++first) {
+         if ((strlen(fault_op_name[first]) == (dot - key))
+             && ! strncmp(key, fault_op_name[first], dot - key))
+            break;
+      }
+      if (first == FOP_COUNT)
+         return 0;
+      last = first;
+   }
+
+   const char* param = dot +1;
+   int i;
+   for (i=first; i<=last; ++i) {
+      FaultOp* fo = &cfg->op[i];
+
+      if (! strcmp(param, "latency")) {
+         if (fault_dist(fo, val))
+            return -1;
+      }
+      else if (! strcmp(param, "error"))
+         fo->error = strtod(val, NULL);
+      else if (! strcmp(param, "errno"))
+         fo->err = fault_errno(val);
+      else if (! strcmp(param, "timeout"))
+         fo->timeout = strtod(val, NULL);
+      else
+         return 0;
+
+      if ((fo->error < 0) || (fo->timeout < 0) || ((fo->error + fo->timeout) > 1)
+          || (fo->err <= 0))
+         return -1;
+   }
+   return 1;
+}
+
+int fault_dal_config(struct DAL*     dal,
+                     xDALConfigOpt** opts,
+                     size_t          opt_count) {
+
+   FaultConfig* cfg = (FaultConfig*)calloc(1, sizeof(FaultConfig));
+   size_t       my_count;
+   if (! cfg) {
+      LOG(LOG_ERR, "couldn't allocate FaultConfig\n");
+      return -1;
+   }
+   struct timespec now;
+   clock_gettime(CLOCK_REALTIME, &now);
+   cfg->seed = ((uint64_t)now.tv_sec * 1000000000ULL) + now.tv_nsec + getpid();
+
+   int i;
+   for (i=0; i<FOP_COUNT; ++i)
+      cfg->op[i].err = EIO;
+
+   if (wrapper_dal_config(dal, opts, opt_count, &cfg->backend, &my_count))
+      return -1;
+
+   for (i=0; i<my_count; ++i) {
+      const char* key = opts[i]->key;
+      const char* val = opts[i]->val.value.str;
+
+      if (! strcmp(key, "seed"))
+         cfg->seed = strtoull(val, NULL, 10);
+      else if (! strcmp(key, "bandwidth"))
+         cfg->bandwidth = strtoull(val, NULL, 10);
+      else if (! strcmp(key, "timeout_ms"))
+         cfg->timeout_ms = strtoul(val, NULL, 10);
+      else {
+         int rc = fault_op_opt(cfg, key, val);
+         if (rc < 0) {
+            LOG(LOG_ERR, "Bad value for FAULT DAL option %s: %s\n", key, val);
+            return -1;
+         }
+         else if (! rc) {
+            LOG(LOG_ERR, "Unrecognized FAULT DAL config option: %s\n", key);
+            return -1;
+         }
+      }
+      LOG(LOG_INFO, "parsing fault option \"%s\" = %s\n", key, val);
+   }
+   for (i=0; i<my_count; ++i)
+      free(opts[i]);
+   free(opts);
+
+   dal->global_state = cfg;
+   return 0;
+}
+
+
+static
+void fault_sleep(double ms) {
+   if (ms <= 0)
+      return;
+   struct timespec ts;
+   ts.tv_sec  = (time_t)(ms / 1000);
+   ts.tv_nsec = (long)((ms - (ts.tv_sec * 1000.0)) * 1000000);
+   while (nanosleep(&ts, &ts) && (errno == EINTR))
+      ;
+}
+
+// draw a latency (msec) for <fo>
+static
+double fault_latency(FaultDal_Context* fc, const FaultOp* fo) {
+   double u = erand48(fc->rand);
+
+   switch (fo->dist) {
+   case FD_FIXED:     return fo->a;
+   case FD_UNIFORM:   return fo->a + (u * (fo->b - fo->a));
+   case FD_EXP:       return -fo->a * log(1.0 - u);
+   case FD_PARETO:    return fo->a / pow(1.0 - u, 1.0 / fo->b);
+   case FD_LOGNORMAL: {
+      // Box-Muller
+      double v = erand48(fc->rand);
+      double z = sqrt(-2.0 * log(1.0 - u)) * cos(2.0 * 3.14159265358979323846 * v);
+      return fo->a * exp(fo->b * z);
+   }
+   default:           return 0;
+   }
+}
+
+// Apply the configured latency for <op>, then maybe fail.  Returns 0 if
+// the op should go ahead, or -1 with errno.
+static
+int fault_inject(DAL_Context* ctx, FaultOpType op) {
+   FaultDal_Context* fc = FAULT_CONTEXT(ctx);
+   const FaultOp*    fo = &fc->config->op[op];
+
+   if (fo->dist)
+      fault_sleep(fault_latency(fc, fo));
+
+   if (! fo->timeout && ! fo->error)
+      return 0;
+
+   double u = erand48(fc->rand);
+   if (u < fo->timeout) {
+      uint32_t ms = fc->config->timeout_ms;
+      if (! ms)
+         ms = (fc->timeout ? (fc->timeout * 1000) : FAULT_DEFAULT_TIMEOUT_MS);
+      LOG(LOG_INFO, "FAULT: %s times out, after %u ms\n", fault_op_name[op], ms);
+      fault_sleep(ms);
+      errno = ETIMEDOUT;
+      return -1;
+   }
+   if (u < (fo->timeout + fo->error)) {
+      LOG(LOG_INFO, "FAULT: %s fails, errno %d\n", fault_op_name[op], fo->err);
+      errno = fo->err;
+      return -1;
+   }
+   return 0;
+}
+
+// hold the stream to the configured bandwidth, after moving <size> more
+static
+void fault_throttle(DAL_Context* ctx, ssize_t size) {
+   FaultDal_Context* fc = FAULT_CONTEXT(ctx);
+   size_t            bw = fc->config->bandwidth;
+   if (! bw || (size <= 0))
+      return;
+
+   fc->moved += size;
+
+   struct timespec now;
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   double elapsed = (((now.tv_sec - fc->start.tv_sec) * 1000.0)
+                     + ((now.tv_nsec - fc->start.tv_nsec) / 1000000.0));
+   double due     = (fc->moved * 1000.0) / bw;
+   fault_sleep(due - elapsed);
+}
+
+
+int fault_dal_ctx_init(DAL_Context* ctx, struct DAL* dal, void* fh) {
+   TRY_DECLS();
+
+   ctx->flags    = 0;
+   ctx->data.ptr = calloc(1, sizeof(FaultDal_Context));
+   if (! ctx->data.ptr) {
+      LOG(LOG_ERR, "couldn't allocate FaultDal_Context\n");
+      errno = ENOMEM;
+      return -1;
+   }
+   FaultDal_Context* fc = FAULT_CONTEXT(ctx);
+   fc->config = (const FaultConfig*)dal->global_state;
+   fc->fh     = (MarFS_FileHandle*)fh;
+
+   uint64_t seed = fc->config->seed
+      + (__sync_fetch_and_add(&fault_ctx_count, 1) * 0x9e3779b97f4a7c15ULL);
+   fc->rand[0] = (unsigned short)(seed);
+   fc->rand[1] = (unsigned short)(seed >> 16);
+   fc->rand[2] = (unsigned short)(seed >> 32);
+
+   TRY0( (*FAULT_DAL(ctx)->init)(FAULT_INNER(ctx), FAULT_DAL(ctx), fh) );
+   return 0;
+}
+
+int fault_dal_ctx_destroy(DAL_Context* ctx, struct DAL* dal) {
+   int rc = 0;
+   if (FAULT_CONTEXT(ctx)) {
+      dal_async_free(FAULT_INNER(ctx));
+      rc = (*FAULT_DAL(ctx)->destroy)(FAULT_INNER(ctx), FAULT_DAL(ctx));
+      free(FAULT_CONTEXT(ctx));
+      ctx->data.ptr = NULL;
+   }
+   return rc;
+}
+
+int fault_dal_update_object_location(DAL_Context* ctx) {
+   return FAULT_OP(update_object_location, ctx);
+}
+
+int fault_dal_open(DAL_Context* ctx,
+                   int          is_put,
+                   size_t       chunk_offset,
+                   size_t       content_length,
+                   uint8_t      preserve_write_count,
+                   uint16_t     timeout) {
+   FaultDal_Context* fc = FAULT_CONTEXT(ctx);
+
+   fc->timeout = timeout;
+   fc->moved   = 0;
+   if (fault_inject(ctx, FOP_OPEN))
+      return -1;
+
+   clock_gettime(CLOCK_MONOTONIC, &fc->start);
+   return FAULT_OP(open, ctx, is_put, chunk_offset, content_length,
+                   preserve_write_count, timeout);
+}
+
+int fault_dal_put(DAL_Context* ctx, const char* buf, size_t size) {
+   if (fault_inject(ctx, FOP_PUT))
+      return -1;
+
+   int rc = FAULT_OP(put, ctx, buf, size);
+   fault_throttle(ctx, rc);
+   return rc;
+}
+
+ssize_t fault_dal_get(DAL_Context* ctx, char* buf, size_t size) {
+   if (fault_inject(ctx, FOP_GET))
+      return -1;
+
+   ssize_t rc = FAULT_OP(get, ctx, buf, size);
+   fault_throttle(ctx, rc);
+   return rc;
+}
+
+int fault_dal_sync(DAL_Context* ctx) {
+   if (fault_inject(ctx, FOP_SYNC))
+      return -1;
+   return FAULT_OP(sync, ctx);
+}
+
+int fault_dal_abort(DAL_Context* ctx) {
+   return FAULT_OP(abort, ctx);
+}
+
+int fault_dal_close(DAL_Context* ctx) {
+   return FAULT_OP(close, ctx);
+}
+
+// del_many() is the default, which comes back through here, so each
+// object in a batch gets its own chance to fail.
+int fault_dal_delete(DAL_Context* ctx) {
+   if (fault_inject(ctx, FOP_DEL))
+      return -1;
+   return FAULT_OP(del, ctx);
+}
+
+
+
+DAL fault_dal = {
+   .name         = "FAULT",
+   .name_len     = 5,
+
+   .global_state = NULL,
+
+   .config       = &fault_dal_config,
+   .init         = &fault_dal_ctx_init,
+   .destroy      = &fault_dal_ctx_destroy,
+
+   .open         = &fault_dal_open,
+   .put          = &fault_dal_put,
+   .get          = &fault_dal_get,
+   .sync         = &fault_dal_sync,
+   .abort        = &fault_dal_abort,
+   .close        = &fault_dal_close,
+   .del          = &fault_dal_delete,
+
+   .update_object_location = &fault_dal_update_object_location
+};
+
+
+
+
+// ===========================================================================
+// POSIX_EC
+// ===========================================================================
+//
+// Erasure-coded objects on plain directories, without libne.  Each object
+// is striped across N+E block-files, one in each of N+E directories (which
+// would be separate file-systems, standing in for MC pods or caps).  The
+// repo's host is a path with one "%d", which gets the block-directory
+// number:
+//
+//   <repo name="ec">
+//     <host>/scratch/ec/block%d</host>
+//     <dal>
+//       <type>POSIX_EC</type>
+//       <opt> <key_val> n                : 10        </key_val> </opt>
+//       <opt> <key_val> e                : 2         </key_val> </opt>
+//       <opt> <key_val> stripe_unit      : bytes     </key_val> </opt>  default 64KB
+//       <opt> <key_val> degraded_log_dir : path      </key_val> </opt>
+//     </dal>
+//   </repo>
+//
+// Object data is dealt out to the N data-blocks stripe_unit bytes at a
+// time, and each stripe gets E parity units, from rs_codec.c.  Each unit is
+// followed by its CRC32C in the block-file, so corrupt units are found and
+// treated like missing ones.  As in MC, the first block of an object goes
+// in directory <start_block> (from the objid hash), and so on, mod N+E.
+//
+//   block-file:  [header][unit 0][crc 0][unit 1][crc 1] ...
+//
+// The header has the object's length, which reads use to find the end.
+// Reads that find up to E bad blocks reconstruct the data, and, like MC,
+// add a line to the degraded-object log.  Error-pattern bits there are by
+// position in the stripe (bit 0 is the first data block).  The path
+// template is the <host> path with the block-number left as "%d".
+// ===========================================================================
+
+// shared with MC, below
+static int open_degraded_object_log(const char *log_dir_path) {
+   char log_path[PATH_MAX];
+   char host_name[HOST_NAME_MAX];
+   if(gethostname(host_name, HOST_NAME_MAX)) {
+      LOG(LOG_ERR, "gethostname() failed.\n");
+      return -1;
+   }
+   pid_t pid = getpid();
+   unsigned int pid_scatter = pid % MC_LOG_SCATTER_WIDTH;
+
+   sprintf(log_path, "%s/%s", log_dir_path, host_name);
+   int res = mkdir(log_path, 0777);
+   // avoid problems with umask
+   if(res == 0) {
+      chmod(log_path, 0777);
+   }
+   sprintf(log_path, "%s/%s/%u", log_dir_path, host_name, pid_scatter);
+   res = mkdir(log_path, 0777);
+   if(res == 0) {
+      chmod(log_path, 0777);
+   }
+
+   // I'm ignoring the results of mkdir() since the directory might
+   // already exist, in which case it would return an error. If
+   // something went wrong and the directory doesn't exist and
+   // couldn't be created then we will catch it when we try to open
+   // the file below.
+
+   sprintf(log_path, "%s/%s/%u/degraded_objects.%u", log_dir_path, host_name,
+           pid_scatter, pid);
+   int fd = open(log_path, O_CREAT|O_APPEND|O_WRONLY,
+                 S_IWUSR|S_IWGRP|S_IWOTH);
+   // TBD: fchown the file so it is owned by root? Then we can have
+   //      read permissions on for the owner. For now we can get awy
+   //      with no read permission since root can read anything and
+   //      the rebuild utility will be run by an admin.
+   if(fd < 0) {
+      LOG(LOG_ERR, "Failed to open degraded object log (%s): %s\n",
+          log_path, strerror(errno));
+   }
+   else {
+      // If we successfully opened the file, the try to chmod it,
+      // since we might have created it. If the file exists this is
+      // wasted effort, but there isn't an easy way to tell whether
+      // open created it without also doing a stat().
+      chmod(log_path, S_IWUSR|S_IWGRP|S_IWOTH);
+   }
+      
+   return fd;
+}
+
+
+#define EC_DEFAULT_UNIT    (64 * 1024)
+#define EC_MAX_UNIT        (64 * 1024 * 1024)
+#define EC_HDR_SIZE        64
+#define EC_HDR_MAGIC       0x4345524d     // "MREC"
+#define EC_HDR_VERSION     1
+#define EC_SCATTER         256
+
+typedef struct {
+   RS_Code           rs;
+   size_t            unit;
+   char*             degraded_log_path;
+   int               degraded_log_fd;
+   pthread_mutex_t   lock;              // for the degraded-log
+} PosixEcConfig;
+
+typedef struct {
+   MarFS_FileHandle*    fh;
+   const PosixEcConfig* config;
+   char                 path_template[MC_MAX_PATH_LEN];
+   int                  start_block;
+   int                  fd[RS_MAX_BLOCKS];  // by position in the stripe
+   uint32_t             failed;             // blocks we've given up on
+   uint32_t             err_pattern;        // blocks with any error
+   char*                stripe_buf;         // N+E units
+   size_t               fill;               // writing: data bytes in stripe_buf
+   size_t               stripe;             // next to write, or the one in stripe_buf
+   uint32_t             valid;              // reading: units of <stripe> in stripe_buf
+   size_t               length;             // object length
+   size_t               pos;                // reading
+   size_t               end;
+} PosixEc_Context;
+
+#define EC_CONTEXT(CTX)  ((PosixEc_Context*)((CTX)->data.ptr))
+#define EC_OS(CTX)       (&EC_CONTEXT(CTX)->fh->os)
+#define EC_N(EC)         ((EC)->config->rs.n)
+#define EC_E(EC)         ((EC)->config->rs.e)
+#define EC_UNIT(EC)      ((EC)->config->unit)
+
+
+static inline
+void ec_put32(char* p, uint32_t v) {
+   int i;
+   for (i=0; i<4; ++i)
+      p[i] = (char)(v >> (8 * i));
+}
+static inline
+uint32_t ec_get32(const char* p) {
+   uint32_t v = 0;
+   int      i;
+   for (i=0; i<4; ++i)
+      v |= ((uint32_t)(uint8_t)p[i]) << (8 * i);
+   return v;
+}
+static inline
+void ec_put64(char* p, uint64_t v) {
+   ec_put32(p,     (uint32_t)v);
+   ec_put32(p + 4, (uint32_t)(v >> 32));
+}
+static inline
+uint64_t ec_get64(const char* p) {
+   return ec_get32(p) | ((uint64_t)ec_get32(p + 4) << 32);
+}
+
+static inline
+off_t ec_unit_offset(const PosixEc_Context* ec, size_t stripe) {
+   return EC_HDR_SIZE + (stripe * (EC_UNIT(ec) + 4));
+}
+
+
+int posix_ec_config(struct DAL*     dal,
+                    xDALConfigOpt** opts,
+                    size_t          opt_count) {
+
+   PosixEcConfig* cfg = (PosixEcConfig*)calloc(1, sizeof(PosixEcConfig));
+   if (! cfg) {
+      LOG(LOG_ERR, "couldn't allocate PosixEcConfig\n");
+      return -1;
+   }
+   cfg->unit            = EC_DEFAULT_UNIT;
+   cfg->degraded_log_fd = -1;
+   pthread_mutex_init(&cfg->lock, NULL);
+
+   int n = 0;
+   int e = 0;
+   int i;
+   for (i=0; i<opt_count; ++i) {
+      const char* key = opts[i]->key;
+      const char* val = opts[i]->val.value.str;
+
+      if (! strcmp(key, "n"))
+         n = strtol(val, NULL, 10);
+      else if (! strcmp(key, "e"))
+         e = strtol(val, NULL, 10);
+      else if (! strcmp(key, "stripe_unit"))
+         cfg->unit = strtoull(val, NULL, 10);
+      else if (! strcmp(key, "degraded_log_dir"))
+         cfg->degraded_log_path = strdup(val);
+      else {
+         LOG(LOG_ERR, "Unrecognized POSIX_EC DAL config option: %s\n", key);
+         return -1;
+      }
+      LOG(LOG_INFO, "parsing posix_ec option \"%s\" = %s\n", key, val);
+   }
+   free_xdal_config_options(opts);
+
+   if (rs_init(&cfg->rs, n, e)) {
+      LOG(LOG_ERR, "POSIX_EC: bad n+e (%d+%d).  Max is %d blocks\n",
+          n, e, RS_MAX_BLOCKS);
+      return -1;
+   }
+   if ((cfg->unit < 512) || (cfg->unit > EC_MAX_UNIT)) {
+      LOG(LOG_ERR, "POSIX_EC: stripe_unit %lu out of range\n", cfg->unit);
+      return -1;
+   }
+   if (! cfg->degraded_log_path) {
+      LOG(LOG_ERR, "no degraded_log_dir specified for DAL '%s'.\n", dal->name);
+      return -1;
+   }
+   LOG(LOG_INFO, "POSIX_EC %d+%d, unit %lu, codec %s\n", n, e, cfg->unit, rs_impl());
+
+   dal->global_state = cfg;
+   return 0;
+}
+
+
+int posix_ec_ctx_init(DAL_Context* ctx, struct DAL* dal, void* fh) {
+   ctx->flags    = 0;
+   ctx->data.ptr = calloc(1, sizeof(PosixEc_Context));
+   if (! ctx->data.ptr) {
+      LOG(LOG_ERR, "couldn't allocate PosixEc_Context\n");
+      errno = ENOMEM;
+      return -1;
+   }
+   PosixEc_Context* ec = EC_CONTEXT(ctx);
+   ec->fh     = (MarFS_FileHandle*)fh;
+   ec->config = (const PosixEcConfig*)dal->global_state;
+
+   int i;
+   for (i=0; i<RS_MAX_BLOCKS; ++i)
+      ec->fd[i] = -1;
+   return 0;
+}
+
+static
+void ec_close_fds(PosixEc_Context* ec) {
+   int i;
+   for (i=0; i<RS_MAX_BLOCKS; ++i) {
+      if (ec->fd[i] >= 0)
+         close(ec->fd[i]);
+      ec->fd[i] = -1;
+   }
+}
+
+int posix_ec_ctx_destroy(DAL_Context* ctx, struct DAL* dal) {
+   PosixEc_Context* ec = EC_CONTEXT(ctx);
+   if (ec) {
+      ec_close_fds(ec);
+      free(ec->stripe_buf);
+      free(ec);
+      ctx->data.ptr = NULL;
+   }
+   return 0;
+}
+
+
+// "<host>/<xx>/<flattened objid>", with the host's "%d" left in.
+int posix_ec_update_path(DAL_Context* ctx) {
+   PosixEc_Context*  ec    = EC_CONTEXT(ctx);
+   const MarFS_Repo* repo  = ec->fh->info.pre.repo;
+   const char*       objid = ec->fh->info.pre.objid;
+
+   char obj_filename[MARFS_MAX_OBJID_SIZE];
+   strncpy(obj_filename, objid, MARFS_MAX_OBJID_SIZE);
+   obj_filename[MARFS_MAX_OBJID_SIZE -1] = 0;
+   flatten_objid(obj_filename);
+
+   uint64_t hash = polyhash(objid);
+   ec->start_block = hash % (EC_N(ec) + EC_E(ec));
+
+   int len = snprintf(ec->path_template, MC_MAX_PATH_LEN, "%s/%02x/%s",
+                      repo->host, (unsigned)((hash >> 16) % EC_SCATTER),
+                      obj_filename);
+   if (len >= MC_MAX_PATH_LEN) {
+      errno = ENAMETOOLONG;
       return -1;
    }
+   LOG(LOG_INFO, "POSIX_EC path template: (starting block: %d) %s\n",
+       ec->start_block, ec->path_template);
+   return 0;
+}
 
-   TRY0( stream_cleanup_for_reopen(POSIX_DAL_OS(ctx), preserve_write_count) );
+// path of the block-file at stripe-position <i>
+static
+void ec_block_path(const PosixEc_Context* ec, int i, char* path) {
+   int dir = (ec->start_block + i) % (EC_N(ec) + EC_E(ec));
+   snprintf(path, MC_MAX_PATH_LEN, ec->path_template, dir);
+}
 
-   char*        object_path = POSIX_DAL_PATH(ctx);
-   int          object_flags;
-   const mode_t mode        = S_IRUSR|S_IWUSR;
 
-   if(is_put) {
-      POSIX_DAL_OS(ctx)->flags |= OSF_WRITING;
-      object_flags = O_WRONLY|O_CREAT;
-   }
-   else {
-      POSIX_DAL_OS(ctx)->flags |= OSF_READING;
-      object_flags = O_RDONLY;
+static
+void ec_fail_block(PosixEc_Context* ec, int i, const char* what) {
+   LOG(LOG_ERR, "POSIX_EC: %s failed for block %d of %s: %s\n",
+       what, i, ec->path_template, strerror(errno));
+   ec->failed      |= (1u << i);
+   ec->err_pattern |= (1u << i);
+   if (ec->fd[i] >= 0)
+      close(ec->fd[i]);
+   ec->fd[i] = -1;
+}
+
+static
+int ec_too_many(const PosixEc_Context* ec, uint32_t pattern) {
+   if (__builtin_popcount(pattern) > EC_E(ec)) {
+      LOG(LOG_ERR, "POSIX_EC: too many bad blocks (0x%x) for %s\n",
+          pattern, ec->path_template);
+      errno = EIO;
+      return 1;
    }
+   return 0;
+}
 
-   int fd = open(object_path, object_flags, mode);
-   if(fd < 0) {
-      LOG(LOG_ERR, "Failed to open file with posix_dal: %s\n", object_path);
+static
+int ec_read_hdr(PosixEc_Context* ec, int i) {
+   char hdr[EC_HDR_SIZE];
+   if (pread(ec->fd[i], hdr, EC_HDR_SIZE, 0) != EC_HDR_SIZE) {
+      if (! errno)
+         errno = EIO;
       return -1;
    }
+   if ((ec_get32(hdr)      != EC_HDR_MAGIC)
+       || (ec_get32(hdr + 60) != crc32c(0, hdr, 60))
+       || (ec_get32(hdr + 8)  != EC_N(ec))
+       || (ec_get32(hdr + 12) != EC_E(ec))
+       || (ec_get32(hdr + 16) != EC_UNIT(ec))
+       || (ec_get32(hdr + 20) != i)) {
+      errno = EIO;
+      return -1;
+   }
+   ec->length = ec_get64(hdr + 24);
+   return 0;
+}
 
-   if (chunk_offset) {
-      off_t rc = lseek(fd, chunk_offset, SEEK_SET);
-      if (rc == (off_t)-1) {
-         LOG(LOG_ERR, "lseek(%ld) faild for posix_dal: %s\n",
-             chunk_offset, object_path);
+static
+int ec_write_hdr(PosixEc_Context* ec, int i) {
+   char hdr[EC_HDR_SIZE];
+   memset(hdr, 0, EC_HDR_SIZE);
+   ec_put32(hdr,      EC_HDR_MAGIC);
+   ec_put32(hdr + 4,  EC_HDR_VERSION);
+   ec_put32(hdr + 8,  EC_N(ec));
+   ec_put32(hdr + 12, EC_E(ec));
+   ec_put32(hdr + 16, (uint32_t)EC_UNIT(ec));
+   ec_put32(hdr + 20, i);
+   ec_put64(hdr + 24, ec->length);
+   ec_put32(hdr + 60, crc32c(0, hdr, 60));
+   return ((pwrite(ec->fd[i], hdr, EC_HDR_SIZE, 0) == EC_HDR_SIZE) ? 0 : -1);
+}
+
+
+int posix_ec_open(DAL_Context* ctx,
+                  int          is_put,
+                  size_t       chunk_offset,
+                  size_t       content_length,
+                  uint8_t      preserve_write_count,
+                  uint16_t     timeout) {
+   TRY_DECLS();
+   PosixEc_Context* ec    = EC_CONTEXT(ctx);
+   ObjectStream*    os    = EC_OS(ctx);
+   const int        total = EC_N(ec) + EC_E(ec);
+   char             path[MC_MAX_PATH_LEN];
+   int              i;
+
+   TRY0( stream_cleanup_for_reopen(os, preserve_write_count) );
+
+   if (! ec->stripe_buf) {
+      ec->stripe_buf = (char*)malloc(total * EC_UNIT(ec));
+      if (! ec->stripe_buf) {
+         errno = ENOMEM;
          return -1;
       }
    }
+   ec_close_fds(ec);
+   ec->failed      = 0;
+   ec->err_pattern = 0;
+   ec->fill        = 0;
+   ec->stripe      = 0;
+   ec->valid       = 0;
+   ec->length      = 0;
+
+   for (i=0; i<total; ++i) {
+      ec_block_path(ec, i, path);
+      if (is_put) {
+         // the block directory is the mount; we make the scatter dir
+         char* slash = strrchr(path, '/');
+         *slash = 0;
+         int rc = posix_mkdirs(path, strlen(path));
+         *slash = '/';
+         ec->fd[i] = (rc ? -1 : open(path, O_WRONLY|O_CREAT|O_TRUNC, S_IRUSR|S_IWUSR));
+      }
+      else
+         ec->fd[i] = open(path, O_RDONLY);
 
-   POSIX_DAL_FD(ctx) = fd;
-   POSIX_DAL_OS(ctx)->flags |= OSF_OPEN;
+      if (ec->fd[i] < 0)
+         ec_fail_block(ec, i, "open");
+      else if (! is_put && ! ec->length && ec_read_hdr(ec, i))
+         ec_fail_block(ec, i, "header");
+   }
+   if (ec_too_many(ec, ec->failed)) {
+      ec_close_fds(ec);
+      return -1;
+   }
 
-   EXIT();
+   if (is_put)
+      os->flags |= OSF_WRITING;
+   else {
+      ec->pos = chunk_offset;
+      ec->end = ec->length;
+      if (content_length && (chunk_offset + content_length < ec->end))
+         ec->end = chunk_offset + content_length;
+      ec->stripe = (size_t)-1;
+      os->flags |= OSF_READING;
+   }
+   os->flags |= OSF_OPEN;
    return 0;
 }
 
-int posix_dal_put(DAL_Context* ctx, const char* buf, size_t size) {
-   int written = write(POSIX_DAL_FD(ctx), buf, size);
 
-   if(written >= 0)
-      POSIX_DAL_OS(ctx)->written += written;
+// encode the stripe in stripe_buf, and write each unit, with its CRC
+static
+int ec_write_stripe(PosixEc_Context* ec) {
+   const int total = EC_N(ec) + EC_E(ec);
+   size_t    unit  = EC_UNIT(ec);
+   uint8_t*  blocks[RS_MAX_BLOCKS];
+   int       i;
+
+   if (ec->fill < (EC_N(ec) * unit))
+      memset(ec->stripe_buf + ec->fill, 0, (EC_N(ec) * unit) - ec->fill);
+
+   for (i=0; i<total; ++i)
+      blocks[i] = (uint8_t*)ec->stripe_buf + (i * unit);
+   rs_encode(&ec->config->rs, blocks, unit);
+
+   off_t off = ec_unit_offset(ec, ec->stripe);
+   for (i=0; i<total; ++i) {
+      if (ec->failed & (1u << i))
+         continue;
+
+      char         crc[4];
+      struct iovec iov[2] = {
+         { .iov_base = blocks[i], .iov_len = unit },
+         { .iov_base = crc,       .iov_len = 4    },
+      };
+      ec_put32(crc, crc32c(0, blocks[i], unit));
+      if (pwritev(ec->fd[i], iov, 2, off) != (unit + 4))
+         ec_fail_block(ec, i, "write");
+   }
 
-   return written;
+   ec->fill = 0;
+   ec->stripe += 1;
+   return (ec_too_many(ec, ec->failed) ? -1 : 0);
 }
 
-ssize_t posix_dal_get(DAL_Context* ctx, char* buf, size_t size) {
-   ssize_t size_read = 0;
-
-   size_read = read(POSIX_DAL_FD(ctx), buf, size);
-   if(size_read == 0) {
-      POSIX_DAL_OS(ctx)->flags |= OSF_EOF;
-   }
-   else if(size_read < 0) {
-      return size_read; // relying on errno set by read
+int posix_ec_put(DAL_Context* ctx, const char* buf, size_t size) {
+   PosixEc_Context* ec     = EC_CONTEXT(ctx);
+   ObjectStream*    os     = EC_OS(ctx);
+   size_t           stripe = EC_N(ec) * EC_UNIT(ec);
+   size_t           done   = 0;
+
+   while (done < size) {
+      size_t move = stripe - ec->fill;
+      if (move > (size - done))
+         move = size - done;
+      memcpy(ec->stripe_buf + ec->fill, buf + done, move);
+      ec->fill   += move;
+      ec->length += move;
+      done       += move;
+
+      if ((ec->fill == stripe)
+          && ec_write_stripe(ec)) {
+         os->flags |= OSF_ERRORS;
+         return -1;
+      }
    }
+   os->written += size;
+   return size;
+}
 
-   POSIX_DAL_OS(ctx)->written += size_read;
 
-   return size_read;
+// read unit <i> of ec->stripe into stripe_buf, and check its CRC
+static
+int ec_read_unit(PosixEc_Context* ec, int i) {
+   size_t       unit = EC_UNIT(ec);
+   char         crc[4];
+   char*        dest = ec->stripe_buf + (i * unit);
+   struct iovec iov[2] = {
+      { .iov_base = dest, .iov_len = unit },
+      { .iov_base = crc,  .iov_len = 4    },
+   };
+
+   errno = 0;
+   ssize_t rc = preadv(ec->fd[i], iov, 2, ec_unit_offset(ec, ec->stripe));
+   if (rc != (unit + 4)) {
+      ec_fail_block(ec, i, "read");
+      return -1;
+   }
+   if (ec_get32(crc) != crc32c(0, dest, unit)) {
+      LOG(LOG_ERR, "POSIX_EC: CRC mismatch in block %d, stripe %lu of %s\n",
+          i, ec->stripe, ec->path_template);
+      ec->err_pattern |= (1u << i);
+      return -1;
+   }
+   return 0;
 }
 
-static int close_posix_object(DAL_Context* ctx) {
-   TRY_DECLS();
+// Make units [first, last] of stripe <stripe> valid in stripe_buf.  If
+// any of them can't be read, read everything else we can, and decode.
+static
+int ec_fill_stripe(PosixEc_Context* ec, size_t stripe, int first, int last) {
+   const int total = EC_N(ec) + EC_E(ec);
+   uint32_t  bad   = 0;
+   int       i;
+
+   if (ec->stripe != stripe) {
+      ec->stripe = stripe;
+      ec->valid  = 0;
+   }
+   for (i=first; i<=last; ++i) {
+      if (ec->valid & (1u << i))
+         continue;
+      if ((ec->failed & (1u << i)) || ec_read_unit(ec, i))
+         bad |= (1u << i);
+      else
+         ec->valid |= (1u << i);
+   }
+   if (! bad)
+      return 0;
 
-   TRY0( close(POSIX_DAL_FD(ctx)) );
-   POSIX_DAL_OS(ctx)->flags &= ~OSF_OPEN;
-   POSIX_DAL_OS(ctx)->flags |= OSF_CLOSED;
-   // prevent future mistakes by clearing out the file descriptor.
-   POSIX_DAL_FD(ctx) = -1;
+   // degraded
+   for (i=0; i<total; ++i) {
+      if ((ec->valid | bad) & (1u << i))
+         continue;
+      if ((ec->failed & (1u << i)) || ec_read_unit(ec, i))
+         bad |= (1u << i);
+      else
+         ec->valid |= (1u << i);
+   }
+   uint32_t erased = ~ec->valid & ((1u << total) - 1);
+   if (ec_too_many(ec, erased))
+      return -1;
+
+   uint8_t* blocks[RS_MAX_BLOCKS];
+   for (i=0; i<total; ++i)
+      blocks[i] = (uint8_t*)ec->stripe_buf + (i * EC_UNIT(ec));
+   if (rs_decode(&ec->config->rs, blocks, erased, EC_UNIT(ec)))
+      return -1;
 
+   ec->valid = (1u << total) - 1;
    return 0;
 }
 
-// See comments on stream_sync. When this returns, all I/O (ever) is
-// completed. No more I/O errors are possible. There should be no more
-// operations done on the stream at this point.
-int posix_dal_sync(DAL_Context* ctx) {
-   TRY_DECLS();
+ssize_t posix_ec_get(DAL_Context* ctx, char* buf, size_t size) {
+   PosixEc_Context* ec     = EC_CONTEXT(ctx);
+   ObjectStream*    os     = EC_OS(ctx);
+   size_t           unit   = EC_UNIT(ec);
+   size_t           stripe = EC_N(ec) * unit;
+   size_t           done   = 0;
 
-   // fsync will set errno = EBADF if the fd is not open. In order to
-   // be consistent with stream_sync, we detect that case and fail
-   // with EINVAL instead.
-   if(! (POSIX_DAL_OS(ctx)->flags & OSF_OPEN)) {
-      LOG(LOG_ERR, "%s isn't open\n", POSIX_DAL_OS(ctx)->url);
-      errno = EINVAL;
+   if (! (os->flags & OSF_OPEN)) {
+      LOG(LOG_ERR, "Attempted get on OS that is not open.\n");
+      errno = EBADF;
       return -1;
    }
 
-   TRY0( fsync(POSIX_DAL_FD(ctx)) );
+   while ((done < size) && (ec->pos < ec->end)) {
+      size_t s     = ec->pos / stripe;
+      size_t in    = ec->pos % stripe;
+      size_t avail = stripe - in;
+      if (avail > (ec->end - ec->pos))
+         avail = ec->end - ec->pos;
+      if (avail > (size - done))
+         avail = size - done;
+
+      if (ec_fill_stripe(ec, s, in / unit, (in + avail - 1) / unit)) {
+         os->flags |= OSF_ERRORS;
+         return -1;
+      }
+      memcpy(buf + done, ec->stripe_buf + in, avail);
+      done    += avail;
+      ec->pos += avail;
+   }
 
-   // Since close might cause an error we do it here.
-   TRY0( close_posix_object(ctx) );
+   if (! done)
+      os->flags |= OSF_EOF;
+   os->written += done;
+   return done;
+}
 
-   return 0;
+
+// add a line for this object to the degraded-object log
+static
+void ec_log_degraded(DAL_Context* ctx) {
+   PosixEc_Context* ec  = EC_CONTEXT(ctx);
+   PosixEcConfig*   cfg = (PosixEcConfig*)ec->config;
+   char             buf[MC_MAX_LOG_LEN];
+
+   LOG(LOG_INFO, "WARNING: Object %s degraded. Error pattern: 0x%x."
+       " (N: %d, E: %d, Start: %d).\n",
+       ec->path_template, ec->err_pattern,
+       EC_N(ec), EC_E(ec), ec->start_block);
+
+   snprintf(buf, MC_MAX_LOG_LEN, MC_DEGRADED_LOG_FORMAT,
+            ec->path_template, EC_N(ec), EC_E(ec),
+            ec->start_block, ec->err_pattern,
+            ec->fh->info.pre.repo->name, 0, 0);
+
+   pthread_mutex_lock(&cfg->lock);
+   if (cfg->degraded_log_fd == -1) {
+      cfg->degraded_log_fd = open_degraded_object_log(cfg->degraded_log_path);
+      if (cfg->degraded_log_fd < 0)
+         LOG(LOG_ERR, "failed to open degraded log file\n");
+   }
+   if ((cfg->degraded_log_fd >= 0)
+       && (write(cfg->degraded_log_fd, buf, strlen(buf)) != strlen(buf)))
+      LOG(LOG_ERR, "Failed to write to degraded object log\n");
+   pthread_mutex_unlock(&cfg->lock);
 }
 
-// Undo any writes that have been made since the "object" was opened.
-//
-// NOTE: Based on the use of this function, we are assuming that no
-//       data has been written to the object when this is called.
-//       In this case, this boils down to a no-op.
-int posix_dal_abort(DAL_Context* ctx) {
-   if(! (POSIX_DAL_OS(ctx)->flags & OSF_OPEN)) {
-      LOG(LOG_ERR, "POSIX_DAL: abort: %s isn't open", POSIX_DAL_OS(ctx)->url);
+// Upon return no more I/O is possible. The stream is closed.
+int posix_ec_sync(DAL_Context* ctx) {
+   PosixEc_Context* ec    = EC_CONTEXT(ctx);
+   ObjectStream*    os    = EC_OS(ctx);
+   const int        total = EC_N(ec) + EC_E(ec);
+   int              rc    = 0;
+   int              i;
+
+   if (! (os->flags & OSF_OPEN)) {
+      LOG(LOG_ERR, "%s isn't open\n", os->url);
       errno = EINVAL;
       return -1;
    }
 
-   POSIX_DAL_OS(ctx)->flags |= OSF_ABORT;
+   if (os->flags & OSF_WRITING) {
+      if (ec->fill && ec_write_stripe(ec))
+         rc = -1;
+      for (i=0; !rc && (i<total); ++i) {
+         if (ec->failed & (1u << i))
+            continue;
+         if (ec_write_hdr(ec, i) || fsync(ec->fd[i]))
+            ec_fail_block(ec, i, "sync");
+      }
+      if (! rc && ec_too_many(ec, ec->failed))
+         rc = -1;
+   }
 
-   // other than setting flags, this is a no-op.
+   if (! rc && ec->err_pattern)
+      ec_log_degraded(ctx);
 
-   return 0;
+   int err = errno;
+   ec_close_fds(ec);
+   os->flags &= ~OSF_OPEN;
+   os->flags |= OSF_CLOSED;
+   if (rc) {
+      os->flags |= OSF_ERRORS;
+      errno = err;
+   }
+   return rc;
 }
 
-int posix_dal_close(DAL_Context* ctx) {
-   TRY_DECLS();
-
-   // the file may have already been closed by _sync
-   if(! (POSIX_DAL_OS(ctx)->flags & OSF_OPEN)) {
-      return 0;
+int posix_ec_abort(DAL_Context* ctx) {
+   if (! (EC_OS(ctx)->flags & OSF_OPEN)) {
+      LOG(LOG_ERR, "POSIX_EC: abort: %s isn't open", EC_OS(ctx)->url);
+      errno = EINVAL;
+      return -1;
    }
-
-   TRY0( close_posix_object(ctx) );
-
+   EC_OS(ctx)->flags |= OSF_ABORT;
    return 0;
 }
 
-int posix_dal_delete(DAL_Context* ctx) {
-   TRY_DECLS();
-
-   return unlink(POSIX_DAL_PATH(ctx));
+int posix_ec_close(DAL_Context* ctx) {
+   ObjectStream* os = EC_OS(ctx);
+   if (os->flags & OSF_OPEN) {
+      ec_close_fds(EC_CONTEXT(ctx));
+      os->flags &= ~OSF_OPEN;
+      os->flags |= OSF_CLOSED;
+   }
+   return 0;
 }
 
+// Missing blocks are fine, unless they all are.
+int posix_ec_del(DAL_Context* ctx) {
+   PosixEc_Context* ec      = EC_CONTEXT(ctx);
+   const int        total   = EC_N(ec) + EC_E(ec);
+   char             path[MC_MAX_PATH_LEN];
+   int              missing = 0;
+   int              err     = 0;
+   int              i;
+
+   for (i=0; i<total; ++i) {
+      ec_block_path(ec, i, path);
+      if (! unlink(path))
+         continue;
+      if (errno == ENOENT)
+         ++missing;
+      else if (! err) {
+         err = errno;
+         LOG(LOG_ERR, "POSIX_EC: unlink(%s) failed: %s\n", path, strerror(err));
+      }
+   }
+   if (missing == total)
+      err = ENOENT;
+   if (err) {
+      errno = err;
+      return -1;
+   }
+   return 0;
+}
 
 
-DAL posix_dal = {
-   .name         = "POSIX",
-   .name_len     = 5,
+DAL posix_ec_dal = {
+   .name         = "POSIX_EC",
+   .name_len     = 8,
 
    .global_state = NULL,
 
-   .config       = &default_dal_config,
-   .init         = &posix_dal_ctx_init,
-   .destroy      = &posix_dal_ctx_destroy,
+   .config       = &posix_ec_config,
+   .init         = &posix_ec_ctx_init,
+   .destroy      = &posix_ec_ctx_destroy,
 
-   .open         = &posix_dal_open,
-   .put          = &posix_dal_put,
-   .get          = &posix_dal_get,
-   .sync         = &posix_dal_sync,
-   .abort        = &posix_dal_abort,
-   .close        = &posix_dal_close,
-   .del          = &posix_dal_delete,
+   .open         = &posix_ec_open,
+   .put          = &posix_ec_put,
+   .get          = &posix_ec_get,
+   .sync         = &posix_ec_sync,
+   .abort        = &posix_ec_abort,
+   .close        = &posix_ec_close,
+   .del          = &posix_ec_del,
 
-   .update_object_location = &generate_path
+   .update_object_location = &posix_ec_update_path
 };
 
 
@@ -649,6 +5145,11 @@ typedef struct mc_context {
    unsigned int      pod;
    unsigned int      cap;
    MC_Config         *config;
+
+   // partial stripe, accumulated by mc_put()
+   char*             stripe_buf;
+   size_t            stripe_size;
+   size_t            stripe_fill;
 } MC_Context;
 
 
@@ -661,58 +5162,6 @@ int mc_path_snprintf_sockets(char*       dest,
 
 
 
-static int open_degraded_object_log(const char *log_dir_path) {
-   char log_path[PATH_MAX];
-   char host_name[HOST_NAME_MAX];
-   if(gethostname(host_name, HOST_NAME_MAX)) {
-      LOG(LOG_ERR, "gethostname() failed.\n");
-      return -1;
-   }
-   pid_t pid = getpid();
-   unsigned int pid_scatter = pid % MC_LOG_SCATTER_WIDTH;
-
-   sprintf(log_path, "%s/%s", log_dir_path, host_name);
-   int res = mkdir(log_path, 0777);
-   // avoid problems with umask
-   if(res == 0) {
-      chmod(log_path, 0777);
-   }
-   sprintf(log_path, "%s/%s/%u", log_dir_path, host_name, pid_scatter);
-   res = mkdir(log_path, 0777);
-   if(res == 0) {
-      chmod(log_path, 0777);
-   }
-
-   // I'm ignoring the results of mkdir() since the directory might
-   // already exist, in which case it would return an error. If
-   // something went wrong and the directory doesn't exist and
-   // couldn't be created then we will catch it when we try to open
-   // the file below.
-
-   sprintf(log_path, "%s/%s/%u/degraded_objects.%u", log_dir_path, host_name,
-           pid_scatter, pid);
-   int fd = open(log_path, O_CREAT|O_APPEND|O_WRONLY,
-                 S_IWUSR|S_IWGRP|S_IWOTH);
-   // TBD: fchown the file so it is owned by root? Then we can have
-   //      read permissions on for the owner. For now we can get awy
-   //      with no read permission since root can read anything and
-   //      the rebuild utility will be run by an admin.
-   if(fd < 0) {
-      LOG(LOG_ERR, "Failed to open degraded object log (%s): %s\n",
-          log_path, strerror(errno));
-   }
-   else {
-      // If we successfully opened the file, the try to chmod it,
-      // since we might have created it. If the file exists this is
-      // wasted effort, but there isn't an easy way to tell whether
-      // open created it without also doing a stat().
-      chmod(log_path, S_IWUSR|S_IWGRP|S_IWOTH);
-   }
-      
-   return fd;
-}
-
-
 int mc_config(struct DAL*     dal,
               xDALConfigOpt** opts,
               size_t          opt_count) {
@@ -754,6 +5203,11 @@ int mc_config(struct DAL*     dal,
          LOG(LOG_INFO, "parsing mc option \"scatter_width\" = %d\n",
              config->scatter_width);
       }
+      else if(!strcmp(opts[i]->key, "stripe_unit")) {
+         config->stripe_unit = strtoul(opts[i]->val.value.str, NULL, 10);
+         LOG(LOG_INFO, "parsing mc option \"stripe_unit\" = %ld\n",
+             config->stripe_unit);
+      }
       else if(!strcmp(opts[i]->key, "degraded_log_dir")) {
          config->degraded_log_path = strdup(opts[i]->val.value.str);
          LOG(LOG_INFO, "parsing mc option \"degraded_log_path\" = %s\n",
@@ -810,6 +5264,9 @@ int mc_config(struct DAL*     dal,
       }
    }
 
+   if(! config->stripe_unit)
+      config->stripe_unit = MC_DEFAULT_STRIPE_UNIT;
+
    if(config->degraded_log_path == NULL) {
       LOG(LOG_ERR, "no degraded_log_dir specified for DAL '%s'.\n", dal->name);
       return -1;
@@ -917,6 +5374,7 @@ int mc_init(DAL_Context* ctx, struct DAL* dal, void* fh) {
 // Free the multi-component context stored in the dal context.
 // `ctx' should not be used any more after this is called.
 int mc_destroy(DAL_Context *ctx, struct DAL* dal) {
+   free(MC_CONTEXT(ctx)->stripe_buf);
    free(MC_CONTEXT(ctx));
    return 0;
 }
@@ -1131,6 +5589,7 @@ int mc_open(DAL_Context* ctx,
 
    os->flags  |= OSF_OPEN;
    MC_CONTEXT(ctx)->chunk_offset = chunk_offset;
+   MC_CONTEXT(ctx)->stripe_fill  = 0;
    
    EXIT();
    return 0;
@@ -1164,14 +5623,60 @@ int mc_put(DAL_Context* ctx,
      return -1;
    }
 
-   ne_handle handle = MC_HANDLE(ctx);
-   int written = ne_write(handle, buf, size);
+   // libne keeps partial stripes around, and computes parity on
+   // fragments, if ne_write() gets sizes that aren't a multiple of the
+   // stripe.  So we only give it whole stripes.  Whole stripes in
+   // caller's buffer go straight through.  Anything else is collected in
+   // stripe_buf.  mc_sync() writes whatever is left.
+   MC_Context* mc     = MC_CONTEXT(ctx);
+   ne_handle   handle = MC_HANDLE(ctx);
+
+   if (! mc->stripe_buf) {
+      mc->stripe_size = MC_CONFIG(ctx)->n * MC_CONFIG(ctx)->stripe_unit;
+      mc->stripe_buf  = (char*)malloc(mc->stripe_size);
+      if (! mc->stripe_buf) {
+         LOG(LOG_ERR, "couldn't allocate %ld-byte stripe buffer\n",
+             mc->stripe_size);
+         errno = ENOMEM;
+         return -1;
+      }
+   }
 
-   if(written < 0) {
-      LOG(LOG_ERR, "ftone_write() failed.\n");
-      os->flags |= OSF_ERRORS;
-      return -1;
+   const char* ptr  = buf;
+   size_t      left = size;
+   while (left) {
+      size_t direct = ((mc->stripe_fill)
+                       ? 0
+                       : left - (left % mc->stripe_size));
+      if (direct) {
+         if (ne_write(handle, ptr, direct) != direct) {
+            LOG(LOG_ERR, "ne_write() failed.\n");
+            os->flags |= OSF_ERRORS;
+            return -1;
+         }
+         ptr  += direct;
+         left -= direct;
+         continue;
+      }
+
+      size_t move = mc->stripe_size - mc->stripe_fill;
+      if (move > left)
+         move = left;
+      memcpy(mc->stripe_buf + mc->stripe_fill, ptr, move);
+      mc->stripe_fill += move;
+      ptr             += move;
+      left            -= move;
+
+      if (mc->stripe_fill == mc->stripe_size) {
+         if (ne_write(handle, mc->stripe_buf, mc->stripe_size) != mc->stripe_size) {
+            LOG(LOG_ERR, "ne_write() failed.\n");
+            os->flags |= OSF_ERRORS;
+            return -1;
+         }
+         mc->stripe_fill = 0;
+      }
    }
+   int written = size;
 
    os->written += written;
    
@@ -1231,6 +5736,21 @@ int mc_sync(DAL_Context* ctx) {
       return -1;
    }
 
+   // flush any partial stripe left by mc_put()
+   if ((os->flags & OSF_WRITING)
+       && mc_context->stripe_fill
+       && (ne_write(handle, mc_context->stripe_buf, mc_context->stripe_fill)
+           != mc_context->stripe_fill)) {
+
+      LOG(LOG_ERR, "ne_write() failed for final partial stripe.\n");
+      mc_context->stripe_fill = 0;
+      ne_close(handle);
+      mc_close(ctx);
+      os->flags |= OSF_ERRORS;
+      return -1;
+   }
+   mc_context->stripe_fill = 0;
+
    // the result of close for a handle opened for reading is an
    // indicator of whether the data is degraded and, if so, which
    // block is corrupt or missing.
@@ -1308,6 +5828,7 @@ int mc_abort(DAL_Context* ctx) {
    }
 
    MC_OS(ctx)->flags |= OSF_ABORT;
+   MC_CONTEXT(ctx)->stripe_fill = 0;
    
    EXIT();
    return 0;
@@ -1333,6 +5854,8 @@ int mc_close(DAL_Context* ctx) {
    return 0;
 }
 
+// There's no native del_many().  The default runs this on several
+// threads, which is as parallel as a batch of ne_delete1() calls gets.
 int mc_del(DAL_Context* ctx) {
    char* path_template = MC_CONTEXT(ctx)->path_template;
    int   nblocks       = MC_CONFIG(ctx)->n + MC_CONFIG(ctx)->e;
@@ -1447,6 +5970,24 @@ int install_DAL(DAL* dal) {
    DL_CHECK(del);
    DL_CHECK(update_object_location);
 
+   // async ops are optional
+   if (! dal->put_async)
+      dal->put_async  = &default_dal_put_async;
+   if (! dal->get_async)
+      dal->get_async  = &default_dal_get_async;
+   if (! dal->sync_async)
+      dal->sync_async = &default_dal_sync_async;
+   if (! dal->wait)
+      dal->wait       = &default_dal_wait;
+
+   // so is batch-delete
+   if (! dal->del_many)
+      dal->del_many   = &default_dal_del_many;
+
+   // and interrupting a get()
+   if (! dal->interrupt)
+      dal->interrupt  = &default_dal_interrupt;
+
    if (dal_count >= MAX_DAL) {
          LOG(LOG_ERR,
              "No room for DAL '%s'.  Increase MAX_DAL_COUNT and rebuild.\n",
@@ -1550,6 +6091,12 @@ DAL* get_DAL(const char* name) {
       assert(! install_DAL(&obj_dal) );
       assert(! install_DAL(&nop_dal) );
       assert(! install_DAL(&posix_dal) );
+      assert(! install_DAL(&posix_direct_dal) );
+      assert(! install_DAL(&mem_dal) );
+      assert(! install_DAL(&cache_dal) );
+      assert(! install_DAL(&compress_dal) );
+      assert(! install_DAL(&fault_dal) );
+      assert(! install_DAL(&posix_ec_dal) );
 #if USE_MC
       assert(! install_DAL(&mc_dal) );
       assert(! install_DAL(&mc_sockets_dal) );
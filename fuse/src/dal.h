@@ -98,6 +98,22 @@ OF SUCH DAMAGE.
 
 #include <stdio.h>
 
+#include "marfs_base.h"  // MARFS_ constants
+
+// The mc path will be the host field of the repo plus an object id.
+// We need a little extra room to account for numbers that will get
+// filled in to create the path template, 128 characters should be
+// more than enough.
+//
+// The POSIX_EC DAL writes its degraded objects to the same kind of log.
+#define MC_MAX_PATH_LEN        (MARFS_MAX_OBJID_SIZE+MARFS_MAX_HOST_SIZE+128)
+#define MC_MAX_LOG_LEN         (MC_MAX_PATH_LEN+512)
+
+// The log format is:
+// <object-path-template>\t<n>\t<e>\t<start-block>\t<error-pattern>\t<repo-name>\t<pod>\t<capacity-unit>\t\n
+#define MC_DEGRADED_LOG_FORMAT "%s\t%d\t%d\t%d\t%d\t%s\t%d\t%d\t\n"
+#define MC_LOG_SCATTER_WIDTH   400
+
 #if USE_MC
 #  include "udal_config.h"  // libne configure-time #defines, like S3_AUTH
 #  if S3_AUTH
@@ -105,21 +121,16 @@ OF SUCH DAMAGE.
 #  endif
 #  define DEFAULT_SKT_AUTH_USER  "mcadmin"  /* libne's SKT_S3_USER might diverge */
 
-#  include "marfs_base.h"  // MARFS_ constants
 #  include "marfs_locks.h" // SEM_T
 #  include "erasure.h"     // NEPathManip
 
-// The mc path will be the host field of the repo plus an object id.
-// We need a little extra room to account for numbers that will get
-// filled in to create the path template, 128 characters should be
-// more than enough.
-#  define MC_MAX_PATH_LEN        (MARFS_MAX_OBJID_SIZE+MARFS_MAX_HOST_SIZE+128)
-#  define MC_MAX_LOG_LEN         (MC_MAX_PATH_LEN+512)
-
-// The log format is:
-// <object-path-template>\t<n>\t<e>\t<start-block>\t<error-pattern>\t<repo-name>\t<pod>\t<capacity-unit>\t\n
-#  define MC_DEGRADED_LOG_FORMAT "%s\t%d\t%d\t%d\t%d\t%s\t%d\t%d\t\n"
-#  define MC_LOG_SCATTER_WIDTH   400
+// mc_put() only gives ne_write() whole stripes (N * stripe_unit bytes).
+// This should match libne's per-block buffer size.
+#  ifdef BLKSZ
+#    define MC_DEFAULT_STRIPE_UNIT  BLKSZ
+#  else
+#    define MC_DEFAULT_STRIPE_UNIT  (1024 * 1024)
+#  endif
 
 #endif // USE_MC
 
@@ -146,6 +157,7 @@ typedef struct mc_config {
    unsigned int  num_pods;
    unsigned int  num_cap;
    unsigned int  scatter_width;
+   size_t        stripe_unit;            // bytes per block, per stripe
    char         *degraded_log_path;
    int           degraded_log_fd;
    SEM_T         lock;
@@ -184,6 +196,9 @@ typedef struct mc_config {
 // file-handles are destroyed.
 //
 
+// fwd-decl.  See the ASYNC section in dal.c
+struct DAL_Async;
+
 typedef struct {
    uint32_t  flags;
    union {
@@ -193,6 +208,7 @@ typedef struct {
       uint32_t  u;
       int32_t   i;
    } data;
+   struct DAL_Async*  async;    // outstanding async ops.  NULL until needed
 } DAL_Context;
 
 
@@ -247,6 +263,15 @@ extern int   default_dal_config(struct DAL*     dal,
                                 xDALConfigOpt** opts,
                                 size_t          opt_count);
 
+// config() for DALs that wrap another DAL, named by a "backend" option.
+// Configures a private copy of the backend with the "backend.xxx"
+// options, and leaves the wrapper's own options at the front of <opts>.
+extern int   wrapper_dal_config(struct DAL*     dal,
+                                xDALConfigOpt** opts,
+                                size_t          opt_count,
+                                struct DAL**    backend,
+                                size_t*         my_count);
+
 
 
 // initialize/destroy context, if desired.
@@ -364,6 +389,95 @@ typedef int      (*dal_delete)(DAL_Context*  ctx);
 
 
 
+// --- asynchronous storage ops (optional)
+//
+// These start the corresponding blocking op (put/get/sync), and return
+// without waiting for it.  They return 0 if the op was started, or -1
+// (with errno) if it could not be.  When the op finishes, <cb> is called
+// (possibly in some other thread) with the return-code the blocking op
+// would have produced, and the errno, if that was negative.  <buf> must
+// remain valid until then.
+//
+// The default implementations complete ops on the same context in the
+// order they were issued.  (Native ones may not, but each op still covers
+// its own span of the object, as though they had been issued in order.)
+// The caller still does open() before issuing them, and must wait() for
+// them before calling the blocking sync(), abort(), or close().
+//
+// DALs that don't provide these get the defaults from dal.c, which run
+// the blocking ops in a shared pool of worker-threads.  (See
+// install_DAL().)  A DAL that provides its own can use dal_async_begin()
+// and dal_async_end(), so that the default wait() still works.
+
+typedef void     (*dal_callback)  (DAL_Context*  ctx,
+                                   ssize_t       rc,
+                                   int           err,
+                                   void*         arg);
+
+typedef int      (*dal_put_async) (DAL_Context*  ctx,
+                                   struct DAL*   dal,
+                                   const char*   buf,
+                                   size_t        size,
+                                   dal_callback  cb,
+                                   void*         arg);
+
+typedef int      (*dal_get_async) (DAL_Context*  ctx,
+                                   struct DAL*   dal,
+                                   char*         buf,
+                                   size_t        size,
+                                   dal_callback  cb,
+                                   void*         arg);
+
+typedef int      (*dal_sync_async)(DAL_Context*  ctx,
+                                   struct DAL*   dal,
+                                   dal_callback  cb,
+                                   void*         arg);
+
+// With <block> non-zero, wait for all outstanding async ops on <ctx>.
+// Returns 0 if they all succeeded, or -1 with errno from the first one
+// that failed.  With <block> zero, just poll: returns the number of ops
+// still outstanding, or (if there are none) the same as the blocking
+// case.  The error is cleared, once it has been returned.
+typedef int      (*dal_wait)      (DAL_Context*  ctx,
+                                   struct DAL*   dal,
+                                   int           block);
+
+
+
+// --- batch delete (optional)
+//
+// Delete every object in <objids>.  These are all in the same repo and
+// namespace as <fh>, which <ctx> was init()'ed with, and which describes
+// them in every way except info.pre.objid.  <fh> is not changed.
+// status[i] gets 0 if objids[i] was deleted, or else the errno.  Returns
+// 0 if everything was deleted, or -1 with errno from the first failure.
+//
+// DALs that don't provide this get default_dal_del_many(), which runs the
+// ordinary del() for each object, on several threads.
+
+typedef int      (*dal_delete_many)(DAL_Context*  ctx,
+                                    struct DAL*   dal,
+                                    void*         fh,
+                                    const char**  objids,
+                                    size_t        count,
+                                    int*          status);
+
+
+
+// --- interrupt (optional)
+//
+// Called from some other thread, to make a get() that is blocked on <ctx>
+// return early, with an error.  The owner of <ctx> must then sync() and
+// close() it.  This is how a hedged GET that lost the race stops waiting
+// for a slow server.  (See hedge_attempt(), in common.c.)
+//
+// DALs that don't provide this get default_dal_interrupt(), which fails
+// with ENOSYS, so the get() just runs to completion.
+
+typedef int      (*dal_interrupt)(DAL_Context*  ctx);
+
+
+
 // This is a collection of function-ptrs
 // They capture a given implementation of interaction with an MDFS.
 typedef struct DAL {
@@ -387,6 +501,14 @@ typedef struct DAL {
 
    dal_update_object_location update_object_location;
 
+   // optional.  install_DAL() fills in defaults
+   dal_put_async              put_async;
+   dal_get_async              get_async;
+   dal_sync_async             sync_async;
+   dal_wait                   wait;
+   dal_delete_many            del_many;
+   dal_interrupt              interrupt;
+
 } DAL;
 
 
@@ -401,6 +523,25 @@ DAL* get_DAL(const char* name);
 int     default_dal_ctx_init   (DAL_Context* ctx, DAL* dal, void* fh);
 int     default_dal_ctx_destroy(DAL_Context* ctx, DAL* dal);
 
+int     default_dal_put_async (DAL_Context* ctx, DAL* dal, const char* buf, size_t size,
+                               dal_callback cb, void* arg);
+int     default_dal_get_async (DAL_Context* ctx, DAL* dal, char* buf, size_t size,
+                               dal_callback cb, void* arg);
+int     default_dal_sync_async(DAL_Context* ctx, DAL* dal, dal_callback cb, void* arg);
+int     default_dal_wait      (DAL_Context* ctx, DAL* dal, int block);
+int     default_dal_del_many  (DAL_Context* ctx, DAL* dal, void* fh,
+                               const char** objids, size_t count, int* status);
+int     default_dal_interrupt (DAL_Context* ctx);
+
+// for async ops that complete some other way than the default worker-pool
+int     dal_async_pending(DAL_Context* ctx);
+int     dal_async_begin(DAL_Context* ctx);
+void    dal_async_end  (DAL_Context* ctx, ssize_t rc, int err,
+                        dal_callback cb, void* arg);
+
+// wait for outstanding async ops, and free the state.  (see destroy_data())
+int     dal_async_free (DAL_Context* ctx);
+
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,712 @@
+
+/*
+This file is part of MarFS, which is released under the BSD license.
+
+
+Copyright (c) 2015, Los Alamos National Security (LANS), LLC
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation and/or
+other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors
+may be used to endorse or promote products derived from this software without
+specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+-----
+NOTE:
+-----
+MarFS uses libaws4c for Amazon S3 object communication. The original version
+is at https://aws.amazon.com/code/Amazon-S3/2601 and under the LGPL license.
+LANS, LLC added functionality to the original work. The original work plus
+LANS, LLC contributions is found at https://github.com/jti-lanl/aws4c.
+
+GNU licenses can be found at <http://www.gnu.org/licenses/>.
+
+
+From Los Alamos National Security, LLC:
+LA-CC-15-039
+
+Copyright (c) 2015, Los Alamos National Security, LLC All rights reserved.
+Copyright 2015. Los Alamos National Security, LLC. This software was produced
+under U.S. Government contract DE-AC52-06NA25396 for Los Alamos National
+Laboratory (LANL), which is operated by Los Alamos National Security, LLC for
+the U.S. Department of Energy. The U.S. Government has rights to use,
+reproduce, and distribute this software.  NEITHER THE GOVERNMENT NOR LOS
+ALAMOS NATIONAL SECURITY, LLC MAKES ANY WARRANTY, EXPRESS OR IMPLIED, OR
+ASSUMES ANY LIABILITY FOR THE USE OF THIS SOFTWARE.  If software is
+modified to produce derivative works, such modified software should be
+clearly marked, so as not to confuse it with the version available from
+LANL.
+
+THIS SOFTWARE IS PROVIDED BY LOS ALAMOS NATIONAL SECURITY, LLC AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL LOS ALAMOS NATIONAL SECURITY, LLC OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+
+
+#include "common.h"
+#include "dedup.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <attr/xattr.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <limits.h>
+#include <pthread.h>
+
+
+// ---------------------------------------------------------------------------
+// fingerprints
+//
+// SHA-256, computed incrementally, because the data of a chunk arrives in
+// pieces.  Objects that differ in layout can't share data, so the layout
+// is hashed first, and they get different fingerprints for the same data.
+// ---------------------------------------------------------------------------
+
+void dedup_hash_init(DedupHash* dh, const MarFS_XattrPre* pre) {
+   char layout[128];
+   int  len = snprintf(layout, sizeof(layout), "marfs-dedup %lu %u %u %u\n",
+                       (unsigned long)pre->chunk_size,
+                       (unsigned)pre->compression,
+                       (unsigned)pre->correction,
+                       (unsigned)pre->encryption);
+   SHA256_Init(&dh->ctx);
+   SHA256_Update(&dh->ctx, layout, len);
+   dh->len = 0;
+}
+
+void dedup_hash_update(DedupHash* dh, const void* buf, size_t len) {
+   SHA256_Update(&dh->ctx, buf, len);
+   dh->len += len;
+}
+
+DedupFP dedup_hash_final(DedupHash* dh) {
+   DedupFP fp;
+   SHA256_Final(fp.sha, &dh->ctx);
+   fp.len = dh->len;
+   return fp;
+}
+
+static
+void dedup_fp_str(char* dest, const DedupFP* fp) {
+   int i;
+   for (i=0; i<SHA256_DIGEST_LENGTH; ++i)
+      sprintf(dest + 2*i, "%02x", fp->sha[i]);
+   sprintf(dest + 2*SHA256_DIGEST_LENGTH, ".%lx", (unsigned long)fp->len);
+}
+
+static
+int dedup_fp_parse(DedupFP* fp, const char* str) {
+   unsigned int  byte;
+   unsigned long len;
+   int           i;
+
+   for (i=0; i<SHA256_DIGEST_LENGTH; ++i) {
+      if (sscanf(str + 2*i, "%2x", &byte) != 1)
+         return -1;
+      fp->sha[i] = byte;
+   }
+   if (sscanf(str + 2*SHA256_DIGEST_LENGTH, ".%lx", &len) != 1)
+      return -1;
+   fp->len = len;
+   return 0;
+}
+
+
+// ---------------------------------------------------------------------------
+// the table  (DEDUP_XATTR)
+// ---------------------------------------------------------------------------
+
+static
+DedupEntry* dedup_add(DedupTable* dt) {
+   if (dt->count == dt->alloc) {
+      size_t      alloc = (dt->alloc ? (2 * dt->alloc) : 16);
+      DedupEntry* entry = (DedupEntry*)realloc(dt->entry, alloc * sizeof(DedupEntry));
+      if (! entry) {
+         errno = ENOMEM;
+         return NULL;
+      }
+      dt->entry = entry;
+      dt->alloc = alloc;
+   }
+   return &dt->entry[dt->count++];
+}
+
+DedupEntry* dedup_find(const DedupTable* dt, size_t chunk_no) {
+   size_t lo = 0;
+   size_t hi = dt->count;
+   while (lo < hi) {
+      size_t mid = (lo + hi) / 2;
+      if (dt->entry[mid].chunk_no == chunk_no)
+         return &dt->entry[mid];
+      if (dt->entry[mid].chunk_no < chunk_no)
+         lo = mid +1;
+      else
+         hi = mid;
+   }
+   return NULL;
+}
+
+void dedup_free(PathInfo* info) {
+   if (info->dedup) {
+      free(info->dedup->entry);
+      free(info->dedup);
+      info->dedup = NULL;
+   }
+}
+
+// "<bucket>/<objid>" for the chunk <pre> currently names
+static
+void dedup_pre_str(char* dest, const MarFS_XattrPre* pre) {
+   snprintf(dest, MARFS_MAX_PRE_SIZE, "%s/%s", pre->bucket, pre->objid);
+}
+
+static
+int dedup_save(PathInfo* info, const DedupTable* dt) {
+   char*  buf = (char*)malloc(DEDUP_XATTR_MAX);
+   size_t len = 0;
+   size_t i;
+
+   if (! buf) {
+      errno = ENOMEM;
+      return -1;
+   }
+   for (i=0; i<dt->count; ++i) {
+      const DedupEntry* ent = &dt->entry[i];
+      char              fp_str[DEDUP_FP_STR_MAX];
+      dedup_fp_str(fp_str, &ent->fp);
+      int n = snprintf(buf + len, DEDUP_XATTR_MAX - len, "%lu %s %s\n",
+                       ent->chunk_no, fp_str, ent->pre);
+      if ((size_t)n >= DEDUP_XATTR_MAX - len) {
+         free(buf);
+         errno = E2BIG;
+         return -1;
+      }
+      len += n;
+   }
+
+   int rc = MD_PATH_OP(lsetxattr, info->ns, info->post.md_path,
+                       DEDUP_XATTR, buf, len, 0);
+   free(buf);
+   return rc;
+}
+
+int dedup_load(PathInfo* info) {
+   dedup_free(info);
+
+   char* buf = (char*)malloc(DEDUP_XATTR_MAX +1);
+   if (! buf) {
+      errno = ENOMEM;
+      return -1;
+   }
+   ssize_t len = MD_PATH_OP(lgetxattr, info->ns, info->post.md_path,
+                            DEDUP_XATTR, buf, DEDUP_XATTR_MAX);
+   if (len < 0) {
+      int err = errno;
+      free(buf);
+      if (err == ENOATTR) {
+         LOG(LOG_ERR, "%s has POST_DEDUP, but no %s\n", info->post.md_path, DEDUP_XATTR);
+         return 0;
+      }
+      errno = err;
+      return -1;
+   }
+   buf[len] = 0;
+
+   DedupTable* dt = (DedupTable*)calloc(1, sizeof(DedupTable));
+   if (! dt) {
+      free(buf);
+      errno = ENOMEM;
+      return -1;
+   }
+
+   char* line = buf;
+   char* eol;
+   for ( ; (eol = strchr(line, '\n')); line = eol +1) {
+      *eol = 0;
+      DedupEntry* ent = dedup_add(dt);
+      if (! ent)
+         goto fail;
+      char fp_str[DEDUP_FP_STR_MAX];
+      if ((sscanf(line, "%lu %81s %s", &ent->chunk_no, fp_str, ent->pre) != 3)
+          || dedup_fp_parse(&ent->fp, fp_str)
+          || ((dt->count > 1) && (ent->chunk_no <= ent[-1].chunk_no))) {
+         LOG(LOG_ERR, "bad %s line in %s: '%s'\n", DEDUP_XATTR, info->post.md_path, line);
+         errno = EIO;
+         goto fail;
+      }
+   }
+   free(buf);
+
+   LOG(LOG_INFO, "%s has %lu dedup entries\n", info->post.md_path, dt->count);
+   info->dedup = dt;
+   return 0;
+
+ fail:
+   free(dt->entry);
+   free(dt);
+   free(buf);
+   return -1;
+}
+
+int dedup_copy_xattr(PathInfo* info, const char* dest_path) {
+   char* buf = (char*)malloc(DEDUP_XATTR_MAX);
+   if (! buf) {
+      errno = ENOMEM;
+      return -1;
+   }
+   ssize_t len = MD_PATH_OP(lgetxattr, info->ns, info->post.md_path,
+                            DEDUP_XATTR, buf, DEDUP_XATTR_MAX);
+   int rc = 0;
+   if (len >= 0) {
+      rc = MD_PATH_OP(lsetxattr, info->ns, dest_path, DEDUP_XATTR, buf, len, 0);
+      if (! rc)
+         rc = 1;
+   }
+   else if (errno != ENOATTR)
+      rc = -1;
+
+   free(buf);
+   return rc;
+}
+
+
+// Point info->pre at the object holding the data of chunk pre.chunk_no.
+// (bucket and objid are regenerated by the next update_pre().)  The index
+// is per-namespace, so a table that names an object in some other
+// namespace didn't come from dedup_publish().
+int dedup_redirect(PathInfo* info) {
+   const DedupEntry* ent = dedup_find(info->dedup, info->pre.chunk_no);
+   if (! ent)
+      return 0;
+
+   char own[MARFS_MAX_PRE_SIZE];
+   dedup_pre_str(own, &info->pre);
+   if (! strcmp(own, ent->pre))
+      return 0;
+
+   MarFS_XattrPre ref;
+   memset(&ref, 0, sizeof(MarFS_XattrPre));
+   if (str_2_pre(&ref, ent->pre, NULL)) {
+      LOG(LOG_ERR, "couldn't parse dedup ref '%s', chunk %lu of %s\n",
+          ent->pre, ent->chunk_no, info->post.md_path);
+      errno = EIO;
+      return -1;
+   }
+   if (ref.repo != info->pre.repo) {
+      LOG(LOG_ERR, "dedup ref '%s' is not in repo %s\n", ent->pre, info->pre.repo->name);
+      errno = EIO;
+      return -1;
+   }
+   if (ref.ns != info->pre.ns) {
+      LOG(LOG_ERR, "dedup ref '%s' is not in namespace %s\n", ent->pre, info->pre.ns->name);
+      errno = EACCES;
+      return -1;
+   }
+
+   LOG(LOG_INFO, "chunk %lu is in %s\n", ent->chunk_no, ref.objid);
+   memcpy(info->pre.bucket, ref.bucket, MARFS_MAX_BUCKET_SIZE);
+   memcpy(info->pre.objid,  ref.objid,  MARFS_MAX_OBJID_SIZE);
+   return 0;
+}
+
+
+// ---------------------------------------------------------------------------
+// the index
+//
+// <dedup_dir>/<repo>/<ns>/<xx>/<fingerprint> holds "<refs> <bucket>/<objid>\n".
+// New entries are written to a temporary name and link()ed into place, so
+// a reader never sees a partial one.  The last reference unlinks the entry
+// while holding its lock.  Anyone who was waiting for the lock then sees
+// st_nlink == 0, and starts over.
+// ---------------------------------------------------------------------------
+
+#define DEDUP_INDEX_TRIES  8
+
+typedef struct {
+   size_t  refs;
+   char    pre[MARFS_MAX_PRE_SIZE];
+} DedupIndexRec;
+
+static
+int dedup_index_path(char* path, const MarFS_XattrPre* pre, const DedupFP* fp) {
+   const MarFS_Repo* repo = pre->repo;
+   if (! repo->dedup_dir) {
+      LOG(LOG_ERR, "repo %s has no dedup_dir\n", repo->name);
+      errno = EINVAL;
+      return -1;
+   }
+   char fp_str[DEDUP_FP_STR_MAX];
+   dedup_fp_str(fp_str, fp);
+   int len = snprintf(path, PATH_MAX, "%s/%s/%s/%02x/%s",
+                      repo->dedup_dir, repo->name, pre->ns->name,
+                      (unsigned)fp->sha[0], fp_str);
+   if (len >= PATH_MAX) {
+      errno = ENAMETOOLONG;
+      return -1;
+   }
+   return 0;
+}
+
+// mkdir the parents of <path>, below dedup_dir
+static
+int dedup_index_mkdirs(char* path, const MarFS_Repo* repo) {
+   char* p = path + strlen(repo->dedup_dir) +1;
+   char* slash;
+   for ( ; (slash = strchr(p, '/')); p = slash +1) {
+      *slash = 0;
+      int rc = mkdir(path, 0755);
+      *slash = '/';
+      if (rc && (errno != EEXIST)) {
+         LOG(LOG_ERR, "mkdir for %s failed: %s\n", path, strerror(errno));
+         return -1;
+      }
+   }
+   return 0;
+}
+
+// lock the entry, and read it.  Returns 1 if it's on its way out.
+static
+int dedup_index_read(int fd, DedupIndexRec* rec) {
+   struct flock lk = { .l_type = F_WRLCK, .l_whence = SEEK_SET };
+   struct stat  st;
+   char         buf[32 + MARFS_MAX_PRE_SIZE];
+
+   if (fcntl(fd, F_SETLKW, &lk) || fstat(fd, &st))
+      return -1;
+   if (! st.st_nlink)
+      return 1;
+
+   ssize_t len = pread(fd, buf, sizeof(buf) -1, 0);
+   if (len < 0)
+      return -1;
+   buf[len] = 0;
+   if (sscanf(buf, "%lu %s", &rec->refs, rec->pre) != 2) {
+      LOG(LOG_ERR, "bad dedup index entry: '%s'\n", buf);
+      errno = EIO;
+      return -1;
+   }
+   return (rec->refs ? 0 : 1);
+}
+
+static
+int dedup_index_write(int fd, const DedupIndexRec* rec) {
+   char buf[32 + MARFS_MAX_PRE_SIZE];
+   int  len = snprintf(buf, sizeof(buf), "%lu %s\n", rec->refs, rec->pre);
+   if ((pwrite(fd, buf, len, 0) != len)
+       || ftruncate(fd, len))
+      return -1;
+   return 0;
+}
+
+// install a new entry for <pre>.  Fails with EEXIST if there already is one.
+static
+int dedup_index_create(char* path, const MarFS_Repo* repo, const char* pre) {
+   char tmp[PATH_MAX];
+   int  len = snprintf(tmp, PATH_MAX, "%s.%d.%lx",
+                       path, (int)getpid(), (unsigned long)pthread_self());
+   if (len >= PATH_MAX) {
+      errno = ENAMETOOLONG;
+      return -1;
+   }
+
+   int fd = open(tmp, O_WRONLY|O_CREAT|O_TRUNC, 0644);
+   if ((fd < 0) && (errno == ENOENT)) {
+      if (dedup_index_mkdirs(path, repo))
+         return -1;
+      fd = open(tmp, O_WRONLY|O_CREAT|O_TRUNC, 0644);
+   }
+   if (fd < 0)
+      return -1;
+
+   DedupIndexRec rec = { .refs = 1 };
+   strncpy(rec.pre, pre, MARFS_MAX_PRE_SIZE);
+   rec.pre[MARFS_MAX_PRE_SIZE -1] = 0;
+
+   int rc = dedup_index_write(fd, &rec);
+   if (! rc)
+      rc = fsync(fd);
+   close(fd);
+   if (! rc)
+      rc = link(tmp, path);
+
+   int err = errno;
+   unlink(tmp);
+   errno = err;
+   return rc;
+}
+
+// Add a reference for chunk-object <pre>.  Returns 0 if it became the
+// object for this fingerprint, or 1 if there already was one, in which
+// case its name goes into <found>.
+static
+int dedup_index_ref(const MarFS_XattrPre* pre, const DedupFP* fp,
+                    const char* obj, char* found) {
+   char path[PATH_MAX];
+   int  i;
+
+   if (dedup_index_path(path, pre, fp))
+      return -1;
+
+   for (i=0; i<DEDUP_INDEX_TRIES; ++i) {
+      int fd = open(path, O_RDWR);
+      if (fd < 0) {
+         if (errno != ENOENT)
+            return -1;
+         if (! dedup_index_create(path, pre->repo, obj))
+            return 0;
+         if (errno != EEXIST)
+            return -1;
+         continue;
+      }
+
+      DedupIndexRec rec;
+      int rc = dedup_index_read(fd, &rec);
+      if (! rc) {
+         rec.refs += 1;
+         rc = dedup_index_write(fd, &rec);
+         close(fd);             // also drops the lock
+         if (rc)
+            return -1;
+         memcpy(found, rec.pre, MARFS_MAX_PRE_SIZE);
+         return 1;
+      }
+      close(fd);
+      if (rc < 0)
+         return -1;
+   }
+
+   LOG(LOG_ERR, "gave up on contended dedup entry %s\n", path);
+   errno = EAGAIN;
+   return -1;
+}
+
+int dedup_unref(const MarFS_XattrPre* pre, const DedupEntry* ent, const char* own_pre) {
+   char          path[PATH_MAX];
+   DedupIndexRec rec;
+   int           rc;
+
+   if (dedup_index_path(path, pre, &ent->fp))
+      return -1;
+
+   int fd = open(path, O_RDWR);
+   if (fd < 0) {
+      if (errno != ENOENT)
+         return -1;
+      rc = 1;
+   }
+   else if ((rc = dedup_index_read(fd, &rec)) < 0) {
+      close(fd);
+      return -1;
+   }
+   else if (! rc && strcmp(rec.pre, ent->pre))
+      rc = 1;                   // some other object, with the same data
+
+   if (rc) {
+      // No entry for this object.  (e.g. we crashed in dedup_publish(),
+      // before adding it.)  Nobody can have found it through the index,
+      // so, if it's our own, we can delete it.
+      if (fd >= 0)
+         close(fd);
+      if (strcmp(ent->pre, own_pre)) {
+         LOG(LOG_ERR, "no dedup entry for %s (chunk %lu).  Not deleting it.\n",
+             ent->pre, ent->chunk_no);
+         return 0;
+      }
+      return 1;
+   }
+
+   rec.refs -= 1;
+   if (rec.refs)
+      rc = dedup_index_write(fd, &rec);
+   else if (! (rc = unlink(path)))
+      rc = 1;
+
+   close(fd);
+   LOG(LOG_INFO, "%s: %lu refs remain\n", ent->pre, rec.refs);
+   return rc;
+}
+
+
+// ---------------------------------------------------------------------------
+// writers
+// ---------------------------------------------------------------------------
+
+void dedup_update(MarFS_FileHandle* fh, const char* buf, size_t size) {
+   PathInfo* info = &fh->info;
+
+   if (! info->dedup) {
+      if (! info->pre.repo->dedup_dir
+          || (info->pre.obj_type == OBJ_Nto1)
+          || (fh->flags & (FH_Nto1_WRITES | FH_PACKED)))
+         return;
+
+      info->dedup = (DedupTable*)calloc(1, sizeof(DedupTable));
+      if (! info->dedup) {
+         LOG(LOG_ERR, "no memory for dedup.  Not deduplicating %s\n", info->post.md_path);
+         return;
+      }
+      dedup_hash_init(&info->dedup->hash, &info->pre);
+   }
+   dedup_hash_update(&info->dedup->hash, buf, size);
+}
+
+// info->pre still names the chunk that was just closed.  The entry says
+// the chunk is its own object, until dedup_publish() finds otherwise.
+void dedup_chunk(MarFS_FileHandle* fh) {
+   PathInfo*   info = &fh->info;
+   DedupTable* dt   = info->dedup;
+   if (! dt)
+      return;
+
+   const size_t data1 = info->pre.chunk_size - MARFS_REC_UNI_SIZE;
+   if ((dt->hash.len == data1)
+       && ((dt->count +1) * DEDUP_LINE_MAX <= DEDUP_XATTR_MAX)) {
+
+      DedupEntry* ent = dedup_add(dt);
+      if (ent) {
+         ent->chunk_no = info->pre.chunk_no;
+         ent->fp       = dedup_hash_final(&dt->hash);
+         dedup_pre_str(ent->pre, &info->pre);
+      }
+   }
+   dedup_hash_init(&dt->hash, &info->pre);
+}
+
+// Called from marfs_flush(), after all chunks are safely written, and
+// before POST is saved.  Problems here don't fail the close.  The file
+// just keeps (some of) its own copies.
+void dedup_publish(MarFS_FileHandle* fh) {
+   PathInfo*   info = &fh->info;
+   DedupTable* dt   = info->dedup;
+   size_t      hits = 0;
+   size_t      i;
+
+   if (! dt || ! dt->count)
+      return;
+
+   // GC must know these chunks are in the index before they are.
+   if (dedup_save(info, dt)) {
+      LOG(LOG_ERR, "couldn't save %s on %s: %s.  Not deduplicating.\n",
+          DEDUP_XATTR, info->post.md_path, strerror(errno));
+      dt->count = 0;
+      return;
+   }
+   info->post.flags |= POST_DEDUP;
+
+   char (*dups)[MARFS_MAX_OBJID_SIZE]
+      = (char (*)[MARFS_MAX_OBJID_SIZE])malloc(dt->count * MARFS_MAX_OBJID_SIZE);
+   if (! dups)
+      return;
+
+   for (i=0; i<dt->count; ++i) {
+      DedupEntry* ent = &dt->entry[i];
+      char        found[MARFS_MAX_PRE_SIZE];
+
+      int rc = dedup_index_ref(&info->pre, &ent->fp, ent->pre, found);
+      if (rc < 0)
+         LOG(LOG_ERR, "dedup index failed for chunk %lu of %s: %s\n",
+             ent->chunk_no, info->post.md_path, strerror(errno));
+      else if (rc) {
+         LOG(LOG_INFO, "chunk %lu of %s is a duplicate of %s\n",
+             ent->chunk_no, info->post.md_path, found);
+
+         // our objid is the part after the bucket
+         const char* objid = strchr(ent->pre, '/');
+         strncpy(dups[hits], (objid ? objid +1 : ent->pre), MARFS_MAX_OBJID_SIZE);
+         dups[hits][MARFS_MAX_OBJID_SIZE -1] = 0;
+         ++hits;
+
+         memcpy(ent->pre, found, MARFS_MAX_PRE_SIZE);
+      }
+   }
+
+   // Our copies can go, once the table says where the data is.  If we
+   // can't say that, the references we took are leaked, but nothing is
+   // lost.
+   if (hits) {
+      if (dedup_save(info, dt))
+         LOG(LOG_ERR, "couldn't update %s on %s: %s\n",
+             DEDUP_XATTR, info->post.md_path, strerror(errno));
+      else {
+         MarFS_FileHandle* dfh = (MarFS_FileHandle*)calloc(1, sizeof(MarFS_FileHandle));
+         const char**      ids = (const char**)malloc(hits * sizeof(char*));
+         int*              st  = (int*)malloc(hits * sizeof(int));
+         if (dfh && ids && st) {
+            dfh->info       = *info;
+            dfh->info.dedup = NULL;
+            for (i=0; i<hits; ++i)
+               ids[i] = dups[i];
+            if (delete_data_many(dfh, ids, hits, st))   // also does destroy_data()
+               LOG(LOG_ERR, "couldn't delete all duplicate chunks of %s\n",
+                   info->post.md_path);
+         }
+         free(st);
+         free(ids);
+         free(dfh);
+      }
+   }
+   free(dups);
+
+   LOG(LOG_INFO, "%s: %lu of %lu chunks were duplicates\n",
+       info->post.md_path, hits, dt->count);
+}
+
+
+// ---------------------------------------------------------------------------
+// GC
+// ---------------------------------------------------------------------------
+
+// delete the object holding the data of <ent>, which may belong to some
+// other file
+int dedup_delete(MarFS_FileHandle* fh, const DedupEntry* ent) {
+   MarFS_FileHandle* dfh = (MarFS_FileHandle*)malloc(sizeof(MarFS_FileHandle));
+   if (! dfh) {
+      errno = ENOMEM;
+      return -1;
+   }
+
+   int rc = fake_filehandle_for_delete(dfh, ent->pre, fh->info.post.md_path);
+   if (rc)
+      LOG(LOG_ERR, "couldn't parse dedup ref '%s'\n", ent->pre);
+   else
+      rc = delete_data(dfh);    // also does destroy_data()
+
+   int err = errno;
+   free(dfh);
+   errno = err;
+   return rc;
+}
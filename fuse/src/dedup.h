@@ -0,0 +1,196 @@
+#ifndef _MARFS_DEDUP_H
+#define _MARFS_DEDUP_H
+
+
+/*
+This file is part of MarFS, which is released under the BSD license.
+
+
+Copyright (c) 2015, Los Alamos National Security (LANS), LLC
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation and/or
+other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors
+may be used to endorse or promote products derived from this software without
+specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+-----
+NOTE:
+-----
+MarFS uses libaws4c for Amazon S3 object communication. The original version
+is at https://aws.amazon.com/code/Amazon-S3/2601 and under the LGPL license.
+LANS, LLC added functionality to the original work. The original work plus
+LANS, LLC contributions is found at https://github.com/jti-lanl/aws4c.
+
+GNU licenses can be found at <http://www.gnu.org/licenses/>.
+
+
+From Los Alamos National Security, LLC:
+LA-CC-15-039
+
+Copyright (c) 2015, Los Alamos National Security, LLC All rights reserved.
+Copyright 2015. Los Alamos National Security, LLC. This software was produced
+under U.S. Government contract DE-AC52-06NA25396 for Los Alamos National
+Laboratory (LANL), which is operated by Los Alamos National Security, LLC for
+the U.S. Department of Energy. The U.S. Government has rights to use,
+reproduce, and distribute this software.  NEITHER THE GOVERNMENT NOR LOS
+ALAMOS NATIONAL SECURITY, LLC MAKES ANY WARRANTY, EXPRESS OR IMPLIED, OR
+ASSUMES ANY LIABILITY FOR THE USE OF THIS SOFTWARE.  If software is
+modified to produce derivative works, such modified software should be
+clearly marked, so as not to confuse it with the version available from
+LANL.
+
+THIS SOFTWARE IS PROVIDED BY LOS ALAMOS NATIONAL SECURITY, LLC AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL LOS ALAMOS NATIONAL SECURITY, LLC OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+
+
+
+// ---------------------------------------------------------------------------
+// DEDUP
+//
+// A repo with a <dedup_dir> keeps an index of the fingerprints of the full
+// chunks of Multi files written through marfs_write().  When a file is
+// closed, each of its full chunks is looked up.  If the same data is
+// already in an object of the same namespace, the chunk becomes a
+// reference to that object, and the file's own copy of the chunk is
+// deleted.
+//
+// Chunks are the fixed-size MarFS chunks (repo chunk_size), because
+// readers compute the chunk holding a given offset.  The fingerprint is
+// the SHA-256 of the things that affect how the data is stored
+// (chunk_size, compression, etc) followed by the chunk's user-data, plus
+// the length of that data.  So only objects with the same layout can
+// match, and a match is trusted without reading either object back.
+//
+// MultiChunkInfo has a fixed size, so references are kept in an extra
+// xattr on the MD file (DEDUP_XATTR), with one line per chunk:
+//
+//     <chunk_no> <fingerprint> <bucket>/<objid>
+//
+// The last part names the object holding the chunk's data, in the same
+// form as the PRE xattr.  If it's the file's own chunk-object, the file is
+// the "owner" of that data.  POST_DEDUP says the xattr is present.  The
+// xattr moves to the trash with the file, like the others.
+//
+// The index has a small file per fingerprint, in
+// <dedup_dir>/<repo>/<ns>/<xx>/, with a reference-count and the name of
+// the object.  Keeping it per-namespace means a chunk is never redirected
+// to data that the reader's namespace doesn't own.  It is updated under
+// fcntl() locks, so it can be shared by all the hosts that write to the
+// repo, and by GC.  The count includes the owner.  GC drops a reference
+// for each listed chunk of a trashed file, and only deletes the object
+// when the count goes to zero.
+//
+// marfs_write() streams each chunk into its own object before the
+// fingerprint can be known, so this saves space, not PUTs.  Updates are
+// ordered so that a crash can only leak a reference (keeping an object
+// alive), never drop one.
+// ---------------------------------------------------------------------------
+
+#include "common.h"
+
+#include <stdint.h>
+
+// SHA256_*() work with every OpenSSL we link (1.0 lacks EVP_MD_CTX_new()),
+// but 3.0 calls them deprecated.
+#ifndef OPENSSL_SUPPRESS_DEPRECATED
+#  define OPENSSL_SUPPRESS_DEPRECATED
+#endif
+#include <openssl/sha.h>
+
+
+#define DEDUP_XATTR        MarFS_XattrPrefix "dedup"
+#define DEDUP_XATTR_MAX    (63 * 1024)  /* GPFS allows 64 KB xattr values */
+#define DEDUP_LINE_MAX     (128 + MARFS_MAX_PRE_SIZE)
+
+
+typedef struct {
+   SHA256_CTX   ctx;
+   size_t       len;          // total bytes hashed (not counting the layout)
+} DedupHash;
+
+typedef struct {
+   uint8_t      sha[SHA256_DIGEST_LENGTH];
+   uint64_t     len;
+} DedupFP;
+
+// "<sha256 hex>.<len hex>"
+#define DEDUP_FP_STR_MAX   (2 * SHA256_DIGEST_LENGTH + 1 + 16 + 1)
+
+typedef struct {
+   size_t       chunk_no;
+   DedupFP      fp;
+   char         pre[MARFS_MAX_PRE_SIZE];  // object holding the chunk's data
+} DedupEntry;
+
+typedef struct DedupTable {
+   DedupHash    hash;         // writer: user-data of the current chunk
+   size_t       count;
+   size_t       alloc;
+   DedupEntry*  entry;        // in chunk_no order
+} DedupTable;
+
+
+void        dedup_hash_init  (DedupHash* dh, const MarFS_XattrPre* pre);
+void        dedup_hash_update(DedupHash* dh, const void* buf, size_t len);
+DedupFP     dedup_hash_final (DedupHash* dh);
+
+// Writers add user-data with dedup_update(), call dedup_chunk() when
+// each full chunk has been closed, and dedup_publish() when the file is
+// closed (after all PUTs are done).
+void        dedup_update (MarFS_FileHandle* fh, const char* buf, size_t size);
+void        dedup_chunk  (MarFS_FileHandle* fh);
+void        dedup_publish(MarFS_FileHandle* fh);
+
+// Readers (and GC) load the table of a file with POST_DEDUP.  open_data()
+// calls dedup_redirect() so that reads of a shared chunk go to the object
+// holding the data.
+int         dedup_load    (PathInfo* info);
+void        dedup_free    (PathInfo* info);
+DedupEntry* dedup_find    (const DedupTable* dt, size_t chunk_no);
+int         dedup_redirect(PathInfo* info);
+
+// GC: dedup_unref() returns 1 if <ent> held the last reference to its
+// object, which should then be deleted with dedup_delete().  <pre> is
+// the file's PRE, whose repo and namespace select the index.
+int         dedup_unref   (const MarFS_XattrPre* pre, const DedupEntry* ent,
+                           const char* own_pre);
+int         dedup_delete  (MarFS_FileHandle* fh, const DedupEntry* ent);
+
+// trash_truncate() copies the table to the trash-file.  Returns 1 if
+// there was one.
+int         dedup_copy_xattr(PathInfo* info, const char* dest_path);
+
+
+#endif
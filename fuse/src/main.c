@@ -74,6 +74,7 @@ OF SUCH DAMAGE.
 #include "marfs_base.h"
 #include "marfs_ops.h"
 #include "push_user.h"
+#include "pi_cache.h"
 
 #include <sys/stat.h>
 #include <stdlib.h>
@@ -921,6 +922,12 @@ int main(int argc, char* argv[])
    // initializations to support stat_xattrs() and save_xattrs()
    init_xattr_specs();
 
+   // recent stat_regular() / stat_xattrs() results, shared across ops
+   if (pi_cache_init()) {
+      fprintf(stderr, "pi_cache_init() failed.  Quitting\n");
+      return -1;
+   }
+
 
    // initialize libaws4c/libcurl
    //
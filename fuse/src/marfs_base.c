@@ -112,12 +112,12 @@ DEFINE_DECODE(obj_type, MarFS_ObjType);
 
 // --- encode_compression() / decode_compression()
 // DEFINE_ENCODE(compression, MarFS_CompType, "_R");
-DEFINE_ENCODE(compression, MarFS_CompType, "_");
+DEFINE_ENCODE(compression, MarFS_CompType, "_L");
 DEFINE_DECODE(compression, MarFS_CompType);
 
 // --- encode_correction() / decode_correction()
 // DEFINE_ENCODE(correction, MarFS_CorrectType, "_CKHRE");
-DEFINE_ENCODE(correction, MarFS_CorrectType, "_");
+DEFINE_ENCODE(correction, MarFS_CorrectType, "_C");
 DEFINE_DECODE(correction, MarFS_CorrectType);
 
 // --- encode_encryption() / decode_encryption()
@@ -863,7 +863,7 @@ int init_post(MarFS_XattrPost* post, MarFS_Namespace* ns, MarFS_Repo* repo) {
 
 // from MarFS_XattrPost to string
 //
-// <repo> is the repo> that was written to.
+// <repo> is the repo> that was written to.  (May be NULL, if unknown.)
 //
 // <add_md_path> allows future version of write_recoveryinfo() to stringify
 // post without setting POST_TRASH in MarFS_XattrPost.flags.
@@ -896,7 +896,7 @@ int post_2_str(char*                  post_str,
    //     file-system *OR* to the location of the file in the trash, we can
    //     not currently support moving semi-direct files to the trash.
    //     Deleting a semi-direct file must just delete it.
-   const char* md_path = ( ((repo->access_method == ACCESSMETHOD_SEMI_DIRECT)
+   const char* md_path = ( ((repo && (repo->access_method == ACCESSMETHOD_SEMI_DIRECT))
                             || (post->flags & POST_TRASH)
                             || add_md_path)
                            ? post->md_path
@@ -1304,6 +1304,297 @@ ssize_t str_2_chunkinfo(MultiChunkInfo* chnk, const char* str, const size_t str_
 
 
 
+// ---------------------------------------------------------------------------
+// packed metadata xattr  (see MARFS_MD_XATTR, in marfs_base.h)
+// ---------------------------------------------------------------------------
+
+// sizes of the fixed-width parts of each section
+#define MD_PRE_FIXED      49
+#define MD_POST_FIXED     46
+#define MD_RESTART_FIXED   9
+
+// fail, unless there are <N> more bytes between <PTR> and <BUF>+<SIZE>
+#define MD_ROOM(PTR, BUF, SIZE, N)                                      \
+   if (((PTR) - (BUF)) + (size_t)(N) > (SIZE)) {                        \
+      LOG(LOG_ERR, "packed MD: no room for %lu more bytes\n", (size_t)(N)); \
+      errno = EINVAL;                                                   \
+      return -1;                                                        \
+   }
+
+// strings are a 2-byte length, followed by the chars (no terminal NULL)
+static
+char* md_put_str(char* dest, const char* str, size_t len) {
+   COPY_OUT(dest, len, uint16_t, htons);
+   memcpy(dest, str, len);
+   return (dest + len);
+}
+
+static
+int md_get_str(char* dest, size_t max_size,
+               char** src, const char* buf, size_t size) {
+   uint16_t len;
+
+   MD_ROOM(*src, buf, size, 2);
+   COPY_IN(len, *src, uint16_t, ntohs);
+   MD_ROOM(*src, buf, size, len);
+   if (len >= max_size) {
+      LOG(LOG_ERR, "packed MD: string of %u chars, max is %lu\n", len, max_size);
+      errno = EINVAL;
+      return -1;
+   }
+   memcpy(dest, *src, len);
+   dest[len] = 0;
+   *src += len;
+   return 0;
+}
+
+
+ssize_t md_2_bin(char*                     buf,
+                 size_t                    max_size,
+                 const MarFS_XattrPre*     pre,
+                 const MarFS_XattrPost*    post,
+                 const MarFS_XattrRestart* restart,
+                 const MarFS_Repo*         repo,
+                 int                       add_md_path) {
+   char* dest = buf;
+
+   MD_ROOM(dest, buf, max_size, 2);
+   *dest++ = MARFS_MD_XATTR_VERS;
+   *dest++ = ((pre     ? MD_HAS_PRE     : 0)
+              | (post    ? MD_HAS_POST    : 0)
+              | (restart ? MD_HAS_RESTART : 0));
+
+   if (pre) {
+      const size_t repo_len = strlen(pre->repo->name);
+      const size_t ns_len   = strlen(pre->ns->name);
+      MD_ROOM(dest, buf, max_size, MD_PRE_FIXED +2 +repo_len +2 +ns_len);
+
+      COPY_OUT(dest, pre->config_vers_maj, ConfigVersType, htons);
+      COPY_OUT(dest, pre->config_vers_min, ConfigVersType, htons);
+      *dest++ = encode_obj_type(pre->obj_type);
+      *dest++ = encode_compression(pre->compression);
+      *dest++ = encode_correction(pre->correction);
+      *dest++ = encode_encryption(pre->encryption);
+      COPY_OUT(dest, pre->md_inode,        uint64_t,       htonll);
+      COPY_OUT(dest, pre->md_ctime,        uint64_t,       htonll);
+      COPY_OUT(dest, pre->obj_ctime,       uint64_t,       htonll);
+      *dest++ = pre->unique;
+      COPY_OUT(dest, pre->chunk_size,      uint64_t,       htonll);
+      COPY_OUT(dest, pre->chunk_no,        uint64_t,       htonll);
+      dest = md_put_str(dest, pre->repo->name, repo_len);
+      dest = md_put_str(dest, pre->ns->name,   ns_len);
+   }
+
+   if (post) {
+      // same rule as post_2_str()
+      const char* md_path = ( ((repo && (repo->access_method == ACCESSMETHOD_SEMI_DIRECT))
+                               || (post->flags & POST_TRASH)
+                               || add_md_path)
+                              ? post->md_path
+                              : "");
+      const size_t path_len = strlen(md_path);
+      MD_ROOM(dest, buf, max_size, MD_POST_FIXED +2 +path_len);
+
+      COPY_OUT(dest, post->config_vers_maj,  ConfigVersType, htons);
+      COPY_OUT(dest, post->config_vers_min,  ConfigVersType, htons);
+      *dest++ = encode_obj_type(post->obj_type);
+      COPY_OUT(dest, post->obj_offset,       uint64_t,       htonll);
+      COPY_OUT(dest, post->chunks,           uint64_t,       htonll);
+      COPY_OUT(dest, post->chunk_info_bytes, uint64_t,       htonll);
+      COPY_OUT(dest, post->correct_info,     CorrectInfo,    htonll);
+      COPY_OUT(dest, post->encrypt_info,     EncryptInfo,    htonll);
+      *dest++ = post->flags;
+      dest = md_put_str(dest, md_path, path_len);
+   }
+
+   if (restart) {
+      MD_ROOM(dest, buf, max_size, MD_RESTART_FIXED);
+
+      COPY_OUT(dest, restart->config_vers_maj, ConfigVersType, htons);
+      COPY_OUT(dest, restart->config_vers_min, ConfigVersType, htons);
+      *dest++ = restart->flags;
+      COPY_OUT(dest, restart->mode,            uint32_t,       htonl);
+   }
+
+   return (dest - buf);
+}
+
+
+// NOTE: As with the v1 parsers, we only accept versions we know how to
+//     parse.  (See str_2_pre().)
+#define MD_VERS_CHECK(MAJOR, MINOR)                                     \
+   if ((   (MAJOR) != MARFS_CONFIG_MAJOR)                               \
+       || ((MINOR) >  MARFS_CONFIG_MINOR)) {                            \
+      LOG(LOG_ERR, "xattr vers '%d.%d' != config %d.%d\n",              \
+          (MAJOR), (MINOR),                                             \
+          MARFS_CONFIG_MAJOR, MARFS_CONFIG_MINOR);                      \
+      errno = EINVAL;                                                   \
+      return -1;                                                        \
+   }
+
+int bin_2_md(MarFS_XattrPre*     pre,
+             MarFS_XattrPost*    post,
+             MarFS_XattrRestart* restart,
+             uint8_t*            sections,
+             const char*         buf,
+             size_t              size,
+             uint8_t             reset,
+             int                 parse_md_path) {
+
+   char*          src = (char*)buf;
+   ConfigVersType major;
+   ConfigVersType minor;
+
+   MD_ROOM(src, buf, size, 2);
+   if ((uint8_t)*src != MARFS_MD_XATTR_VERS) {
+      LOG(LOG_ERR, "packed MD vers %d, expected %d\n",
+          (uint8_t)*src, MARFS_MD_XATTR_VERS);
+      errno = EINVAL;
+      return -1;
+   }
+   ++src;
+   *sections = (uint8_t)*src++;
+
+   if (*sections & MD_HAS_PRE) {
+      char  repo_name[MARFS_MAX_REPO_NAME];
+      char  ns_name[MARFS_MAX_OBJID_SIZE]; // more than enough
+
+      MD_ROOM(src, buf, size, MD_PRE_FIXED);
+      COPY_IN(major,           src, ConfigVersType, ntohs);
+      COPY_IN(minor,           src, ConfigVersType, ntohs);
+      MD_VERS_CHECK(major, minor);
+
+      pre->config_vers_maj = major;
+      pre->config_vers_min = minor;
+      pre->obj_type        = decode_obj_type(*src++);
+      pre->compression     = decode_compression(*src++);
+      pre->correction      = decode_correction(*src++);
+      pre->encryption      = decode_encryption(*src++);
+      COPY_IN(pre->md_inode,   src, uint64_t,       ntohll);
+      COPY_IN(pre->md_ctime,   src, uint64_t,       ntohll);
+      COPY_IN(pre->obj_ctime,  src, uint64_t,       ntohll);
+      pre->unique = (uint8_t)*src++;
+      COPY_IN(pre->chunk_size, src, uint64_t,       ntohll);
+      COPY_IN(pre->chunk_no,   src, uint64_t,       ntohll);
+
+      if (md_get_str(repo_name, MARFS_MAX_REPO_NAME,  &src, buf, size)
+          || md_get_str(ns_name, MARFS_MAX_OBJID_SIZE, &src, buf, size))
+         return -1;
+
+      MarFS_Repo* repo = find_repo_by_name(repo_name);
+      if (! repo) {
+         LOG(LOG_ERR, "couldn't find repo '%s'\n", repo_name);
+         errno = EINVAL;
+         return -1;
+      }
+      MarFS_Namespace* ns = find_namespace_by_name(ns_name);
+      if (! ns) {
+         LOG(LOG_ERR, "couldn't find namespace '%s'\n", ns_name);
+         errno = EINVAL;
+         return -1;
+      }
+      pre->repo = repo;
+      pre->ns   = ns;
+
+      // see str_2_pre()
+      if (init_pre_seed(pre, repo)
+          || init_pre_hostname_hash(pre, repo)) {
+         LOG(LOG_ERR, "couldn't generate random-seed/hostname-hash\n");
+         errno = EINVAL;
+         return -1;
+      }
+
+      // callers of str_2_pre() get the object-ID, too
+      if (update_pre(pre))
+         return -1;
+   }
+
+   if (*sections & MD_HAS_POST) {
+      char  md_path[MARFS_MAX_MD_PATH];
+
+      MD_ROOM(src, buf, size, MD_POST_FIXED);
+      COPY_IN(major,                  src, ConfigVersType, ntohs);
+      COPY_IN(minor,                  src, ConfigVersType, ntohs);
+      MD_VERS_CHECK(major, minor);
+
+      post->config_vers_maj = major;
+      post->config_vers_min = minor;
+      post->obj_type        = decode_obj_type(*src++);
+      COPY_IN(post->obj_offset,       src, uint64_t,       ntohll);
+      COPY_IN(post->chunks,           src, uint64_t,       ntohll);
+      COPY_IN(post->chunk_info_bytes, src, uint64_t,       ntohll);
+      COPY_IN(post->correct_info,     src, CorrectInfo,    ntohll);
+      COPY_IN(post->encrypt_info,     src, EncryptInfo,    ntohll);
+      post->flags = (uint8_t)*src++;
+
+      if (md_get_str(md_path, MARFS_MAX_MD_PATH, &src, buf, size))
+         return -1;
+
+      // same as str_2_post(): an empty md_path leaves the caller's alone
+      if (reset)
+         post->md_path[0] = 0;
+      if (parse_md_path && md_path[0])
+         strcpy(post->md_path, md_path);
+   }
+
+   if (*sections & MD_HAS_RESTART) {
+      MD_ROOM(src, buf, size, MD_RESTART_FIXED);
+      COPY_IN(major,                  src, ConfigVersType, ntohs);
+      COPY_IN(minor,                  src, ConfigVersType, ntohs);
+      MD_VERS_CHECK(major, minor);
+
+      restart->config_vers_maj = major;
+      restart->config_vers_min = minor;
+      restart->flags = (uint8_t)*src++;
+      COPY_IN(restart->mode,          src, uint32_t,       ntohl);
+   }
+
+   return 0;
+}
+
+
+int md_bin_2_strs(char*       pre_str,
+                  char*       post_str,
+                  char*       restart_str,
+                  size_t      max_size,
+                  uint8_t*    sections,
+                  const char* buf,
+                  size_t      size) {
+
+   MarFS_XattrPre      pre;
+   MarFS_XattrPost     post;
+   MarFS_XattrRestart  restart;
+
+   memset(&pre,     0, sizeof(pre));
+   memset(&post,    0, sizeof(post));
+   memset(&restart, 0, sizeof(restart));
+
+   if (bin_2_md(&pre, &post, &restart, sections, buf, size, 1, 1))
+      return -1;
+
+   pre_str[0]     = 0;
+   post_str[0]    = 0;
+   restart_str[0] = 0;
+
+   if ((*sections & MD_HAS_PRE)
+       && pre_2_str(pre_str, max_size, &pre))
+      return -1;
+
+   // post.md_path is only non-empty if md_2_bin() stored it
+   if ((*sections & MD_HAS_POST)
+       && post_2_str(post_str, max_size, &post,
+                     ((*sections & MD_HAS_PRE) ? pre.repo : NULL), 1))
+      return -1;
+
+   if ((*sections & MD_HAS_RESTART)
+       && restart_2_str(restart_str, max_size, &restart))
+      return -1;
+
+   return 0;
+}
+
+
+
 // ---------------------------------------------------------------------------
 // validate the results of read_config()
 // ---------------------------------------------------------------------------
@@ -1337,6 +1628,16 @@ int validate_configuration() {
          retval = -1;
       }
 
+      // a stripe-unit must fit in a chunk, so that each round of a
+      // stripe puts at least some data into every object
+      if ((repo->stripe_width > 1)
+          && (repo->stripe_unit > repo->chunk_size - recovery)) {
+         LOG(LOG_ERR, "repo '%s' has stripe_unit (%ld) "
+             "larger than chunk-size less recovery-info (%ld)\n",
+             repo->name, repo->stripe_unit, repo->chunk_size - recovery);
+         retval = -1;
+      }
+
 
 #if 1
       LOG(LOG_WARNING, "DAL installation is now done in read_configuration\n");
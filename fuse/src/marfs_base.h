@@ -310,6 +310,10 @@ extern "C" {
 typedef uint64_t            CorrectInfo;
 typedef uint64_t            EncryptInfo;
 
+// With CORRECTTYPE_CRC32C, a CorrectInfo holds the CRC in the low 32 bits,
+// plus this bit, so that zero still means "nothing was recorded".
+#define CORRECT_INFO_VALID  ((CorrectInfo)1 << 32)
+
 
 // some things can't be done in common/configuration/src
 extern int validate_configuration();
@@ -568,14 +572,26 @@ int update_pre(MarFS_XattrPre* pre);
 // NOTE: The <chunks> field means different things for different object-types.
 //       Multi:  <chunks> is the number of ChunkInfos written in MDFS file
 //       Packed: <chunks> is number of files stored in the object
+//       Striped: <chunks> is the number of objects (and of ChunkInfos)
+//
+// NOTE: For Striped files, <obj_offset> holds the stripe layout, instead
+//       of an offset.  See STRIPE_LAYOUT(), and stripe.h
 
 typedef enum {
    POST_TRASH           = 0x01, // file is in trash?
+   POST_DEDUP           = 0x02, // some chunks are in the dedup xattr (see dedup.h)
 } PostFlags;
 
 typedef uint8_t  PostFlagsType;
 
 
+// stripe-width (objects) and stripe-unit (bytes) of a Striped file, as
+// kept in Post.obj_offset
+#define STRIPE_LAYOUT(WIDTH, UNIT)  (((size_t)(WIDTH) << 56) | (size_t)(UNIT))
+#define STRIPE_WIDTH(POST)          ((size_t)(POST)->obj_offset >> 56)
+#define STRIPE_UNIT(POST)           ((size_t)(POST)->obj_offset & (((size_t)1 << 56) -1))
+
+
 
 
 typedef struct MarFS_XattrPost {
@@ -653,6 +669,86 @@ int str_2_restart(MarFS_XattrRestart* restart, const char* restart_str);
 
 
 
+// Packed metadata (xattr format "v2").
+//
+// The text xattrs above ("v1") cost one lgetxattr() apiece, plus a
+// sscanf() of the object-ID, and together they are often too big for the
+// space GPFS keeps inside the inode.  Instead, save_xattrs() can write
+// Pre, Post and Restart as binary fields (network-byte-order) in the
+// single xattr MARFS_MD_XATTR:
+//
+//   version (1 byte)  = MARFS_MD_XATTR_VERS
+//   sections (1 byte) = OR'ed MDSections, for the parts that follow
+//
+//   Pre:      vers maj/min (2+2), encoded obj_type, compression,
+//             correction, encryption (1 each), md_inode, md_ctime,
+//             obj_ctime (8 each), unique (1), chunk_size, chunk_no (8
+//             each), repo-name and ns-name (2-byte length + chars)
+//
+//   Post:     vers maj/min (2+2), encoded obj_type (1), obj_offset,
+//             chunks, chunk_info_bytes, correct_info, encrypt_info (8
+//             each), flags (1), md_path (2-byte length + chars)
+//
+//   Restart:  vers maj/min (2+2), flags (1), mode (4)
+//
+// The object-ID (Pre.bucket/objid) is not stored; it is regenerated from
+// the fields, as update_pre() always does.  Post.md_path is only stored
+// in the cases where post_2_str() would print it.
+//
+// Readers (stat_xattrs(), and the GPFS scanners) take the packed xattr if
+// it is present, and otherwise fall back to the v1 xattrs.  Files are
+// converted the next time save_xattrs() writes them.  See
+// MarFS_Config.xattr_version.
+
+#define MARFS_MD_XATTR        MarFS_XattrPrefix "md"
+#define MARFS_MD_XATTR_VERS   2
+
+// [same bits as XVT_PRE, XVT_POST, XVT_RESTART, in common.h]
+typedef enum {
+   MD_HAS_PRE      = 0x01,
+   MD_HAS_POST     = 0x02,
+   MD_HAS_RESTART  = 0x04,
+} MDSections;
+
+// Pack the non-NULL structs into <buf>.  <repo> and <add_md_path> are
+// as for post_2_str().  Returns the number of bytes used, or -1.
+ssize_t md_2_bin(char*                     buf,
+                 size_t                    max_size,
+                 const MarFS_XattrPre*     pre,
+                 const MarFS_XattrPost*    post,
+                 const MarFS_XattrRestart* restart,
+                 const MarFS_Repo*         repo,
+                 int                       add_md_path);
+
+// Unpack the sections found in <buf> into the corresponding structs, and
+// return the OR'ed MDSections in <sections>.  <reset> and <parse_md_path>
+// are as for str_2_post().  Pre gets its bucket/objid, as with
+// str_2_pre().
+int bin_2_md(MarFS_XattrPre*     pre,
+             MarFS_XattrPost*    post,
+             MarFS_XattrRestart* restart,
+             uint8_t*            sections,
+             const char*         buf,
+             size_t              size,
+             uint8_t             reset,
+             int                 parse_md_path);
+
+// For tools that handle the v1 strings (e.g. the GPFS scanners).  Each
+// string is the value the corresponding v1 xattr would have.  Absent
+// sections give empty strings.
+int md_bin_2_strs(char*       pre_str,
+                  char*       post_str,
+                  char*       restart_str,
+                  size_t      max_size,
+                  uint8_t*    sections,
+                  const char* buf,
+                  size_t      size);
+
+
+
+
+
+
 // TBD: "Shard" will be used to redirect directory paths via hashing to a
 // set of shards for each directory.
 typedef struct MarFS_XattrShard {
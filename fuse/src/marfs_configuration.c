@@ -595,12 +595,14 @@ int decode_enctype( char code, MarFS_EncryptType *enumeration ) {
 
 /****************************************************************************/
 
-static char comptype_index[] = "_";
+static char comptype_index[] = "_L";
 
 int lookup_comptype( const char* str, MarFS_CompType *enumeration ) {
 
   if ( ! strcasecmp( str, "NONE" )) {
     *enumeration = COMPTYPE_NONE;
+  } else if ( ! strcasecmp( str, "LZ" )) {
+    *enumeration = COMPTYPE_LZ;
   } else {
     return -1;
   }
@@ -611,7 +613,7 @@ int lookup_comptype( const char* str, MarFS_CompType *enumeration ) {
 int encode_comptype( MarFS_CompType enumeration, char *code ) {
 
   if (( enumeration >= COMPTYPE_NONE )	&&
-      ( enumeration <= COMPTYPE_NONE )) {
+      ( enumeration <= COMPTYPE_LZ )) {
 
     *code = comptype_index[enumeration];
   } else {
@@ -635,12 +637,14 @@ int decode_comptype( char code, MarFS_CompType *enumeration ) {
 
 /****************************************************************************/
 
-static char correcttype_index[] = "_";
+static char correcttype_index[] = "_C";
 
 int lookup_correcttype( const char* str, MarFS_CorrectType *enumeration ) {
 
   if ( ! strcasecmp( str, "NONE" )) {
     *enumeration = CORRECTTYPE_NONE;
+  } else if ( ! strcasecmp( str, "CRC32C" )) {
+    *enumeration = CORRECTTYPE_CRC32C;
   } else {
     return -1;
   }
@@ -651,7 +655,7 @@ int lookup_correcttype( const char* str, MarFS_CorrectType *enumeration ) {
 int encode_correcttype( MarFS_CorrectType enumeration, char *code ) {
 
   if (( enumeration >= CORRECTTYPE_NONE )	&&
-      ( enumeration <= CORRECTTYPE_NONE )) {
+      ( enumeration <= CORRECTTYPE_CRC32C )) {
 
     *code = correcttype_index[enumeration];
   } else {
@@ -1328,6 +1332,14 @@ static MarFS_Config_Ptr read_configuration_internal() {
       return NULL;
     }
 
+    // compressed objects are only written (and read back) by the COMPRESS DAL
+    if (( m_repo->comp_type != COMPTYPE_NONE ) &&
+        strcmp( m_repo->dal->name, "COMPRESS" )) {
+      LOG( LOG_ERR, "Repo '%s' has comp_type \"%s\", but DAL %s.  Use COMPRESS.\n",
+           p_repo->name, p_repo->comp_type, m_repo->dal->name );
+      return NULL;
+    }
+
     if ( lookup_correcttype( p_repo->correct_type, &( m_repo->correct_type ))) {
       LOG( LOG_ERR, "Invalid correct_type value of \"%s\".\n", p_repo->correct_type );
       return NULL;
@@ -1373,6 +1385,135 @@ static MarFS_Config_Ptr read_configuration_internal() {
       return NULL;
     }
     m_repo->read_timeout = rd_timeout;
+
+
+    // default Repo.write_buffers = 0 means stream_put() is synchronous
+    // with the PUT.  Values larger than OS_MAX_WR_BUFS are truncated by
+    // stream_init().
+    errno = 0;
+    unsigned long wr_bufs = (p_repo->write_buffers
+                             ? strtoul( p_repo->write_buffers, (char **) NULL, 10 )
+                             : 0);
+    if ( errno || (wr_bufs > (uint8_t)-1)) {
+      LOG( LOG_ERR, "Invalid write_buffers value \"%s\".\n", p_repo->write_buffers );
+      return NULL;
+    }
+    m_repo->write_buffers = wr_bufs;
+
+
+    // default Repo.read_buffers = 0 means no read-ahead in marfs_read().
+    // Values larger than RA_MAX_BUFS are truncated by read_ahead_start().
+    errno = 0;
+    unsigned long rd_bufs = (p_repo->read_buffers
+                             ? strtoul( p_repo->read_buffers, (char **) NULL, 10 )
+                             : 0);
+    if ( errno || (rd_bufs > (uint8_t)-1)) {
+      LOG( LOG_ERR, "Invalid read_buffers value \"%s\".\n", p_repo->read_buffers );
+      return NULL;
+    }
+    m_repo->read_buffers = rd_bufs;
+
+
+    // default Repo.parallel_gets = 0 means marfs_read() issues one GET at
+    // a time.  Values larger than PG_MAX_PARTS are truncated by
+    // parallel_get().
+    errno = 0;
+    unsigned long par_gets = (p_repo->parallel_gets
+                              ? strtoul( p_repo->parallel_gets, (char **) NULL, 10 )
+                              : 0);
+    if ( errno || (par_gets > (uint8_t)-1)) {
+      LOG( LOG_ERR, "Invalid parallel_gets value \"%s\".\n", p_repo->parallel_gets );
+      return NULL;
+    }
+    m_repo->parallel_gets = par_gets;
+
+
+    // default Repo.write_pipeline = 0 means marfs_write() finishes each
+    // chunk before opening the next.  Values larger than OS_MAX_PIPE are
+    // truncated by stream_init().
+    errno = 0;
+    unsigned long wr_pipe = (p_repo->write_pipeline
+                             ? strtoul( p_repo->write_pipeline, (char **) NULL, 10 )
+                             : 0);
+    if ( errno || (wr_pipe > (uint8_t)-1)) {
+      LOG( LOG_ERR, "Invalid write_pipeline value \"%s\".\n", p_repo->write_pipeline );
+      return NULL;
+    }
+    m_repo->write_pipeline = wr_pipe;
+
+
+    // default Repo.hedge_percentile = 0 means GETs are never duplicated.
+    // See fetch_range(), in common.c.
+    errno = 0;
+    unsigned long hedge = (p_repo->hedge_percentile
+                           ? strtoul( p_repo->hedge_percentile, (char **) NULL, 10 )
+                           : 0);
+    if ( errno || (hedge > 99)) {
+      LOG( LOG_ERR, "Invalid hedge_percentile value \"%s\".\n", p_repo->hedge_percentile );
+      return NULL;
+    }
+    m_repo->hedge_percentile = hedge;
+
+
+    // default Repo.read_retries = 0 means a failed GET fails the read.
+    // Only parallel or hedged GETs are retried.  (See fetch_range().)
+    errno = 0;
+    unsigned long rd_retries = (p_repo->read_retries
+                                ? strtoul( p_repo->read_retries, (char **) NULL, 10 )
+                                : 0);
+    if ( errno || (rd_retries > (uint8_t)-1)) {
+      LOG( LOG_ERR, "Invalid read_retries value \"%s\".\n", p_repo->read_retries );
+      return NULL;
+    }
+    if ( rd_retries && (par_gets <= 1) && ! hedge ) {
+      LOG( LOG_ERR, "read_retries requires parallel_gets > 1, or hedge_percentile > 0.\n" );
+      return NULL;
+    }
+    m_repo->read_retries = rd_retries;
+
+    // default Repo.verify_reads = NO
+    m_repo->verify_reads = _FALSE;
+    if ( p_repo->verify_reads
+         && lookup_boolean( p_repo->verify_reads, &( m_repo->verify_reads ))) {
+      LOG( LOG_ERR, "Invalid verify_reads value of \"%s\".\n", p_repo->verify_reads );
+      return NULL;
+    }
+
+    // default Repo.dedup_dir = NULL means chunks are never deduplicated.
+    // See dedup.c.
+    m_repo->dedup_dir = NULL;
+    if ( p_repo->dedup_dir ) {
+      if ( p_repo->dedup_dir[0] != '/' ) {
+        LOG( LOG_ERR, "Repo '%s' dedup_dir \"%s\" is not an absolute path.\n",
+             p_repo->name, p_repo->dedup_dir );
+        return NULL;
+      }
+      m_repo->dedup_dir = strdup( p_repo->dedup_dir );
+    }
+
+    // default Repo.stripe_width = 0 means files written by marfs_write()
+    // go one chunk at a time (Multi).  Values larger than STRIPE_MAX_WIDTH
+    // are truncated by stripe_alloc().  See stripe.h.
+    errno = 0;
+    unsigned long width = (p_repo->stripe_width
+                           ? strtoul( p_repo->stripe_width, (char **) NULL, 10 )
+                           : 0);
+    if ( errno || (width > (uint8_t)-1)) {
+      LOG( LOG_ERR, "Invalid stripe_width value \"%s\".\n", p_repo->stripe_width );
+      return NULL;
+    }
+    m_repo->stripe_width = width;
+
+    // default Repo.stripe_unit = 1 MB.  validate_configuration() checks
+    // that it fits in a chunk.
+    errno = 0;
+    m_repo->stripe_unit = (p_repo->stripe_unit
+                           ? strtoull( p_repo->stripe_unit, (char **) NULL, 10 )
+                           : (1024 * 1024));
+    if ( errno || ! m_repo->stripe_unit ) {
+      LOG( LOG_ERR, "Invalid stripe_unit value \"%s\".\n", p_repo->stripe_unit );
+      return NULL;
+    }
   }
   free( repoList );
 
@@ -1458,6 +1599,30 @@ static MarFS_Config_Ptr read_configuration_internal() {
     m_ns->md_path = strdup( p_ns->md_path );
     m_ns->md_path_len = strlen( p_ns->md_path );
 
+    /* md_shard (optional) */
+    k = 0;
+    while ( p_ns->md_shard && p_ns->md_shard[k] ) {
+      k++;
+    }
+    if ( k ) {
+      m_ns->md_shards = (char **) malloc( sizeof( char * ) * ( k + 1 ));
+      if ( ! m_ns->md_shards ) {
+        LOG( LOG_ERR, "Error allocating memory for the md_shards of namespace \"%s\".\n",
+             m_ns->name );
+        return NULL;
+      }
+      m_ns->md_shards[k] = NULL;
+      m_ns->md_shard_count = k;
+
+      for ( k = 0; k < m_ns->md_shard_count; k++ ) {
+        if ( ! p_ns->md_shard[k]->path ) {
+          LOG( LOG_ERR, "MarFS namespace '%s' has an md_shard with no path.\n", m_ns->name );
+          return NULL;
+        }
+        m_ns->md_shards[k] = strdup( p_ns->md_shard[k]->path );
+      }
+    }
+
 
     /* iwrite_repo */
     m_ns->iwrite_repo = find_repo_by_name( p_ns->iwrite_repo_name );
@@ -1771,6 +1936,40 @@ static MarFS_Config_Ptr read_configuration_internal() {
   marfs_config->mdfs_top     = strdup( config->mdfs_top );
   marfs_config->mdfs_top_len = mdfs_top_len;
 
+  // fuse keeps recent stat/xattr results for this long (msec).  0 turns
+  // the cache off.  See pi_cache.h
+  errno = 0;
+  unsigned long ttl = (config->pi_cache_ttl
+                       ? strtoul( config->pi_cache_ttl, (char **) NULL, 10 )
+                       : 1000);
+  if ( errno || (ttl > (uint32_t)-1)) {
+     LOG( LOG_ERR, "Invalid pi_cache_ttl value \"%s\".\n", config->pi_cache_ttl );
+     return NULL;
+  }
+  marfs_config->pi_cache_ttl = ttl;
+
+  errno = 0;
+  marfs_config->pi_cache_entries = (config->pi_cache_entries
+                                    ? strtoull( config->pi_cache_entries, (char **) NULL, 10 )
+                                    : 8192);
+  if ( errno ) {
+     LOG( LOG_ERR, "Invalid pi_cache_entries value \"%s\".\n", config->pi_cache_entries );
+     return NULL;
+  }
+
+  // 2 = save_xattrs() writes the packed MD xattr, 1 = the old text
+  // xattrs, for sites where older tools still read the MDFS.  Readers
+  // handle both.  See MARFS_MD_XATTR, in marfs_base.h
+  errno = 0;
+  unsigned long xattr_vers = (config->xattr_version
+                              ? strtoul( config->xattr_version, (char **) NULL, 10 )
+                              : 2);
+  if ( errno || (xattr_vers < 1) || (xattr_vers > 2)) {
+     LOG( LOG_ERR, "Invalid xattr_version value \"%s\".\n", config->xattr_version );
+     return NULL;
+  }
+  marfs_config->xattr_version = xattr_vers;
+
   // marfs_config->namespace_list = marfs_namespace_list;
   // marfs_config->namespace_count = namespaceCount;
 
@@ -1781,6 +1980,9 @@ static MarFS_Config_Ptr read_configuration_internal() {
   LOG( LOG_INFO, "\tconfig version         : %d.%d\n", marfs_config->version_major, marfs_config->version_minor );
   LOG( LOG_INFO, "\tconfig mnt_top         : %s\n", marfs_config->mnt_top );
   LOG( LOG_INFO, "\tconfig mdfs_top        : %s\n", marfs_config->mdfs_top );
+  LOG( LOG_INFO, "\tconfig pi_cache_ttl    : %u\n", marfs_config->pi_cache_ttl );
+  LOG( LOG_INFO, "\tconfig pi_cache_entries: %lu\n", marfs_config->pi_cache_entries );
+  LOG( LOG_INFO, "\tconfig xattr_version   : %u\n", marfs_config->xattr_version );
   // LOG( LOG_INFO, "\tconfig namespace count : %lu\n", marfs_config->namespace_count );
   LOG( LOG_INFO, "\tconfig repo count      : %d\n", repoCount );
   fflush( stdout );
@@ -1833,6 +2035,7 @@ static int free_configuration_internal( MarFS_Config_Ptr *config ) {
     free( marfs_repo_list[j]->name );
     free( marfs_repo_list[j]->host );
     free( marfs_repo_list[j]->online_cmds );
+    free( marfs_repo_list[j]->dedup_dir );
     free( marfs_repo_list[j] );
 
     struct DAL* dal = marfs_repo_list[j]->dal;
@@ -1849,6 +2052,11 @@ static int free_configuration_internal( MarFS_Config_Ptr *config ) {
     free( marfs_namespace_list[j]->mnt_path );
     free( marfs_namespace_list[j]->md_path );
 
+    for ( k = 0; k < marfs_namespace_list[j]->md_shard_count; k++ ) {
+      free( marfs_namespace_list[j]->md_shards[k] );
+    }
+    free( marfs_namespace_list[j]->md_shards );
+
 /*
  * The only dynamically allocated part of a namespace_repo_range_list
  * is a pointer to the repo itself. The repos were all freed in the
@@ -1964,6 +2172,8 @@ int debug_xdal_config_options(xDALConfigOpt** opt) {
 }
 
 int debug_namespace( MarFS_Namespace* ns ) {
+   int i;
+
    fprintf(stdout, "Namespace\n");
    fprintf(stdout, "\tname                %s\n",   ns->name );
    fprintf(stdout, "\tname_len            %ld\n",  ns->name_len);
@@ -1973,6 +2183,8 @@ int debug_namespace( MarFS_Namespace* ns ) {
    fprintf(stdout, "\tiperms              0x%x\n", ns->iperms);
    fprintf(stdout, "\tmd_path             %s\n",   ns->md_path);
    fprintf(stdout, "\tmd_path_len         %ld\n",  ns->md_path_len);
+   for (i=0; i<ns->md_shard_count; ++i)
+      fprintf(stdout, "\tmd_shard[%d]         %s\n",   i, ns->md_shards[i]);
    fprintf(stdout, "\tiwrite_repo         %s\n",   ns->iwrite_repo->name);
 
    fprintf(stdout, "\trepo_range_list\n");
@@ -2033,6 +2245,16 @@ int debug_repo (MarFS_Repo* repo ) {
    fprintf(stdout, "\tonline_cmds         %s\n",   repo->online_cmds);
    fprintf(stdout, "\tonline_cmds_len     %ld\n",  repo->online_cmds_len);
    fprintf(stdout, "\tlatency             %llu\n", repo->latency);
+   fprintf(stdout, "\twrite_buffers       %d\n",   repo->write_buffers);
+   fprintf(stdout, "\tread_buffers        %d\n",   repo->read_buffers);
+   fprintf(stdout, "\tparallel_gets       %d\n",   repo->parallel_gets);
+   fprintf(stdout, "\twrite_pipeline      %d\n",   repo->write_pipeline);
+   fprintf(stdout, "\thedge_percentile    %d\n",   repo->hedge_percentile);
+   fprintf(stdout, "\tread_retries        %d\n",   repo->read_retries);
+   fprintf(stdout, "\tverify_reads        %d\n",   repo->verify_reads);
+   fprintf(stdout, "\tdedup_dir           %s\n",   repo->dedup_dir);
+   fprintf(stdout, "\tstripe_width        %d\n",   repo->stripe_width);
+   fprintf(stdout, "\tstripe_unit         %ld\n",  repo->stripe_unit);
    fprintf(stdout, "\ttiming_flags        0x%x\n", repo->timing_flags);
 
    return 0;
@@ -230,11 +230,13 @@ extern const char* securitymethod_string( MarFS_SecurityMethod method );
 
 typedef enum {
    COMPTYPE_NONE = 0,
+   COMPTYPE_LZ,                  // LZ77 frames, written by the COMPRESS DAL
 } MarFS_CompType;
 
 
 typedef enum {
    CORRECTTYPE_NONE = 0,
+   CORRECTTYPE_CRC32C,           // per-chunk CRC32C of user-data (see crc32c.h)
 } MarFS_CorrectType;
 
 // // this type is for per-object correction-values, stored in obj-ID
@@ -409,6 +411,16 @@ typedef struct marfs_repo {
    unsigned long long    latency;
    uint32_t              write_timeout;
    uint32_t              read_timeout;
+   uint8_t               write_buffers; // ObjectStream write-ring. 0,1 = none
+   uint8_t               read_buffers;  // marfs_read() read-ahead.  0,1 = none
+   uint8_t               parallel_gets; // concurrent GETs per marfs_read().  0,1 = serial
+   uint8_t               write_pipeline; // chunk PUTs in flight per stream.  0,1 = serial
+   uint8_t               hedge_percentile; // latency pctile before hedging a GET.  0 = never
+   uint8_t               read_retries;  // re-issue failed GETs.  0 = never
+   MarFS_Bool            verify_reads;  // check CORRECTTYPE_CRC32C on sequential reads
+   char                 *dedup_dir;     // chunk-fingerprint index.  NULL = no dedup
+   uint8_t               stripe_width;  // objects per stripe (OBJ_STRIPED).  0,1 = Multi
+   size_t                stripe_unit;   // bytes per object, per round of a stripe
 }
    MarFS_Repo,
    *MarFS_Repo_Ptr,
@@ -488,6 +500,9 @@ typedef struct marfs_namespace {
    char                 *md_path;
    size_t                md_path_len;
 
+   char                **md_shards;        // extra MDFS roots for file MD (see shard.h)
+   int                   md_shard_count;   // 0 = not sharded
+
    MarFS_Repo_Ptr        iwrite_repo;
    MarFS_Repo_Range_List repo_range_list;
    int                   repo_range_list_count;
@@ -570,6 +585,9 @@ typedef struct marfs_config {
   size_t                mnt_top_len;
   char                 *mdfs_top;        // NOTE: Do NOT include a final slash.
   size_t                mdfs_top_len;
+  uint32_t              pi_cache_ttl;     // msec.  0 = no PathInfo cache (see pi_cache.h)
+  size_t                pi_cache_entries; // max entries in PathInfo cache
+  uint8_t               xattr_version;    // format save_xattrs() writes (see MARFS_MD_XATTR)
 
   MarFS_RunTime_Config  runtime;
 
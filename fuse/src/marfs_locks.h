@@ -111,8 +111,7 @@ extern "C" {
       if (PSL_wait_with_timeout((SEM_PTR), (TIMEOUT_SEC))) {            \
          LOG(LOG_ERR, "PSL_wait_with_timeout failed. (%s)  Killing thread.\n", strerror(errno)); \
          (OS_PTR)->flags |= OSF_TIMEOUT_K;                              \
-         /* pthread_kill((OS_PTR)->op, SIGKILL); */                     \
-         pthread_cancel((OS_PTR)->op);                                  \
+         cancel_thread(OS_PTR);                                         \
                                                                         \
          LOG(LOG_INFO, "waiting for terminated op-thread\n");           \
          if (stream_wait(os)) {                                         \
@@ -157,8 +156,7 @@ int timed_sem_wait(sem_t* sem, size_t timeout_sec);
       if (timed_sem_wait((SEM_PTR), (TIMEOUT_SEC))) {                   \
          LOG(LOG_ERR, "timed_sem_wait failed. (%s)  Killing thread.\n", strerror(errno)); \
          (OS_PTR)->flags |= OSF_TIMEOUT_K;                              \
-         /* pthread_kill((OS_PTR)->op, SIGKILL); */                     \
-         pthread_cancel((OS_PTR)->op);                                  \
+         cancel_thread(OS_PTR);                                         \
                                                                         \
          LOG(LOG_INFO, "waiting for terminated op-thread\n");           \
          if (stream_wait(os)) {                                         \
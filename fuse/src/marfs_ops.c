@@ -72,6 +72,10 @@ OF SUCH DAMAGE.
 
 #include "common.h"
 #include "marfs_ops.h"
+#include "dedup.h"
+#include "stripe.h"
+#include "pi_cache.h"
+#include "shard.h"
 
 /*
 @@@-HTTPS:
@@ -188,6 +192,7 @@ int marfs_chmod(const char* path,
    // WARNING: No lchmod() on rrz.
    //          chmod() always follows links.
    TRY0( MD_PATH_OP(chmod, info.ns, info.post.md_path, mode) );
+   pi_cache_invalidate(info.post.md_path);
 
    EXIT();
    return 0;
@@ -206,6 +211,7 @@ int marfs_chown (const char* path,
 
    // No need for access check, just try the op
    TRY0( MD_PATH_OP(lchown, info.ns, info.post.md_path, uid, gid) );
+   pi_cache_invalidate(info.post.md_path);
 
    EXIT();
    return 0;
@@ -267,16 +273,32 @@ int marfs_flush (const char*        path,
    ObjectStream*     os     = &fh->os;
    int               retval = 0;
 
+   // PUTs of earlier chunks of a Multi may still be finishing in the
+   // background.  Wait for them, and write their chunk-info, before
+   // writing xattrs.  (See stream_drain().)
+   if (fh->flags & FH_WRITING) {
+      if (stream_drain(os))
+         retval = -1;
+      if (flush_chunkinfo(fh))
+         retval = -1;
+   }
+
+   // A striped file never opens <os>.  Its objects are finished here, and
+   // POST describes the layout.  (See stripe.h)
+   int striped = (fh->stripe && (fh->flags & FH_WRITING));
+   if (striped && stripe_close(fh))
+      retval = -1;
+
    // It is now possible that we had never opened the stream, this
    // happens in the case of attempting to overwrite a file for which
    // the user does not have write permission. In this case we simply
    // skip all the operations below and return.  [Also happens for
    // a zero-length file, because no calls to marfs_write() means no
    // opening of the underlying ObjectStream.]
-   if( (fh->flags & FH_WRITING) && !(os->flags & OSF_OPEN) ) {
+   if( (fh->flags & FH_WRITING) && !(os->flags & OSF_OPEN) && ! striped ) {
       LOG(LOG_INFO, "releasing unopened stream.\n");
       EXIT();
-      return 0;
+      return retval;
    }
 
    // close object stream (before closing MDFS file).  For writes, this
@@ -290,6 +312,12 @@ int marfs_flush (const char*        path,
    //
    // NOTE: Even-newer approach: we now allow that maybe read left a stream
    //     open, in an attempt to avoid extra calls to stream_close/reopen.
+   // read-ahead thread may be using the stream
+   if (fh->read_status.read_ahead) {
+      if (read_ahead_stop(fh))
+         retval = -1;
+   }
+
    if (fh->os.flags & OSF_OPEN) {
 
       if (fh->flags & FH_WRITING) {
@@ -313,9 +341,13 @@ int marfs_flush (const char*        path,
       }
    }
 
+   // striped reads keep their own streams
+   if (fh->stripe)
+      stripe_free(fh);
+
    // free aws4c resources if the file is not packed
    if( !(fh->flags & FH_PACKED) ) {
-      aws_iobuf_reset_hard(&os->iob);
+      stream_release(os);
    }
 
    if (! (fh->os.flags & (OSF_ERRORS | OSF_ABORT))) {
@@ -344,6 +376,10 @@ int marfs_flush (const char*        path,
          // reset current chunk-number, so xattrs will represent obj 0
          info->pre.chunk_no = 0;
       }
+
+      // final CRC goes into POST
+      if (fh->flags & FH_WRITING)
+         fold_correctinfo(fh);
    }
 
    // new lock controls access to read() for multi-threaded nfsd
@@ -382,6 +418,7 @@ int marfs_flush (const char*        path,
       off_t size = os->written - fh->write_status.sys_writes;
       if ( MD_PATH_OP(truncate, info->ns, info->post.md_path, size) )
          retval = -1;
+      pi_cache_invalidate(info->post.md_path);
    }
    if (retval) {
       EXIT();
@@ -408,6 +445,8 @@ int marfs_flush (const char*        path,
        && (fh->flags & FH_WRITING)
        && !(fh->flags & FH_Nto1_WRITES)) {
 
+      // chunks that other files already have are swapped for references
+      dedup_publish(fh);
       SAVE_XATTRS(info, MARFS_ALL_XATTRS);
 
       // install final access-mode, if needed. (We might have added our own
@@ -417,6 +456,7 @@ int marfs_flush (const char*        path,
       if (install_final_mode) {
          TRY0( MD_PATH_OP(chmod, info->ns,
                           info->post.md_path, info->restart.mode) );
+         pi_cache_invalidate(info->post.md_path);
       }
    }
 
@@ -628,8 +668,12 @@ int marfs_getattr (const char*  path,
       //
       // NOTE: kernel should already have called readlink, to get past any
       //     symlinks.  lstat here is just to be safe.
+      //
+      // stat_regular() may be answered from the PathInfo cache, e.g. with
+      // results that marfs_readdir() left there.
       LOG(LOG_INFO, "lstat %s\n", info.post.md_path);
-      TRY0( MD_PATH_OP(lstat, info.ns, info.post.md_path, stp) );
+      TRY0( stat_regular(&info) );
+      *stp = info.st;
    }
 
    // mask out setuid bits.  Those are belong to us.  (see marfs_chmod())
@@ -812,8 +856,18 @@ int marfs_mkdir (const char* path,
 
    // Check/act on quota num files
 
+   // directories live in the primary tree (see shard.h)
+   if (info.flags & PI_MD_SHARD) {
+      if (info.st.st_ino) {
+         errno = EEXIST;        // a file, in a shard
+         return -1;
+      }
+      TRY0( shard_primary(&info, path) );
+   }
+
    // No need for access check, just try the op
    TRY0( MD_D_PATH_OP(mkdir, info.ns, info.post.md_path, mode) );
+   pi_cache_invalidate(info.post.md_path);
 
    EXIT();
    return 0;
@@ -875,9 +929,13 @@ int marfs_mknod (const char* path,
       mode |= missing;          // more-permissive mode
    }
 
+   // new files in a sharded NS need the bucket for their directory
+   TRY0( shard_mkbucket(&info, path) );
+
    // No need for access check, just try the op
    // Appropriate mknod-like/open-create-like call filling in fuse structure
    TRY0( MD_PATH_OP(mknod, info.ns, info.post.md_path, mode, rdev) );
+   pi_cache_invalidate(info.post.md_path);
    LOG(LOG_INFO, "mode: (octal) 0%o\n", mode);
 
    // PROBLEM: marfs_open() assumes that a file that exists, which doesn't
@@ -1203,6 +1261,22 @@ int marfs_open(const char*         path,
    }
 
 
+   // CRCs start over for each file written (packed files share a handle)
+   if (fh->flags & FH_WRITING) {
+      fh->write_status.chunk_crc     = 0;
+      fh->write_status.chunk_crc_len = 0;
+      fh->write_status.file_crc      = 0;
+      info->post.correct_info        = 0;
+   }
+
+   // so do chunk fingerprints.  Readers need to know where deduplicated
+   // chunks live.
+   dedup_free(info);
+   if (! (fh->flags & FH_WRITING)
+       && has_all_xattrs(info, XVT_POST)
+       && (info->post.flags & POST_DEDUP))
+      TRY0( dedup_load(info) );
+
    // Install namespace-path (e.g. for writing into recovery-info)
    size_t path_len = strlen(path);
    if (path_len >= MARFS_MAX_NS_PATH) {
@@ -1668,6 +1742,13 @@ static ssize_t marfs_read_internal (const char*        path,
    // (Or on first call from fuse.)
    if (offset != fh->read_status.log_offset) {
 
+      // read-ahead is only useful for sequential reads.  Stopping it
+      // may leave the stream open, which we handle next.
+      if (fh->read_status.read_ahead) {
+         LOG(LOG_INFO, "discontiguous read: stopping read-ahead\n");
+         TRY0( read_ahead_stop(fh) );
+      }
+
       if (os->flags & OSF_OPEN) {
 
          LOG(LOG_INFO, "discontiguous read detected: gap %lu-%lu\n",
@@ -1768,6 +1849,16 @@ static ssize_t marfs_read_internal (const char*        path,
       return 0;
    }
 
+   // Striped objects are read concurrently, bypassing the single-stream
+   // machinery below (read-ahead, parallel_get(), hedged GETs).
+   if (info->post.obj_type == OBJ_STRIPED) {
+      TRY_GE0( stripe_read(fh, buf, size, offset) );
+      TRY0( verify_correctinfo(fh, offset, buf, rc_ssize) );
+      fh->read_status.log_offset = offset + rc_ssize;
+      EXIT();
+      return rc_ssize;
+   }
+
    // portions of each chunk that are used for system-data vs. user-data.
    const size_t recovery   = MARFS_REC_UNI_SIZE; // sys bytes, per chunk
    const size_t data1      = (info->pre.chunk_size - recovery); // log bytes, per chunk
@@ -1809,6 +1900,28 @@ static ssize_t marfs_read_internal (const char*        path,
 
    uint16_t rd_timeout = info->pre.repo->read_timeout;
 
+   // If the repo allows it, sequential reads are served from a ring of
+   // buffers filled by a background thread, which keeps the GET moving
+   // between calls, and opens the next chunk before we get there.  (See
+   // read_ahead_start().)  pftool's marfs_open_at_offset() (data_remain)
+   // already knows exactly what it wants, so it doesn't need this.
+   if (! fh->read_status.read_ahead
+       && (info->pre.repo->read_buffers > 1)
+       && ! fh->read_status.data_remain) {
+
+      if (os->flags & OSF_OPEN)
+         TRY0( close_data(fh, 0, 0) );
+      TRY0( read_ahead_start(fh, offset, max_extent) );
+   }
+   if (fh->read_status.read_ahead) {
+      TRY_GE0( read_ahead_get(fh, buf, size) );
+      TRY0( verify_correctinfo(fh, fh->read_status.log_offset, buf, rc_ssize) );
+      fh->read_status.log_offset += rc_ssize;
+
+      EXIT();
+      return rc_ssize;
+   }
+
    // Starting at the appropriate chunk and offset to match caller's
    // logical offset in the multi-object data, move through successive
    // chunks, reading contiguous user-data (skipping recovery-info), until
@@ -1836,7 +1949,37 @@ static ssize_t marfs_read_internal (const char*        path,
       }
 
 
-      if (! (os->flags & OSF_OPEN)) {
+      // If the repo allows it, and caller wants enough of this chunk to
+      // be worth splitting, fetch it with concurrent GETs, instead of
+      // opening our own stream.  That ignores max_get_size here, but each
+      // of the GETs still respects it.  (See parallel_get().)  If the repo
+      // hedges GETs, reads of at least HEDGE_MIN_SIZE also go this way, so
+      // each GET can be hedged.
+      size_t par_size = 0;
+      if (((info->pre.repo->parallel_gets > 1)
+           || info->pre.repo->hedge_percentile)
+          && ! (os->flags & OSF_OPEN)) {
+
+         par_size = size - read_count;
+         if (par_size > chunk_remain)
+            par_size = chunk_remain;
+         if (par_size > max_read)
+            par_size = max_read;
+         if (fh->read_status.data_remain
+             && (par_size > fh->read_status.data_remain))
+            par_size = fh->read_status.data_remain;
+         if ((par_size < (2 * PG_MIN_PART))
+             && ! (info->pre.repo->hedge_percentile
+                   && (par_size >= HEDGE_MIN_SIZE)))
+            par_size = 0;
+      }
+      if (par_size) {
+         read_size = par_size;
+         TRY0( parallel_get(fh, buf_ptr, chunk_no, chunk_offset, read_size, rd_timeout) );
+         buf_ptr  += read_size;
+      }
+
+      else if (! (os->flags & OSF_OPEN)) {
 
          // update the URL in the ObjectStream, in our FileHandle
          info->pre.chunk_no = chunk_no;
@@ -1878,8 +2021,8 @@ static ssize_t marfs_read_internal (const char*        path,
       //    server doesn't give us everything we asked for.  However, we
       //    may get 206, even for successful reads.
 
-      size_t sub_read = read_size; // bytes remaining within <read_size>
-      do {
+      size_t sub_read = (par_size ? 0 : read_size); // bytes remaining within <read_size>
+      while (sub_read) {
          rc_ssize = DAL_OP(get, fh, buf_ptr, sub_read);
          if ((rc_ssize < 0)
              && (os->iob.code != 200)
@@ -1925,7 +2068,7 @@ static ssize_t marfs_read_internal (const char*        path,
          buf_ptr       += rc_ssize;
          sub_read      -= rc_ssize;
 
-      } while (sub_read);
+      }
       LOG(LOG_INFO, "completed read_size = %lu\n", read_size);
 
       // We got all of read_size.  We're either at the end of this chunk or
@@ -1934,6 +2077,8 @@ static ssize_t marfs_read_internal (const char*        path,
       max_read      -= read_size;
       chunk_remain  -= read_size;
 
+      TRY0( verify_correctinfo(fh, fh->read_status.log_offset,
+                               buf_ptr - read_size, read_size) );
       fh->read_status.log_offset  += read_size;
       if (fh->read_status.data_remain)
          fh->read_status.data_remain -= read_size;
@@ -1941,7 +2086,8 @@ static ssize_t marfs_read_internal (const char*        path,
       // reading more?
       if (read_count < size) {
 
-         TRY0( close_data(fh, 0, 0) );
+         if (os->flags & OSF_OPEN) // not, after parallel_get()
+            TRY0( close_data(fh, 0, 0) );
 
          // ready to move on to the next chunk?
          if (! chunk_remain) {
@@ -1974,6 +2120,171 @@ static ssize_t marfs_read_internal (const char*        path,
 }
 
 
+// "ls -l" or "find -size" on a big directory makes the kernel follow
+// readdir with a lookup (and getattr) for every entry.  Each of those
+// would be another expand_path_info() + lstat() against the MDFS.  When
+// the PathInfo cache is on, marfs_readdir() slips this filler in front of
+// fuse's, which stats each entry as it goes by (with fstatat() on the open
+// directory, where we have one), and leaves the result in the cache for
+// the getattr that follows.  The stat also goes to fuse's filler, which
+// can use at least the file-type.
+//
+// The MD file of a Multi or packed file is truncated to the logical size
+// in marfs_flush(), so this stat already has the size users expect.
+
+typedef struct {
+   void*             buf;       // fuse's
+   marfs_fill_dir_t  filler;    // fuse's
+   MarFS_Namespace*  ns;
+   int               stat_entries;
+   int               skip_dots; // e.g. listing a bucket in an MD shard
+   int               dir_fd;    // -1 means use MD_PATH_OP(lstat, ...)
+   char              md_path[MARFS_MAX_MD_PATH];
+   size_t            md_path_len;
+} ReaddirPlus;
+
+// <md_path> is the MDFS directory about to be listed
+static
+void readdir_plus_dir(ReaddirPlus* rp, const char* md_path) {
+   size_t len = strlen(md_path);
+
+   rp->dir_fd       = -1;
+   rp->stat_entries = (pi_cache_active() && (len +2 < MARFS_MAX_MD_PATH));
+   if (! rp->stat_entries)
+      return;
+
+   memcpy(rp->md_path, md_path, len);
+   if (! len || (rp->md_path[len -1] != '/'))
+      rp->md_path[len++] = '/';
+   rp->md_path[len] = 0;
+   rp->md_path_len  = len;
+}
+
+static
+int readdir_plus_fill(void* buf, const char* name,
+                      const struct stat* stbuf, off_t off) {
+   ReaddirPlus* rp       = (ReaddirPlus*)buf;
+   size_t       name_len = strlen(name);
+   int          dots     = ((! strcmp(name, ".")) || (! strcmp(name, "..")));
+
+   if (dots && rp->skip_dots)
+      return 0;
+   if (dots || ! rp->stat_entries
+       || (rp->md_path_len + name_len >= MARFS_MAX_MD_PATH))
+      return rp->filler(rp->buf, name, stbuf, off);
+
+   PathInfo child = {0};
+   child.ns = rp->ns;
+   memcpy(child.post.md_path, rp->md_path, rp->md_path_len);
+   memcpy(child.post.md_path + rp->md_path_len, name, name_len +1);
+
+   // don't replace an entry that may also be holding xattrs
+   int hit = pi_cache_stat(&child);
+   if (hit < 0)
+      return rp->filler(rp->buf, name, NULL, off); // cached ENOENT
+   else if (! hit) {
+      uint64_t gen = pi_cache_gen(child.post.md_path);
+      int      rc  = ((rp->dir_fd >= 0)
+                      ? fstatat(rp->dir_fd, name, &child.st, AT_SYMLINK_NOFOLLOW)
+                      : MD_PATH_OP(lstat, rp->ns, child.post.md_path, &child.st));
+      if (rc) {
+         // e.g. deleted since readdir() saw it.  Let getattr() sort it out.
+         LOG(LOG_INFO, "couldn't stat %s (%s)\n", child.post.md_path, strerror(errno));
+         return rp->filler(rp->buf, name, NULL, off);
+      }
+      pi_cache_put(&child, 0, gen);
+   }
+
+   child.st.st_mode &= ~(S_ISUID); // see marfs_getattr()
+   return rp->filler(rp->buf, name, &child.st, off);
+}
+
+// list an MDFS directory opened with opendir_md()
+static
+int readdir_md(MarFS_DirHandle*  dh,
+               const char*       path,
+               void*             buf,
+               marfs_fill_dir_t  filler,
+               off_t             offset) {
+   int retval = 0;
+
+#if USE_MDAL
+   retval = D_OP(readdir, dh, path, buf, filler, offset);
+
+#else
+   DIR*           dirp = dh->internal.dirp;
+   struct dirent* dent;
+   ssize_t        rc_ssize;
+
+   if (filler == readdir_plus_fill)
+      ((ReaddirPlus*)buf)->dir_fd = dirfd(dirp);
+
+   while (1) {
+      errno = 0;
+
+      // #if _POSIX_C_SOURCE >= 1 || _XOPEN_SOURCE || _BSD_SOURCE || _SVID_SOURCE || _POSIX_SOURCE
+      //      struct dirent* dent_r;       /* for readdir_r() */
+      //      TRY0( readdir_r(dirp, dent, &dent_r) );
+      //      if (! dent_r)
+      //         break;                 /* EOF */
+      //      if (filler(buf, dent_r->d_name, NULL, 0))
+      //         break;                 /* no more room in <buf>*/
+
+      // #else
+      rc_ssize = (ssize_t)readdir(dirp);
+      if (! rc_ssize) {
+         if (errno)
+            retval = -1;     /* error */
+         break;              /* EOF */
+      }
+      dent = (struct dirent*)rc_ssize;
+      if (filler(buf, dent->d_name, NULL, 0))
+         break;                 /* no more room in <buf>*/
+      // #endif
+   }
+#endif
+
+   return retval;
+}
+
+// In a sharded namespace, files in the directory <info> may also be in
+// its bucket in each MD shard (see shard.h)
+static
+int readdir_shards(PathInfo*     info,
+                   const char*   path,
+                   ReaddirPlus*  rp,
+                   off_t         offset) {
+   TRY_DECLS();
+   int shard;
+
+   TRY0( stat_regular(info) );
+   rp->skip_dots = 1;
+
+   for (shard=1; shard<=info->ns->md_shard_count; ++shard) {
+      PathInfo        bucket = {0};
+      MarFS_DirHandle bdh;
+
+      bucket.ns = info->ns;
+      TRY0( shard_bucket_path(bucket.post.md_path, MARFS_MAX_MD_PATH,
+                              info->ns, shard, info->st.st_ino) );
+      if (stat_regular(&bucket)) {
+         if (errno == ENOENT)
+            continue;           // no files from this dir, in this shard
+         return -1;
+      }
+
+      memset(&bdh, 0, sizeof(bdh));
+      TRY_GT0( opendir_md(&bdh, &bucket) );
+
+      readdir_plus_dir(rp, bucket.post.md_path);
+      int rc = readdir_md(&bdh, path, rp, readdir_plus_fill, offset);
+      closedir_md(&bdh);
+      if (rc)
+         return -1;
+   }
+   return 0;
+}
+
 int marfs_readdir (const char*        path,
                    void*              buf,
                    marfs_fill_dir_t   filler,
@@ -2010,46 +2321,26 @@ int marfs_readdir (const char*        path,
       }
    }
    else {
+      ReaddirPlus rp;
+      rp.buf       = buf;
+      rp.filler    = filler;
+      rp.ns        = info.ns;
+      rp.skip_dots = 0;
+      readdir_plus_dir(&rp, info.post.md_path);
+
+      if (rp.stat_entries)
+         retval = readdir_md(dh, path, &rp, readdir_plus_fill, offset);
+      else
+         retval = readdir_md(dh, path, buf, filler, offset);
 
-#if USE_MDAL
-      retval = D_OP(readdir, dh, path, buf, filler, offset);
-
-#else
-      DIR*           dirp = dh->internal.dirp;
-      struct dirent* dent;
-
-      while (1) {
-         errno = 0;
-
-         // #if _POSIX_C_SOURCE >= 1 || _XOPEN_SOURCE || _BSD_SOURCE || _SVID_SOURCE || _POSIX_SOURCE
-         //      struct dirent* dent_r;       /* for readdir_r() */
-         //      TRY0( readdir_r(dirp, dent, &dent_r) );
-         //      if (! dent_r)
-         //         break;                 /* EOF */
-         //      if (filler(buf, dent_r->d_name, NULL, 0))
-         //         break;                 /* no more room in <buf>*/
-
-         // #else
-         rc_ssize = (ssize_t)readdir(dirp);
-         if (! rc_ssize) {
-            if (errno)
-               retval = -1;     /* error */
-            break;              /* EOF */
-         }
-         dent = (struct dirent*)rc_ssize;
-         if (filler(buf, dent->d_name, NULL, 0))
-            break;                 /* no more room in <buf>*/
-         // #endif
-      }
-#endif
-
+      if (! retval && info.ns->md_shard_count)
+         retval = readdir_shards(&info, path, &rp, offset);
    }
 
    EXIT();
    return retval;
 }
 
-
 // It appears that, unlike readlink(2), we shouldn't return the number of
 // chars in the path.  Also, unlike readlink(2), we *should* write the
 // final '\0' into the caller's buf.
@@ -2161,7 +2452,11 @@ int marfs_release (const char*        path,
    // been called on this object.
    if( !(fh->flags & FH_FLUSHED) ) {
       LOG(LOG_INFO, "flushing unflushed stream\n");
-      TRY0( marfs_flush(path, fh) );
+      int flush_rc = marfs_flush(path, fh);
+      stripe_free(fh);
+      free_chunk_index(fh);
+      dedup_free(&fh->info);
+      TRY0( flush_rc );
       EXIT();
       return 0;
    }
@@ -2177,6 +2472,10 @@ int marfs_release (const char*        path,
    PathInfo*         info = &fh->info;                  /* shorthand */
    ObjectStream*     os   = &fh->os;
 
+   stripe_free(fh);
+   free_chunk_index(fh);
+   dedup_free(info);
+
    EXIT();
    return 0;
 }
@@ -2255,6 +2554,7 @@ int marfs_packed_clear_restart(const char* path) {
       // install more-restrictive mode, if needed.
       if (install_new_mode) {
          TRY0( MD_PATH_OP(chmod, info.ns, info.post.md_path, new_mode) );
+         pi_cache_invalidate(info.post.md_path);
       }
    }
    else
@@ -2274,15 +2574,22 @@ int marfs_release_fh(MarFS_FileHandle* fh) {
 
    ObjectStream*     os   = &fh->os;
 
+   // read-ahead thread may be using the stream
+   TRY0( read_ahead_stop(fh) );
+
    if(fh->os.flags & OSF_OPEN) {
       // Opens are defered.
       // If open_data wasn't called fh->dal_handle.dal will be NULL
       // prevent problems by not closing unopened streams
       TRY0( close_data(fh, 0, 1) );
    }
+   TRY0( stream_drain(os) );
 
    // free aws4c resources
-   aws_iobuf_reset_hard(&os->iob);
+   stream_release(os);
+   stripe_free(fh);
+   free_chunk_index(fh);
+   dedup_free(&fh->info);
 
    //memset(fh, 0, sizeof(MarFS_FileHandle));
 
@@ -2374,6 +2681,7 @@ int marfs_removexattr (const char* path,
    // No need for access check, just try the op
    // Appropriate  removexattr call filling in fuse structure 
    TRY0( MD_PATH_OP(lremovexattr, info.ns, info.post.md_path, name) );
+   pi_cache_invalidate(info.post.md_path);
 
    EXIT();
    return 0;
@@ -2406,9 +2714,40 @@ int marfs_rename (const char* path,
       return -1;
    }
 
+   // In a sharded NS, a directory stays in the primary tree.  A file goes
+   // to the shard for its new name, which may be another MDFS, in which
+   // case rename() fails with EXDEV, and we move the MD file ourselves.
+   // (Callers that write a temp-file and rename it into place expect
+   // rename() to work within a directory.)
+   if (info.flags & PI_MD_SHARD)
+      TRY0( shard_check_dir(&info, path) );
+   if (info2.flags & PI_MD_SHARD) {
+      STAT(&info);
+      if (S_ISDIR(info.st.st_mode)) {
+         if (info2.st.st_ino) {
+            errno = ENOTDIR;    // a file, in a shard
+            return -1;
+         }
+         TRY0( shard_primary(&info2, to) );
+      }
+      else
+         TRY0( shard_mkbucket(&info2, to) );
+   }
+
    // No need for access check, just try the op
    // Appropriate  rename call filling in fuse structure 
-   TRY0( MD_PATH_OP(rename, info.ns, info.post.md_path, info2.post.md_path) );
+   rc = MD_PATH_OP(rename, info.ns, info.post.md_path, info2.post.md_path);
+   if (rc
+       && (errno == EXDEV)
+       && (info.ns == info2.ns)
+       && info.ns->md_shard_count)
+      rc = move_md_file(&info, info2.post.md_path);
+   if (rc)
+      return -1;
+
+   // either one may be a directory
+   pi_cache_invalidate_tree(info.post.md_path);
+   pi_cache_invalidate_tree(info2.post.md_path);
 
    EXIT();
    return 0;
@@ -2436,9 +2775,13 @@ int marfs_rmdir (const char* path) {
       return -1;
    }
 
+   // files in MD shards are in buckets for this directory
+   TRY0( shard_rmbuckets(&info) );
+
    // No need for access check, just try the op
    // Appropriate rmdirlike call filling in fuse structure 
    TRY0( MD_D_PATH_OP(rmdir, info.ns, info.post.md_path) );
+   pi_cache_invalidate(info.post.md_path);
 
    EXIT();
    return 0;
@@ -2476,6 +2819,7 @@ int marfs_setxattr (const char* path,
    // Appropriate  setxattr call filling in fuse structure 
    TRY0( MD_PATH_OP(lsetxattr, info.ns,
                     info.post.md_path, name, value, size, flags) );
+   pi_cache_invalidate(info.post.md_path);
 
    EXIT();
    return 0;
@@ -2510,6 +2854,14 @@ int marfs_statvfs (const char*      path,
    // wipe caller's statbuf
    memset(statbuf, 0, sizeof(struct statvfs));
 
+   // df on the mount is an easy way to see how the connection-pool is doing
+   ConnPoolStats pool;
+   stream_conn_stats(&pool);
+   LOG(LOG_INFO, "conn-pool: idle %lu, hits %lu, misses %lu, "
+       "returned %lu, discarded %lu, reaped %lu\n",
+       pool.idle, pool.hits, pool.misses,
+       pool.returned, pool.discarded, pool.reaped);
+
 
    // Gather total storage accounted for in fsinfo files of all namespaces.
    //
@@ -2688,9 +3040,19 @@ int marfs_symlink (const char* target,
       return -1;
    }
 
+   // symlinks stay in the primary tree, with directories (see shard.h)
+   if (lnk_info.flags & PI_MD_SHARD) {
+      if (lnk_info.st.st_ino) {
+         errno = EEXIST;
+         return -1;
+      }
+      TRY0( shard_primary(&lnk_info, linkname) );
+   }
+
    // No need for access check, just try the op
    // Appropriate  symlink call filling in fuse structure
    TRY0( MD_PATH_OP(symlink, lnk_info.ns, target, lnk_info.post.md_path) );
+   pi_cache_invalidate(lnk_info.post.md_path);
 
    EXIT();
    return 0;
@@ -2728,6 +3090,7 @@ int marfs_truncate (const char* path,
    if (! has_any_xattrs(&info, MARFS_ALL_XATTRS)) {
       LOG(LOG_INFO, "no xattrs\n");
       TRY0( MD_PATH_OP(truncate, info.ns, info.post.md_path, size) );
+      pi_cache_invalidate(info.post.md_path);
       return 0;
    }
 
@@ -2778,6 +3141,9 @@ int marfs_unlink (const char* path) {
 
    STAT(&info);
 
+   // a file in an MD shard is in a bucket that everyone can write
+   TRY0( shard_check_dir(&info, path) );
+
    // rename file with all xattrs into trashdir, preserving objects and paths 
    TRASH_UNLINK(&info, path);
 
@@ -2812,6 +3178,7 @@ int marfs_utime(const char*     path,
    // Appropriate  utimens call filling in fuse structure
    // NOTE: we're assuming expanded path is absolute, so dirfd is ignored
    TRY_GE0( MD_PATH_OP(utime, info.ns, info.post.md_path, buf) );
+   pi_cache_invalidate(info.post.md_path);
 
    EXIT();
    return 0;
@@ -2837,6 +3204,7 @@ int marfs_utimensat(const char*           path,
    // NOTE: we're assuming expanded path is absolute, so dirfd is ignored
    TRY_GE0( MD_PATH_OP(utimensat, info.ns,
                        AT_FDCWD, info.post.md_path, times, flags) );
+   pi_cache_invalidate(info.post.md_path);
 
    EXIT();
    return 0;
@@ -2876,6 +3244,7 @@ int marfs_utimens(const char*           path,
    // NOTE: we're assuming expanded path is absolute, so dirfd is ignored
    TRY_GE0( MD_PATH_OP(utimensat, info.ns,
                        0, info.post.md_path, tv, AT_SYMLINK_NOFOLLOW) );
+   pi_cache_invalidate(info.post.md_path);
 
    EXIT();
    return 0;
@@ -2914,6 +3283,7 @@ ssize_t marfs_write(const char*        path,
        && (info->pre.repo->access_method == ACCESSMETHOD_DIRECT)) {
       LOG(LOG_INFO, "no xattrs, and DIRECT: writing to file\n");
       TRY_GE0( MD_FILE_OP(write, fh, buf, size) );
+      pi_cache_invalidate(info->post.md_path);
 
       return rc_ssize;
    }
@@ -2961,6 +3331,20 @@ ssize_t marfs_write(const char*        path,
 #endif
    }
 
+   // Repo may ask for files written through fuse to be striped across
+   // several concurrent objects.  That is decided at the first write.
+   // (See stripe.h)
+   if (fh->stripe
+       || (! (os->flags & (OSF_OPEN | OSF_CLOSED))
+           && ! os->written
+           && stripe_wanted(fh))) {
+
+      TRY_GE0( stripe_write(fh, buf, size) );
+      os->written += rc_ssize;
+      EXIT();
+      return rc_ssize;
+   }
+
    // If first write allocate space for current obj being written put addr
    //     in fuse open table
    // If first write or if new file length will make object bigger than
@@ -3067,6 +3451,8 @@ ssize_t marfs_write(const char*        path,
       }
 
 
+      update_correctinfo(fh, buf_ptr, fill);
+      dedup_update(fh, buf_ptr, fill);
       TRY_GE0( DAL_OP(put, fh, buf_ptr, fill) );
       buf_ptr    += fill;
       log_offset += fill;
@@ -3074,21 +3460,34 @@ ssize_t marfs_write(const char*        path,
       TRY_GE0( write_recoveryinfo(os, info, fh) );
 
 
-      // close the object
+      // close the object.  With a write-pipeline, the PUT may finish in
+      // the background, while we write the next chunk.  (See
+      // stream_sync_piped().)
       LOG(LOG_INFO, "closing chunk: %ld\n", info->pre.chunk_no);
+      const int piped = (os->flags & OSF_PIPED);
+      if (piped)
+         os->flags |= OSF_RETIRE;
       TRY0( close_data(fh, 0, 0) );
+      dedup_chunk(fh);
 
       // MD file gets per-chunk information
       // pftool (OBJ_Nto1) will install chunkinfo directly.
+      // A retired PUT may still be running.  Its chunk-info waits for it.
       if (info->pre.obj_type != OBJ_Nto1) {
-         TRY0( write_chunkinfo(fh,
-                               // fh->open_offset,
-                               (os->written - fh->write_status.sys_writes),
-                               0) );
+         if (piped)
+            TRY0( queue_chunkinfo(fh,
+                                  (os->written - fh->write_status.sys_writes),
+                                  0) );
+         else
+            TRY0( write_chunkinfo(fh,
+                                  // fh->open_offset,
+                                  (os->written - fh->write_status.sys_writes),
+                                  0) );
       }
 
       // keep count of amount of real chunk-info written into MD file
       info->post.chunk_info_bytes += sizeof(MultiChunkInfo);
+      fold_correctinfo(fh);
 
 
       // if we still have more data to write, prepare for next iteration
@@ -3131,8 +3530,11 @@ ssize_t marfs_write(const char*        path,
 
    // write more data into object. This amount doesn't finish out any
    // object, so don't write chunk-info to MD file.
-   if (write_size)
+   if (write_size) {
+      update_correctinfo(fh, buf_ptr, write_size);
+      dedup_update(fh, buf_ptr, write_size);
       TRY_GE0( DAL_OP(put, fh, buf_ptr, write_size) );
+   }
 
 #if 0
    // EXPERIMENT for NFS
@@ -3237,6 +3639,7 @@ int marfs_create(const char*        path,
    // No need for access check, just try the op
    // Appropriate mknod-like/open-create-like call filling in fuse structure
    TRY0( MD_PATH_OP(mknod, info.ns, info.post.md_path, mode, rdev) );
+   pi_cache_invalidate(info.post.md_path);
 
    EXIT();
    return 0;
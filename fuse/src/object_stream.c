@@ -97,6 +97,40 @@ OF SUCH DAMAGE.
 
 void stream_reset(ObjectStream* os, uint8_t preserve_os_written);
 
+// op-thread pool (see below)
+static int  op_start(ObjectStream* os);
+static int  op_tryjoin(ObjectStream* os);
+static void op_cancel(ObjectStream* os);
+
+// connection pool (see below)
+static AWSContext* conn_pool_get(const void* repo, const char* host);
+static int         conn_pool_put(const void* repo, const char* host, AWSContext* ctx);
+
+// pipelined PUTs (see below)
+struct PipedPut;
+typedef struct PutPipe {
+   const MarFS_Repo*  repo;         // for conn_setup()
+   char               host  [MARFS_MAX_HOST_SIZE];
+   char               bucket[MARFS_MAX_BUCKET_SIZE];
+   uint8_t            depth;        // max PUTs in flight (cur + retired)
+
+   ObjectStream*      cur;          // PUT that is receiving data
+   struct PipedPut {
+      pthread_t       thr;
+      ObjectStream*   os;
+      int             err;          // errno, if the PUT failed
+   }                  retired[OS_MAX_PIPE]; // PUTs finishing in the background
+   uint8_t            head;         // oldest retired PUT
+   uint8_t            count;        // number of retired PUTs
+   int                err;          // first error from a retired PUT
+} PutPipe;
+
+static int  stream_open_piped(ObjectStream* os, size_t chunk_offset,
+                              curl_off_t content_length, uint16_t timeout);
+static int  stream_sync_piped(ObjectStream* os);
+static int  stream_abort_piped(ObjectStream* os);
+static int  pipe_drain(PutPipe* pipe);
+
 
 // With the advent of the DAL and stream_del(), it's starting to make sense
 // to move this aws4c-specific initialization out of marfs_open(), so that
@@ -110,40 +144,58 @@ void stream_reset(ObjectStream* os, uint8_t preserve_os_written);
 // The unused argument is so we can match the format the DAL_OP will expand
 // into, in init_data(), in the case of a non-DAL build.
 
-int stream_init(void* os_void, void* null_void, void* fh_void) {
-   TRY_DECLS();
+// Get a context for <host> in <repo>, with <bucket> installed.  Reuse a
+// pooled AWSContext (and its connection) to that host, if there is one.
+// Host and protocol settings are already installed in a pooled context.
+// Only the bucket might differ.  Otherwise, configure a new clone of the
+// default context.
 
-   MarFS_FileHandle* fh   = (MarFS_FileHandle*)fh_void;
-   PathInfo*         info = &fh->info;
-   ObjectStream*     os   = &fh->os;
-   IOBuf*            b    = &os->iob;
+static
+AWSContext* conn_setup(const MarFS_Repo* repo, char* host, const char* bucket) {
+
+   AWSContext* ctx = NULL;
+   if (ACCESSMETHOD_IS_S3(repo->access_method))
+      ctx = conn_pool_get(repo, host);
+
+   if (ctx) {
+      LOG(LOG_INFO, "host   '%s' (pooled)\n", host);
+      s3_set_bucket_r((char*)bucket, ctx);
+      LOG(LOG_INFO, "bucket '%s'\n", bucket);
+
+      // PUT settings left over from the previous owner.  (GETs always
+      // install a byte-range, in stream_open().)
+      s3_set_content_length_r(0, ctx);
+      s3_chunked_transfer_encoding_r(0, ctx);
+
+      return ctx;
+   }
 
    // Configure a private AWSContext, for this request
-   AWSContext* ctx = aws_context_clone();
-   if (ACCESSMETHOD_IS_S3(info->pre.repo->access_method)) { // (includes S3_EMC)
+   ctx = aws_context_clone();
+   if (ACCESSMETHOD_IS_S3(repo->access_method)) { // (includes S3_EMC)
 
       // install the host and bucket
-      s3_set_host_r(info->pre.host, ctx);
-      LOG(LOG_INFO, "host   '%s'\n", info->pre.host);
-      // fprintf(stderr, "host   '%s'\n", info->pre.host); // for debugging pftool
+      s3_set_host_r(host, ctx);
+      LOG(LOG_INFO, "host   '%s'\n", host);
+      // fprintf(stderr, "host   '%s'\n", host); // for debugging pftool
 
-      s3_set_bucket_r(info->pre.bucket, ctx);
-      LOG(LOG_INFO, "bucket '%s'\n", info->pre.bucket);
+      s3_set_bucket_r((char*)bucket, ctx);
+      LOG(LOG_INFO, "bucket '%s'\n", bucket);
    }
 
-   if (info->pre.repo->access_method == ACCESSMETHOD_S3_EMC) {
+   if (repo->access_method == ACCESSMETHOD_S3_EMC) {
       s3_enable_EMC_extensions_r(1, ctx);
 
       // For now if we're using HTTPS, I'm just assuming that it is without
       // validating the SSL certificate (curl's -k or --insecure flags). If
       // we ever get a validated certificate, we will want to put a flag
       // into the MarFS_Repo struct that says it's validated or not.
-      if ( info->pre.repo->ssl ) {
+      if ( repo->ssl ) {
          s3_https_r( 1, ctx );
          s3_https_insecure_r( 1, ctx );
       }
    }
-   else if (info->pre.repo->access_method == ACCESSMETHOD_SPROXYD) {
+   else if (repo->access_method == ACCESSMETHOD_SPROXYD) {
       s3_enable_Scality_extensions_r(1, ctx);
       s3_sproxyd_r(1, ctx);
 
@@ -151,18 +203,68 @@ int stream_init(void* os_void, void* null_void, void* fh_void) {
       // validating the SSL certificate (curl's -k or --insecure flags). If
       // we ever get a validated certificate, we will want to put a flag
       // into the MarFS_Repo struct that says it's validated or not.
-      if ( info->pre.repo->ssl ) {
+      if ( repo->ssl ) {
          s3_https_r( 1, ctx );
          s3_https_insecure_r( 1, ctx );
       }
    }
 
-   if (info->pre.repo->security_method == SECURITYMETHOD_HTTP_DIGEST) {
+   if (repo->security_method == SECURITYMETHOD_HTTP_DIGEST) {
       s3_http_digest_r(1, ctx);
    }
 
-   // install custom context
-   aws_iobuf_context(b, ctx);
+   return ctx;
+}
+
+
+int stream_init(void* os_void, void* null_void, void* fh_void) {
+   TRY_DECLS();
+
+   MarFS_FileHandle* fh   = (MarFS_FileHandle*)fh_void;
+   PathInfo*         info = &fh->info;
+   ObjectStream*     os   = &fh->os;
+   IOBuf*            b    = &os->iob;
+   const MarFS_Repo* repo = info->pre.repo;
+
+   // open_data() calls us again for every re-open (e.g. the next chunk
+   // of a Multi).  Put the previous context back in the pool, rather
+   // than leaking it.  If the host hasn't changed, we get it right back.
+   if (b->context)
+      stream_release(os);
+
+   // size of the write-ring, if any.  (See stream_put().)
+   os->wr_bufs = ((repo->write_buffers > OS_MAX_WR_BUFS)
+                  ? OS_MAX_WR_BUFS
+                  : repo->write_buffers);
+
+   // install custom context.  A piped stream is being re-opened for the
+   // next chunk, which will go to a new PutPipe.cur, with a context of its
+   // own.  (See stream_open_piped().)
+   if (! (os->flags & OSF_PIPED))
+      aws_iobuf_context(b, conn_setup(repo, info->pre.host, info->pre.bucket));
+
+   os->conn_repo = repo;
+   strncpy(os->conn_host, info->pre.host, MARFS_MAX_HOST_SIZE);
+   os->conn_host[MARFS_MAX_HOST_SIZE -1] = 0;
+
+   // PUTs may be pipelined.  (See stream_open_piped().)  The pipe may
+   // still have PUTs in flight from earlier chunks, which we keep.
+   uint8_t depth = ((repo->write_pipeline > OS_MAX_PIPE)
+                    ? OS_MAX_PIPE
+                    : repo->write_pipeline);
+   if ((depth > 1) && ! os->pipe) {
+      os->pipe = (PutPipe*)calloc(1, sizeof(PutPipe));
+      if (! os->pipe)
+         LOG(LOG_ERR, "couldn't allocate PutPipe.  PUTs will not be pipelined\n");
+   }
+   if (os->pipe) {
+      os->pipe->repo  = repo;
+      os->pipe->depth = depth;
+      strncpy(os->pipe->host,   info->pre.host,   MARFS_MAX_HOST_SIZE);
+      strncpy(os->pipe->bucket, info->pre.bucket, MARFS_MAX_BUCKET_SIZE);
+      os->pipe->host  [MARFS_MAX_HOST_SIZE   -1] = 0;
+      os->pipe->bucket[MARFS_MAX_BUCKET_SIZE -1] = 0;
+   }
 
    return 0;
 }
@@ -178,16 +280,7 @@ int stream_init(void* os_void, void* null_void, void* fh_void) {
 // in libaws4c.
 
 void cancel_thread(ObjectStream* os) {
-   int rc = pthread_cancel(os->op);
-   if (rc) {
-      LOG(LOG_ERR, "cancellation failed (%s), killing thread\n",
-          strerror(errno));
-      pthread_kill(os->op, SIGKILL);
-      LOG(LOG_INFO, "killed thread\n");
-   }
-   else {
-      LOG(LOG_INFO, "cancelled\n");
-   }
+   op_cancel(os);
 
    os->flags |= OSF_CANCELED;
 
@@ -203,26 +296,25 @@ void cancel_thread(ObjectStream* os) {
 // ---------------------------------------------------------------------------
 // stream_wait()
 //
-// Wait until thread completes (and return immediately when that happens).
-// Loop is necessary to handle the case where another thread is also trying
-// to join (in which case, our join gets EINVAL).  This would happen, I
-// think, in the case of dup'ed marfs file-handles.
+// Wait until the op-thread is done with this stream (and return
+// immediately when that happens).  Op-threads are pooled, so we don't
+// actually join them.  Instead, the op-thread posts os->op_done when it
+// returns from s3_op().  (See "OP-THREAD POOL", below.)
 //
-// In the event of a failed join, we now forcibly cancel the thread.  This
+// In the event of a failed wait, we now forcibly cancel the thread.  This
 // simplifies stream_sync(), which can now assume that stream_wait() always
 // succeeds.
 //
-// NOTE: The return from pthread_timedjoin_np() is not the same as the
-//     retval from the thread!  We return 0 if the thread was joined
-//     successfully.  You need to check errno for e.g. curl error-codes
-//     returned from GET/PUT.
+// NOTE: We return 0 if the op completed successfully.  You need to check
+//     errno for e.g. curl error-codes returned from GET/PUT.
 //
 // NOTE: This supports fuse flush.  Fuse flush is not the same as fflush().
 //     Fuse flush means to wait until the all possible reads/writes are
 //     completed, such that no more errors can be generated on this stream.
 //
-// NOTE: Can't use pthread_timedjoin_np(), without #define _GNU_SOURCE.
-//     Not sure I want to do that.
+// NOTE: Dup'ed marfs file-handles could have more than one thread waiting
+//     here.  The first one to get op_done marks the stream OSF_JOINED, and
+//     re-posts op_done, so the others don't have to wait for a timeout.
 //
 // TBD: compare accumulated wait with a max-timeout limit, that could be
 //     provided in e.g. OpenStream.timeout_sec, representing a maximum time
@@ -240,59 +332,21 @@ int stream_wait(ObjectStream* os) {
    static const size_t  default_timeout = 20;
    size_t timeout_sec = (os->timeout ? os->timeout : default_timeout);
 
-   struct timespec timeout;
-   if (clock_gettime(CLOCK_REALTIME, &timeout)) {
-      LOG(LOG_ERR, "failed to get timer '%s'\n", strerror(errno));
-      return -1;                // errno is set
-   }
-   timeout.tv_sec += timeout_sec;
-
-
-   int   rc;
-   void* thread_retval = 0;
-   while (1) {
-
-      // check whether thread has returned.  Could mean a curl error, an S3
-      // protocol error, or server flaking out.  Successful return will
-      // have saved retval in os->op_rc, so we don't have to return it.
-      rc = pthread_timedjoin_np(os->op, &thread_retval, &timeout);
-      LOG(LOG_INFO, "pthread_timedjoin_np returned %d (errno=%d)\n", rc, errno);
-      LOG(LOG_INFO, "thread retval (via os->op_rc) %d\n", os->op_rc);
-
-      if (! rc) {
-         os->flags |= OSF_JOINED;
-         break;                 // joined
-      }
-      else if (rc == ESRCH) {
-         os->flags |= OSF_JOINED;
-         break;                 // no-such thread  (treat as success)
-      }
-      else if (rc == EINVAL) {
-         // EINVAL == another thread is also trying to join (?)  timed-wait
-         // will just return immediately again, and we'll turn into a
-         // busy-wait.  Add an explicit sleep here.  [Alternatively, here's
-         // another idea: If multiple threads are waiting on this thread, then
-         // that implies the fuse handle was dup'ed.  In that case, if we
-         // return success, fuse might still wait until all threads have
-         // flushed?  I don't trust my knowledge of fuse enough to depend on
-         // that.]
-         sleep(1);
-      }
-      else if (rc == ETIMEDOUT) {
-         errno = rc;
-         break;             // timed-out
-      }
-      else {
-         errno = rc;
-         break;             // error
-      }
+   // check whether thread has returned.  Could mean a curl error, an S3
+   // protocol error, or server flaking out.  Successful return will
+   // have saved retval in os->op_rc, so we don't have to return it.
+   if (! TIMED_WAIT(&os->op_done, timeout_sec)) {
+      LOG(LOG_INFO, "op-thread done, retval (via os->op_rc) %d\n", os->op_rc);
+      os->flags |= OSF_JOINED;
+      POST(&os->op_done);       // for any other waiters
    }
 
    // if we failed to join, then cancel the thread
-   if (! (os->flags & OSF_JOINED)) {
-      LOG(LOG_INFO, "join failed: %s\n", strerror(errno));
+   else {
+      LOG(LOG_INFO, "wait failed: %s\n", strerror(errno));
       cancel_thread(os);
-      pthread_tryjoin_np(os->op, &thread_retval);
+      if (! TIMED_WAIT(&os->op_done, 1))
+         os->flags |= OSF_JOINED;
    }
 
    return 0;
@@ -380,10 +434,224 @@ void* s3_op(void* arg) {
    else
       LOG(LOG_INFO, "done (%s)\n", os->url);
 
+   // If stream_put() is waiting for a free slot in the write-ring, it
+   // would otherwise wait until it timed out.  Wake it up, so it can see
+   // that nobody is draining the ring anymore.
+   os->flags |= OSF_OP_DONE;
+   if ((os->flags & OSF_WRITING) && (os->wr_bufs > 1))
+      POST(&os->iob_empty);
+
    return os;
 }
 
 
+
+// ---------------------------------------------------------------------------
+// OP-THREAD POOL
+//
+// Every open stream needs a thread to run the blocking s3_get()/s3_put().
+// [libaws4c only provides blocking requests, which run curl's "easy"
+// interface internally, so we can't drive them all from a few threads
+// running a curl "multi" loop, without replacing libaws4c.]  What we can
+// avoid is creating and destroying a thread for every stream_open().
+// Instead, op-threads that finish an op park themselves on a per-thread
+// semaphore, and the next stream_open() hands its ObjectStream to one of
+// them.  If none are parked, stream_open() starts another.  At most
+// OP_POOL_MAX_IDLE are kept parked, extras exit when their op is done.
+// This is still one blocking thread per open stream.  The thread count
+// grows with the number of streams open at once; pooling only saves the
+// create/teardown cost per open.
+//
+// Nobody joins op-threads.  Instead, when an op-thread is done with a
+// stream, it posts ObjectStream.op_done, which is what stream_wait(),
+// stream_sync(), etc, now wait for.
+//
+// Cancellation: cancel_thread() may only cancel an op-thread while it is
+// still assigned to the caller's stream.  The thread gives up the stream
+// (and posts op_done) while holding op_pool_lock, and then tests for
+// cancellation before parking, so a cancel meant for one stream can never
+// land on an op for some other stream.  A cancelled op-thread posts
+// op_done and exits, from its cleanup-handler.
+//
+// A cancelled op-thread may not have let go by the time stream_close()
+// gives up waiting.  stream_close() then detaches it (op_detach()), under
+// op_pool_lock, so the late op-thread can't post op_done or set
+// OSF_OP_DONE on a later op of the same stream (or on a freed one).
+// ---------------------------------------------------------------------------
+
+#define OP_POOL_MAX_IDLE  64
+
+typedef struct OpWorker {
+   pthread_t                 thr;
+   SEM_T                     go;       // posted when <os> is assigned
+   ObjectStream*             os;       // stream we're running an op for
+   struct OpWorker*          next;     // idle list
+} OpWorker;
+
+static pthread_mutex_t  op_pool_lock       = PTHREAD_MUTEX_INITIALIZER;
+static OpWorker*        op_pool_idle       = NULL;
+static size_t           op_pool_idle_count = 0;
+
+
+// give up our stream, and let waiters know we're done with it.
+// Caller holds op_pool_lock.
+static
+void op_worker_release_os(OpWorker* w) {
+   ObjectStream* os = w->os;
+   if (os) {
+      w->os         = NULL;
+      os->op_worker = NULL;
+      os->flags    |= OSF_OP_DONE;
+      POST(&os->op_done);
+   }
+}
+
+// only runs if we were cancelled (or at normal exit, with w->os == NULL)
+static
+void op_worker_cleanup(void* arg) {
+   OpWorker* w = (OpWorker*)arg;
+
+   pthread_mutex_lock(&op_pool_lock);
+   op_worker_release_os(w);
+   pthread_mutex_unlock(&op_pool_lock);
+
+   SEM_DESTROY(&w->go);
+   free(w);
+}
+
+static
+void* op_worker(void* arg) {
+   OpWorker* w = (OpWorker*)arg;
+
+   pthread_cleanup_push(op_worker_cleanup, w);
+   while (1) {
+
+      // wait for op_start() to give us a stream
+      WAIT(&w->go);
+      s3_op(w->os);
+
+      // NOTE: No cancellation-points (e.g. LOG) between the end of the
+      //     op, and the point where we release the stream.
+      pthread_mutex_lock(&op_pool_lock);
+      op_worker_release_os(w);
+      pthread_mutex_unlock(&op_pool_lock);
+
+      // a cancel that arrived during the op should take effect now,
+      // rather than during the next op.
+      pthread_testcancel();
+
+      // park, unless there are enough parked already
+      pthread_mutex_lock(&op_pool_lock);
+      if (op_pool_idle_count >= OP_POOL_MAX_IDLE) {
+         pthread_mutex_unlock(&op_pool_lock);
+         break;
+      }
+      w->next      = op_pool_idle;
+      op_pool_idle = w;
+      ++ op_pool_idle_count;
+      pthread_mutex_unlock(&op_pool_lock);
+   }
+   pthread_cleanup_pop(1);
+
+   return NULL;
+}
+
+
+// Hand <os> to a parked op-thread, or start a new one.
+static
+int op_start(ObjectStream* os) {
+
+   SEM_INIT(&os->op_done, 0, 0);
+
+   pthread_mutex_lock(&op_pool_lock);
+   OpWorker* w = op_pool_idle;
+   if (w) {
+      op_pool_idle = w->next;
+      -- op_pool_idle_count;
+   }
+   else {
+      w = (OpWorker*)calloc(1, sizeof(OpWorker));
+      if (! w) {
+         pthread_mutex_unlock(&op_pool_lock);
+         LOG(LOG_ERR, "couldn't allocate op-thread\n");
+         errno = ENOMEM;
+         return -1;
+      }
+      SEM_INIT(&w->go, 0, 0);
+
+      pthread_attr_t attr;
+      pthread_attr_init(&attr);
+      pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+      int rc = pthread_create(&w->thr, &attr, &op_worker, w);
+      pthread_attr_destroy(&attr);
+      if (rc) {
+         pthread_mutex_unlock(&op_pool_lock);
+         LOG(LOG_ERR, "pthread_create failed: '%s'\n", strerror(rc));
+         SEM_DESTROY(&w->go);
+         free(w);
+         errno = rc;
+         return -1;
+      }
+      LOG(LOG_INFO, "started new op-thread\n");
+   }
+   w->next       = NULL;
+   w->os         = os;
+   os->op        = w->thr;
+   os->op_worker = w;
+   pthread_mutex_unlock(&op_pool_lock);
+
+   POST(&w->go);
+   return 0;
+}
+
+
+// Like pthread_tryjoin_np().  Return 0 if the op-thread is done with <os>.
+static
+int op_tryjoin(ObjectStream* os) {
+   if (os->flags & OSF_JOINED)
+      return 0;
+   if (! TIMED_WAIT(&os->op_done, 0)) {
+      POST(&os->op_done);       // for stream_wait(), etc
+      return 0;
+   }
+   errno = EBUSY;
+   return -1;
+}
+
+
+// Stop a (cancelled) op-thread that hasn't let go of <os> from ever
+// touching it again.  After this, nobody else posts os->op_done.
+static
+void op_detach(ObjectStream* os) {
+   pthread_mutex_lock(&op_pool_lock);
+   if (os->op_worker) {
+      LOG(LOG_INFO, "detaching op-thread that hasn't let go\n");
+      os->op_worker->os = NULL;
+      os->op_worker     = NULL;
+   }
+   pthread_mutex_unlock(&op_pool_lock);
+}
+
+// Cancel the op-thread, if it is still working on <os>
+static
+void op_cancel(ObjectStream* os) {
+   pthread_mutex_lock(&op_pool_lock);
+   if (os->op_worker) {
+      int rc = pthread_cancel(os->op);
+      if (rc) {
+         LOG(LOG_ERR, "cancellation failed (%s), killing thread\n",
+             strerror(rc));
+         pthread_kill(os->op, SIGKILL);
+         LOG(LOG_INFO, "killed thread\n");
+      }
+      else {
+         LOG(LOG_INFO, "cancelled\n");
+      }
+   }
+   pthread_mutex_unlock(&op_pool_lock);
+}
+
+
 // ---------------------------------------------------------------------------
 // PUT (write)
 //
@@ -402,6 +670,62 @@ void* s3_op(void* arg) {
 //     return CURL_READFUNC_ABORT.
 // ---------------------------------------------------------------------------
 
+// Write-ring version of streaming_readfunc().  stream_put() has already
+// accounted for the data in os->written, so we don't touch that here.
+// Slots are drained in the order stream_put() filled them.  Because a
+// slot may be larger than curl's buffer, we may leave a slot partially
+// drained, in which case the next callback is pre-approved.
+//
+// stream_abort() doesn't consume a slot.  It just asserts OSF_ABORT and
+// posts iob_full, so we can abandon any data still queued in the ring.
+
+static
+size_t streaming_readfunc_ring(ObjectStream* os, char* ptr, size_t total) {
+
+   // wait for producer to fill a slot
+   WAIT(&os->iob_full);
+
+   // maybe we were requested to abort?
+   if (os->flags & OSF_ABORT) {
+      LOG(LOG_INFO, "(%08lx) got ABORT\n", (size_t)os);
+      POST(&os->iob_empty); // polite
+      return CURL_READFUNC_ABORT;
+   }
+
+   OSWriteBuf* wb = &os->wr_ring[os->wr_tail];
+   LOG(LOG_INFO, "(%08lx) slot %d avail-data: %ld\n",
+       (size_t)os, os->wr_tail, wb->len - wb->pos);
+
+   // maybe we were requested to quit?
+   if (! wb->len) {
+      // called by stream_sync()
+      LOG(LOG_INFO, "(%08lx) got EOF\n", (size_t)os);
+      os->wr_tail = (os->wr_tail +1) % os->wr_bufs;
+      POST(&os->iob_empty); // polite
+      return 0;
+   }
+
+   // move producer's data into curl buffers.
+   // (Might take more than one callback)
+   size_t moved = (wb->len - wb->pos);
+   if (moved > total)
+      moved = total;
+   memcpy(ptr, wb->buf + wb->pos, moved);
+   wb->pos += moved;
+
+   if (wb->pos < wb->len) {
+      LOG(LOG_INFO, "(%08lx) iterating (avail: %ld)\n", (size_t)os, wb->len - wb->pos);
+      POST(&os->iob_full);  // next callback is pre-approved
+   }
+   else {
+      LOG(LOG_INFO, "(%08lx) done with slot %d\n", (size_t)os, os->wr_tail);
+      os->wr_tail = (os->wr_tail +1) % os->wr_bufs;
+      POST(&os->iob_empty); // tell producer that a slot is free
+   }
+
+   return moved;
+}
+
 size_t streaming_readfunc(void* ptr, size_t size, size_t nmemb, void* stream) {
    LOG(LOG_INFO, "entry\n");
 
@@ -410,6 +734,9 @@ size_t streaming_readfunc(void* ptr, size_t size, size_t nmemb, void* stream) {
    size_t        total = (size * nmemb);
    LOG(LOG_INFO, "(%08lx) curl buff %ld\n", (size_t)os, total);
 
+   if (os->wr_bufs > 1)
+      return streaming_readfunc_ring(os, (char*)ptr, total);
+
    // wait for producer to fill buffers
    WAIT(&os->iob_full);
    LOG(LOG_INFO, "(%08lx) avail-data: %ld\n", (size_t)os, b->avail);
@@ -449,13 +776,135 @@ size_t streaming_readfunc(void* ptr, size_t size, size_t nmemb, void* stream) {
    return moved;
 }
 
+// Write-ring version of stream_put().  Copy caller's <buf> into the next
+// free slot, let the readfunc know it's there, and return without waiting
+// for it to be moved into the PUT.  We only wait if all the slots are
+// full.  Because we return before the server has seen the data, any
+// errors from the PUT will be reported by stream_sync().
+//
+// We count the data in os->written as soon as it's accepted, because
+// marfs_write() uses that to track the logical offset.
+//
+// NOTE: Slot-buffers grow to fit the largest stream_put() they have seen.
+//     They are freed in stream_close().
+
+static
+int stream_put_ring(ObjectStream* os,
+                    const char*   buf,
+                    size_t        size,
+                    uint16_t      timeout_sec) {
+
+   // stream_abort() has already asserted OSF_ABORT.  The readfunc will
+   // see that, without needing a slot.
+   if (buf == (const char*)1) {
+      LOG(LOG_INFO, "(%08lx) signalling ABORT\n", (size_t)os);
+      POST(&os->iob_full);
+      return size;
+   }
+
+   // wait for a free slot
+   LOG(LOG_INFO, "(%08lx) waiting %ds for free slot\n", (size_t)os, timeout_sec);
+   SAFE_WAIT(&os->iob_empty, timeout_sec, os);
+
+   // Nobody will drain the ring, if the op-thread has already returned.
+   // (e.g. the PUT failed.)
+   if (os->flags & OSF_OP_DONE) {
+      LOG(LOG_ERR, "(%08lx) op-thread has already returned (%d)\n",
+          (size_t)os, os->op_rc);
+      POST(&os->iob_empty);  // in case there's another waiter
+      errno = EIO;
+      return -1;
+   }
+
+   OSWriteBuf* wb = &os->wr_ring[os->wr_head];
+   if (size > wb->buf_size) {
+      char* new_buf = (char*)realloc(wb->buf, size);
+      if (! new_buf) {
+         LOG(LOG_ERR, "(%08lx) failed to allocate %ld bytes for slot %d\n",
+             (size_t)os, size, os->wr_head);
+         POST(&os->iob_empty);  // slot is still free
+         errno = ENOMEM;
+         return -1;
+      }
+      wb->buf      = new_buf;
+      wb->buf_size = size;
+   }
+   if (size)
+      memcpy(wb->buf, buf, size);
+   wb->len = size;
+   wb->pos = 0;
+   LOG(LOG_INFO, "(%08lx) installed %ld bytes in slot %d\n",
+       (size_t)os, size, os->wr_head);
+
+   os->wr_head  = (os->wr_head +1) % os->wr_bufs;
+   os->written += size;
+
+   // let readfunc move data
+   POST(&os->iob_full);
+
+   return size;
+}
+
+
+// SAFE_WAIT() returns from the caller on timeout.  This lets
+// drain_wr_ring() give back the slots it already took, first.
+static
+int wait_wr_slot(ObjectStream* os, uint16_t timeout_sec) {
+   SAFE_WAIT(&os->iob_empty, timeout_sec, os);
+   return 0;
+}
+
+
+// Wait until the readfunc has drained every slot in the write-ring, so
+// that stream_sync() is only left waiting for the server.  Each slot gets
+// the usual timeout.  Returns -1 (with OSF_TIMEOUT) if the ring stalls.
+// If the op-thread has already returned, there's nothing to wait for.
+static
+int drain_wr_ring(ObjectStream* os) {
+
+   static const uint16_t default_timeout = 20; /* totally made up out of thin air */
+   uint16_t timeout_sec = (os->timeout ? os->timeout : default_timeout);
+
+   int free_slots = 0;
+   while ((free_slots < os->wr_bufs)
+          && !(os->flags & OSF_OP_DONE)) {
+      if (wait_wr_slot(os, timeout_sec)) {
+         while (free_slots--)
+            POST(&os->iob_empty);
+         return -1;
+      }
+      ++free_slots;
+   }
+   LOG(LOG_INFO, "(%08lx) write-ring drained (%d slots)\n", (size_t)os, free_slots);
+
+   // give the slots back, for the EOF in stream_sync()
+   while (free_slots--)
+      POST(&os->iob_empty);
+
+   return 0;
+}
+
+
+static
+void free_wr_ring(ObjectStream* os) {
+   int i;
+   for (i=0; i<OS_MAX_WR_BUFS; ++i) {
+      if (os->wr_ring[i].buf)
+         free(os->wr_ring[i].buf);
+   }
+   memset(os->wr_ring, 0, sizeof(os->wr_ring));
+}
+
+
 // Hand <buf> over to the streaming_readfunc(), so it can be added into
 // the ongoing streaming PUT.  You must call stream_open() first.
 //
 // NOTE: Doing this a little differently from the test_aws.c (case 12)
 //       approach.  We're forcing *synchronous* interaction with the
 //       readfunc, because we don't want caller's <buf> to go out of scope
-//       until the readfunc is finished with it.
+//       until the readfunc is finished with it.  If the repo configures
+//       write_buffers > 1, we copy into a write-ring, instead.  (See
+//       stream_put_ring().)
 //
 int stream_put(ObjectStream* os,
                const char*   buf,
@@ -475,13 +924,27 @@ int stream_put(ObjectStream* os,
       errno = EBADF;
       return -1;
    }
+   if (os->flags & OSF_PIPED) {
+      ObjectStream* cur = os->pipe->cur;
+      int rc = stream_put(cur, buf, size);
+      if (rc < 0)
+         os->flags |= (cur->flags & OSF_ERRORS);
+      else
+         os->written += size;
+      return rc;
+   }
+   if (os->wr_bufs > 1)
+      return stream_put_ring(os, buf, size, timeout_sec);
+
    IOBuf* b = &os->iob;         // shorthand
 
 #if 0
    // QUESTION: Does it improve performance to copy the caller's buffer,
    //    so we can return immediately?
    //
-   // ANSWER: No.
+   // ANSWER: No.  [Not with a single static copy, anyhow.  With several
+   //    buffers, stream_put() can run ahead of the readfunc.  See
+   //    stream_put_ring().]
 
    // readfunc done with IOBuf?
    LOG(LOG_INFO, "(%08lx) waiting %ds for IOBuf\n", (size_t)os, timeout_sec); 
@@ -756,6 +1219,13 @@ ssize_t stream_get(ObjectStream* os,
    SAFE_WAIT(&os->iob_full, timeout_sec, os);
    //   SAFE_WAIT_KILL(&os->iob_full, timeout_sec, os);
 
+   // see stream_interrupt()
+   if (os->flags & OSF_TIMEOUT) {
+      LOG(LOG_INFO, "interrupted\n");
+      errno = EINTR;
+      return -1;
+   }
+
    // writefn detected CURL EOF?
    if (os->flags & OSF_EOF) {
       LOG(LOG_INFO, "EOF is asserted\n");
@@ -845,6 +1315,9 @@ int stream_open(ObjectStream* os,
    if (! preserve_os_written)
       os->written = 0;          // total read/written through OS
 
+   if (put && os->pipe)
+      return stream_open_piped(os, chunk_offset, content_length, timeout);
+
    // caller's open-flags, in case we need to close/repoen
    // (e.g. for Multi, or marfs_ftruncate())
    //
@@ -880,7 +1353,10 @@ int stream_open(ObjectStream* os,
    aws_iobuf_reset(b);          // doesn't affect <user_data> or <context>
 
    if (put) {
-      SEM_INIT(&os->iob_empty, 0, 0);
+      // with a write-ring, iob_empty counts the free slots
+      os->wr_head = 0;
+      os->wr_tail = 0;
+      SEM_INIT(&os->iob_empty, 0, ((os->wr_bufs > 1) ? os->wr_bufs : 0));
       SEM_INIT(&os->iob_full,  0, 0);
       aws_iobuf_readfunc(b, &streaming_readfunc);
    }
@@ -899,8 +1375,8 @@ int stream_open(ObjectStream* os,
 
    // thread runs the GET/PUT, with the iobuf in <os>
    LOG(LOG_INFO, "starting thread\n");
-   if (pthread_create(&os->op, NULL, &s3_op, os)) {
-      LOG(LOG_ERR, "pthread_create failed: '%s'\n", strerror(errno));
+   if (op_start(os)) {
+      LOG(LOG_ERR, "op_start failed: '%s'\n", strerror(errno));
       errno = EIO;  // "something mysterious" went wrong with your write
 
       os->flags &= ~(OSF_OPEN);
@@ -965,8 +1441,6 @@ int stream_open(ObjectStream* os,
 // wait for the S3 GET/PUT to complete
 int stream_sync(ObjectStream* os) {
 
-   void* retval;
-
    // fuse may call fuse-flush multiple times (one for every open stream).
    // but will not call flush after calling close().
    if (! (os->flags & OSF_OPEN)) {
@@ -975,11 +1449,14 @@ int stream_sync(ObjectStream* os) {
       return -1;
    }
 
+   if (os->flags & OSF_PIPED)
+      return stream_sync_piped(os);
+
    // See NOTE, above, regarding the difference between reads and writes.
    if (os->flags & OSF_JOINED) {
       LOG(LOG_INFO, "already joined\n");
    }
-   else if (! pthread_tryjoin_np(os->op, &retval)) {
+   else if (! op_tryjoin(os)) {
       LOG(LOG_INFO, "op-thread joined\n");
       os->flags |= OSF_JOINED;
    }
@@ -1012,6 +1489,18 @@ int stream_sync(ObjectStream* os) {
          wait = 0;
       }
 
+      // With a write-ring, stream_put() returned before its data was sent.
+      // Let the readfunc catch up, before deciding how to end the PUT.
+      // [Otherwise, the content-length test below could succeed while data
+      // is still queued, and stream_wait() would be timing the transfer of
+      // the whole ring.]  If this fails, the put is declared a failure.
+      else if ((os->flags & OSF_WRITING)
+               && (os->wr_bufs > 1)
+               && drain_wr_ring(os)) {
+         LOG(LOG_ERR, "(wr) write-ring failed to drain\n");
+         cancel = 1;
+      }
+
       // Our installed version of libcurl is 7.19.7.  We are experimenting
       // with a custom-built libcurl based on 7.45.0.  We notice that the
       // latter does not call streaming_readfunc() again, if stream_open()
@@ -1103,10 +1592,14 @@ int stream_sync(ObjectStream* os) {
    os->flags |= OSF_JOINED;
 
    // maybe reduce the number of connections in CLOSE_WAIT, by
-   // resetting connections on timed-out obj-streams.
+   // resetting connections on timed-out obj-streams.  Healthy streams
+   // keep their curl-handle, so the connection can be reused by the next
+   // open.  (See CONNECTION POOL, below.)
    IOBuf*      b   = &os->iob;
    AWSContext* ctx = b->context;
-   if (ctx->ch) {
+   if (ctx->ch
+       && ((os->flags & (OSF_ERRORS | OSF_CANCELED))
+           || (os->op_rc && (os->op_rc != CURLE_WRITE_ERROR)))) {
       LOG(LOG_INFO, "resetting connections in curl-handle\n");
       curl_easy_cleanup(ctx->ch);
       ctx->ch = NULL;
@@ -1173,9 +1666,11 @@ int stream_abort(ObjectStream* os) {
       return -1;
    }
 
+   if (os->flags & OSF_PIPED)
+      return stream_abort_piped(os);
+
    // See NOTE, above, regarding the difference between reads and writes.
-   void* retval;
-   if (! pthread_tryjoin_np(os->op, &retval)) {
+   if (! op_tryjoin(os)) {
       LOG(LOG_INFO, "op-thread joined\n");
       os->flags |= OSF_JOINED;
    }
@@ -1206,7 +1701,8 @@ int stream_abort(ObjectStream* os) {
    LOG(LOG_INFO, "op-thread returned %d\n", os->op_rc);
 
    if ((os->op_rc == CURLE_ABORTED_BY_CALLBACK)
-       && (os->iob.read_pos == (char*)1)) {
+       && ((os->iob.read_pos == (char*)1)
+           || (os->wr_bufs > 1))) { // write-ring doesn't use iob
 
       LOG(LOG_INFO, "op-thread return is as expected for ABORT\n");
       return 0;
@@ -1218,6 +1714,18 @@ int stream_abort(ObjectStream* os) {
 }
 
 
+// Reads can't be aborted.  (See stream_abort().)  Instead, we fake the
+// time-out that the reader would eventually see, anyhow.  The extra POST
+// doesn't matter, because the stream is closed next.  If the reader wasn't
+// waiting yet, its next stream_get() returns right away.
+int stream_interrupt(ObjectStream* os) {
+   LOG(LOG_INFO, "interrupting %s\n", os->url);
+   os->flags |= OSF_TIMEOUT;
+   POST(&os->iob_full);
+   return 0;
+}
+
+
 // ---------------------------------------------------------------------------
 // CLOSE
 //
@@ -1241,8 +1749,25 @@ int stream_close(ObjectStream* os) {
       return -1;
    }
 
+   // the PUT itself was in OS.pipe->cur, which stream_sync() or
+   // stream_abort() already closed.
+   if (os->flags & OSF_PIPED) {
+      os->flags &= ~(OSF_OPEN | OSF_RETIRE);
+      os->flags |= OSF_CLOSED;
+      if (os->flags & OSF_THREAD_ERR) {
+         errno = EIO;
+         return -1;
+      }
+      return 0;
+   }
+
    SEM_DESTROY(&os->iob_empty);
    SEM_DESTROY(&os->iob_full);
+   op_detach(os);               // a cancelled op-thread may not have let go
+   SEM_DESTROY(&os->op_done);
+
+   // op-thread is gone, so nobody is looking at the write-ring
+   free_wr_ring(os);
 
    os->flags &= ~(OSF_OPEN);
    os->flags |= OSF_CLOSED;     /* so stream_open() can identify re-opens */
@@ -1279,6 +1804,211 @@ int stream_close(ObjectStream* os) {
 }
 
 
+// ---------------------------------------------------------------------------
+// PIPELINED PUTS
+//
+// Closing one chunk of a Multi means waiting for the server to finish the
+// PUT, before we can open the next chunk.  If the repo has
+// write_pipeline > 1, stream_open() for a PUT instead opens a separate
+// heap-allocated stream (PutPipe.cur, with its own op-thread and
+// AWSContext), and the caller's stream just forwards stream_put() to it,
+// counting OS.written as usual.  When marfs_write() closes a full chunk,
+// it asserts OSF_RETIRE, and stream_sync() hands PutPipe.cur to a
+// background thread, which syncs/closes it, while the caller's stream is
+// re-opened for the next chunk.  At most <depth> PUTs are in flight.
+//
+// Errors from retired PUTs are reported by the next stream_sync(), or by
+// stream_drain().  A stream_sync() without OSF_RETIRE (e.g. from
+// marfs_flush()) waits for all PUTs to complete, so chunk-info and xattrs
+// written after that are only written once the objects are complete.
+// marfs_write() holds the chunk-info of each retired chunk until
+// stream_retired() says its PUT has finished.  (See queue_chunkinfo().)
+// ---------------------------------------------------------------------------
+
+static
+int stream_open_piped(ObjectStream* os,
+                      size_t        chunk_offset,
+                      curl_off_t    content_length,
+                      uint16_t      timeout) {
+   PutPipe* pipe = os->pipe;
+
+   ObjectStream* cur = (ObjectStream*)calloc(1, sizeof(ObjectStream));
+   if (! cur) {
+      LOG(LOG_ERR, "couldn't allocate piped stream\n");
+      errno = ENOMEM;
+      return -1;
+   }
+   strncpy(cur->url, os->url, MARFS_MAX_URL_SIZE);
+   cur->wr_bufs   = os->wr_bufs;
+   cur->conn_repo = pipe->repo;
+   strncpy(cur->conn_host, pipe->host, MARFS_MAX_HOST_SIZE);
+   aws_iobuf_context(&cur->iob, conn_setup(pipe->repo, cur->conn_host, pipe->bucket));
+
+   LOG(LOG_INFO, "(%08lx) piped PUT (%08lx), %d retired\n",
+       (size_t)os, (size_t)cur, pipe->count);
+   if (stream_open(cur, OS_PUT, chunk_offset, content_length, 0, timeout)) {
+      stream_release(cur);
+      free(cur);
+      return -1;
+   }
+
+   pipe->cur       = cur;
+   os->content_len = content_length;
+   os->flags      |= (OSF_OPEN | OSF_WRITING | OSF_PIPED);
+   return 0;
+}
+
+
+// sync/close/free a piped PUT.  Runs in a background thread for retired
+// PUTs.
+static
+void* piped_put_finish(void* arg) {
+   struct PipedPut* p   = (struct PipedPut*)arg;
+   ObjectStream*    cur = p->os;
+
+   int rc  = stream_sync(cur);
+   int err = errno;
+   if (stream_close(cur) && ! rc) {
+      rc  = -1;
+      err = errno;
+   }
+   if (rc)
+      LOG(LOG_ERR, "(%08lx) piped PUT failed: '%s'\n", (size_t)cur, strerror(err));
+
+   stream_release(cur);
+   free(cur);
+
+   p->err = (rc ? (err ? err : EIO) : 0);
+   return NULL;
+}
+
+static
+void pipe_join_oldest(PutPipe* pipe) {
+   struct PipedPut* p = &pipe->retired[pipe->head];
+
+   pthread_join(p->thr, NULL);
+   if (p->err && ! pipe->err)
+      pipe->err = p->err;
+
+   pipe->head = (pipe->head +1) % OS_MAX_PIPE;
+   pipe->count -= 1;
+}
+
+static
+int pipe_drain(PutPipe* pipe) {
+   while (pipe->count)
+      pipe_join_oldest(pipe);
+
+   if (pipe->err) {
+      errno = pipe->err;
+      return -1;
+   }
+   return 0;
+}
+
+
+static
+int stream_sync_piped(ObjectStream* os) {
+   PutPipe*      pipe = os->pipe;
+   ObjectStream* cur  = pipe->cur;
+
+   pipe->cur = NULL;
+   if (cur) {
+      if (os->flags & OSF_RETIRE) {
+
+         // make room
+         if (pipe->count >= (pipe->depth -1))
+            pipe_join_oldest(pipe);
+
+         struct PipedPut* p = &pipe->retired[(pipe->head + pipe->count)
+                                             % OS_MAX_PIPE];
+         p->os  = cur;
+         p->err = 0;
+         if (pthread_create(&p->thr, NULL, &piped_put_finish, p)) {
+            LOG(LOG_ERR, "pthread_create failed: '%s'.  Finishing PUT here\n",
+                strerror(errno));
+            piped_put_finish(p);
+            if (p->err && ! pipe->err)
+               pipe->err = p->err;
+         }
+         else
+            pipe->count += 1;
+      }
+      else {
+         struct PipedPut p = { .os = cur };
+         piped_put_finish(&p);
+         if (p.err && ! pipe->err)
+            pipe->err = p.err;
+      }
+   }
+
+   if (! (os->flags & OSF_RETIRE))
+      pipe_drain(pipe);
+
+   os->flags |= OSF_JOINED;
+   if (pipe->err) {
+      LOG(LOG_ERR, "(%08lx) piped PUT failed: '%s'\n",
+          (size_t)os, strerror(pipe->err));
+      os->flags |= OSF_THREAD_ERR;
+      errno = EIO;
+      return -1;
+   }
+   return 0;
+}
+
+
+// Retired PUTs had all their data, so they are allowed to complete.
+static
+int stream_abort_piped(ObjectStream* os) {
+   PutPipe*      pipe = os->pipe;
+   ObjectStream* cur  = pipe->cur;
+   int           rc   = 0;
+
+   os->flags |= OSF_ABORT;
+   pipe->cur  = NULL;
+   if (cur) {
+      rc = stream_abort(cur);
+      stream_close(cur);
+      stream_release(cur);
+      free(cur);
+   }
+   pipe_drain(pipe);
+
+   os->flags |= OSF_JOINED;
+   return rc;
+}
+
+
+// Retired PUTs are joined in the order they were retired.
+int stream_retired(ObjectStream* os) {
+   PutPipe* pipe = os->pipe;
+   if (! pipe)
+      return 0;
+
+   if (pipe->err) {
+      errno = pipe->err;
+      return -1;
+   }
+   return pipe->count;
+}
+
+
+int stream_drain(ObjectStream* os) {
+   if (! os->pipe)
+      return 0;
+
+   if (pipe_drain(os->pipe)) {
+      LOG(LOG_ERR, "(%08lx) piped PUT failed: '%s'\n",
+          (size_t)os, strerror(os->pipe->err));
+      os->flags |= OSF_THREAD_ERR;
+      errno = EIO;
+      return -1;
+   }
+   return 0;
+}
+
+
+
 // (Unused.)
 //
 // This is the DAL-support complement of stream_init().  It's a place where
@@ -1292,7 +2022,203 @@ int stream_close(ObjectStream* os) {
 
 int stream_destroy(ObjectStream* os) {
    if (os)
-      aws_iobuf_reset_hard(&os->iob);
+      stream_release(os);
+   return 0;
+}
+
+
+
+// ---------------------------------------------------------------------------
+// CONNECTION POOL
+//
+// Each AWSContext has its own curl handle, which keeps the connection
+// open between requests (see aws_reuse_connections(), in main()), along
+// with curl's DNS cache and TLS session.  Previously, every file-handle
+// cloned a fresh context in stream_init(), and freed it in
+// marfs_release(), so every open of a small object paid for DNS, TCP,
+// and TLS setup.  Now, stream_release() parks healthy contexts here,
+// keyed by repo and host, and stream_init() takes them back out.
+//
+// update_pre() picks a random host in the repo for each file, and we only
+// hand out a pooled context that is connected to that host.  Handing out
+// one for another host would undo the random choice, and pile every open
+// onto whichever hosts happen to have idle connections.
+//
+// Contexts idle for longer than CONN_POOL_IDLE_SEC are freed, as are any
+// that don't fit in the pool.
+// ---------------------------------------------------------------------------
+
+#define CONN_POOL_MAX_IDLE   256
+#define CONN_POOL_IDLE_SEC    60
+
+typedef struct ConnPoolEntry {
+   const void*            repo;
+   char                   host[MARFS_MAX_HOST_SIZE];
+   AWSContext*            ctx;
+   time_t                 idle_since;
+   struct ConnPoolEntry*  next;
+} ConnPoolEntry;
+
+static pthread_mutex_t  conn_pool_lock  = PTHREAD_MUTEX_INITIALIZER;
+static ConnPoolEntry*   conn_pool       = NULL;     // most-recent first
+static ConnPoolStats    conn_pool_stats = {0};
+
+
+// aws_iobuf_reset_hard() is what frees a context
+static
+void conn_free(AWSContext* ctx) {
+   IOBuf b;
+   memset(&b, 0, sizeof(IOBuf));
+   aws_iobuf_context(&b, ctx);
+   aws_iobuf_reset_hard(&b);
+}
+
+// Unlink entries that have been idle too long.  Caller holds
+// conn_pool_lock.  Caller frees the returned list, after unlocking.
+static
+ConnPoolEntry* conn_pool_reap(time_t now) {
+   ConnPoolEntry*  reaped = NULL;
+   ConnPoolEntry** pp     = &conn_pool;
+   while (*pp) {
+      ConnPoolEntry* e = *pp;
+      if ((now - e->idle_since) > CONN_POOL_IDLE_SEC) {
+         *pp       = e->next;
+         e->next   = reaped;
+         reaped    = e;
+         -- conn_pool_stats.idle;
+         ++ conn_pool_stats.reaped;
+      }
+      else
+         pp = &e->next;
+   }
+   return reaped;
+}
+
+static
+void conn_pool_free_list(ConnPoolEntry* e) {
+   while (e) {
+      ConnPoolEntry* next = e->next;
+      conn_free(e->ctx);
+      free(e);
+      e = next;
+   }
+}
+
+
+// Return a pooled context for <repo> that is connected to <host>.
+// Returns NULL if there are none.
+static
+AWSContext* conn_pool_get(const void* repo, const char* host) {
+   time_t now = time(NULL);
+
+   pthread_mutex_lock(&conn_pool_lock);
+   ConnPoolEntry* reaped = conn_pool_reap(now);
+
+   ConnPoolEntry** found = NULL;
+   ConnPoolEntry** pp;
+   for (pp = &conn_pool; *pp; pp = &(*pp)->next) {
+      if (((*pp)->repo == repo)
+          && ! strcmp((*pp)->host, host)) {
+         found = pp;
+         break;
+      }
+   }
+
+   AWSContext* ctx = NULL;
+   if (found) {
+      ConnPoolEntry* e = *found;
+      *found = e->next;
+      -- conn_pool_stats.idle;
+      ++ conn_pool_stats.hits;
+
+      ctx = e->ctx;
+      free(e);
+   }
+   else
+      ++ conn_pool_stats.misses;
+
+   pthread_mutex_unlock(&conn_pool_lock);
+
+   conn_pool_free_list(reaped);
+   return ctx;
+}
+
+
+// Add <ctx> to the pool.  Return -1 if the pool is full (in which case
+// the caller still owns <ctx>).
+static
+int conn_pool_put(const void* repo, const char* host, AWSContext* ctx) {
+   ConnPoolEntry* e = (ConnPoolEntry*)malloc(sizeof(ConnPoolEntry));
+   if (! e) {
+      errno = ENOMEM;
+      return -1;
+   }
+   e->repo       = repo;
+   e->ctx        = ctx;
+   e->idle_since = time(NULL);
+   strncpy(e->host, host, MARFS_MAX_HOST_SIZE);
+   e->host[MARFS_MAX_HOST_SIZE -1] = 0;
+
+   pthread_mutex_lock(&conn_pool_lock);
+   ConnPoolEntry* reaped = conn_pool_reap(e->idle_since);
+   int full = (conn_pool_stats.idle >= CONN_POOL_MAX_IDLE);
+   if (full)
+      ++ conn_pool_stats.discarded;
+   else {
+      e->next   = conn_pool;
+      conn_pool = e;
+      ++ conn_pool_stats.idle;
+      ++ conn_pool_stats.returned;
+   }
+   pthread_mutex_unlock(&conn_pool_lock);
+
+   conn_pool_free_list(reaped);
+   if (full) {
+      free(e);
+      errno = ENOSPC;
+      return -1;
+   }
+   return 0;
+}
+
+
+void stream_conn_stats(ConnPoolStats* stats) {
+   pthread_mutex_lock(&conn_pool_lock);
+   *stats = conn_pool_stats;
+   pthread_mutex_unlock(&conn_pool_lock);
+}
+
+
+// Only pool contexts whose connection we trust.  After errors, timeouts,
+// cancellation, or abort, we don't know what state the connection (or
+// the context) is in, so just free it.  Likewise if the stream is still
+// open.
+int stream_release(ObjectStream* os) {
+   IOBuf* b = &os->iob;
+
+   if (b->context && os->conn_repo) {
+      if ((os->flags & (OSF_ERRORS | OSF_CANCELED | OSF_ABORT | OSF_OPEN))
+          || b->context->inside) {
+         pthread_mutex_lock(&conn_pool_lock);
+         ++ conn_pool_stats.discarded;
+         pthread_mutex_unlock(&conn_pool_lock);
+      }
+      else if (! conn_pool_put(os->conn_repo, os->conn_host, b->context)) {
+         LOG(LOG_INFO, "pooled context for '%s'\n", os->conn_host);
+         b->context = NULL;
+      }
+   }
+   os->conn_repo = NULL;
+
+   // a pipe with PUTs in flight is kept until stream_drain()
+   if (os->pipe
+       && ! os->pipe->cur
+       && ! os->pipe->count) {
+      free(os->pipe);
+      os->pipe = NULL;
+   }
+
+   aws_iobuf_reset_hard(b);
    return 0;
 }
 
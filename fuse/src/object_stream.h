@@ -95,10 +95,14 @@ OF SUCH DAMAGE.
 // that the readfunc can properly end the stream with curl (by returning
 // 0).  A similar set of operation is done for fuse_read.
 //
-// TBD: double buffering.  ObjectStream wouldhave 2 IOBufs.  In the writing
-//      case, stream_put would signal readfunc to go ahead, and return
-//      immediately.  Next write would work on the other IOBuf.  See
-//      example-code in test_aws.c, case 12.
+// Multi-buffering (writes): If Repo.write_buffers is > 1, the
+//      ObjectStream uses a ring of that many private buffers, instead of
+//      handing the caller's buffer straight to the readfunc.  stream_put
+//      copies into a free slot, signals the readfunc, and returns
+//      immediately, so marfs_write() can overlap with the PUT.  The
+//      readfunc drains slots in order.  Errors from the PUT are then
+//      reported by stream_sync(), rather than by the stream_put() that
+//      provided the data.  (See example-code in test_aws.c, case 12.)
 //
 // TBD: Should ObjectStream.iob be volatile?  Test code worked without that,
 //      but future changes here might introduce subtle bugs without it.
@@ -142,6 +146,9 @@ typedef enum {
    OSF_CLOSED     = 0x0800,
 
    OSF_THREAD_ERR = 0x1000,     // thread returned non-zero (curl err)
+   OSF_OP_DONE    = 0x2000,     // op-thread has returned (maybe not joined)
+   OSF_PIPED      = 0x4000,     // PUT is forwarded to OS.pipe->cur
+   OSF_RETIRE     = 0x8000,     // stream_sync() may finish the PUT in background
 } OSFlags;
 typedef uint16_t OSFlags_t;
 
@@ -150,6 +157,30 @@ typedef uint16_t OSFlags_t;
 #define OSF_ERRORS (OSF_TIMEOUT | OSF_TIMEOUT_K | OSF_THREAD_ERR)
 
 
+// Max number of slots in the write-ring.  (See Repo.write_buffers.)
+#define OS_MAX_WR_BUFS  16
+
+// One slot in the write-ring.  stream_put() copies caller's data into
+// <buf>, and streaming_readfunc() moves it to curl, advancing <pos>.  A
+// slot with <len> == 0 is the EOF sent by stream_sync().
+typedef struct {
+   char*               buf;
+   size_t              buf_size;  // allocated size of <buf>
+   size_t              len;       // valid data in <buf>
+   size_t              pos;       // amount already moved to curl
+} OSWriteBuf;
+
+
+// Max number of chunk PUTs in flight, per stream.  (See Repo.write_pipeline.)
+#define OS_MAX_PIPE  8
+
+// opaque.  See stream_open_piped(), in object_stream.c
+struct PutPipe;
+
+// opaque.  See "OP-THREAD POOL", in object_stream.c
+struct OpWorker;
+
+
 //  For stream_write(), the op-thread runs s3_put(), and acts as a
 //  consumer.  It waits for iob_full to be set by stream_write(), and then
 //  begins to interact with the streaming_readfunc() to move data to curl
@@ -161,6 +192,10 @@ typedef uint16_t OSFlags_t;
 //  interact with the streaming_writefunc() to move data from curl [curl is
 //  "writing" the data we are reading] Meanwhile stream_read() waits for
 //  the thread to set iob_full, before returning.
+//
+//  With a write-ring (wr_bufs > 1), iob_empty counts free slots and
+//  iob_full counts filled slots.  stream_put() only waits if the ring is
+//  full.
 
 typedef struct {
    // This comes from libaws4c
@@ -170,7 +205,9 @@ typedef struct {
    SEM_T               iob_full;
    SEM_T               read_lock; // concurrent NFS reads
 
-   pthread_t           op;        // GET/PUT
+   pthread_t           op;        // GET/PUT  (pooled thread.  Don't join it)
+   struct OpWorker*    op_worker; // op-thread still assigned to us (under op_pool_lock)
+   SEM_T               op_done;   // posted when the op-thread is done with us
    int                 op_rc;     // typically 0 or -1  (see iob.result, for curl/S3 errors)
    char                url[MARFS_MAX_URL_SIZE]; // WARNING: only valid during open_object()
    size_t              written;   // bytes written-to/read-from stream
@@ -179,6 +216,18 @@ typedef struct {
 
    volatile OSFlags_t  flags;
 
+   OSWriteBuf          wr_ring[OS_MAX_WR_BUFS];
+   uint8_t             wr_bufs;   // slots in use.  0 or 1 means no ring
+   uint8_t             wr_head;   // next slot for stream_put() to fill
+   uint8_t             wr_tail;   // next slot for readfunc to drain
+
+   // connection-pool key for iob.context (see stream_release())
+   const void*         conn_repo;
+   char                conn_host[MARFS_MAX_HOST_SIZE];
+
+   // pipelined PUTs.  NULL unless Repo.write_pipeline > 1
+   struct PutPipe*     pipe;
+
    // OSOpenFlags       open_flags; // caller's open flags, for when we need to close/repoen
 } ObjectStream;
 
@@ -192,6 +241,25 @@ typedef enum {
 int     stream_init(void* os, void* unused, void* fh);
 // int     stream_destroy(void* fh);
 
+// Free aws4c resources in the stream, when the file-handle is done with
+// it.  If the stream's connection is still healthy, the AWSContext (which
+// holds the curl handle, and therefore the connection, the DNS cache, and
+// the TLS session) goes to a process-wide pool, where stream_init() can
+// pick it up for the next stream to the same repo and host.
+int     stream_release(ObjectStream* os);
+
+typedef struct {
+   size_t  idle;         // contexts currently in the pool
+   size_t  hits;         // stream_init() found one for the same host
+   size_t  misses;       // ... had to clone a new context
+   size_t  returned;     // stream_release() added one to the pool
+   size_t  discarded;    // ... freed one (pool full, or stream errors)
+   size_t  reaped;       // idle too long
+} ConnPoolStats;
+
+// counters since startup.  marfs_statvfs() logs them.
+void    stream_conn_stats(ConnPoolStats* stats);
+
 
 // Initialize os.url, before calling.  Use <preserve_os_written> to prevent
 // resetting the count of data written, in os->written.
@@ -214,6 +282,20 @@ int     stream_abort(ObjectStream* os);
 
 int     stream_close(ObjectStream* os);
 
+// From another thread, make a stream_get() that is waiting for the server
+// return now, as though it had timed out.  The owner then does
+// stream_sync(), which cancels the op-thread, and stream_close().
+int     stream_interrupt(ObjectStream* os);
+
+// With a write-pipeline, stream_sync() of an OSF_RETIRE stream returns
+// while the PUT is still finishing.  Wait for all such PUTs.  Returns -1
+// (with OSF_THREAD_ERR) if any of them failed.  No-op on other streams.
+int     stream_drain(ObjectStream* os);
+
+// Number of retired PUTs (see stream_drain()) that haven't finished.  The
+// oldest ones finish first.  Returns -1 if any retired PUT has failed.
+int     stream_retired(ObjectStream* os);
+
 // Reset flags in os to facilitate reopening/reusing an object stream.
 // Must be called in every DAL->open() implementation.
 int stream_cleanup_for_reopen(ObjectStream* os, int preserve_os_written);
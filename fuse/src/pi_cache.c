@@ -0,0 +1,458 @@
+
+/*
+This file is part of MarFS, which is released under the BSD license.
+
+
+Copyright (c) 2015, Los Alamos National Security (LANS), LLC
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation and/or
+other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors
+may be used to endorse or promote products derived from this software without
+specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+-----
+NOTE:
+-----
+MarFS uses libaws4c for Amazon S3 object communication. The original version
+is at https://aws.amazon.com/code/Amazon-S3/2601 and under the LGPL license.
+LANS, LLC added functionality to the original work. The original work plus
+LANS, LLC contributions is found at https://github.com/jti-lanl/aws4c.
+
+GNU licenses can be found at <http://www.gnu.org/licenses/>.
+
+
+From Los Alamos National Security, LLC:
+LA-CC-15-039
+
+Copyright (c) 2015, Los Alamos National Security, LLC All rights reserved.
+Copyright 2015. Los Alamos National Security, LLC. This software was produced
+under U.S. Government contract DE-AC52-06NA25396 for Los Alamos National
+Laboratory (LANL), which is operated by Los Alamos National Security, LLC for
+the U.S. Department of Energy. The U.S. Government has rights to use,
+reproduce, and distribute this software.  NEITHER THE GOVERNMENT NOR LOS
+ALAMOS NATIONAL SECURITY, LLC MAKES ANY WARRANTY, EXPRESS OR IMPLIED, OR
+ASSUMES ANY LIABILITY FOR THE USE OF THIS SOFTWARE.  If software is
+modified to produce derivative works, such modified software should be
+clearly marked, so as not to confuse it with the version available from
+LANL.
+
+THIS SOFTWARE IS PROVIDED BY LOS ALAMOS NATIONAL SECURITY, LLC AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL LOS ALAMOS NATIONAL SECURITY, LLC OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+
+
+#include "common.h"
+#include "pi_cache.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+
+typedef struct PICacheEntry {
+   struct PICacheEntry*  next;        // hash chain
+   struct PICacheEntry*  lru_prev;    // more-recently used
+   struct PICacheEntry*  lru_next;    // less-recently used
+   uint64_t              hash;
+   uint64_t              expires;     // msec, CLOCK_MONOTONIC
+   int                   err;         // non-zero: cached lstat() failure
+
+   struct stat           st;
+   XattrMaskType         found;       // xattrs copied below
+   XattrMaskType         missing;     // xattrs the MD file doesn't have
+   PathInfoFlagType      flags;       // PI_XATTRS_V1
+   MarFS_XattrPre        pre;
+   MarFS_XattrPost       post;        // post.md_path is the key
+   MarFS_XattrRestart    restart;
+} PICacheEntry;
+
+typedef struct {
+   pthread_mutex_t       lock;
+   uint64_t              gen;         // bumped by invalidations
+   PICacheEntry**        bucket;
+   size_t                n_buckets;   // power of 2
+   size_t                count;
+   size_t                max;
+   PICacheEntry*         lru_head;    // most-recently used
+   PICacheEntry*         lru_tail;
+} PICacheShard;
+
+
+static PICacheShard*  pi_shard = NULL; // NULL = no cache
+static uint64_t       pi_ttl;          // msec
+
+
+static
+uint64_t now_msec() {
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ((uint64_t)ts.tv_sec * 1000) + (ts.tv_nsec / 1000000);
+}
+
+// FNV-1a
+static
+uint64_t path_hash(const char* path) {
+   uint64_t h = 0xcbf29ce484222325ULL;
+   for ( ; *path; ++path) {
+      h ^= (uint8_t)*path;
+      h *= 0x100000001b3ULL;
+   }
+   return h;
+}
+
+static inline
+PICacheShard* shard_of(uint64_t hash) {
+   return &pi_shard[hash % PI_CACHE_SHARDS];
+}
+
+static inline
+PICacheEntry** bucket_of(PICacheShard* sh, uint64_t hash) {
+   // low bits chose the shard
+   return &sh->bucket[(hash / PI_CACHE_SHARDS) & (sh->n_buckets -1)];
+}
+
+
+
+int pi_cache_init() {
+   const size_t entries = marfs_config->pi_cache_entries;
+   size_t       i;
+
+   if (pi_shard)
+      return 0;
+   if (! marfs_config->pi_cache_ttl || ! entries) {
+      LOG(LOG_INFO, "PathInfo cache is disabled\n");
+      return 0;
+   }
+
+   PICacheShard* shards = (PICacheShard*)calloc(PI_CACHE_SHARDS, sizeof(PICacheShard));
+   if (! shards) {
+      LOG(LOG_ERR, "couldn't allocate PathInfo cache\n");
+      errno = ENOMEM;
+      return -1;
+   }
+   for (i=0; i<PI_CACHE_SHARDS; ++i) {
+      PICacheShard* sh = &shards[i];
+
+      sh->max       = (entries + PI_CACHE_SHARDS -1) / PI_CACHE_SHARDS;
+      sh->n_buckets = 1;
+      while (sh->n_buckets < sh->max)
+         sh->n_buckets <<= 1;
+
+      sh->bucket = (PICacheEntry**)calloc(sh->n_buckets, sizeof(PICacheEntry*));
+      if (! sh->bucket) {
+         LOG(LOG_ERR, "couldn't allocate PathInfo cache buckets\n");
+         while (i--)
+            free(shards[i].bucket);
+         free(shards);
+         errno = ENOMEM;
+         return -1;
+      }
+      pthread_mutex_init(&sh->lock, NULL);
+   }
+
+   pi_ttl   = marfs_config->pi_cache_ttl;
+   pi_shard = shards;
+   LOG(LOG_INFO, "PathInfo cache: %lu entries, ttl %lu msec\n", entries, pi_ttl);
+   return 0;
+}
+
+
+
+// caller holds sh->lock
+static
+void lru_unlink(PICacheShard* sh, PICacheEntry* e) {
+   if (e->lru_prev)
+      e->lru_prev->lru_next = e->lru_next;
+   else
+      sh->lru_head = e->lru_next;
+
+   if (e->lru_next)
+      e->lru_next->lru_prev = e->lru_prev;
+   else
+      sh->lru_tail = e->lru_prev;
+
+   e->lru_prev = NULL;
+   e->lru_next = NULL;
+}
+
+// caller holds sh->lock
+static
+void lru_push(PICacheShard* sh, PICacheEntry* e) {
+   e->lru_prev = NULL;
+   e->lru_next = sh->lru_head;
+   if (sh->lru_head)
+      sh->lru_head->lru_prev = e;
+   else
+      sh->lru_tail = e;
+   sh->lru_head = e;
+}
+
+// caller holds sh->lock
+static
+void entry_drop(PICacheShard* sh, PICacheEntry* e) {
+   PICacheEntry** pp = bucket_of(sh, e->hash);
+   while (*pp && (*pp != e))
+      pp = &(*pp)->next;
+   if (*pp)
+      *pp = e->next;
+
+   lru_unlink(sh, e);
+   -- sh->count;
+   free(e);
+}
+
+// Find the live entry for <md_path>, and make it most-recent.  Expired
+// entries are dropped.  Caller holds sh->lock.
+static
+PICacheEntry* entry_find(PICacheShard* sh, uint64_t hash, const char* md_path) {
+   PICacheEntry* e;
+
+   for (e = *bucket_of(sh, hash); e; e = e->next) {
+      if ((e->hash == hash) && ! strcmp(e->post.md_path, md_path))
+         break;
+   }
+   if (! e)
+      return NULL;
+
+   if (e->expires <= now_msec()) {
+      entry_drop(sh, e);
+      return NULL;
+   }
+   if (sh->lru_head != e) {
+      lru_unlink(sh, e);
+      lru_push(sh, e);
+   }
+   return e;
+}
+
+
+
+int pi_cache_active() {
+   return (pi_shard != NULL);
+}
+
+
+uint64_t pi_cache_gen(const char* md_path) {
+   if (! pi_shard)
+      return 0;
+
+   PICacheShard* sh = shard_of(path_hash(md_path));
+   pthread_mutex_lock(&sh->lock);
+   uint64_t gen = sh->gen;
+   pthread_mutex_unlock(&sh->lock);
+   return gen;
+}
+
+
+int pi_cache_stat(PathInfo* info) {
+   int rc = 0;
+
+   if (! pi_shard)
+      return 0;
+
+   uint64_t      hash = path_hash(info->post.md_path);
+   PICacheShard* sh   = shard_of(hash);
+   pthread_mutex_lock(&sh->lock);
+
+   PICacheEntry* e = entry_find(sh, hash, info->post.md_path);
+   if (e && e->err) {
+      errno = e->err;
+      rc    = -1;
+   }
+   else if (e) {
+      info->st = e->st;
+      rc       = 1;
+   }
+
+   pthread_mutex_unlock(&sh->lock);
+   if (rc)
+      LOG(LOG_INFO, "hit%s %s\n", ((rc < 0) ? " (ENOENT)" : ""), info->post.md_path);
+   return rc;
+}
+
+
+XattrMaskType pi_cache_xattrs(PathInfo* info, XattrMaskType* missing) {
+   XattrMaskType found = 0;
+
+   *missing = 0;
+   if (! pi_shard)
+      return 0;
+
+   uint64_t      hash = path_hash(info->post.md_path);
+   PICacheShard* sh   = shard_of(hash);
+   pthread_mutex_lock(&sh->lock);
+
+   PICacheEntry* e = entry_find(sh, hash, info->post.md_path);
+   if (e && ! e->err && (e->found | e->missing)) {
+      found    = e->found;
+      *missing = e->missing;
+
+      if (found & XVT_PRE)
+         info->pre = e->pre;
+      if (found & XVT_POST)
+         info->post = e->post;  // same md_path
+      if (found & XVT_RESTART)
+         info->restart = e->restart;
+      info->xattrs |= found;
+      info->flags  |= e->flags;
+   }
+
+   pthread_mutex_unlock(&sh->lock);
+   if (found | *missing)
+      LOG(LOG_INFO, "hit %s (found 0x%02x, missing 0x%02x)\n",
+          info->post.md_path, found, *missing);
+   return found;
+}
+
+
+void pi_cache_put(const PathInfo* info, int err, uint64_t gen) {
+   const int errno_save = errno;
+
+   if (! pi_shard)
+      return;
+
+   // other failures (EACCES, ESTALE, ...) may not last
+   if (err && (err != ENOENT))
+      return;
+
+   uint64_t      hash = path_hash(info->post.md_path);
+   PICacheShard* sh   = shard_of(hash);
+   pthread_mutex_lock(&sh->lock);
+
+   // something changed since the caller looked
+   if (sh->gen != gen) {
+      pthread_mutex_unlock(&sh->lock);
+      errno = errno_save;
+      return;
+   }
+
+   PICacheEntry* e = entry_find(sh, hash, info->post.md_path);
+   if (! e) {
+      if ((sh->count >= sh->max) && sh->lru_tail)
+         entry_drop(sh, sh->lru_tail);
+
+      e = (PICacheEntry*)malloc(sizeof(PICacheEntry));
+      if (! e) {
+         pthread_mutex_unlock(&sh->lock);
+         errno = errno_save;
+         return;
+      }
+      e->hash = hash;
+      strncpy(e->post.md_path, info->post.md_path, MARFS_MAX_MD_PATH);
+      e->post.md_path[MARFS_MAX_MD_PATH -1] = 0;
+
+      PICacheEntry** pp = bucket_of(sh, hash);
+      e->next = *pp;
+      *pp     = e;
+      lru_push(sh, e);
+      ++ sh->count;
+   }
+
+   e->expires = now_msec() + pi_ttl;
+   e->err     = err;
+   e->found   = 0;
+   e->missing = 0;
+   e->flags   = 0;
+   if (! err) {
+      e->st = info->st;
+
+      if (info->flags & PI_XATTR_QUERY) {
+         const XattrMaskType mask = (XVT_PRE | XVT_POST | XVT_RESTART);
+         e->found   = (info->xattrs      & mask);
+         e->missing = (info->xattr_inits & mask & ~e->found);
+         e->flags   = (info->flags & PI_XATTRS_V1);
+
+         if (e->found & XVT_PRE)
+            e->pre = info->pre;
+         if (e->found & XVT_POST)
+            e->post = info->post;
+         if (e->found & XVT_RESTART)
+            e->restart = info->restart;
+      }
+   }
+
+   pthread_mutex_unlock(&sh->lock);
+   errno = errno_save;
+}
+
+
+
+void pi_cache_invalidate(const char* md_path) {
+   if (! pi_shard)
+      return;
+
+   uint64_t      hash = path_hash(md_path);
+   PICacheShard* sh   = shard_of(hash);
+   PICacheEntry* e;
+   pthread_mutex_lock(&sh->lock);
+
+   ++ sh->gen;
+   for (e = *bucket_of(sh, hash); e; e = e->next) {
+      if ((e->hash == hash) && ! strcmp(e->post.md_path, md_path)) {
+         entry_drop(sh, e);
+         break;
+      }
+   }
+
+   pthread_mutex_unlock(&sh->lock);
+}
+
+
+void pi_cache_invalidate_tree(const char* md_path) {
+   size_t len = strlen(md_path);
+   size_t i;
+
+   if (! pi_shard)
+      return;
+
+   for (i=0; i<PI_CACHE_SHARDS; ++i) {
+      PICacheShard* sh = &pi_shard[i];
+      PICacheEntry* e;
+      PICacheEntry* next;
+      pthread_mutex_lock(&sh->lock);
+
+      ++ sh->gen;
+      for (e = sh->lru_head; e; e = next) {
+         next = e->lru_next;
+         if (! strncmp(e->post.md_path, md_path, len)
+             && ((e->post.md_path[len] == 0) || (e->post.md_path[len] == '/')))
+            entry_drop(sh, e);
+      }
+
+      pthread_mutex_unlock(&sh->lock);
+   }
+   LOG(LOG_INFO, "invalidated %s/...\n", md_path);
+}
@@ -0,0 +1,147 @@
+#ifndef _MARFS_PI_CACHE_H
+#define _MARFS_PI_CACHE_H
+
+
+
+/*
+This file is part of MarFS, which is released under the BSD license.
+
+
+Copyright (c) 2015, Los Alamos National Security (LANS), LLC
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation and/or
+other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors
+may be used to endorse or promote products derived from this software without
+specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+-----
+NOTE:
+-----
+MarFS uses libaws4c for Amazon S3 object communication. The original version
+is at https://aws.amazon.com/code/Amazon-S3/2601 and under the LGPL license.
+LANS, LLC added functionality to the original work. The original work plus
+LANS, LLC contributions is found at https://github.com/jti-lanl/aws4c.
+
+GNU licenses can be found at <http://www.gnu.org/licenses/>.
+
+
+From Los Alamos National Security, LLC:
+LA-CC-15-039
+
+Copyright (c) 2015, Los Alamos National Security, LLC All rights reserved.
+Copyright 2015. Los Alamos National Security, LLC. This software was produced
+under U.S. Government contract DE-AC52-06NA25396 for Los Alamos National
+Laboratory (LANL), which is operated by Los Alamos National Security, LLC for
+the U.S. Department of Energy. The U.S. Government has rights to use,
+reproduce, and distribute this software.  NEITHER THE GOVERNMENT NOR LOS
+ALAMOS NATIONAL SECURITY, LLC MAKES ANY WARRANTY, EXPRESS OR IMPLIED, OR
+ASSUMES ANY LIABILITY FOR THE USE OF THIS SOFTWARE.  If software is
+modified to produce derivative works, such modified software should be
+clearly marked, so as not to confuse it with the version available from
+LANL.
+
+THIS SOFTWARE IS PROVIDED BY LOS ALAMOS NATIONAL SECURITY, LLC AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL LOS ALAMOS NATIONAL SECURITY, LLC OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+
+
+
+// ---------------------------------------------------------------------------
+// PI_CACHE
+//
+// Nearly every fuse op expands a PathInfo and calls stat_regular() and/or
+// stat_xattrs(), which costs an lstat() plus one lgetxattr() per MarFS
+// xattr, against the MDFS.  Tools like "ls -l" repeat these for the same
+// paths, many times over.  So, the fuse daemon keeps recent results, keyed
+// by MD path:
+//
+//   - the stat of the MD file, or the fact that it doesn't exist (ENOENT)
+//   - the parsed Pre/Post/Restart xattrs, and which ones were missing
+//
+// Values that were missing are not kept; stat_xattrs() initializes them
+// fresh, as it would without the cache, so e.g. new object-IDs don't get
+// reused.
+//
+// Entries expire after marfs_config->pi_cache_ttl msec, to bound how long
+// we may miss changes made by other hosts (e.g. pftool).  Changes made
+// through this daemon invalidate entries explicitly.  The calls that
+// change MD files (save_xattrs(), the trash functions, and the fuse ops
+// that touch the MDFS directly) call pi_cache_invalidate() *after* the
+// change.  Each shard has a generation-count that is bumped by every
+// invalidation, and a lookup that started before that can't install its
+// (possibly stale) result.
+//
+// The cache is split into PI_CACHE_SHARDS shards, each with its own lock
+// and LRU list, holding at most 1/PI_CACHE_SHARDS of
+// marfs_config->pi_cache_entries.  Only fuse calls pi_cache_init().  For
+// everyone else (pftool, GC, etc) all of these are no-ops.
+// ---------------------------------------------------------------------------
+
+#include "common.h"
+
+#include <stdint.h>
+
+
+#define PI_CACHE_SHARDS    64
+
+
+int           pi_cache_init(void);
+
+// non-zero if pi_cache_init() turned the cache on
+int           pi_cache_active(void);
+
+// generation of the shard holding <md_path>.  Take this before querying
+// the MDFS, and pass it to pi_cache_put().
+uint64_t      pi_cache_gen(const char* md_path);
+
+// 1 = hit (info->st is filled in), -1 = cached ENOENT (errno is set),
+// 0 = miss
+int           pi_cache_stat(PathInfo* info);
+
+// On a hit, the xattrs that were found are copied into <info>, and
+// returned.  <missing> gets the ones that the MD file doesn't have.  A
+// miss returns 0, with <missing> = 0.
+XattrMaskType pi_cache_xattrs(PathInfo* info, XattrMaskType* missing);
+
+// save the results of stat_regular() (<err> is its errno, or 0) and, if
+// PI_XATTR_QUERY is set, stat_xattrs().
+void          pi_cache_put(const PathInfo* info, int err, uint64_t gen);
+
+void          pi_cache_invalidate(const char* md_path);
+
+// drop <md_path> and everything below it (e.g. rename of a directory)
+void          pi_cache_invalidate_tree(const char* md_path);
+
+
+#endif
@@ -0,0 +1,550 @@
+
+/*
+This file is part of MarFS, which is released under the BSD license.
+
+
+Copyright (c) 2015, Los Alamos National Security (LANS), LLC
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation and/or
+other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors
+may be used to endorse or promote products derived from this software without
+specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+-----
+NOTE:
+-----
+MarFS uses libaws4c for Amazon S3 object communication. The original version
+is at https://aws.amazon.com/code/Amazon-S3/2601 and under the LGPL license.
+LANS, LLC added functionality to the original work. The original work plus
+LANS, LLC contributions is found at https://github.com/jti-lanl/aws4c.
+
+GNU licenses can be found at <http://www.gnu.org/licenses/>.
+
+
+From Los Alamos National Security, LLC:
+LA-CC-15-039
+
+Copyright (c) 2015, Los Alamos National Security, LLC All rights reserved.
+Copyright 2015. Los Alamos National Security, LLC. This software was produced
+under U.S. Government contract DE-AC52-06NA25396 for Los Alamos National
+Laboratory (LANL), which is operated by Los Alamos National Security, LLC for
+the U.S. Department of Energy. The U.S. Government has rights to use,
+reproduce, and distribute this software.  NEITHER THE GOVERNMENT NOR LOS
+ALAMOS NATIONAL SECURITY, LLC MAKES ANY WARRANTY, EXPRESS OR IMPLIED, OR
+ASSUMES ANY LIABILITY FOR THE USE OF THIS SOFTWARE.  If software is
+modified to produce derivative works, such modified software should be
+clearly marked, so as not to confuse it with the version available from
+LANL.
+
+THIS SOFTWARE IS PROVIDED BY LOS ALAMOS NATIONAL SECURITY, LLC AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL LOS ALAMOS NATIONAL SECURITY, LLC OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+
+
+
+#include "rs_codec.h"
+
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#  define RS_X86    1
+#  include <immintrin.h>
+#elif defined(__aarch64__) && defined(__GNUC__)
+#  define RS_NEON   1
+#  include <arm_neon.h>
+#endif
+
+
+#define RS_POLY   0x11d   // x^8 + x^4 + x^3 + x^2 + 1
+
+// Work on this much of each block at a time, so the sources for one
+// parity block are still in cache for the next.
+#define RS_SLICE  (16 * 1024)
+
+static uint8_t         gf_exp[512];
+static uint8_t         gf_log[256];
+static uint8_t         gf_mul_tbl[256][256];
+static pthread_once_t  rs_once = PTHREAD_ONCE_INIT;
+
+typedef uint8_t RS_Nibbles[32];
+
+// For each o < m (which is 1 or 2):
+//   dst[o][off .. off+len) = sum over j<k of coef[o][j] * src[j][off .. off+len)
+// Doing two outputs at once halves the passes over the sources.
+typedef void (*rs_dot_fn)(uint8_t* const* dst, int m,
+                          const uint8_t* const* src, size_t off,
+                          const uint8_t* const* coef, const RS_Nibbles* const* tbl,
+                          int k, size_t len);
+
+static rs_dot_fn       rs_dot = NULL;   // NULL means rs_dot_table()
+static const char*     rs_dot_name = "table";
+
+
+
+// ---------------------------------------------------------------------------
+// GF(2^8) arithmetic
+// ---------------------------------------------------------------------------
+
+static uint8_t gf_mul(uint8_t a, uint8_t b) {
+   return gf_mul_tbl[a][b];
+}
+
+static uint8_t gf_inv(uint8_t a) {
+   return gf_exp[255 - gf_log[a]];
+}
+
+static void rs_nibble_tbl(uint8_t* t, uint8_t c) {
+   int i;
+   for (i=0; i<16; ++i) {
+      t[i]      = gf_mul(c, (uint8_t)i);
+      t[16 + i] = gf_mul(c, (uint8_t)(i << 4));
+   }
+}
+
+// invert the k x k matrix <m> (which is destroyed) into <inv>.  Returns
+// 0, or -1 if it is singular.
+static int gf_invert(uint8_t m[RS_MAX_BLOCKS][RS_MAX_BLOCKS],
+                     uint8_t inv[RS_MAX_BLOCKS][RS_MAX_BLOCKS], int k) {
+   int r, c, i;
+
+   for (r=0; r<k; ++r) {
+      memset(inv[r], 0, k);
+      inv[r][r] = 1;
+   }
+   for (c=0; c<k; ++c) {
+      for (r=c; (r<k) && !m[r][c]; ++r)
+         ;
+      if (r == k)
+         return -1;
+      if (r != c) {
+         uint8_t tmp[RS_MAX_BLOCKS];
+         memcpy(tmp,    m[r],   k); memcpy(m[r],   m[c],   k); memcpy(m[c],   tmp, k);
+         memcpy(tmp,    inv[r], k); memcpy(inv[r], inv[c], k); memcpy(inv[c], tmp, k);
+      }
+      uint8_t scale = gf_inv(m[c][c]);
+      for (i=0; i<k; ++i) {
+         m[c][i]   = gf_mul(scale, m[c][i]);
+         inv[c][i] = gf_mul(scale, inv[c][i]);
+      }
+      for (r=0; r<k; ++r) {
+         uint8_t f = m[r][c];
+         if ((r == c) || !f)
+            continue;
+         for (i=0; i<k; ++i) {
+            m[r][i]   ^= gf_mul(f, m[c][i]);
+            inv[r][i] ^= gf_mul(f, inv[c][i]);
+         }
+      }
+   }
+   return 0;
+}
+
+
+
+// ---------------------------------------------------------------------------
+// table-driven
+// ---------------------------------------------------------------------------
+
+// Same as an rs_dot_fn, but without the nibble tables, which only the
+// SIMD versions need.  They also use this for the tail of a slice.
+static void rs_dot_table(uint8_t* const* dst, int m,
+                         const uint8_t* const* src, size_t off,
+                         const uint8_t* const* coef,
+                         int k, size_t len) {
+   int o;
+   for (o=0; o<m; ++o) {
+      uint8_t*       d   = dst[o] + off;
+      const uint8_t* mul = gf_mul_tbl[coef[o][0]];
+      const uint8_t* s   = src[0] + off;
+      size_t         i;
+      int            j;
+
+      for (i=0; i<len; ++i)
+         d[i] = mul[s[i]];
+
+      for (j=1; j<k; ++j) {
+         mul = gf_mul_tbl[coef[o][j]];
+         s   = src[j] + off;
+         for (i=0; i<len; ++i)
+            d[i] ^= mul[s[i]];
+      }
+   }
+}
+
+
+
+// ---------------------------------------------------------------------------
+// x86_64
+// ---------------------------------------------------------------------------
+
+#ifdef RS_X86
+
+__attribute__((target("avx2")))
+static void rs_dot_avx2(uint8_t* const* dst, int m,
+                        const uint8_t* const* src, size_t off,
+                        const uint8_t* const* coef, const RS_Nibbles* const* tbl,
+                        int k, size_t len) {
+   const __m256i mask = _mm256_set1_epi8(0x0f);
+   size_t        i;
+   int           j;
+
+#  define LOAD_TBL(T)  _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)(T)))
+#  define MUL(T, L, H) _mm256_xor_si256(_mm256_shuffle_epi8(LOAD_TBL(T), L),         \
+                                        _mm256_shuffle_epi8(LOAD_TBL((T) + 16), H))
+
+   for (i=0; i+64 <= len; i+=64) {
+      __m256i a0 = _mm256_setzero_si256();
+      __m256i a1 = _mm256_setzero_si256();
+      __m256i b0 = _mm256_setzero_si256();
+      __m256i b1 = _mm256_setzero_si256();
+
+      for (j=0; j<k; ++j) {
+         const uint8_t* s  = src[j] + off + i;
+         __m256i        x0 = _mm256_loadu_si256((const __m256i*)s);
+         __m256i        x1 = _mm256_loadu_si256((const __m256i*)(s + 32));
+         __m256i        l0 = _mm256_and_si256(x0, mask);
+         __m256i        h0 = _mm256_and_si256(_mm256_srli_epi64(x0, 4), mask);
+         __m256i        l1 = _mm256_and_si256(x1, mask);
+         __m256i        h1 = _mm256_and_si256(_mm256_srli_epi64(x1, 4), mask);
+
+         a0 = _mm256_xor_si256(a0, MUL(tbl[0][j], l0, h0));
+         a1 = _mm256_xor_si256(a1, MUL(tbl[0][j], l1, h1));
+         if (m > 1) {
+            b0 = _mm256_xor_si256(b0, MUL(tbl[1][j], l0, h0));
+            b1 = _mm256_xor_si256(b1, MUL(tbl[1][j], l1, h1));
+         }
+      }
+      _mm256_storeu_si256((__m256i*)(dst[0] + off + i),      a0);
+      _mm256_storeu_si256((__m256i*)(dst[0] + off + i + 32), a1);
+      if (m > 1) {
+         _mm256_storeu_si256((__m256i*)(dst[1] + off + i),      b0);
+         _mm256_storeu_si256((__m256i*)(dst[1] + off + i + 32), b1);
+      }
+   }
+#  undef MUL
+#  undef LOAD_TBL
+
+   if (i < len)
+      rs_dot_table(dst, m, src, off + i, coef, k, len - i);
+}
+
+__attribute__((target("ssse3")))
+static void rs_dot_ssse3(uint8_t* const* dst, int m,
+                         const uint8_t* const* src, size_t off,
+                         const uint8_t* const* coef, const RS_Nibbles* const* tbl,
+                         int k, size_t len) {
+   const __m128i mask = _mm_set1_epi8(0x0f);
+   size_t        i;
+   int           j;
+
+#  define LOAD_TBL(T)  _mm_loadu_si128((const __m128i*)(T))
+#  define MUL(T, L, H) _mm_xor_si128(_mm_shuffle_epi8(LOAD_TBL(T), L),             \
+                                     _mm_shuffle_epi8(LOAD_TBL((T) + 16), H))
+
+   for (i=0; i+32 <= len; i+=32) {
+      __m128i a0 = _mm_setzero_si128();
+      __m128i a1 = _mm_setzero_si128();
+      __m128i b0 = _mm_setzero_si128();
+      __m128i b1 = _mm_setzero_si128();
+
+      for (j=0; j<k; ++j) {
+         const uint8_t* s  = src[j] + off + i;
+         __m128i        x0 = _mm_loadu_si128((const __m128i*)s);
+         __m128i        x1 = _mm_loadu_si128((const __m128i*)(s + 16));
+         __m128i        l0 = _mm_and_si128(x0, mask);
+         __m128i        h0 = _mm_and_si128(_mm_srli_epi64(x0, 4), mask);
+         __m128i        l1 = _mm_and_si128(x1, mask);
+         __m128i        h1 = _mm_and_si128(_mm_srli_epi64(x1, 4), mask);
+
+         a0 = _mm_xor_si128(a0, MUL(tbl[0][j], l0, h0));
+         a1 = _mm_xor_si128(a1, MUL(tbl[0][j], l1, h1));
+         if (m > 1) {
+            b0 = _mm_xor_si128(b0, MUL(tbl[1][j], l0, h0));
+            b1 = _mm_xor_si128(b1, MUL(tbl[1][j], l1, h1));
+         }
+      }
+      _mm_storeu_si128((__m128i*)(dst[0] + off + i),      a0);
+      _mm_storeu_si128((__m128i*)(dst[0] + off + i + 16), a1);
+      if (m > 1) {
+         _mm_storeu_si128((__m128i*)(dst[1] + off + i),      b0);
+         _mm_storeu_si128((__m128i*)(dst[1] + off + i + 16), b1);
+      }
+   }
+#  undef MUL
+#  undef LOAD_TBL
+
+   if (i < len)
+      rs_dot_table(dst, m, src, off + i, coef, k, len - i);
+}
+
+#endif // RS_X86
+
+
+
+// ---------------------------------------------------------------------------
+// aarch64
+// ---------------------------------------------------------------------------
+
+#ifdef RS_NEON
+
+static void rs_dot_neon(uint8_t* const* dst, int m,
+                        const uint8_t* const* src, size_t off,
+                        const uint8_t* const* coef, const RS_Nibbles* const* tbl,
+                        int k, size_t len) {
+   const uint8x16_t mask = vdupq_n_u8(0x0f);
+   size_t           i;
+   int              j;
+
+#  define MUL(T, L, H) veorq_u8(vqtbl1q_u8(vld1q_u8(T), L),                    \
+                                vqtbl1q_u8(vld1q_u8((T) + 16), H))
+
+   for (i=0; i+32 <= len; i+=32) {
+      uint8x16_t a0 = vdupq_n_u8(0);
+      uint8x16_t a1 = vdupq_n_u8(0);
+      uint8x16_t b0 = vdupq_n_u8(0);
+      uint8x16_t b1 = vdupq_n_u8(0);
+
+      for (j=0; j<k; ++j) {
+         const uint8_t* s  = src[j] + off + i;
+         uint8x16_t     x0 = vld1q_u8(s);
+         uint8x16_t     x1 = vld1q_u8(s + 16);
+         uint8x16_t     l0 = vandq_u8(x0, mask);
+         uint8x16_t     h0 = vshrq_n_u8(x0, 4);
+         uint8x16_t     l1 = vandq_u8(x1, mask);
+         uint8x16_t     h1 = vshrq_n_u8(x1, 4);
+
+         a0 = veorq_u8(a0, MUL(tbl[0][j], l0, h0));
+         a1 = veorq_u8(a1, MUL(tbl[0][j], l1, h1));
+         if (m > 1) {
+            b0 = veorq_u8(b0, MUL(tbl[1][j], l0, h0));
+            b1 = veorq_u8(b1, MUL(tbl[1][j], l1, h1));
+         }
+      }
+      vst1q_u8(dst[0] + off + i,      a0);
+      vst1q_u8(dst[0] + off + i + 16, a1);
+      if (m > 1) {
+         vst1q_u8(dst[1] + off + i,      b0);
+         vst1q_u8(dst[1] + off + i + 16, b1);
+      }
+   }
+#  undef MUL
+
+   if (i < len)
+      rs_dot_table(dst, m, src, off + i, coef, k, len - i);
+}
+
+#endif // RS_NEON
+
+
+
+// ---------------------------------------------------------------------------
+// API
+// ---------------------------------------------------------------------------
+
+static void rs_setup(void) {
+   int i, j;
+   int x = 1;
+   for (i=0; i<255; ++i) {
+      gf_exp[i]       = (uint8_t)x;
+      gf_exp[i + 255] = (uint8_t)x;
+      gf_log[x]       = (uint8_t)i;
+      x <<= 1;
+      if (x & 0x100)
+         x ^= RS_POLY;
+   }
+   for (i=0; i<256; ++i) {
+      for (j=0; j<256; ++j)
+         gf_mul_tbl[i][j] = ((i && j)
+                             ? gf_exp[gf_log[i] + gf_log[j]]
+                             : 0);
+   }
+
+#if defined(RS_X86)
+   __builtin_cpu_init();
+   if (__builtin_cpu_supports("avx2")) {
+      rs_dot      = &rs_dot_avx2;
+      rs_dot_name = "avx2";
+   }
+   else if (__builtin_cpu_supports("ssse3")) {
+      rs_dot      = &rs_dot_ssse3;
+      rs_dot_name = "ssse3";
+   }
+#elif defined(RS_NEON)
+   rs_dot      = &rs_dot_neon;
+   rs_dot_name = "neon";
+#endif
+}
+
+
+// compute <m> outputs, two at a time, a slice at a time
+static void rs_dot_all(uint8_t* const* dst, int m, const uint8_t* const* src,
+                       const uint8_t* const* coef, const RS_Nibbles* const* tbl,
+                       int k, size_t len) {
+   size_t off;
+   int    o;
+   for (off=0; off<len; off+=RS_SLICE) {
+      size_t slice = ((len - off < RS_SLICE) ? (len - off) : RS_SLICE);
+      for (o=0; o<m; o+=2) {
+         if (rs_dot)
+            (*rs_dot)(dst + o, ((m - o > 1) ? 2 : 1), src, off,
+                      coef + o, tbl + o, k, slice);
+         else
+            rs_dot_table(dst + o, ((m - o > 1) ? 2 : 1), src, off,
+                         coef + o, k, slice);
+      }
+   }
+}
+
+
+int rs_init(RS_Code* rs, int n, int e) {
+   pthread_once(&rs_once, &rs_setup);
+
+   if ((n < 1) || (e < 0) || ((n + e) > RS_MAX_BLOCKS)) {
+      errno = EINVAL;
+      return -1;
+   }
+   memset(rs, 0, sizeof(RS_Code));
+   rs->n = n;
+   rs->e = e;
+
+   // Cauchy rows: 1 / (x_p + y_j), with x_p = n+p and y_j = j all distinct
+   int p, j;
+   for (p=0; p<e; ++p) {
+      for (j=0; j<n; ++j) {
+         rs->gen[p][j] = gf_inv((uint8_t)((n + p) ^ j));
+         rs_nibble_tbl(rs->tbl[p][j], rs->gen[p][j]);
+      }
+   }
+   return 0;
+}
+
+
+void rs_encode(const RS_Code* rs, uint8_t* const* blocks, size_t len) {
+   pthread_once(&rs_once, &rs_setup);
+
+   const uint8_t*    coef[RS_MAX_BLOCKS];
+   const RS_Nibbles* tbl [RS_MAX_BLOCKS];
+   int               p;
+   for (p=0; p<rs->e; ++p) {
+      coef[p] = rs->gen[p];
+      tbl[p]  = rs->tbl[p];
+   }
+   rs_dot_all(blocks + rs->n, rs->e, (const uint8_t* const*)blocks,
+              coef, tbl, rs->n, len);
+}
+
+
+int rs_decode(const RS_Code* rs, uint8_t* const* blocks,
+              uint32_t erased, size_t len) {
+   pthread_once(&rs_once, &rs_setup);
+
+   const int         n     = rs->n;
+   const int         total = rs->n + rs->e;
+   uint8_t*          dst [RS_MAX_BLOCKS];
+   const uint8_t*    coef[RS_MAX_BLOCKS];
+   const RS_Nibbles* tbl [RS_MAX_BLOCKS];
+   int               m     = 0;
+   int               i;
+
+   if (total < 32)
+      erased &= ((1u << total) - 1);
+   if (__builtin_popcount(erased) > rs->e) {
+      errno = EIO;
+      return -1;
+   }
+   if (! erased)
+      return 0;
+
+   // lost data-blocks are a combination of the first <n> survivors
+   uint32_t lost_data = erased & ((n < 32) ? ((1u << n) - 1) : ~0u);
+   if (lost_data) {
+      uint8_t        mat [RS_MAX_BLOCKS][RS_MAX_BLOCKS];
+      uint8_t        inv [RS_MAX_BLOCKS][RS_MAX_BLOCKS];
+      RS_Nibbles     itbl[RS_MAX_BLOCKS][RS_MAX_BLOCKS];
+      const uint8_t* surv[RS_MAX_BLOCKS];
+      int            k = 0;
+
+      for (i=0; (i<total) && (k<n); ++i) {
+         if (erased & (1u << i))
+            continue;
+         if (i < n) {
+            memset(mat[k], 0, n);
+            mat[k][i] = 1;
+         }
+         else
+            memcpy(mat[k], rs->gen[i - n], n);
+         surv[k++] = blocks[i];
+      }
+      if (gf_invert(mat, inv, n)) {
+         errno = EIO;
+         return -1;
+      }
+
+      for (i=0; i<n; ++i) {
+         if (! (lost_data & (1u << i)))
+            continue;
+         int r;
+         for (r=0; r<n; ++r)
+            rs_nibble_tbl(itbl[m][r], inv[i][r]);
+         dst[m]  = blocks[i];
+         coef[m] = inv[i];
+         tbl[m]  = itbl[m];
+         ++m;
+      }
+      rs_dot_all(dst, m, surv, coef, tbl, n, len);
+   }
+
+   // lost parity is just re-encoded, now that the data is whole
+   m = 0;
+   for (i=0; i<rs->e; ++i) {
+      if (! (erased & (1u << (n + i))))
+         continue;
+      dst[m]  = blocks[n + i];
+      coef[m] = rs->gen[i];
+      tbl[m]  = rs->tbl[i];
+      ++m;
+   }
+   if (m)
+      rs_dot_all(dst, m, (const uint8_t* const*)blocks, coef, tbl, n, len);
+
+   return 0;
+}
+
+
+const char* rs_impl(void) {
+   pthread_once(&rs_once, &rs_setup);
+   return rs_dot_name;
+}
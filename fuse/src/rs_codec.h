@@ -0,0 +1,121 @@
+#ifndef _MARFS_RS_CODEC_H
+#define _MARFS_RS_CODEC_H
+
+
+/*
+This file is part of MarFS, which is released under the BSD license.
+
+
+Copyright (c) 2015, Los Alamos National Security (LANS), LLC
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation and/or
+other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors
+may be used to endorse or promote products derived from this software without
+specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+-----
+NOTE:
+-----
+MarFS uses libaws4c for Amazon S3 object communication. The original version
+is at https://aws.amazon.com/code/Amazon-S3/2601 and under the LGPL license.
+LANS, LLC added functionality to the original work. The original work plus
+LANS, LLC contributions is found at https://github.com/jti-lanl/aws4c.
+
+GNU licenses can be found at <http://www.gnu.org/licenses/>.
+
+
+From Los Alamos National Security, LLC:
+LA-CC-15-039
+
+Copyright (c) 2015, Los Alamos National Security, LLC All rights reserved.
+Copyright 2015. Los Alamos National Security, LLC. This software was produced
+under U.S. Government contract DE-AC52-06NA25396 for Los Alamos National
+Laboratory (LANL), which is operated by Los Alamos National Security, LLC for
+the U.S. Department of Energy. The U.S. Government has rights to use,
+reproduce, and distribute this software.  NEITHER THE GOVERNMENT NOR LOS
+ALAMOS NATIONAL SECURITY, LLC MAKES ANY WARRANTY, EXPRESS OR IMPLIED, OR
+ASSUMES ANY LIABILITY FOR THE USE OF THIS SOFTWARE.  If software is
+modified to produce derivative works, such modified software should be
+clearly marked, so as not to confuse it with the version available from
+LANL.
+
+THIS SOFTWARE IS PROVIDED BY LOS ALAMOS NATIONAL SECURITY, LLC AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL LOS ALAMOS NATIONAL SECURITY, LLC OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+// Systematic Reed-Solomon erasure code over GF(2^8), for the POSIX_EC DAL.
+// There are <n> data blocks and <e> parity blocks, and any <n> of them are
+// enough to recover the rest.  Parity rows of the generator are a Cauchy
+// matrix, so every n x n submatrix of [I ; C] is invertible.
+//
+// Products are done with split-nibble lookup tables (two 16-entry tables
+// per coefficient), which the AVX2, SSSE3, and NEON shuffle instructions
+// can apply to a whole vector at once.  The choice is made once, at
+// run-time.  Otherwise, we use plain multiplication tables.
+//
+// Blocks are given as arrays of <n+e> pointers to <len> bytes each.
+
+#include <stdint.h>
+#include <stddef.h>
+
+#  ifdef __cplusplus
+extern "C" {
+#  endif
+
+#define RS_MAX_BLOCKS  32       // n+e.  Error-patterns are bit-masks
+
+typedef struct {
+   int       n;
+   int       e;
+   uint8_t   gen[RS_MAX_BLOCKS][RS_MAX_BLOCKS];       // parity rows only
+   uint8_t   tbl[RS_MAX_BLOCKS][RS_MAX_BLOCKS][32];   // nibble tables for gen
+} RS_Code;
+
+// Returns 0, or -1 with errno=EINVAL, if n and e don't fit
+int         rs_init(RS_Code* rs, int n, int e);
+
+// compute blocks[n .. n+e) from blocks[0 .. n)
+void        rs_encode(const RS_Code* rs, uint8_t* const* blocks, size_t len);
+
+// Recompute the blocks in <erased> (bit i is blocks[i]) from the others.
+// Returns 0, or -1 with errno=EIO, if more than <e> are erased.
+int         rs_decode(const RS_Code* rs, uint8_t* const* blocks,
+                      uint32_t erased, size_t len);
+
+const char* rs_impl(void);      // "avx2", "ssse3", "neon", or "table"
+
+#  ifdef __cplusplus
+}
+#  endif
+
+#endif // _MARFS_RS_CODEC_H
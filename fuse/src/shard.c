@@ -0,0 +1,318 @@
+/*
+This file is part of MarFS, which is released under the BSD license.
+
+
+Copyright (c) 2015, Los Alamos National Security (LANS), LLC
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation and/or
+other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors
+may be used to endorse or promote products derived from this software without
+specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+-----
+NOTE:
+-----
+MarFS uses libaws4c for Amazon S3 object communication. The original version
+is at https://aws.amazon.com/code/Amazon-S3/2601 and under the LGPL license.
+LANS, LLC added functionality to the original work. The original work plus
+LANS, LLC contributions is found at https://github.com/jti-lanl/aws4c.
+
+GNU licenses can be found at <http://www.gnu.org/licenses/>.
+
+
+From Los Alamos National Security, LLC:
+LA-CC-15-039
+
+Copyright (c) 2015, Los Alamos National Security, LLC All rights reserved.
+Copyright 2015. Los Alamos National Security, LLC. This software was produced
+under U.S. Government contract DE-AC52-06NA25396 for Los Alamos National
+Laboratory (LANL), which is operated by Los Alamos National Security, LLC for
+the U.S. Department of Energy. The U.S. Government has rights to use,
+reproduce, and distribute this software.  NEITHER THE GOVERNMENT NOR LOS
+ALAMOS NATIONAL SECURITY, LLC MAKES ANY WARRANTY, EXPRESS OR IMPLIED, OR
+ASSUMES ANY LIABILITY FOR THE USE OF THIS SOFTWARE.  If software is
+modified to produce derivative works, such modified software should be
+clearly marked, so as not to confuse it with the version available from
+LANL.
+
+THIS SOFTWARE IS PROVIDED BY LOS ALAMOS NATIONAL SECURITY, LLC AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL LOS ALAMOS NATIONAL SECURITY, LLC OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+
+
+
+#include "common.h"
+#include "shard.h"
+#include "pi_cache.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+
+// FNV-1a, over the parent inode (in a fixed byte-order) and the name
+static
+uint32_t shard_of(const MarFS_Namespace* ns, ino_t dir_ino, const char* name) {
+   uint64_t hash = 14695981039346656037ULL;
+   uint64_t ino  = (uint64_t)dir_ino;
+   int      i;
+
+   for (i=0; i<8; ++i) {
+      hash ^= (uint8_t)(ino >> (i * 8));
+      hash *= 1099511628211ULL;
+   }
+   for ( ; *name; ++name) {
+      hash ^= (uint8_t)*name;
+      hash *= 1099511628211ULL;
+   }
+   return (uint32_t)(hash % (ns->md_shard_count +1));
+}
+
+
+int shard_bucket_path(char* bucket, size_t max_size,
+                      const MarFS_Namespace* ns, int shard, ino_t dir_ino) {
+
+   if ((shard < 1) || (shard > ns->md_shard_count)) {
+      LOG(LOG_ERR, "namespace %s has no MD shard %d\n", ns->name, shard);
+      errno = EINVAL;
+      return -1;
+   }
+   int prt_count = snprintf(bucket, max_size, "%s/%03lu/%lu",
+                            ns->md_shards[shard -1],
+                            (unsigned long)(dir_ino % 1000),
+                            (unsigned long)dir_ino);
+   if (prt_count < 0) {
+      LOG(LOG_ERR, "snprintf(..., %s, %lu) failed\n",
+          ns->md_shards[shard -1], (unsigned long)dir_ino);
+      return -1;
+   }
+   else if (prt_count >= max_size) {
+      LOG(LOG_ERR, "snprintf(..., %s, %lu) truncated\n",
+          ns->md_shards[shard -1], (unsigned long)dir_ino);
+      errno = EIO;
+      return -1;
+   }
+   return 0;
+}
+
+
+// primary-tree path of the directory holding <sub_path>
+static
+int parent_path(char* md_path, const MarFS_Namespace* ns, const char* sub_path) {
+   const char* name = strrchr(sub_path, '/');
+   int         len  = (name ? (int)(name - sub_path) : 0);
+
+   int prt_count = snprintf(md_path, MARFS_MAX_MD_PATH, "%s%.*s",
+                            ns->md_path, len, sub_path);
+   if ((prt_count < 0) || (prt_count >= MARFS_MAX_MD_PATH)) {
+      LOG(LOG_ERR, "no room for parent of %s%s\n", ns->md_path, sub_path);
+      errno = EIO;
+      return -1;
+   }
+   return 0;
+}
+
+
+int shard_resolve(PathInfo* info, const char* sub_path) {
+   MarFS_Namespace* ns = info->ns;
+
+   if (! ns->md_shard_count)
+      return 0;
+
+   const char* name = strrchr(sub_path, '/');
+   if (! name || ! name[1])
+      return 0;                 // the NS root-dir
+   ++ name;
+
+   // The parent must be a directory in the primary tree.  If it isn't,
+   // leave the primary path, and let the caller's op fail there.
+   PathInfo parent = {0};
+   parent.ns = ns;
+   if (parent_path(parent.post.md_path, ns, sub_path))
+      return -1;
+   if (stat_regular(&parent) || ! S_ISDIR(parent.st.st_mode))
+      return 0;
+
+   uint32_t shard = shard_of(ns, parent.st.st_ino, name);
+   if (! shard)
+      return 0;
+
+   PathInfo cand = {0};
+   cand.ns = ns;
+   if (shard_bucket_path(cand.post.md_path, MARFS_MAX_MD_PATH,
+                         ns, shard, parent.st.st_ino))
+      return -1;
+   size_t len = strlen(cand.post.md_path);
+   if (len + strlen(name) +1 >= MARFS_MAX_MD_PATH) {
+      LOG(LOG_ERR, "no room for '%s' in bucket %s\n", name, cand.post.md_path);
+      errno = EIO;
+      return -1;
+   }
+   cand.post.md_path[len] = '/';
+   strcpy(cand.post.md_path + len +1, name);
+
+   if (! stat_regular(&cand)) {
+      strcpy(info->post.md_path, cand.post.md_path);
+      info->st     = cand.st;
+      info->flags |= (PI_STAT_QUERY | PI_MD_SHARD);
+   }
+   else if (errno != ENOENT)
+      return -1;
+
+   // directories (and files from before the NS was sharded)
+   else if (! stat_regular(info))
+      return 0;
+   else if (errno != ENOENT)
+      return -1;
+
+   // doesn't exist yet.  New files go in the shard.
+   else {
+      strcpy(info->post.md_path, cand.post.md_path);
+      info->flags |= PI_MD_SHARD;
+   }
+
+   LOG(LOG_INFO, "shard %u: %s\n", shard, info->post.md_path);
+   return 0;
+}
+
+
+int shard_primary(PathInfo* info, const char* path) {
+   if (! (info->flags & PI_MD_SHARD))
+      return 0;
+
+   const char* sub_path  = path + info->ns->mnt_path_len;
+   int         prt_count = snprintf(info->post.md_path, MARFS_MAX_MD_PATH,
+                                    "%s%s", info->ns->md_path, sub_path);
+   if ((prt_count < 0) || (prt_count >= MARFS_MAX_MD_PATH)) {
+      LOG(LOG_ERR, "snprintf(..., %s, %s) failed\n",
+          info->ns->md_path, sub_path);
+      errno = EIO;
+      return -1;
+   }
+
+   memset(&info->st, 0, sizeof(struct stat));
+   info->flags &= ~(PI_MD_SHARD | PI_STAT_QUERY);
+   return 0;
+}
+
+
+int shard_check_dir(PathInfo* info, const char* path) {
+   TRY_DECLS();
+   char dir_path[MARFS_MAX_MD_PATH];
+
+   if (! (info->flags & PI_MD_SHARD))
+      return 0;
+
+   TRY0( parent_path(dir_path, info->ns, path + info->ns->mnt_path_len) );
+   TRY0( MD_PATH_OP(faccessat, info->ns, AT_FDCWD, dir_path,
+                    (W_OK | X_OK), AT_EACCESS) );
+   return 0;
+}
+
+
+// mkdir <dir_path> with mode 0777, regardless of umask
+static
+int mkdir_shared(const MarFS_Namespace* ns, const char* dir_path) {
+   TRY_DECLS();
+
+   if (MD_D_PATH_OP(mkdir, ns, dir_path, 0777)) {
+      if (errno == EEXIST)
+         return 0;
+      return -1;
+   }
+   TRY0( MD_PATH_OP(chmod, ns, dir_path, 0777) );
+   pi_cache_invalidate(dir_path);
+   return 0;
+}
+
+int shard_mkbucket(PathInfo* info, const char* path) {
+   TRY_DECLS();
+   char bucket[MARFS_MAX_MD_PATH];
+
+   if (! (info->flags & PI_MD_SHARD))
+      return 0;
+
+   TRY0( shard_check_dir(info, path) );
+
+   strcpy(bucket, info->post.md_path);
+   char* slash = strrchr(bucket, '/');
+   *slash = 0;
+
+   if (! mkdir_shared(info->ns, bucket))
+      return 0;
+   else if (errno != ENOENT) {
+      LOG(LOG_ERR, "couldn't create bucket %s (%s)\n", bucket, strerror(errno));
+      return -1;
+   }
+
+   // need the "hi" dir, too
+   slash = strrchr(bucket, '/');
+   *slash = 0;
+   TRY0( mkdir_shared(info->ns, bucket) );
+   *slash = '/';
+   TRY0( mkdir_shared(info->ns, bucket) );
+
+   return 0;
+}
+
+
+int shard_rmbuckets(PathInfo* info) {
+   TRY_DECLS();
+   const MarFS_Namespace* ns = info->ns;
+   char                   bucket[MARFS_MAX_MD_PATH];
+   int                    shard;
+
+   if (! ns->md_shard_count)
+      return 0;
+
+   TRY0( stat_regular(info) );
+   if (! S_ISDIR(info->st.st_mode))
+      return 0;                 // let rmdir() complain
+
+   for (shard=1; shard<=ns->md_shard_count; ++shard) {
+      TRY0( shard_bucket_path(bucket, MARFS_MAX_MD_PATH, ns, shard, info->st.st_ino) );
+
+      if (MD_D_PATH_OP(rmdir, ns, bucket)) {
+         if (errno == ENOENT)
+            continue;
+         LOG(LOG_INFO, "couldn't remove bucket %s (%s)\n", bucket, strerror(errno));
+         return -1;             // e.g. ENOTEMPTY
+      }
+      pi_cache_invalidate(bucket);
+   }
+   return 0;
+}
@@ -0,0 +1,154 @@
+#ifndef _MARFS_SHARD_H
+#define _MARFS_SHARD_H
+
+
+/*
+This file is part of MarFS, which is released under the BSD license.
+
+
+Copyright (c) 2015, Los Alamos National Security (LANS), LLC
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation and/or
+other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors
+may be used to endorse or promote products derived from this software without
+specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+-----
+NOTE:
+-----
+MarFS uses libaws4c for Amazon S3 object communication. The original version
+is at https://aws.amazon.com/code/Amazon-S3/2601 and under the LGPL license.
+LANS, LLC added functionality to the original work. The original work plus
+LANS, LLC contributions is found at https://github.com/jti-lanl/aws4c.
+
+GNU licenses can be found at <http://www.gnu.org/licenses/>.
+
+
+From Los Alamos National Security, LLC:
+LA-CC-15-039
+
+Copyright (c) 2015, Los Alamos National Security, LLC All rights reserved.
+Copyright 2015. Los Alamos National Security, LLC. This software was produced
+under U.S. Government contract DE-AC52-06NA25396 for Los Alamos National
+Laboratory (LANL), which is operated by Los Alamos National Security, LLC for
+the U.S. Department of Energy. The U.S. Government has rights to use,
+reproduce, and distribute this software.  NEITHER THE GOVERNMENT NOR LOS
+ALAMOS NATIONAL SECURITY, LLC MAKES ANY WARRANTY, EXPRESS OR IMPLIED, OR
+ASSUMES ANY LIABILITY FOR THE USE OF THIS SOFTWARE.  If software is
+modified to produce derivative works, such modified software should be
+clearly marked, so as not to confuse it with the version available from
+LANL.
+
+THIS SOFTWARE IS PROVIDED BY LOS ALAMOS NATIONAL SECURITY, LLC AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL LOS ALAMOS NATIONAL SECURITY, LLC OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+
+
+
+
+// ---------------------------------------------------------------------------
+// SHARD
+//
+// Normally, all the MD of a namespace lives in one tree, under
+// Namespace.md_path, so one MDFS (e.g. one GPFS file-set) takes all the
+// creates and stats.  A namespace can also list extra MDFS roots
+// (Namespace.md_shards, e.g. on file-sets served by other metadata
+// servers), and have the MD files spread across them:
+//
+//   - Directories always live in the primary tree (md_path).
+//
+//   - A file's "shard" is a hash of the inode of its parent directory (in
+//     the primary tree) and its name.  Shard 0 is the usual place in the
+//     primary tree.  Shard N > 0 puts the MD file in a "bucket" for the
+//     parent directory, under md_shards[N-1]:
+//
+//        <shard_root>/<dir_ino % 1000>/<dir_ino>/<name>
+//
+//     Buckets are keyed by inode, rather than path, so renaming a
+//     directory doesn't move anything in the shards.
+//
+// expand_path_info() calls shard_resolve(), which points post.md_path at
+// the shard, if the file is there.  Otherwise, we use the primary tree,
+// which has the directories, and any files that were made before the
+// namespace was sharded.  A name that exists in neither place resolves to
+// the shard, so that's where mknod() creates it.  mkdir() uses
+// shard_primary() to put it back in the primary tree.  Readdir lists the
+// primary directory, and then its bucket in each shard.
+//
+// Buckets are created on demand, with mode 0777 (and the "hi" dirs above
+// them also), because they are shared by all users who can write the
+// parent directory.  Ops that add or remove names in a bucket check the
+// parent directory in the primary tree instead (see shard_check_dir()).
+// Users should not have direct access to the shard roots.
+//
+// A rename that moves a file to a different MDFS gets EXDEV from rename(),
+// so marfs_rename() copies the MD file (see move_md_file()) instead.
+//
+// The list of shards can't be changed after files have been created in a
+// sharded namespace (files would hash elsewhere).  marfs_quota and
+// marfs_packer walk each of the namespace's md_shards, after their scan of
+// the primary tree.  GC only scans the trash, which isn't sharded.
+// ---------------------------------------------------------------------------
+
+#include "common.h"
+
+#include <sys/types.h>
+
+
+// called by expand_path_info(), after it has put the primary-tree path
+// into info->post.md_path.  <sub_path> is the path below the namespace.
+int     shard_resolve(PathInfo* info, const char* sub_path);
+
+// make <info> refer to the primary tree (e.g. for mkdir).  <path> is the
+// one that was expanded.
+int     shard_primary(PathInfo* info, const char* path);
+
+// for a file resolved to a shard: check that the user could add/remove
+// names in the parent directory
+int     shard_check_dir(PathInfo* info, const char* path);
+
+// shard_check_dir(), then create the bucket, if needed, before creating a
+// file resolved to a shard
+int     shard_mkbucket(PathInfo* info, const char* path);
+
+// before removing a directory (<info> is its primary path), remove its
+// (empty) buckets.  ENOTEMPTY, if any of them still has files.
+int     shard_rmbuckets(PathInfo* info);
+
+// bucket for files in the directory <dir_ino>, in shard <shard> (1 .. N)
+int     shard_bucket_path(char* bucket, size_t max_size,
+                          const MarFS_Namespace* ns, int shard, ino_t dir_ino);
+
+
+#endif
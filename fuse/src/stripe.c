@@ -0,0 +1,726 @@
+
+/*
+This file is part of MarFS, which is released under the BSD license.
+
+
+Copyright (c) 2015, Los Alamos National Security (LANS), LLC
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation and/or
+other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors
+may be used to endorse or promote products derived from this software without
+specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+-----
+NOTE:
+-----
+MarFS uses libaws4c for Amazon S3 object communication. The original version
+is at https://aws.amazon.com/code/Amazon-S3/2601 and under the LGPL license.
+LANS, LLC added functionality to the original work. The original work plus
+LANS, LLC contributions is found at https://github.com/jti-lanl/aws4c.
+
+GNU licenses can be found at <http://www.gnu.org/licenses/>.
+
+
+From Los Alamos National Security, LLC:
+LA-CC-15-039
+
+Copyright (c) 2015, Los Alamos National Security, LLC All rights reserved.
+Copyright 2015. Los Alamos National Security, LLC. This software was produced
+under U.S. Government contract DE-AC52-06NA25396 for Los Alamos National
+Laboratory (LANL), which is operated by Los Alamos National Security, LLC for
+the U.S. Department of Energy. The U.S. Government has rights to use,
+reproduce, and distribute this software.  NEITHER THE GOVERNMENT NOR LOS
+ALAMOS NATIONAL SECURITY, LLC MAKES ANY WARRANTY, EXPRESS OR IMPLIED, OR
+ASSUMES ANY LIABILITY FOR THE USE OF THIS SOFTWARE.  If software is
+modified to produce derivative works, such modified software should be
+clearly marked, so as not to confuse it with the version available from
+LANL.
+
+THIS SOFTWARE IS PROVIDED BY LOS ALAMOS NATIONAL SECURITY, LLC AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL LOS ALAMOS NATIONAL SECURITY, LLC OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+
+
+#include "common.h"
+#include "stripe.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+
+struct StripeLane;
+
+// one writer buffer.  <inflight> is cleared by lane_put_done(), when the
+// PUT of that buffer completes.
+typedef struct {
+   struct StripeLane* lane;
+   int                inflight;
+   int                err;         // errno from a failed PUT
+} LanePut;
+
+typedef struct StripeLane {
+   MarFS_FileHandle   fh;          // private file-handle, one object at a time
+   struct Stripe*     st;
+   size_t             chunk_no;    // object open on <fh>
+   int                open;
+   size_t             pos;         // offset of next user-data in the object
+   size_t             end;         // reader: end of the open GET
+
+   // writer: one stripe-unit fills while the previous one is in flight
+   char*              buf[2];
+   size_t             fill;        // bytes in buf[cur]
+   int                cur;
+   LanePut            put[2];
+   pthread_mutex_t    put_lock;
+   pthread_cond_t     put_done;
+
+   // reader: the part of the current request that this lane handles
+   pthread_t          thr;
+   char*              rd_buf;
+   size_t             rd_offset;
+   size_t             rd_size;
+   int                rd_want;
+   int                err;
+} StripeLane;
+
+typedef struct Stripe {
+   MarFS_FileHandle*  fh;          // owner
+   size_t             width;
+   size_t             unit;
+   size_t             data1;       // user-data per object
+   size_t             rows;        // stripe-units per object (last may be short)
+   size_t             extent;      // reader: logical size of the file
+   size_t             written;     // writer: logical offset
+   size_t             objects;     // writer: objects started
+   int                failed;      // writer: something went wrong
+   StripeLane         lane[STRIPE_MAX_WIDTH];
+} Stripe;
+
+
+
+// ---------------------------------------------------------------------------
+// layout
+// ---------------------------------------------------------------------------
+
+// object holding logical <offset>, the offset within that object, and the
+// amount of data that is contiguous there (i.e. to the end of the unit)
+static
+void stripe_map(const Stripe* st, size_t offset,
+                size_t* chunk_no, size_t* obj_off, size_t* run) {
+
+   const size_t group_bytes = st->width * st->data1;
+   const size_t row_bytes   = st->width * st->unit;
+
+   size_t group = offset / group_bytes;
+   size_t rem   = offset - (group * group_bytes);
+   size_t row   = rem / row_bytes;
+   size_t unit  = st->unit;
+   if (row >= st->rows -1) {
+      row  = st->rows -1;
+      unit = st->data1 - (row * st->unit);
+   }
+   size_t in_row = rem - (row * row_bytes);
+   size_t lane   = in_row / unit;
+   size_t in_unit = in_row - (lane * unit);
+
+   *chunk_no = (group * st->width) + lane;
+   *obj_off  = (row * st->unit) + in_unit;
+   *run      = unit - in_unit;
+}
+
+// logical offset of the first byte in object <chunk_no>
+static
+size_t stripe_log_offset(const Stripe* st, size_t chunk_no) {
+   size_t group = chunk_no / st->width;
+   return (group * st->width * st->data1) + ((chunk_no % st->width) * st->unit);
+}
+
+// amount of user-data in object <chunk_no>, given st->extent
+static
+size_t stripe_obj_size(const Stripe* st, size_t chunk_no) {
+   size_t last_chunk;
+   size_t last_off;
+   size_t run;
+
+   if (! st->extent)
+      return 0;
+   stripe_map(st, st->extent -1, &last_chunk, &last_off, &run);
+
+   size_t group      = chunk_no   / st->width;
+   size_t last_group = last_chunk / st->width;
+   if (group < last_group)
+      return st->data1;
+   if (group > last_group)
+      return 0;
+
+   size_t lane      = chunk_no   % st->width;
+   size_t last_lane = last_chunk % st->width;
+   size_t row       = last_off / st->unit;
+   size_t row_unit  = ((row == st->rows -1)
+                       ? (st->data1 - (row * st->unit))
+                       : st->unit);
+   if (lane < last_lane)
+      return (row * st->unit) + row_unit;
+   if (lane == last_lane)
+      return last_off +1;
+   return (row * st->unit);
+}
+
+
+static
+Stripe* stripe_alloc(MarFS_FileHandle* fh, size_t width, size_t unit) {
+   const size_t data1 = fh->info.pre.chunk_size - MARFS_REC_UNI_SIZE;
+
+   if (width > STRIPE_MAX_WIDTH)
+      width = STRIPE_MAX_WIDTH;
+   if ((width < 2) || ! unit || (unit > data1)) {
+      LOG(LOG_ERR, "bad stripe layout: %lu x %lu (chunk data %lu)\n",
+          width, unit, data1);
+      errno = EINVAL;
+      return NULL;
+   }
+
+   Stripe* st = (Stripe*)calloc(1, sizeof(Stripe));
+   if (! st) {
+      LOG(LOG_ERR, "couldn't allocate Stripe\n");
+      errno = ENOMEM;
+      return NULL;
+   }
+   st->fh    = fh;
+   st->width = width;
+   st->unit  = unit;
+   st->data1 = data1;
+   st->rows  = (data1 + unit -1) / unit;
+
+   size_t i;
+   for (i=0; i<width; ++i) {
+      StripeLane* lane = &st->lane[i];
+      lane->st          = st;
+      lane->put[0].lane = lane;
+      lane->put[1].lane = lane;
+      pthread_mutex_init(&lane->put_lock, NULL);
+      pthread_cond_init(&lane->put_done, NULL);
+   }
+
+   LOG(LOG_INFO, "%s: %lu x %lu\n", fh->info.post.md_path, width, unit);
+   fh->stripe = st;
+   return st;
+}
+
+// point the lane's file-handle at object <chunk_no>.  The lane keeps its
+// ObjectStream (and connection) from one object to the next.
+static
+int lane_init(StripeLane* lane, size_t chunk_no) {
+   MarFS_FileHandle* fh  = lane->st->fh;
+   MarFS_FileHandle* lfh = &lane->fh;
+
+   lfh->info                = fh->info;
+   lfh->info.dedup          = NULL;
+   lfh->info.pre.chunk_no   = chunk_no;
+   lfh->info.pre.seed      += (chunk_no % lane->st->width); // spread across hosts
+   lfh->flags               = (fh->flags & (FH_READING | FH_WRITING));
+   memset(&lfh->write_status, 0, sizeof(WriteStatus));
+
+   lane->chunk_no = chunk_no;
+   lane->pos      = 0;
+   lane->fill     = 0;
+   return update_pre(&lfh->info.pre);
+}
+
+
+
+// ---------------------------------------------------------------------------
+// writers
+// ---------------------------------------------------------------------------
+
+int stripe_wanted(MarFS_FileHandle* fh) {
+   const PathInfo*   info = &fh->info;
+   const MarFS_Repo* repo = info->pre.repo;
+
+   return ((repo->stripe_width > 1)
+           && ! (fh->flags & (FH_PACKED | FH_Nto1_WRITES))
+           && (info->pre.obj_type != OBJ_Nto1)
+           && ! fh->write_status.sys_req   // marfs_open_at_offset()
+           && ! fh->open_offset);
+}
+
+#if USE_DAL
+// completion of the PUT of one buffer (maybe in some other thread)
+static
+void lane_put_done(DAL_Context* ctx, ssize_t rc, int err, void* arg) {
+   LanePut*    put  = (LanePut*)arg;
+   StripeLane* lane = put->lane;
+
+   pthread_mutex_lock(&lane->put_lock);
+   put->inflight = 0;
+   if (rc < 0)
+      put->err = err;
+   pthread_cond_broadcast(&lane->put_done);
+   pthread_mutex_unlock(&lane->put_lock);
+}
+#endif
+
+// start the PUT of whatever is in the current buffer
+static
+int lane_flush(StripeLane* lane) {
+   if (! lane->fill)
+      return 0;
+
+#if USE_DAL
+   LanePut* put = &lane->put[lane->cur];
+   put->inflight = 1;           // the callback may run before we return
+   if (DAL_OP(put_async, &lane->fh, FH_DAL(&lane->fh),
+              lane->buf[lane->cur], lane->fill, &lane_put_done, put)) {
+      put->inflight = 0;
+      return -1;
+   }
+#else
+   if (DAL_OP(put, &lane->fh, lane->buf[lane->cur], lane->fill) < 0)
+      return -1;
+#endif
+
+   lane->fill = 0;
+   lane->cur ^= 1;
+   return 0;
+}
+
+// wait for the PUT of buffer <idx>, so it can be refilled.  The PUT of
+// the other buffer stays in flight.
+static
+int lane_wait_buf(StripeLane* lane, int idx) {
+   LanePut* put = &lane->put[idx];
+
+   pthread_mutex_lock(&lane->put_lock);
+   while (put->inflight)
+      pthread_cond_wait(&lane->put_done, &lane->put_lock);
+   int err  = put->err;
+   put->err = 0;
+   pthread_mutex_unlock(&lane->put_lock);
+
+   if (err) {
+      errno = err;
+      return -1;
+   }
+   return 0;
+}
+
+// wait for all PUTs in flight, and collect the status of the context, as
+// required before close().
+static
+int lane_wait(StripeLane* lane) {
+   int rc = 0;
+   int err = 0;
+
+   if (lane_wait_buf(lane, 0)) {
+      rc  = -1;
+      err = errno;
+   }
+   if (lane_wait_buf(lane, 1) && ! rc) {
+      rc  = -1;
+      err = errno;
+   }
+#if USE_DAL
+   if (DAL_OP(wait, &lane->fh, FH_DAL(&lane->fh), 1) && ! rc) {
+      rc  = -1;
+      err = errno;
+   }
+#endif
+
+   if (rc)
+      errno = err;
+   return rc;
+}
+
+static
+int lane_start(StripeLane* lane, size_t chunk_no) {
+   TRY_DECLS();
+   Stripe*           st   = lane->st;
+   MarFS_FileHandle* fh   = st->fh;
+   PathInfo*         info = &fh->info;
+
+   TRY0( lane_init(lane, chunk_no) );
+   if (chunk_no >= st->objects)
+      st->objects = chunk_no +1;
+
+   // The file becomes Striped when it gets a second object.  As with a
+   // new Multi, save PRE, and give each object a ChunkInfo right away,
+   // so that GC can find all the objects of a file that never gets
+   // closed.  (See trash_truncate().)  The real ones come later.
+   if (chunk_no) {
+      MultiChunkInfo chnk = (MultiChunkInfo) {
+         .config_vers_maj  = MARFS_CONFIG_MAJOR,
+         .config_vers_min  = MARFS_CONFIG_MINOR,
+         .chunk_no         = chunk_no,
+         .logical_offset   = stripe_log_offset(st, chunk_no),
+      };
+      if (chunk_no == 1) {
+         TRY0( save_xattrs(info, XVT_PRE) );
+         MultiChunkInfo chnk0 = chnk;
+         chnk0.chunk_no       = 0;
+         chnk0.logical_offset = 0;
+         TRY0( put_chunkinfo(fh, &chnk0) );
+      }
+      TRY0( put_chunkinfo(fh, &chnk) );
+   }
+
+   // no content-length.  We don't know how much will be written.
+   TRY0( open_data(&lane->fh, OS_PUT, 0, 0, 0, info->pre.repo->write_timeout) );
+   lane->open = 1;
+   return 0;
+}
+
+// finish the object open on this lane.  With <abort>, just get rid of it.
+static
+int lane_finish(StripeLane* lane, int abort) {
+   Stripe*           st  = lane->st;
+   MarFS_FileHandle* fh  = st->fh;
+   MarFS_FileHandle* lfh = &lane->fh;
+   int               rc  = 0;
+
+   if (abort)
+      lane_wait(lane);
+   else if (lane_flush(lane) || lane_wait(lane)) {
+      LOG(LOG_ERR, "PUT failed for chunk %lu: %s\n", lane->chunk_no, strerror(errno));
+      rc = -1;
+   }
+   else if (write_recoveryinfo(&lfh->os, &lfh->info, lfh) < 0)
+      rc = -1;
+
+   if (close_data(lfh, (abort || rc), 1))
+      rc = -1;
+   lane->open = 0;
+
+   if (! abort && ! rc && (st->objects > 1)) {
+      MultiChunkInfo chnk = (MultiChunkInfo) {
+         .config_vers_maj  = MARFS_CONFIG_MAJOR,
+         .config_vers_min  = MARFS_CONFIG_MINOR,
+         .chunk_no         = lane->chunk_no,
+         .logical_offset   = stripe_log_offset(st, lane->chunk_no),
+         .chunk_data_bytes = lane->pos,
+         .correct_info     = chunk_correctinfo(lfh),
+         .encrypt_info     = fh->info.post.encrypt_info,
+      };
+      rc = put_chunkinfo(fh, &chnk);
+   }
+
+   LOG(LOG_INFO, "chunk %lu: %lu bytes, rc=%d\n", lane->chunk_no, lane->pos, rc);
+   return rc;
+}
+
+ssize_t stripe_write(MarFS_FileHandle* fh, const char* buf, size_t size) {
+   Stripe* st = fh->stripe;
+   size_t  done = 0;
+
+   if (! st) {
+      const MarFS_Repo* repo = fh->info.pre.repo;
+      st = stripe_alloc(fh, repo->stripe_width, repo->stripe_unit);
+      if (! st)
+         return -1;
+   }
+   if (st->failed) {
+      errno = EIO;
+      return -1;
+   }
+
+   while (done < size) {
+      size_t chunk_no;
+      size_t obj_off;
+      size_t run;
+      stripe_map(st, st->written, &chunk_no, &obj_off, &run);
+
+      StripeLane* lane = &st->lane[chunk_no % st->width];
+      if (! lane->open || (lane->chunk_no != chunk_no)) {
+         if (lane->open && lane_finish(lane, 0))
+            goto fail;
+         if (lane_start(lane, chunk_no))
+            goto fail;
+      }
+
+      // reuse a buffer once its PUT is done
+      if (lane_wait_buf(lane, lane->cur))
+         goto fail;
+      if (! lane->buf[lane->cur]) {
+         lane->buf[lane->cur] = (char*)malloc(st->unit);
+         if (! lane->buf[lane->cur]) {
+            errno = ENOMEM;
+            goto fail;
+         }
+      }
+
+      size_t n = size - done;
+      if (n > run)
+         n = run;
+      memcpy(lane->buf[lane->cur] + lane->fill, buf + done, n);
+      update_correctinfo(&lane->fh, buf + done, n); // this object
+      update_correctinfo(fh, buf + done, n);        // the whole file
+      lane->fill  += n;
+      lane->pos   += n;
+      st->written += n;
+      done        += n;
+
+      // end of a stripe-unit
+      if ((n == run) && lane_flush(lane))
+         goto fail;
+   }
+   return size;
+
+ fail:
+   LOG(LOG_ERR, "%s: failed at %lu: %s\n",
+       fh->info.post.md_path, st->written, strerror(errno));
+   st->failed = 1;
+   return -1;
+}
+
+int stripe_close(MarFS_FileHandle* fh) {
+   Stripe*   st   = fh->stripe;
+   PathInfo* info = &fh->info;
+   int       rc   = 0;
+   size_t    i;
+
+   if (! st)
+      return 0;
+
+   for (i=0; i<st->width; ++i) {
+      if (st->lane[i].open && lane_finish(&st->lane[i], st->failed))
+         rc = -1;
+   }
+   if (st->failed)
+      rc = -1;
+
+   if (! rc && (st->objects > 1)) {
+      info->post.obj_type         = OBJ_STRIPED;
+      info->post.obj_offset       = STRIPE_LAYOUT(st->width, st->unit);
+      info->post.chunks           = st->objects;
+      info->post.chunk_info_bytes = st->objects * sizeof(MultiChunkInfo);
+   }
+   LOG(LOG_INFO, "%s: %lu bytes in %lu objects, rc=%d\n",
+       info->post.md_path, st->written, st->objects, rc);
+
+   stripe_free(fh);
+   return rc;
+}
+
+
+
+// ---------------------------------------------------------------------------
+// readers
+// ---------------------------------------------------------------------------
+
+// read <size> bytes at <obj_off> in object <chunk_no>, into <buf>
+static
+int lane_get(StripeLane* lane, size_t chunk_no, size_t obj_off,
+             char* buf, size_t size) {
+   TRY_DECLS();
+   Stripe*            st   = lane->st;
+   MarFS_FileHandle*  lfh  = &lane->fh;
+   const MarFS_Repo*  repo = st->fh->info.pre.repo;
+
+   while (size) {
+
+      // not where we want to be?
+      if (lane->open
+          && ((lane->chunk_no != chunk_no)
+              || (lane->pos != obj_off))) {
+         close_data(lfh, 1, 1);
+         lane->open = 0;
+      }
+
+      // GET the rest of the object (or max_get_size of it)
+      if (! lane->open) {
+         size_t end = stripe_obj_size(st, chunk_no);
+         if (repo->max_get_size && (end - obj_off > repo->max_get_size))
+            end = obj_off + repo->max_get_size;
+
+         TRY0( lane_init(lane, chunk_no) );
+         TRY0( open_data(lfh, OS_GET, obj_off, end - obj_off, 0, repo->read_timeout) );
+         lane->open = 1;
+         lane->pos  = obj_off;
+         lane->end  = end;
+      }
+
+      size_t n   = ((size < lane->end - lane->pos) ? size : lane->end - lane->pos);
+      size_t got = 0;
+      while (got < n) {
+         rc_ssize = DAL_OP(get, lfh, buf + got, n - got);
+         if (rc_ssize <= 0) {
+            LOG(LOG_ERR, "get returned %ld, chunk %lu at %lu (%d '%s')\n",
+                rc_ssize, chunk_no, lane->pos + got, lfh->os.iob.code, lfh->os.iob.result);
+            close_data(lfh, 1, 1);
+            lane->open = 0;
+            errno = EIO;
+            return -1;
+         }
+         got += rc_ssize;
+      }
+      lane->pos += n;
+      obj_off   += n;
+      buf       += n;
+      size      -= n;
+
+      if (lane->pos == lane->end) {
+         lane->open = 0;
+         TRY0( close_data(lfh, 0, 0) );
+      }
+   }
+   return 0;
+}
+
+// read this lane's parts of [rd_offset, rd_offset + rd_size)
+static
+void* lane_read(void* arg) {
+   StripeLane*  lane = (StripeLane*)arg;
+   Stripe*      st   = lane->st;
+   const size_t idx  = lane - st->lane;
+   const size_t end  = lane->rd_offset + lane->rd_size;
+   size_t       pos  = lane->rd_offset;
+
+   while (pos < end) {
+      size_t chunk_no;
+      size_t obj_off;
+      size_t run;
+      stripe_map(st, pos, &chunk_no, &obj_off, &run);
+
+      size_t n = ((run < end - pos) ? run : end - pos);
+      if (((chunk_no % st->width) == idx)
+          && lane_get(lane, chunk_no, obj_off,
+                      lane->rd_buf + (pos - lane->rd_offset), n)) {
+         lane->err = (errno ? errno : EIO);
+         break;
+      }
+      pos += n;
+   }
+   return NULL;
+}
+
+ssize_t stripe_read(MarFS_FileHandle* fh, char* buf, size_t size, size_t offset) {
+   PathInfo* info = &fh->info;
+   Stripe*   st   = fh->stripe;
+   size_t    i;
+
+   if (! st) {
+      st = stripe_alloc(fh, STRIPE_WIDTH(&info->post), STRIPE_UNIT(&info->post));
+      if (! st)
+         return -1;
+   }
+   st->extent = info->st.st_size;
+
+   // which lanes have something to do?
+   size_t lanes = 0;
+   size_t pos   = offset;
+   for (i=0; i<st->width; ++i)
+      st->lane[i].rd_want = 0;
+   while ((pos < offset + size) && (lanes < st->width)) {
+      size_t chunk_no;
+      size_t obj_off;
+      size_t run;
+      stripe_map(st, pos, &chunk_no, &obj_off, &run);
+
+      StripeLane* lane = &st->lane[chunk_no % st->width];
+      if (! lane->rd_want) {
+         lane->rd_want   = 1;
+         lane->rd_buf    = buf;
+         lane->rd_offset = offset;
+         lane->rd_size   = size;
+         lane->err       = 0;
+         ++ lanes;
+      }
+      pos += run;
+   }
+
+   // one lane runs in this thread.  If we can't start a thread for some
+   // other one, it runs here, too.
+   StripeLane* here    = NULL;
+   int         started[STRIPE_MAX_WIDTH] = {0};
+   for (i=0; i<st->width; ++i) {
+      StripeLane* lane = &st->lane[i];
+      if (! lane->rd_want)
+         continue;
+      if (! here)
+         here = lane;
+      else if (! pthread_create(&lane->thr, NULL, &lane_read, lane))
+         started[i] = 1;
+      else {
+         LOG(LOG_ERR, "pthread_create failed for lane %lu: '%s'\n", i, strerror(errno));
+         lane_read(lane);
+      }
+   }
+   if (here)
+      lane_read(here);
+
+   int err = 0;
+   for (i=0; i<st->width; ++i) {
+      StripeLane* lane = &st->lane[i];
+      if (started[i])
+         pthread_join(lane->thr, NULL);
+      if (lane->rd_want && lane->err && ! err)
+         err = lane->err;
+   }
+   if (err) {
+      LOG(LOG_ERR, "%s: striped read %lu+%lu failed: %s\n",
+          info->post.md_path, offset, size, strerror(err));
+      errno = err;
+      return -1;
+   }
+
+   LOG(LOG_INFO, "%s: read %lu+%lu from %lu lanes\n",
+       info->post.md_path, offset, size, lanes);
+   return size;
+}
+
+
+
+void stripe_free(MarFS_FileHandle* fh) {
+   Stripe* st = fh->stripe;
+   size_t  i;
+
+   if (! st)
+      return;
+
+   for (i=0; i<st->width; ++i) {
+      StripeLane* lane = &st->lane[i];
+      if (lane->open) {
+         lane_wait(lane);
+         close_data(&lane->fh, 1, 1);
+      }
+      stream_release(&lane->fh.os);
+      free(lane->buf[0]);
+      free(lane->buf[1]);
+      pthread_cond_destroy(&lane->put_done);
+      pthread_mutex_destroy(&lane->put_lock);
+   }
+   free(st);
+   fh->stripe = NULL;
+}
@@ -0,0 +1,135 @@
+#ifndef _MARFS_STRIPE_H
+#define _MARFS_STRIPE_H
+
+
+
+/*
+This file is part of MarFS, which is released under the BSD license.
+
+
+Copyright (c) 2015, Los Alamos National Security (LANS), LLC
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation and/or
+other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors
+may be used to endorse or promote products derived from this software without
+specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+-----
+NOTE:
+-----
+MarFS uses libaws4c for Amazon S3 object communication. The original version
+is at https://aws.amazon.com/code/Amazon-S3/2601 and under the LGPL license.
+LANS, LLC added functionality to the original work. The original work plus
+LANS, LLC contributions is found at https://github.com/jti-lanl/aws4c.
+
+GNU licenses can be found at <http://www.gnu.org/licenses/>.
+
+
+From Los Alamos National Security, LLC:
+LA-CC-15-039
+
+Copyright (c) 2015, Los Alamos National Security, LLC All rights reserved.
+Copyright 2015. Los Alamos National Security, LLC. This software was produced
+under U.S. Government contract DE-AC52-06NA25396 for Los Alamos National
+Laboratory (LANL), which is operated by Los Alamos National Security, LLC for
+the U.S. Department of Energy. The U.S. Government has rights to use,
+reproduce, and distribute this software.  NEITHER THE GOVERNMENT NOR LOS
+ALAMOS NATIONAL SECURITY, LLC MAKES ANY WARRANTY, EXPRESS OR IMPLIED, OR
+ASSUMES ANY LIABILITY FOR THE USE OF THIS SOFTWARE.  If software is
+modified to produce derivative works, such modified software should be
+clearly marked, so as not to confuse it with the version available from
+LANL.
+
+THIS SOFTWARE IS PROVIDED BY LOS ALAMOS NATIONAL SECURITY, LLC AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL LOS ALAMOS NATIONAL SECURITY, LLC OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+
+
+
+
+
+// ---------------------------------------------------------------------------
+// STRIPE
+//
+// A repo with stripe_width K > 1 writes the files that come through
+// marfs_write() as OBJ_STRIPED.  The data goes round-robin, stripe_unit
+// bytes at a time, to K objects, all of which are open at once, each with
+// its own file-handle (and so, its own DAL state and connection).  PUTs
+// to the K objects run concurrently, so one file can use K object servers.
+//
+// Objects are still chunks, with the usual object-IDs (chunk_no), sizes
+// (chunk_size, with recovery-info at the tail), and MultiChunkInfos.
+// Object N belongs to stripe-group N / K, which holds K chunks' worth of
+// user-data, and is lane N % K in that group:
+//
+//    group 0:   obj 0    obj 1    ...  obj K-1
+//               unit 0   unit 1   ...  unit K-1
+//               unit K   unit K+1 ...  unit 2K-1
+//               ...
+//    group 1:   obj K    obj K+1  ...  obj 2K-1
+//
+// If stripe_unit doesn't divide a chunk, the last round of units in each
+// group is short.  Post.obj_offset holds the width and unit (see
+// STRIPE_LAYOUT()), and Post.chunks the number of objects.  A file that
+// never gets past its first object is just Uni.
+//
+// Readers map each part of a request to its object, and read the parts
+// for different objects concurrently.  Each lane keeps its GET open
+// across calls, so sequential small reads still stream.
+//
+// pftool (N:1, or marfs_open_at_offset()) and Packed files don't stripe.
+// ---------------------------------------------------------------------------
+
+#include "common.h"
+
+
+#define STRIPE_MAX_WIDTH   16
+
+
+// should marfs_write() stripe this (newly-opened) file?
+int     stripe_wanted(MarFS_FileHandle* fh);
+
+// Writers.  stripe_write() takes the next <size> bytes of the file.
+// stripe_close() finishes all the objects, and fills in POST.
+ssize_t stripe_write (MarFS_FileHandle* fh, const char* buf, size_t size);
+int     stripe_close (MarFS_FileHandle* fh);
+
+// Readers.  Caller has STAT'ed, and cropped <size> to the extent.
+ssize_t stripe_read  (MarFS_FileHandle* fh, char* buf, size_t size, size_t offset);
+
+// abandon any open streams, and free everything
+void    stripe_free  (MarFS_FileHandle* fh);
+
+
+#endif
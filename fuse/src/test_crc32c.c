@@ -0,0 +1,196 @@
+/*
+This file is part of MarFS, which is released under the BSD license.
+
+
+Copyright (c) 2015, Los Alamos National Security (LANS), LLC
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation and/or
+other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors
+may be used to endorse or promote products derived from this software without
+specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+-----
+NOTE:
+-----
+MarFS uses libaws4c for Amazon S3 object communication. The original version
+is at https://aws.amazon.com/code/Amazon-S3/2601 and under the LGPL license.
+LANS, LLC added functionality to the original work. The original work plus
+LANS, LLC contributions is found at https://github.com/jti-lanl/aws4c.
+
+GNU licenses can be found at <http://www.gnu.org/licenses/>.
+
+
+From Los Alamos National Security, LLC:
+LA-CC-15-039
+
+Copyright (c) 2015, Los Alamos National Security, LLC All rights reserved.
+Copyright 2015. Los Alamos National Security, LLC. This software was produced
+under U.S. Government contract DE-AC52-06NA25396 for Los Alamos National
+Laboratory (LANL), which is operated by Los Alamos National Security, LLC for
+the U.S. Department of Energy. The U.S. Government has rights to use,
+reproduce, and distribute this software.  NEITHER THE GOVERNMENT NOR LOS
+ALAMOS NATIONAL SECURITY, LLC MAKES ANY WARRANTY, EXPRESS OR IMPLIED, OR
+ASSUMES ANY LIABILITY FOR THE USE OF THIS SOFTWARE.  If software is
+modified to produce derivative works, such modified software should be
+clearly marked, so as not to confuse it with the version available from
+LANL.
+
+THIS SOFTWARE IS PROVIDED BY LOS ALAMOS NATIONAL SECURITY, LLC AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL LOS ALAMOS NATIONAL SECURITY, LLC OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+
+// Check crc32c() against known values and the table-driven version, then
+// measure its throughput, and what that costs against a streaming write
+// at a given bandwidth.  For scale, we also show memcpy() of the same
+// data, which every write already pays for, copying user-data into the
+// stream's buffers.
+//
+//    test_crc32c [stream_MB_per_sec]      (default 2000)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "crc32c.h"
+
+
+#define BENCH_BUF    (256 * 1024 * 1024)
+#define BENCH_CALL   (1024 * 1024)      // like a large fuse/pftool write
+
+
+static double now_sec(void) {
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + (ts.tv_nsec / 1e9);
+}
+
+static int check(void) {
+   static const char* vec = "123456789";
+   int                err = 0;
+
+   if (crc32c(0, vec, 9) != 0xe3069283) {
+      fprintf(stderr, "crc32c(\"%s\") = 0x%08x, expected 0xe3069283\n",
+              vec, crc32c(0, vec, 9));
+      err = 1;
+   }
+   if (crc32c_sw(0, vec, 9) != 0xe3069283) {
+      fprintf(stderr, "crc32c_sw(\"%s\") = 0x%08x, expected 0xe3069283\n",
+              vec, crc32c_sw(0, vec, 9));
+      err = 1;
+   }
+
+   // odd lengths and alignments, chained and combined
+   static char buf[(64 * 1024) + 8];
+   size_t i;
+   for (i=0; i<sizeof(buf); ++i)
+      buf[i] = (char)rand();
+   for (i=0; i<1000 && !err; ++i) {
+      size_t off   = rand() % 8;
+      size_t len   = rand() % (sizeof(buf) - 8);
+      size_t split = (len ? rand() % len : 0);
+
+      uint32_t whole = crc32c_sw(0, buf + off, len);
+      uint32_t a     = crc32c(0, buf + off, split);
+      uint32_t b     = crc32c(0, buf + off + split, len - split);
+
+      if (crc32c(0, buf + off, len) != whole) {
+         fprintf(stderr, "mismatch: off=%lu len=%lu\n", off, len);
+         err = 1;
+      }
+      else if (crc32c(a, buf + off + split, len - split) != whole) {
+         fprintf(stderr, "chain mismatch: off=%lu len=%lu split=%lu\n", off, len, split);
+         err = 1;
+      }
+      else if (crc32c_combine(a, b, len - split) != whole) {
+         fprintf(stderr, "combine mismatch: off=%lu len=%lu split=%lu\n", off, len, split);
+         err = 1;
+      }
+   }
+   return err;
+}
+
+// stands in for the copy into the write-ring, or libcurl's buffer
+static uint32_t copy_fn(uint32_t crc, const void* buf, size_t len) {
+   static char dest[BENCH_CALL];
+   memcpy(dest, buf, len);
+   return crc + dest[len / 2];
+}
+
+typedef uint32_t (*crc_fn)(uint32_t crc, const void* buf, size_t len);
+
+static double bench(crc_fn fn, const char* buf) {
+   double   t0  = now_sec();
+   uint32_t crc = 0;
+   size_t   off;
+   for (off=0; off<BENCH_BUF; off+=BENCH_CALL)
+      crc = (*fn)(crc, buf + off, BENCH_CALL);
+   double   t1  = now_sec();
+
+   if (crc == 0x12345678)       // keep the compiler honest
+      printf("(lucky)\n");
+   return (BENCH_BUF / (1024.0 * 1024.0)) / (t1 - t0);
+}
+
+int main(int argc, char* argv[]) {
+   double stream_mbs = ((argc > 1) ? atof(argv[1]) : 2000.0);
+
+   if (check()) {
+      printf("FAIL\n");
+      return 1;
+   }
+   printf("checks passed (%s)\n", crc32c_impl());
+
+   char* buf = (char*)malloc(BENCH_BUF);
+   if (! buf) {
+      fprintf(stderr, "couldn't allocate %d bytes\n", BENCH_BUF);
+      return 1;
+   }
+   memset(buf, 0xa5, BENCH_BUF); // fault it in
+
+   double hw = bench(&crc32c,    buf);
+   double sw = bench(&crc32c_sw, buf);
+   double cp = bench(&copy_fn,   buf);
+
+   // CRC is computed inline with the write, so at a stream of S MB/s,
+   // computing it at C MB/s costs S/C of each second.
+   printf("crc32c (%s)  %9.1f MB/s   overhead at %.0f MB/s: %5.2f%%\n",
+          crc32c_impl(), hw, stream_mbs, 100.0 * stream_mbs / hw);
+   printf("crc32c (table)  %9.1f MB/s   overhead at %.0f MB/s: %5.2f%%\n",
+          sw, stream_mbs, 100.0 * stream_mbs / sw);
+   printf("memcpy          %9.1f MB/s\n", cp);
+
+   free(buf);
+   return 0;
+}
@@ -0,0 +1,211 @@
+
+/*
+This file is part of MarFS, which is released under the BSD license.
+
+
+Copyright (c) 2015, Los Alamos National Security (LANS), LLC
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation and/or
+other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors
+may be used to endorse or promote products derived from this software without
+specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+-----
+NOTE:
+-----
+MarFS uses libaws4c for Amazon S3 object communication. The original version
+is at https://aws.amazon.com/code/Amazon-S3/2601 and under the LGPL license.
+LANS, LLC added functionality to the original work. The original work plus
+LANS, LLC contributions is found at https://github.com/jti-lanl/aws4c.
+
+GNU licenses can be found at <http://www.gnu.org/licenses/>.
+
+
+From Los Alamos National Security, LLC:
+LA-CC-15-039
+
+Copyright (c) 2015, Los Alamos National Security, LLC All rights reserved.
+Copyright 2015. Los Alamos National Security, LLC. This software was produced
+under U.S. Government contract DE-AC52-06NA25396 for Los Alamos National
+Laboratory (LANL), which is operated by Los Alamos National Security, LLC for
+the U.S. Department of Energy. The U.S. Government has rights to use,
+reproduce, and distribute this software.  NEITHER THE GOVERNMENT NOR LOS
+ALAMOS NATIONAL SECURITY, LLC MAKES ANY WARRANTY, EXPRESS OR IMPLIED, OR
+ASSUMES ANY LIABILITY FOR THE USE OF THIS SOFTWARE.  If software is
+modified to produce derivative works, such modified software should be
+clearly marked, so as not to confuse it with the version available from
+LANL.
+
+THIS SOFTWARE IS PROVIDED BY LOS ALAMOS NATIONAL SECURITY, LLC AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL LOS ALAMOS NATIONAL SECURITY, LLC OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+
+
+// Check that rs_decode() recovers every pattern of up to <e> lost blocks,
+// then measure encode and decode throughput, in terms of data bytes (n
+// blocks per stripe), the same way libne reports it.
+//
+//    test_rs_codec [n [e [block_KB]]]      (default 10 2 1024)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "rs_codec.h"
+
+
+#define BENCH_BYTES  (1024L * 1024 * 1024)  // data encoded, per benchmark
+
+
+static double now_sec(void) {
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + (ts.tv_nsec / 1e9);
+}
+
+static uint8_t** alloc_blocks(int count, size_t len) {
+   uint8_t** blocks = (uint8_t**)calloc(count, sizeof(uint8_t*));
+   int i;
+   for (i=0; blocks && (i<count); ++i) {
+      blocks[i] = (uint8_t*)malloc(len);
+      if (! blocks[i])
+         return NULL;
+   }
+   return blocks;
+}
+
+// try every erasure-pattern of up to <e> blocks
+static int check(int n, int e, size_t len) {
+   RS_Code   rs;
+   int       total = n + e;
+   uint8_t** blocks = alloc_blocks(total, len);
+   uint8_t** orig   = alloc_blocks(total, len);
+   int       i;
+
+   if (! blocks || ! orig || rs_init(&rs, n, e)) {
+      fprintf(stderr, "setup failed for %d+%d\n", n, e);
+      return 1;
+   }
+   for (i=0; i<n; ++i) {
+      size_t j;
+      for (j=0; j<len; ++j)
+         blocks[i][j] = (uint8_t)rand();
+   }
+   rs_encode(&rs, blocks, len);
+   for (i=0; i<total; ++i)
+      memcpy(orig[i], blocks[i], len);
+
+   uint32_t pattern;
+   for (pattern=1; pattern < (1u << total); ++pattern) {
+      if (__builtin_popcount(pattern) > e)
+         continue;
+      for (i=0; i<total; ++i) {
+         if (pattern & (1u << i))
+            memset(blocks[i], 0x5a, len);
+      }
+      if (rs_decode(&rs, blocks, pattern, len)) {
+         fprintf(stderr, "%d+%d: decode failed for pattern 0x%x\n", n, e, pattern);
+         return 1;
+      }
+      for (i=0; i<total; ++i) {
+         if (memcmp(blocks[i], orig[i], len)) {
+            fprintf(stderr, "%d+%d: block %d wrong after pattern 0x%x\n",
+                    n, e, i, pattern);
+            return 1;
+         }
+      }
+   }
+
+   // one too many
+   if (e < total && ! rs_decode(&rs, blocks, (1u << (e + 1)) - 1, len)) {
+      fprintf(stderr, "%d+%d: decode of %d lost blocks should fail\n", n, e, e + 1);
+      return 1;
+   }
+
+   for (i=0; i<total; ++i) {
+      free(blocks[i]);
+      free(orig[i]);
+   }
+   free(blocks);
+   free(orig);
+   return 0;
+}
+
+int main(int argc, char* argv[]) {
+   int    n   = ((argc > 1) ? atoi(argv[1]) : 10);
+   int    e   = ((argc > 2) ? atoi(argv[2]) : 2);
+   size_t len = ((argc > 3) ? atoi(argv[3]) : 1024) * 1024;
+
+   // odd lengths exercise the scalar tails
+   if (check(4, 2, 1000) || check(6, 3, 4099) || check(10, 2, 65536)
+       || check(3, 1, 777) || check(n, e, 4096)) {
+      printf("FAIL\n");
+      return 1;
+   }
+   printf("checks passed (%s)\n", rs_impl());
+
+   RS_Code   rs;
+   uint8_t** blocks = alloc_blocks(n + e, len);
+   if (rs_init(&rs, n, e) || ! blocks) {
+      fprintf(stderr, "couldn't set up %d+%d with %lu-byte blocks\n", n, e, len);
+      return 1;
+   }
+   int i;
+   for (i=0; i<n; ++i)
+      memset(blocks[i], 0xa5 + i, len);
+
+   long   stripes = BENCH_BYTES / (n * len);
+   long   s;
+   if (stripes < 1)
+      stripes = 1;
+   double data_mb = (stripes * n * (double)len) / (1024.0 * 1024.0);
+
+   double t0 = now_sec();
+   for (s=0; s<stripes; ++s)
+      rs_encode(&rs, blocks, len);
+   double t1 = now_sec();
+   printf("encode %d+%d            %9.1f MB/s\n", n, e, data_mb / (t1 - t0));
+
+   // worst case: <e> data-blocks lost
+   uint32_t lost = (1u << e) - 1;
+   t0 = now_sec();
+   for (s=0; s<stripes; ++s)
+      rs_decode(&rs, blocks, lost, len);
+   t1 = now_sec();
+   printf("decode %d+%d, %d data lost %9.1f MB/s\n", n, e, e, data_mb / (t1 - t0));
+
+   return 0;
+}
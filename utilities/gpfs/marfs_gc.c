@@ -81,6 +81,7 @@ OF SUCH DAMAGE.
 #include "aws4c.h"
 #include "marfs_configuration.h"
 #include "common.h"
+#include "dedup.h"
 #include "utilities_common.h"
 
 typedef struct payload_file_struct {
@@ -666,6 +667,50 @@ int get_xattr_value(struct     marfs_xattr *xattr_ptr,
    return(ret_value);
 }
 
+/***************************************************************************** 
+Name:  get_md_xattrs
+
+Stores the v1 strings from the packed MD xattr (see get_md_v1_xattrs())
+that are named in marfs_xattr, after the <count> already found.  A string
+replaces an older xattr of the same name, already found, because the
+packed xattr is the current one, when a file has both.  Returns the new
+count.
+
+*****************************************************************************/
+static int get_md_xattrs(const char *valueP,
+                         unsigned int valueLen,
+                         const char **marfs_xattr,
+                         int max_xattr_count,
+                         struct marfs_xattr *xattr_ptr,
+                         int count) {
+   V1_Xattr v1[MD_V1_XATTRS];
+   int v1_count;
+   int i;
+   int j;
+
+   v1_count = get_md_v1_xattrs(valueP, valueLen, v1);
+   for (j=0; j < v1_count; j++) {
+      for (i=0; i < max_xattr_count; i++) {
+         if (!strcmp(v1[j].name, marfs_xattr[i]))
+            break;
+      }
+      if (i == max_xattr_count)
+         continue;              // caller isn't interested
+
+      int index = get_xattr_value(xattr_ptr, v1[j].name, count);
+      if (index < 0) {
+         if (count >= MAX_MARFS_XATTR)
+            continue;
+         index = count++;
+      }
+      strcpy(xattr_ptr[index].xattr_name, v1[j].name);
+      strncpy(xattr_ptr[index].xattr_value, v1[j].value,
+              GPFS_FCNTL_XATTR_MAX_VALUELEN -1);
+      xattr_ptr[index].xattr_value[GPFS_FCNTL_XATTR_MAX_VALUELEN -1] = '\0';
+   }
+   return(count);
+}
+
 /***************************************************************************** 
 Name:  get_xattrs
 
@@ -688,6 +733,7 @@ int get_xattrs(gpfs_iscan_t *iscanP,
    int printable;
    int xattr_count =0;
    int desired_xattr = 0;
+   struct marfs_xattr *first = xattr_ptr;
 
    /*  Loop through attributes */
    while ((xattrBufP != NULL) && (xattrBufLen > 0)) {
@@ -703,6 +749,19 @@ int get_xattrs(gpfs_iscan_t *iscanP,
 
 
 
+      // the packed MD xattr stands in for the ones below
+      if (!strcmp(nameP, MARFS_MD_XATTR)) {
+         xattr_count = get_md_xattrs(valueP, valueLen,
+                                     marfs_xattr, max_xattr_count,
+                                     first, xattr_count);
+         xattr_ptr   = first + xattr_count;
+         continue;
+      }
+
+      // a text xattr loses to the same one from the packed xattr
+      if (get_xattr_value(first, nameP, xattr_count) >= 0)
+         continue;
+
       //Determine if found a marfs_xattr by comparing our list of xattrs
       //to what the scan has found
       for ( i=0; i < max_xattr_count; i++) {
@@ -1270,6 +1329,7 @@ int dump_trash(MarFS_FileHandle   *fh,
    MarFS_XattrPre  *pre_ptr     = &fh->info.pre;
    MarFS_XattrPost *post_ptr    = &fh->info.post;
    char            *md_path_ptr =  fh->info.post.md_path;
+   Chunk_Batch     *batch       = NULL;
 
 
    // This is the case where a file in trash has a RESTART xattr and the
@@ -1311,6 +1371,14 @@ int dump_trash(MarFS_FileHandle   *fh,
          return -1;
       }
       
+      batch = (Chunk_Batch*)malloc(sizeof(Chunk_Batch));
+      if (! batch) {
+         fprintf(stderr, "no memory to delete chunks of MD file: '%s'\n", md_path_ptr);
+         close_md(fh);
+         return -1;
+      }
+      batch->count = 0;
+
       // read chunkinfo and create object name so that it can be deleted
       MultiChunkInfo chunk_info;
       while (! read_chunkinfo(fh, &chunk_info)) {
@@ -1318,36 +1386,55 @@ int dump_trash(MarFS_FileHandle   *fh,
 
             pre_ptr->chunk_no = chunk_info.chunk_no;
             update_pre(pre_ptr);
-            update_url(&fh->os, &fh->info);
 
-            if ((delete_obj_status = delete_object(fh, file_info_ptr, multi_flag))) {
-               print_current_time();
-               fprintf(run_info.outfd,
-                       "delete error (return value: %d) on object %s\n",
-                       delete_obj_status, fh->os.url); // xattr_ptr->xattr_value
+            if (queue_chunk(fh, file_info_ptr, batch))
                return_value = -1;
-            }
          }
       }
+      if (delete_chunks(fh, file_info_ptr, batch))
+         return_value = -1;
       close_md(fh);
    }
-   // If multi type file then delete all objects associated with file
-   else if (post_ptr->obj_type == OBJ_MULTI) {
+   // If multi type file then delete all objects associated with file.
+   // Striped files also have one chunk-info per object.
+   else if ((post_ptr->obj_type == OBJ_MULTI)
+            || (post_ptr->obj_type == OBJ_STRIPED)) {
       multi_flag = 1;
 
+      batch = (Chunk_Batch*)malloc(sizeof(Chunk_Batch));
+      if (! batch) {
+         fprintf(stderr, "no memory to delete chunks of MD file: '%s'\n", md_path_ptr);
+         return -1;
+      }
+      batch->count = 0;
+
+      // Deduplicated chunks may be shared with other files.  Without the
+      // table of references, we can't tell which ones, so keep the file.
+      if ((post_ptr->flags & POST_DEDUP)
+          && (dedup_load(&fh->info) || ! fh->info.dedup)) {
+         print_current_time();
+         fprintf(run_info.outfd, "couldn't read %s of %s\n", DEDUP_XATTR, md_path_ptr);
+         free(batch);
+         return -1;
+      }
+
       for (i=0; i < post_ptr->chunks; i++ ) {
          pre_ptr->chunk_no = i;
          update_pre(pre_ptr);
-         update_url(&fh->os, &fh->info);
 
-         if ((delete_obj_status = delete_object(fh, file_info_ptr, multi_flag))) {
-            print_current_time();
-            fprintf(run_info.outfd,
-                    "delete error (return value: %d) on object %s\n",
-                    delete_obj_status, fh->os.url); // xattr_ptr->xattr_value
-            return_value = -1;
+         const DedupEntry* ent = (fh->info.dedup
+                                  ? dedup_find(fh->info.dedup, i)
+                                  : NULL);
+         if (ent) {
+            if (release_dedup_chunk(fh, file_info_ptr, ent))
+               return_value = -1;
          }
+         else if (queue_chunk(fh, file_info_ptr, batch))
+            return_value = -1;
       }
+      if (delete_chunks(fh, file_info_ptr, batch))
+         return_value = -1;
+      dedup_free(&fh->info);
    }
 
    // else UNI, but need to implement other formats, as they are developed 
@@ -1370,6 +1457,8 @@ int dump_trash(MarFS_FileHandle   *fh,
    // not delete objects anymore, I would delete files so hopefully I could
    // use delete file as is.  
 
+   free(batch);
+
    // Delete trash files
    // Only delete if no error deleting object
    if (!return_value) {
@@ -1436,6 +1525,128 @@ int delete_object(MarFS_FileHandle *fh,
    return 0;
 }
 
+/***************************************************************************** 
+Name: queue_chunk 
+
+ This function adds the chunk-object whose ID is in fh->pre to the batch,
+ deleting the batch first, if it is full.  Returns -1 if that delete had
+ errors, 0 otherwise.
+*****************************************************************************/
+int queue_chunk(MarFS_FileHandle *fh,
+                File_Info        *file_info_ptr,
+                Chunk_Batch      *batch)
+{
+   int rc = 0;
+
+   if (batch->count == GC_DELETE_BATCH)
+      rc = delete_chunks(fh, file_info_ptr, batch);
+
+   size_t n = batch->count++;
+   batch->chunk_no[n] = fh->info.pre.chunk_no;
+   strncpy(batch->objid[n], fh->info.pre.objid, MARFS_MAX_OBJID_SIZE);
+   batch->objid[n][MARFS_MAX_OBJID_SIZE -1] = 0;
+   batch->objids[n] = batch->objid[n];
+
+   return rc;
+}
+
+/***************************************************************************** 
+Name: delete_chunks 
+
+ This function deletes the chunk-objects of a multi file that have been
+ collected in the batch, with a single DAL call, and empties the batch.
+ Returns -1 if any of them could not be deleted, 0 if successful.
+*****************************************************************************/
+int delete_chunks(MarFS_FileHandle *fh,
+                  File_Info        *file_info_ptr,
+                  Chunk_Batch      *batch)
+{
+   MarFS_XattrPre* pre_ptr = &fh->info.pre;
+   int             rc      = 0;
+   size_t          i;
+
+   for (i=0; i < batch->count; i++) {
+      // timestamp, plus "ID'd " or "deleting "
+      print_delete_preamble();
+
+      if (file_info_ptr->restart_found && pre_ptr->obj_type == OBJ_Nto1)
+         fprintf(run_info.outfd, "chunk %zd of incomplete Nto1 multi object %s\n",
+                 batch->chunk_no[i], batch->objid[i]);
+      else if (file_info_ptr->restart_found && pre_ptr->obj_type == OBJ_FUSE)
+         fprintf(run_info.outfd, "incomplete FUSE multi object %s\n",
+                 batch->objid[i]);
+      else
+         fprintf(run_info.outfd, "chunk %zd of multi object %s\n",
+                 batch->chunk_no[i], batch->objid[i]);
+   }
+
+   if ( batch->count && ! run_info.no_delete ) {
+      if( (rc = delete_data_many(fh, batch->objids, batch->count, batch->status)) ) {
+         for (i=0; i < batch->count; i++) {
+            if (batch->status[i]) {
+               print_current_time();
+               fprintf(run_info.outfd,
+                       "delete error (errno: %d '%s') on object %s\n",
+                       batch->status[i], strerror(batch->status[i]),
+                       batch->objid[i]);
+            }
+         }
+      }
+   }
+
+   batch->count = 0;
+   return rc;
+}
+
+/***************************************************************************** 
+Name: release_dedup_chunk 
+
+ This function drops the reference that chunk fh->pre.chunk_no of a
+ deduplicated multi file holds on the object that has its data (see
+ dedup.h), and deletes that object if this was the last reference.
+ Returns -1 if error, 0 if successful
+*****************************************************************************/
+int release_dedup_chunk(MarFS_FileHandle *fh,
+                        File_Info        *file_info_ptr,
+                        const DedupEntry *ent)
+{
+   MarFS_XattrPre* pre_ptr = &fh->info.pre;
+   char            own_pre[MARFS_MAX_PRE_SIZE];
+   int             rc;
+
+   snprintf(own_pre, MARFS_MAX_PRE_SIZE, "%s/%s", pre_ptr->bucket, pre_ptr->objid);
+
+   // With '-n', we can't know whether ours is the last reference, without
+   // dropping it.
+   if ( run_info.no_delete ) {
+      print_delete_preamble();
+      fprintf(run_info.outfd, "chunk %zd of multi object %s (dedup ref %s)\n",
+              pre_ptr->chunk_no, own_pre, ent->pre);
+      return 0;
+   }
+
+   rc = dedup_unref(pre_ptr, ent, own_pre);
+   if (rc < 0) {
+      print_current_time();
+      fprintf(run_info.outfd, "dedup error (errno: %d '%s') on chunk %zd of %s\n",
+              errno, strerror(errno), pre_ptr->chunk_no, fh->info.post.md_path);
+      return -1;
+   }
+   else if (! rc)
+      return 0;                 // other files still use it
+
+   print_delete_preamble();
+   fprintf(run_info.outfd, "chunk %zd of multi object %s\n",
+           pre_ptr->chunk_no, ent->pre);
+
+   if ( (rc = dedup_delete(fh, ent)) ) {
+      fprintf(run_info.outfd, "ERROR: failed delete of object %s (returned code %d)\n",
+              ent->pre, rc);
+      return -1;
+   }
+   return 0;
+}
+
 /***************************************************************************** 
 Name: delete_file 
 
@@ -82,6 +82,7 @@ OF SUCH DAMAGE.
 
 #include "marfs_base.h"
 #include "common.h"             // marfs/fuse/src/common.h
+#include "dedup.h"
 #include "aws4c.h"
 #include "hash_table.h"
 
@@ -102,6 +103,9 @@ OF SUCH DAMAGE.
 
 #define TMP_LOCAL_FILE_LEN 1024 
 
+// chunk-objects of a Multi file are deleted this many at a time
+#define GC_DELETE_BATCH 256
+
 #define VERB_FPRINTF(...)  if( run_info.verbose ) { fprintf(__VA_ARGS__); }
 
 struct marfs_xattr {
@@ -139,6 +143,14 @@ typedef struct File_Info {
    unsigned char  restart_found;
 } File_Info;
 
+typedef struct Chunk_Batch {
+   size_t        count;
+   size_t        chunk_no[GC_DELETE_BATCH];
+   const char   *objids[GC_DELETE_BATCH];
+   int           status[GC_DELETE_BATCH];
+   char          objid[GC_DELETE_BATCH][MARFS_MAX_OBJID_SIZE];
+} Chunk_Batch;
+
 
 int read_inodes(const char   *fnameP, 
                 int          fileset_id, 
@@ -165,6 +177,15 @@ int  dump_trash(MarFS_FileHandle   *fh,
 int  delete_object(MarFS_FileHandle *fh,
                    File_Info        *file_info_ptr,
                    int               is_mult);
+int  queue_chunk(MarFS_FileHandle *fh,
+                 File_Info        *file_info_ptr,
+                 Chunk_Batch      *batch);
+int  delete_chunks(MarFS_FileHandle *fh,
+                   File_Info        *file_info_ptr,
+                   Chunk_Batch      *batch);
+int  release_dedup_chunk(MarFS_FileHandle *fh,
+                         File_Info        *file_info_ptr,
+                         const DedupEntry *ent);
 int  delete_file(char *filename);
 int  process_packed(hash_table_t* ht, hash_table_t* rt);
 void print_current_time();
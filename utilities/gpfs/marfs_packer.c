@@ -79,6 +79,7 @@
 #include <stdlib.h>
 #include <gpfs_fcntl.h>
 #include <sys/types.h>
+#include <sys/stat.h>
 #include <ctype.h>
 #include <attr/xattr.h>
 #include "marfs_base.h"
@@ -225,8 +226,24 @@ int main(int argc, char **argv){
         // inodes with directory paths
         // Once the paths are established perform a inode scan to find candidates
         // for packing.  If objects found, pack, write and update xattrs.
-        walk_and_scan_control (fnameP, ns, repo, namespace, no_pack_flag, 
-                               pack_elements_ptr);
+        walk_and_scan_control (fnameP, 3, namespace->md_path, ns, repo, 
+                               namespace, no_pack_flag, pack_elements_ptr);
+
+        // Files in MD shards (see fuse/src/shard.h) are under other roots,
+        // maybe on other filesystems.  Walk each of them on its own.  The
+        // walk above has found the directories, for get_marfs_path().
+        int k;
+        for (k = 0; k < namespace->md_shard_count; k++) {
+           struct stat st;
+           if (stat(namespace->md_shards[k], &st)) {
+              fprintf(stderr, "Error with MD shard %s: %s\n",
+                      namespace->md_shards[k], strerror(errno));
+              continue;
+           }
+           walk_and_scan_control (namespace->md_shards[k], st.st_ino,
+                                  namespace->md_shards[k], ns, repo,
+                                  namespace, no_pack_flag, pack_elements_ptr);
+        }
         //                        
         fclose(pack_elements_ptr->outfd);
         return 0;
@@ -656,6 +673,100 @@ int pop( struct walk_path stack[MAX_STACK_SIZE], int *top, struct walk_path *dat
 } // pop
 
 
+/******************************************************************************
+* Name record_dir / lookup_dir
+* Directories of a sharded namespace's primary tree, by inode.  A file in an
+* MD shard is in a bucket named for the inode of its directory
+* (<shard_root>/<hi>/<dir_ino>/<name>), so this is how get_marfs_path()
+* finds where it is in the namespace.
+******************************************************************************/
+struct dir_ent {
+   size_t  inode;
+   char   *path;
+};
+static struct dir_ent *dir_map = NULL;
+static size_t          dir_count = 0;
+static size_t          dir_alloc = 0;
+static int             dir_sorted = 0;
+
+static void record_dir(size_t inode, const char *top_level_path, const char *rel,
+                       const char *md_path)
+{
+   char *path = (char *)malloc(strlen(top_level_path) + strlen(rel) +1);
+   if (path == NULL)
+      return;
+   sprintf(path, "%s%s", top_level_path, rel);
+   if (strstr(path, md_path) == NULL) {
+      free(path);               // not in the namespace
+      return;
+   }
+
+   if (dir_count == dir_alloc) {
+      size_t alloc = (dir_alloc ? dir_alloc * 2 : 1024);
+      struct dir_ent *map = (struct dir_ent *)realloc(dir_map, alloc * sizeof(struct dir_ent));
+      if (map == NULL) {
+         fprintf(stderr, "Error allocating memory for directory map\n");
+         free(path);
+         return;
+      }
+      dir_map = map;
+      dir_alloc = alloc;
+   }
+   dir_map[dir_count].inode = inode;
+   dir_map[dir_count].path = path;
+   dir_count++;
+   dir_sorted = 0;
+}
+
+static int dir_ent_cmp(const void *a, const void *b)
+{
+   size_t x = ((const struct dir_ent *)a)->inode;
+   size_t y = ((const struct dir_ent *)b)->inode;
+   return ((x > y) - (x < y));
+}
+
+static const char *lookup_dir(size_t inode)
+{
+   if (!dir_sorted) {
+      qsort(dir_map, dir_count, sizeof(struct dir_ent), dir_ent_cmp);
+      dir_sorted = 1;
+   }
+   struct dir_ent key = { .inode = inode };
+   struct dir_ent *ent = (struct dir_ent *)bsearch(&key, dir_map, dir_count,
+                                                   sizeof(struct dir_ent), dir_ent_cmp);
+   return (ent ? ent->path : NULL);
+}
+
+// If <patht> is in an MD shard, put the path it would have in the primary
+// tree into <md_path>, and return 0.
+static int shard_md_path(const char *patht, char *md_path)
+{
+   NSIterator ns_iter = namespace_iterator();
+   MarFS_Namespace *ns;
+   int k;
+
+   while ((ns = namespace_next(&ns_iter))) {
+      for (k = 0; k < ns->md_shard_count; k++) {
+         size_t len = strlen(ns->md_shards[k]);
+         unsigned long dir_ino;
+         int name_pos = 0;
+         const char *dir;
+
+         if (strncmp(patht, ns->md_shards[k], len) || (patht[len] != '/'))
+            continue;
+         if ((sscanf(patht + len, "/%*u/%lu/%n", &dir_ino, &name_pos) < 1)
+             || !name_pos
+             || ((dir = lookup_dir(dir_ino)) == NULL)) {
+            fprintf(stderr, "Can't find the directory of %s\n", patht);
+            return -1;
+         }
+         snprintf(md_path, MAX_PATH_LENGTH, "%s/%s", dir, patht + len + name_pos);
+         return 0;
+      }
+   }
+   return -1;
+}
+
 /******************************************************************************
 * Name get_marfs_path
 * This function, given a metadata path, determines the fuse mount path for a 
@@ -665,6 +776,9 @@ int pop( struct walk_path stack[MAX_STACK_SIZE], int *top, struct walk_path *dat
 //int get_marfs_path(char * patht, char *marfs[]){
 void get_marfs_path(char * patht, char *marfs){
 	char *mnt_top = marfs_config->mnt_top;
+        char shard_path[MAX_PATH_LENGTH];
+        if (!shard_md_path(patht, shard_path))
+           patht = shard_path;
         MarFS_Namespace *ns;
 //	printf("got to get_marfs_path step1\n");
         NSIterator ns_iter;
@@ -710,7 +824,8 @@ void print_usage()
 * a set of paths are identified, pack_and_write is called to continue the 
 * process. 
 ******************************************************************************/
-int walk_and_scan_control (char* top_level_path, const char* ns,
+int walk_and_scan_control (char* top_level_path, size_t root_inode,
+                            const char* md_root, const char* ns,
                             MarFS_Repo* repo, MarFS_Namespace* namespace,
                             uint8_t no_pack, pack_vars *pack_params)
 {
@@ -731,7 +846,7 @@ int walk_and_scan_control (char* top_level_path, const char* ns,
    }
 
 
-   rdpath.inode = 3;
+   rdpath.inode = root_inode;
    strcpy(rdpath.path,top_level_path);
 
    // HAD TO SET THIS otherwise first pop was pulling garbage
@@ -777,6 +892,9 @@ int walk_and_scan_control (char* top_level_path, const char* ns,
                strcat(dpath.parent, "/");
                strcat(dpath.parent, dpath.path);
                push(stack, &top, &dpath);
+               if (namespace->md_shard_count && (root_inode == 3))
+                  record_dir(dpath.inode, top_level_path, dpath.parent,
+                             namespace->md_path);
                strcpy(dpath.parent, walkP.path);
             }
          }
@@ -790,7 +908,7 @@ int walk_and_scan_control (char* top_level_path, const char* ns,
             // instead of using dpath.inode, use counter value and update inode and path in structure
             //paths[dpath.inode] = dpath;
             LOG(LOG_INFO, "Found regular file %s\n", dpath.parent);
-            if ((strstr(dpath.parent, namespace->md_path))!=NULL) {
+            if ((strstr(dpath.parent, md_root))!=NULL) {
                paths[reg_file_cnt] = dpath;
                LOG(LOG_INFO, "found inode in desired namespace\n");
             //}
@@ -830,6 +948,29 @@ int walk_and_scan_control (char* top_level_path, const char* ns,
 }
 
 
+/******************************************************************************
+ * Name:  has_packed_md
+ * Does the inode have the packed MD xattr (MARFS_MD_XATTR)?  If so, any
+ * text xattrs it still has are left over from before it was converted.
+******************************************************************************/
+static int has_packed_md(gpfs_iscan_t *iscanP, const char *xattrP,
+                         unsigned int xattrLen)
+{
+   const char* nameP;
+   const char* valueP;
+   unsigned int valueLen;
+
+   while ((xattrP != NULL) && (xattrLen > 0)) {
+      if (gpfs_next_xattr(iscanP, &xattrP, &xattrLen, &nameP, &valueLen, &valueP)
+          || (nameP == NULL))
+         break;
+      if (strcmp(nameP, MARFS_MD_XATTR) == 0)
+         return 1;
+   }
+   return 0;
+}
+
+
 /******************************************************************************
  * Name:  get_inodes 
  * This function performs a gpfs inode scan looking for candidate
@@ -881,12 +1022,15 @@ int get_inodes(const char *fnameP, struct marfs_inode *inode,
       if (iattrP->ia_inode != 3 && xattr_len > 0) {
          const char *xattrBufP = xattrBP;
          unsigned int xattrBufLen = xattr_len;
+         int packed_md = has_packed_md(iscanP, xattrBP, xattr_len);
          //MarFS_XattrPre pre;
 
          gpfs_igetfilesetname(iscanP, iattrP->ia_filesetid,
                               &fileset_name_buffer, MARFS_MAX_NAMESPACE_NAME);
 
-         if (!strcmp(fileset_name_buffer, namespace)) {
+         // files in MD shards are in other filesets, but the walk found them
+         if (!strcmp(fileset_name_buffer, namespace)
+             || (find_inode(iattrP->ia_inode, paths, pack_params) != -1)) {
 
             // Get xattrs associated with file
             while ((xattrBufP != NULL) && (xattrBufLen > 0)) {
@@ -920,17 +1064,35 @@ int get_inodes(const char *fnameP, struct marfs_inode *inode,
 
                LOG(LOG_INFO,"xattr length %d\n", valueLen);
                LOG(LOG_INFO,"%s %d\n", valueP, valueLen);
+               int got_post = 0;
+
+               // packed MD xattr - has both pre and post structures
+               if (strcmp(nameP, MARFS_MD_XATTR) == 0){
+                  uint8_t            sections;
+                  MarFS_XattrRestart restart;
+                  char               objid[MARFS_MAX_BUCKET_SIZE + MARFS_MAX_OBJID_SIZE];
+
+                  if (bin_2_md(&pre, &post, &restart, &sections, valueP, valueLen, 1, 1)
+                      || ((sections & (MD_HAS_PRE | MD_HAS_POST)) != (MD_HAS_PRE | MD_HAS_POST))
+                      || pre_2_str(objid, sizeof(objid), &pre))
+                     continue;
+                  object=strdup(objid);
+                  got_post = 1;
+               }
                // If object xattr - convert to pre structure
-               if (strcmp(nameP, "user.marfs_objid") == 0){
+               else if ((strcmp(nameP, "user.marfs_objid") == 0) && !packed_md){
                   //LOG(LOG_INFO,"%s %d\n", valueP, valueLen);
                   ret = str_2_pre(&pre, valueP, NULL);
                   object=strdup(valueP);
                }
                // else if post xattr - convert to post structure
-               else if (strcmp(nameP, "user.marfs_post") == 0){
+               else if ((strcmp(nameP, "user.marfs_post") == 0) && !packed_md){
                   //MarFS_XattrPost post;
                   rc = str_2_post(&post, valueP, 1, 1); /* do we really want the post.md_path init'ed here? */
+                  got_post = 1;
+               }
 
+               if (got_post) {
                   // Check if this is a relevant object for packing 
                   if (post.flags != POST_TRASH && iattrP->ia_size > 0 && 
                       iattrP->ia_size<=pack_params->max_pack_file_size && 
@@ -148,7 +148,8 @@ int push( struct walk_path stack[MAX_STACK_SIZE],int *top, struct walk_path *dat
 int pop( struct walk_path stack[MAX_STACK_SIZE], int *top, struct walk_path *data);
 void get_marfs_path(char * patht, char marfs[]);
 void print_usage();
-int walk_and_scan_control (char* top_level_path, const char* ns,
+int walk_and_scan_control (char* top_level_path, size_t root_inode,
+                            const char* md_root, const char* ns,
                             MarFS_Repo* repo, MarFS_Namespace* namespace,
                             uint8_t no_pack_flag, pack_vars *pack_params);
 int get_inodes(const char *fnameP, struct marfs_inode *inode,
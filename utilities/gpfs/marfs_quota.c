@@ -78,8 +78,12 @@
 #include <unistd.h>
 #include <getopt.h>
 #include <sys/types.h>
+#include <ftw.h>
+#include <attr/xattr.h>
 #include "marfs_quota.h"
 #include "marfs_configuration.h"
+#include "aws4c.h"
+#include "utilities_common.h"
 
 /******************************************************************************
 * This program reads gpfs inodes and extended attributes in order to provide
@@ -270,15 +274,15 @@ Name: fill_size_histo
 This function counts file sizes based on small, medium, and large for 
 the purposes of displaying a size histogram.
 *****************************************************************************/
-static void fill_size_histo(const         gpfs_iattr_t *iattrP, 
+static void fill_size_histo(unsigned long long size, 
                             Fileset_Stats *fileset_buffer, 
                             int           index)
 {
 
-   if (iattrP->ia_size < SMALL_FILE_MAX) 
+   if (size < SMALL_FILE_MAX) 
      fileset_buffer[index].small_count+= 1;
    
-   else if (iattrP->ia_size < MEDIUM_FILE_MAX) 
+   else if (size < MEDIUM_FILE_MAX) 
      fileset_buffer[index].medium_count+= 1;
    else
      fileset_buffer[index].large_count+= 1;
@@ -309,6 +313,50 @@ int get_xattr_value(Marfs_Xattr *xattr_ptr,
    return(ret_value);
 }
 
+/***************************************************************************** 
+Name:  get_md_xattrs
+
+Stores the v1 strings from the packed MD xattr (see get_md_v1_xattrs())
+that are named in marfs_xattr, after the <count> already found.  A string
+replaces an older xattr of the same name, already found, because the
+packed xattr is the current one, when a file has both.  Returns the new
+count.
+
+*****************************************************************************/
+static int get_md_xattrs(const char *valueP,
+                         unsigned int valueLen,
+                         const char **marfs_xattr,
+                         int max_xattr_count,
+                         Marfs_Xattr *xattr_ptr,
+                         int count) {
+   V1_Xattr v1[MD_V1_XATTRS];
+   int v1_count;
+   int i;
+   int j;
+
+   v1_count = get_md_v1_xattrs(valueP, valueLen, v1);
+   for (j=0; j < v1_count; j++) {
+      for (i=0; i < max_xattr_count; i++) {
+         if (!strcmp(v1[j].name, marfs_xattr[i]))
+            break;
+      }
+      if (i == max_xattr_count)
+         continue;              // caller isn't interested
+
+      int index = get_xattr_value(xattr_ptr, v1[j].name, count, NULL);
+      if (index < 0) {
+         if (count >= MAX_MARFS_XATTR)
+            continue;
+         index = count++;
+      }
+      strcpy(xattr_ptr[index].xattr_name, v1[j].name);
+      strncpy(xattr_ptr[index].xattr_value, v1[j].value,
+              GPFS_FCNTL_XATTR_MAX_VALUELEN -1);
+      xattr_ptr[index].xattr_value[GPFS_FCNTL_XATTR_MAX_VALUELEN -1] = '\0';
+   }
+   return(count);
+}
+
 /***************************************************************************** 
 Name:  get_xattrs
 
@@ -331,6 +379,7 @@ size_t get_xattrs(gpfs_iscan_t *iscanP,
    int printable;
    size_t xattr_count = 0;
    int desired_xattr = 0;
+   Marfs_Xattr *first = xattr_ptr;
 
    /*  Loop through attributes */
    while ((xattrBufP != NULL) && (xattrBufLen > 0)) {
@@ -344,6 +393,19 @@ size_t get_xattrs(gpfs_iscan_t *iscanP,
       if (nameP == NULL)
          break;
 
+      // the packed MD xattr stands in for the ones below
+      if (!strcmp(nameP, MARFS_MD_XATTR)) {
+         xattr_count = get_md_xattrs(valueP, valueLen,
+                                     marfs_xattr, max_xattr_count,
+                                     first, xattr_count);
+         xattr_ptr   = first + xattr_count;
+         continue;
+      }
+
+      // a text xattr loses to the same one from the packed xattr
+      if (get_xattr_value(first, nameP, xattr_count, NULL) >= 0)
+         continue;
+
       // find marfs xattrs we care about by comaring our list of xattrs
       // to what the scan has found
       for ( i=0; i < max_xattr_count; i++) {
@@ -592,7 +654,7 @@ int read_inodes(const char    *fnameP,
                    last_struct_index,
                    iattrP->ia_size,
                    fileset_stat_ptr[last_struct_index].sum_size,iattrP->ia_inode);
-               fill_size_histo(iattrP, fileset_stat_ptr, last_struct_index); 
+               fill_size_histo(iattrP->ia_size, fileset_stat_ptr, last_struct_index); 
            
                //if trash and in trash fileset set flag so that non trash fileset files
                //can still be counted
@@ -661,11 +723,102 @@ int read_inodes(const char    *fnameP,
          }
       }
    } // endwhile
+
+   // -f limits the scan to one GPFS fileset, so leave out the shards
+   if (fileset_id < 0)
+      scan_md_shards(fileset_stat_ptr, rec_count, offset_start);
+
    write_fsinfo(outfd, fileset_stat_ptr, rec_count, offset_start, fnameP, non_marfs_inode_cnt);
    clean_exit(outfd, iscanP, fsP, early_exit);
    return(rc);
 }
 
+/***************************************************************************** 
+Name: scan_md_shards 
+
+A sharded namespace (see fuse/src/shard.h) keeps some of its MD files under
+the roots in md_shards, which are usually in other filesets, so the inode
+scan doesn't credit them to the namespace.  Walk each shard root, and add
+its files to the namespace's counts, as read_inodes() would.
+
+*****************************************************************************/
+static Fileset_Stats *shard_stat_ptr;  // for shard_file()
+static int            shard_index;
+
+static int shard_file(const char        *path,
+                      const struct stat *st,
+                      int               type,
+                      struct FTW        *ftw) {
+   static char        buf[MARFS_MAX_XATTR_SIZE];
+   MarFS_XattrPre     pre;
+   MarFS_XattrPost    post;
+   MarFS_XattrRestart restart;
+   uint8_t            sections = 0;
+   ssize_t            len;
+
+   if ((type != FTW_F) || ! S_ISREG(st->st_mode))
+      return 0;
+
+   // the packed MD xattr stands in for the text ones
+   len = lgetxattr(path, MARFS_MD_XATTR, buf, sizeof(buf));
+   if (len >= 0) {
+      if (bin_2_md(&pre, &post, &restart, &sections, buf, len, 1, 1)) {
+         fprintf(stderr, "ERROR: couldn't parse %s on %s -- %s\n",
+                 MARFS_MD_XATTR, path, strerror(errno));
+         return 0;
+      }
+   }
+   else {
+      if (lgetxattr(path, "user.marfs_restart", NULL, 0) >= 0)
+         sections |= MD_HAS_RESTART;
+      len = lgetxattr(path, "user.marfs_post", buf, sizeof(buf) -1);
+      if (len >= 0) {
+         buf[len] = '\0';
+         int test = str_2_post(&post, buf, 1, 1);
+         if (test == -3 || test == 0)
+            sections |= MD_HAS_POST;
+         else
+            LOG(LOG_ERR, "Something wrong with post value (return: %d). "
+                "File: %s Value: %s\n", test, path, buf);
+      }
+   }
+
+   if (sections & MD_HAS_RESTART) {
+      shard_stat_ptr[shard_index].sum_restart_size += st->st_size;
+      shard_stat_ptr[shard_index].sum_restart_file_count += 1;
+   }
+   if (sections & MD_HAS_POST) {
+      shard_stat_ptr[shard_index].sum_size += st->st_size;
+      shard_stat_ptr[shard_index].sum_file_count += 1;
+      fill_size_histo(st->st_size, shard_stat_ptr, shard_index);
+      update_type(&post, shard_stat_ptr, shard_index);
+      shard_stat_ptr[shard_index].sum_filespace_used += post.chunk_info_bytes;
+   }
+   return 0;
+}
+
+void scan_md_shards(Fileset_Stats *fileset_stat_ptr,
+                    size_t        rec_count,
+                    size_t        offset_start) {
+   MarFS_Namespace *ns;
+   size_t          i;
+   int             k;
+
+   shard_stat_ptr = fileset_stat_ptr;
+   for (i = offset_start; i < offset_start + rec_count; i++) {
+      if ((ns = find_namespace_by_name(fileset_stat_ptr[i].fileset_name)) == NULL)
+         continue;              // e.g. "trash"
+      shard_index = i;
+      for (k = 0; k < ns->md_shard_count; k++) {
+         LOG(LOG_INFO, "scanning MD shard %s of %s\n",
+             ns->md_shards[k], ns->name);
+         if (nftw(ns->md_shards[k], shard_file, 32, FTW_PHYS))
+            fprintf(stderr, "ERROR: couldn't scan MD shard %s -- %s\n",
+                    ns->md_shards[k], strerror(errno));
+      }
+   }
+}
+
 /***************************************************************************** 
 Name: lookup_fileset 
 
@@ -836,6 +989,7 @@ void update_type(MarFS_XattrPost * xattr_post,
          fileset_stat_ptr[index].obj_type.uni_count +=1;
          break;
       case OBJ_MULTI :
+      case OBJ_STRIPED :
          fileset_stat_ptr[index].obj_type.multi_count +=1;
          break;
       case OBJ_PACKED :
@@ -153,7 +153,8 @@ size_t get_xattrs(gpfs_iscan_t *iscanP,
 void print_usage();
 void init_records(Fileset_Stats *fileset_stat_buf, unsigned int record_count);
 int lookup_fileset(Fileset_Stats *fileset_stat_ptr, size_t rec_count, size_t offset_start, char *inode_fileset);
-static void fill_size_histo(const gpfs_iattr_t *iattrP, Fileset_Stats *fileset_buffer, int index);
+static void fill_size_histo(unsigned long long size, Fileset_Stats *fileset_buffer, int index);
+void scan_md_shards(Fileset_Stats *fileset_stat_ptr, size_t rec_count, size_t offset_start);
 void write_fsinfo(FILE* outfd, Fileset_Stats* fileset_stat_ptr, size_t rec_count, size_t index_start, const char *root_dir, size_t non_marfs_cnt);
 void update_type(MarFS_XattrPost * xattr_post, Fileset_Stats *fileset_stat_ptr, int index);
 int lookup_fileset_path(Fileset_Stats *fileset_stat_ptr, size_t rec_count, int *trash_index, char *md_path_ptr);
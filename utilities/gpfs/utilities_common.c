@@ -167,3 +167,45 @@ int setup_config(){
         aws_read_config("root");
         return 0;
 }
+
+/***************************************************************************** 
+Name:  get_md_v1_xattrs
+
+Files written with xattr_version 2 keep Pre, Post and Restart packed into
+one binary xattr (MARFS_MD_XATTR).  This function converts that value to
+the strings the older xattrs would have had.  For each section present,
+<v1> gets the v1 xattr name and its value.  The values are in static
+buffers, good until the next call.  Returns the number of entries filled
+(at most MD_V1_XATTRS), or -1 if the value can't be parsed.
+
+*****************************************************************************/
+int get_md_v1_xattrs(const char *valueP, unsigned int valueLen, V1_Xattr *v1) {
+   static char pre_str[MARFS_MAX_XATTR_SIZE];
+   static char post_str[MARFS_MAX_XATTR_SIZE];
+   static char restart_str[MARFS_MAX_XATTR_SIZE];
+   uint8_t sections;
+   int count = 0;
+   int j;
+
+   if (md_bin_2_strs(pre_str, post_str, restart_str, MARFS_MAX_XATTR_SIZE,
+                     &sections, valueP, valueLen)) {
+      fprintf(stderr, "ERROR: couldn't parse %s -- %s\n",
+              MARFS_MD_XATTR, strerror(errno));
+      return(-1);
+   }
+
+   const struct {
+      uint8_t     section;
+      V1_Xattr    xattr;
+   } all[MD_V1_XATTRS] = {
+      { MD_HAS_PRE,     { MarFS_XattrPrefix "objid",   pre_str } },
+      { MD_HAS_POST,    { MarFS_XattrPrefix "post",    post_str } },
+      { MD_HAS_RESTART, { MarFS_XattrPrefix "restart", restart_str } },
+   };
+
+   for (j=0; j < MD_V1_XATTRS; j++) {
+      if (sections & all[j].section)
+         v1[count++] = all[j].xattr;
+   }
+   return(count);
+}
@@ -75,7 +75,15 @@ enum{S3_GET, S3_PUT, S3_DELETE};
 #define HTTP_OK 200
 #define HTTP_NO_CONTENT 204
 
+// one of the text xattrs that xattr_version 1 used for Pre, Post, Restart
+typedef struct {
+   const char *name;
+   const char *value;
+} V1_Xattr;
+#define MD_V1_XATTRS 3
+
 void check_security_access(MarFS_XattrPre *pre);
 int check_S3_error( CURLcode curl_return, IOBuf *s3_buf, int action );
 int setup_config();
+int get_md_v1_xattrs(const char *valueP, unsigned int valueLen, V1_Xattr *v1);
 #endif